@@ -0,0 +1,246 @@
+#include "batch_transforms.hpp"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TK_BT_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define TK_BT_NEON
+#include <arm_neon.h>
+#endif
+#if defined(_MSC_VER) && !defined(__clang__) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace tk {
+namespace {
+
+#ifdef TK_BT_SSE2
+struct Sse2Ops {
+	typedef __m128 V;
+	static constexpr u32 N = 4;
+	static V set1(float x) { return _mm_set1_ps(x); }
+	static V add(V a, V b) { return _mm_add_ps(a, b); }
+	static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+	static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+	static V div(V a, V b) { return _mm_div_ps(a, b); }
+	static V fmadd(V a, V b, V c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+	static V abs(V a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+	static V min(V a, V b) { return _mm_min_ps(a, b); }
+	static V max(V a, V b) { return _mm_max_ps(a, b); }
+	static float hmin(V a) {
+		a = _mm_min_ps(a, _mm_movehl_ps(a, a));
+		return _mm_cvtss_f32(_mm_min_ss(a, _mm_shuffle_ps(a, a, 1)));
+	}
+	static float hmax(V a) {
+		a = _mm_max_ps(a, _mm_movehl_ps(a, a));
+		return _mm_cvtss_f32(_mm_max_ss(a, _mm_shuffle_ps(a, a, 1)));
+	}
+
+	// (x, y, z, 0). It doesn't read past the vec3, which could be the end of the array
+	static V loadVec3(const float* p) { return _mm_movelh_ps(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)p), _mm_load_ss(p + 2)); }
+	static void storeVec3(float* p, V v) {
+		_mm_storel_pi((__m64*)p, v);
+		_mm_store_ss(p + 2, _mm_movehl_ps(v, v));
+	}
+
+	static void load3(const float* p, size_t stride, V& x, V& y, V& z) {
+		V r0 = loadVec3(p), r1 = loadVec3(byteOffset(p, stride)), r2 = loadVec3(byteOffset(p, 2 * stride)), r3 = loadVec3(byteOffset(p, 3 * stride));
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		x = r0; y = r1; z = r2;
+	}
+	static void load4(const float* p, size_t stride, V& x, V& y, V& z, V& w) {
+		x = _mm_loadu_ps(p);
+		y = _mm_loadu_ps(byteOffset(p, stride));
+		z = _mm_loadu_ps(byteOffset(p, 2 * stride));
+		w = _mm_loadu_ps(byteOffset(p, 3 * stride));
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+	}
+	static void store3(float* p, size_t stride, V x, V y, V z) {
+		V w = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		storeVec3(p, x);
+		storeVec3(byteOffset(p, stride), y);
+		storeVec3(byteOffset(p, 2 * stride), z);
+		storeVec3(byteOffset(p, 3 * stride), w);
+	}
+	static void store4(float* p, size_t stride, V x, V y, V z, V w) {
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		_mm_storeu_ps(p, x);
+		_mm_storeu_ps(byteOffset(p, stride), y);
+		_mm_storeu_ps(byteOffset(p, 2 * stride), z);
+		_mm_storeu_ps(byteOffset(p, 3 * stride), w);
+	}
+};
+#endif
+
+#ifdef TK_BT_NEON
+struct NeonOps {
+	typedef float32x4_t V;
+	static constexpr u32 N = 4;
+	static V set1(float x) { return vdupq_n_f32(x); }
+	static V add(V a, V b) { return vaddq_f32(a, b); }
+	static V sub(V a, V b) { return vsubq_f32(a, b); }
+	static V mul(V a, V b) { return vmulq_f32(a, b); }
+	static V div(V a, V b) {
+#ifdef __aarch64__
+		return vdivq_f32(a, b);
+#else
+		// reciprocal estimate refined with two Newton-Raphson steps
+		V r = vrecpeq_f32(b);
+		r = vmulq_f32(vrecpsq_f32(b, r), r);
+		r = vmulq_f32(vrecpsq_f32(b, r), r);
+		return vmulq_f32(a, r);
+#endif
+	}
+	static V fmadd(V a, V b, V c) { return vmlaq_f32(c, a, b); }
+	static V abs(V a) { return vabsq_f32(a); }
+	static V min(V a, V b) { return vminq_f32(a, b); }
+	static V max(V a, V b) { return vmaxq_f32(a, b); }
+	static float hmin(V a) {
+		float32x2_t r = vpmin_f32(vget_low_f32(a), vget_high_f32(a));
+		return vget_lane_f32(vpmin_f32(r, r), 0);
+	}
+	static float hmax(V a) {
+		float32x2_t r = vpmax_f32(vget_low_f32(a), vget_high_f32(a));
+		return vget_lane_f32(vpmax_f32(r, r), 0);
+	}
+
+	static void transpose(V& r0, V& r1, V& r2, V& r3) {
+		const float32x4x2_t t01 = vtrnq_f32(r0, r1); // (a0 b0 a2 b2) (a1 b1 a3 b3)
+		const float32x4x2_t t23 = vtrnq_f32(r2, r3); // (c0 d0 c2 d2) (c1 d1 c3 d3)
+		r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+		r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+		r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+		r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+	}
+	static V loadVec3(const float* p) { return vcombine_f32(vld1_f32(p), vld1_lane_f32(p + 2, vdup_n_f32(0), 0)); }
+	static void storeVec3(float* p, V v) {
+		vst1_f32(p, vget_low_f32(v));
+		vst1q_lane_f32(p + 2, v, 2);
+	}
+
+	static void load3(const float* p, size_t stride, V& x, V& y, V& z) {
+		V w = loadVec3(byteOffset(p, 3 * stride));
+		x = loadVec3(p);
+		y = loadVec3(byteOffset(p, stride));
+		z = loadVec3(byteOffset(p, 2 * stride));
+		transpose(x, y, z, w);
+	}
+	static void load4(const float* p, size_t stride, V& x, V& y, V& z, V& w) {
+		x = vld1q_f32(p);
+		y = vld1q_f32(byteOffset(p, stride));
+		z = vld1q_f32(byteOffset(p, 2 * stride));
+		w = vld1q_f32(byteOffset(p, 3 * stride));
+		transpose(x, y, z, w);
+	}
+	static void store3(float* p, size_t stride, V x, V y, V z) {
+		V w = vdupq_n_f32(0);
+		transpose(x, y, z, w);
+		storeVec3(p, x);
+		storeVec3(byteOffset(p, stride), y);
+		storeVec3(byteOffset(p, 2 * stride), z);
+		storeVec3(byteOffset(p, 3 * stride), w);
+	}
+	static void store4(float* p, size_t stride, V x, V y, V z, V w) {
+		transpose(x, y, z, w);
+		vst1q_f32(p, x);
+		vst1q_f32(byteOffset(p, stride), y);
+		vst1q_f32(byteOffset(p, 2 * stride), z);
+		vst1q_f32(byteOffset(p, 3 * stride), w);
+	}
+};
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+static bool cpuSupportsAvx2Fma()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	const bool fma = info[2] & (1 << 12);
+	const bool osxsave = info[2] & (1 << 27);
+	if (!fma || !osxsave || (_xgetbv(0) & 6) != 6) // the OS must also save the YMM registers
+		return false;
+	__cpuidex(info, 7, 0);
+	return info[1] & (1 << 5);
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+#endif
+
+static BatchTransformKernels selectBatchTransformKernels()
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+	if (const auto* kernels = getBatchTransformKernels_avx2(); kernels && cpuSupportsAvx2Fma())
+		return *kernels;
+#endif
+#if defined(TK_BT_SSE2)
+	return makeBatchTransformKernels<Sse2Ops>("SSE2");
+#elif defined(TK_BT_NEON)
+	return makeBatchTransformKernels<NeonOps>("NEON");
+#else
+	return makeBatchTransformKernels<ScalarOps>("scalar");
+#endif
+}
+
+static const BatchTransformKernels& getKernels()
+{
+	static const BatchTransformKernels kernels = selectBatchTransformKernels();
+	return kernels;
+}
+
+template <typename T>
+BtIn toBt(StridedSpan<const T> s) { return { (const u8*)s.first, s.stride }; }
+template <typename T>
+BtOut toBt(StridedSpan<T> s) { return { (u8*)s.first, s.stride }; }
+
+}
+
+CStr batchTransforms_isa()
+{
+	return getKernels().isa;
+}
+
+void buildMtx_batch(StridedSpan<glm::mat4> out, StridedSpan<const glm::vec3> positions, StridedSpan<const glm::quat> rotations, StridedSpan<const glm::vec3> scales)
+{
+	assert(positions.size() == out.size() && rotations.size() == out.size() && scales.size() == out.size());
+	getKernels().buildMtx(toBt(out), toBt(positions), toBt(rotations), toBt(scales), out.size());
+}
+
+void mulMtx_batch(StridedSpan<glm::mat4> out, const glm::mat4& a, StridedSpan<const glm::mat4> b)
+{
+	assert(b.size() == out.size());
+	getKernels().mulMtx(toBt(out), &a[0][0], toBt(b), out.size());
+}
+
+void affineNormalMtx_batch(StridedSpan<glm::mat3> out, StridedSpan<const glm::mat4> m)
+{
+	assert(m.size() == out.size());
+	getKernels().affineNormalMtx(toBt(out), toBt(m), out.size());
+}
+
+void transformAABB_batch(StridedSpan<AABB> out, StridedSpan<const AABB> aabbs, StridedSpan<const glm::mat4> m)
+{
+	assert(aabbs.size() == out.size() && m.size() == out.size());
+	getKernels().transformAABBs(toBt(out), toBt(aabbs), toBt(m), out.size());
+}
+
+AABB pointCloudToAABB(CSpan<glm::vec3> positions)
+{
+	if (positions.empty())
+		return {};
+	const glm::vec3& p0 = positions[0];
+	float minMax[6] = { p0.x, p0.y, p0.z, p0.x, p0.y, p0.z };
+	getKernels().pointsMinMax(minMax, { (const u8*)positions.data(), sizeof(glm::vec3) }, positions.size());
+	return {
+		.min = { minMax[0], minMax[1], minMax[2] },
+		.max = { minMax[3], minMax[4], minMax[5] },
+	};
+}
+
+}
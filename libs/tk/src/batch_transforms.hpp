@@ -0,0 +1,230 @@
+#pragma once
+
+// Internal header of the batch transform kernels (the public API is in utils.hpp).
+// The kernels are written once, as templates over the SIMD operations, and instantiated in several translation units: batch_transforms.cpp (scalar, SSE2, NEON)
+// and batch_transforms_avx2.cpp, which is the only one built with AVX2 flags. The kernels have internal linkage, so the AVX2 instantiations can't be picked
+// by the linker for the other translation units. For the same reason, they work with raw floats, and must not call glm or other inline functions
+#include "utils.hpp"
+
+namespace tk {
+
+// these are shared by all the translation units, so they are plain data
+struct BtIn {
+	const u8* data;
+	size_t stride; // in bytes
+};
+struct BtOut {
+	u8* data;
+	size_t stride;
+};
+
+struct BatchTransformKernels {
+	const char* isa;
+	void (*buildMtx)(BtOut out, BtIn positions, BtIn rotations, BtIn scales, size_t n);
+	void (*mulMtx)(BtOut out, const float* a, BtIn b, size_t n);
+	void (*affineNormalMtx)(BtOut out, BtIn m, size_t n);
+	void (*transformAABBs)(BtOut out, BtIn aabbs, BtIn m, size_t n);
+	void (*pointsMinMax)(float (&minMax)[6], BtIn points, size_t n);
+};
+
+// nullptr if the AVX2 kernels were not built (not x86)
+const BatchTransformKernels* getBatchTransformKernels_avx2();
+
+namespace {
+
+#ifdef GLM_FORCE_QUAT_DATA_XYZW
+constexpr bool k_quatWFirst = false;
+#else
+constexpr bool k_quatWFirst = true; // glm's default memory layout is (w, x, y, z)
+#endif
+
+// the element i of an array, plus an offset in bytes
+const float* at(BtIn a, size_t i, size_t offset = 0) { return (const float*)(a.data + i * a.stride + offset); }
+float* at(BtOut a, size_t i, size_t offset = 0) { return (float*)(a.data + i * a.stride + offset); }
+template <typename T>
+T* byteOffset(T* p, size_t bytes) { return (T*)((std::conditional_t<std::is_const_v<T>, const u8, u8>*)p + bytes); }
+
+// the ops of a SIMD instruction set. The lanes are consecutive elements of the arrays:
+// load3/load4 read a vec3/vec4 of each lane and transpose them, so each register has the same component of all the lanes. store3/store4 do the opposite
+struct ScalarOps {
+	typedef float V;
+	static constexpr u32 N = 1;
+	static V set1(float x) { return x; }
+	static V add(V a, V b) { return a + b; }
+	static V sub(V a, V b) { return a - b; }
+	static V mul(V a, V b) { return a * b; }
+	static V div(V a, V b) { return a / b; }
+	static V fmadd(V a, V b, V c) { return a * b + c; }
+	static V abs(V a) { return a < 0 ? -a : a; }
+	static V min(V a, V b) { return b < a ? b : a; }
+	static V max(V a, V b) { return a < b ? b : a; }
+	static float hmin(V a) { return a; }
+	static float hmax(V a) { return a; }
+	static void load3(const float* p, size_t, V& x, V& y, V& z) { x = p[0]; y = p[1]; z = p[2]; }
+	static void load4(const float* p, size_t, V& x, V& y, V& z, V& w) { x = p[0]; y = p[1]; z = p[2]; w = p[3]; }
+	static void store3(float* p, size_t, V x, V y, V z) { p[0] = x; p[1] = y; p[2] = z; }
+	static void store4(float* p, size_t, V x, V y, V z, V w) { p[0] = x; p[1] = y; p[2] = z; p[3] = w; }
+};
+
+// The kernels process the elements [i, n) in blocks of S::N, and return the first element they didn't process (the remainder is left for ScalarOps)
+
+// out[i] = translate(positions[i]) * toMat4(rotations[i]) * scale(scales[i]). Same as buildMtx()
+template <typename S>
+size_t bt_buildMtx(BtOut out, BtIn positions, BtIn rotations, BtIn scales, size_t i, size_t n)
+{
+	typedef typename S::V V;
+	const V zero = S::set1(0), one = S::set1(1);
+	for (; i + S::N <= n; i += S::N) {
+		V px, py, pz, qx, qy, qz, qw, sx, sy, sz;
+		S::load3(at(positions, i), positions.stride, px, py, pz);
+		if constexpr (k_quatWFirst)
+			S::load4(at(rotations, i), rotations.stride, qw, qx, qy, qz);
+		else
+			S::load4(at(rotations, i), rotations.stride, qx, qy, qz, qw);
+		S::load3(at(scales, i), scales.stride, sx, sy, sz);
+
+		const V x2 = S::add(qx, qx), y2 = S::add(qy, qy), z2 = S::add(qz, qz);
+		const V xx = S::mul(qx, x2), yy = S::mul(qy, y2), zz = S::mul(qz, z2);
+		const V xy = S::mul(qx, y2), xz = S::mul(qx, z2), yz = S::mul(qy, z2);
+		const V wx = S::mul(qw, x2), wy = S::mul(qw, y2), wz = S::mul(qw, z2);
+
+		S::store4(at(out, i, 0), out.stride,
+			S::mul(S::sub(one, S::add(yy, zz)), sx), S::mul(S::add(xy, wz), sx), S::mul(S::sub(xz, wy), sx), zero);
+		S::store4(at(out, i, 16), out.stride,
+			S::mul(S::sub(xy, wz), sy), S::mul(S::sub(one, S::add(xx, zz)), sy), S::mul(S::add(yz, wx), sy), zero);
+		S::store4(at(out, i, 32), out.stride,
+			S::mul(S::add(xz, wy), sz), S::mul(S::sub(yz, wx), sz), S::mul(S::sub(one, S::add(xx, yy)), sz), zero);
+		S::store4(at(out, i, 48), out.stride, px, py, pz, one);
+	}
+	return i;
+}
+
+// out[i] = a * b[i]. "a" is column major. "out" can be the same as "b"
+template <typename S>
+size_t bt_mulMtx(BtOut out, const float* a, BtIn b, size_t i, size_t n)
+{
+	typedef typename S::V V;
+	V A[16];
+	for (u32 k = 0; k < 16; k++)
+		A[k] = S::set1(a[k]);
+	for (; i + S::N <= n; i += S::N) {
+		for (u32 c = 0; c < 4; c++) {
+			V bx, by, bz, bw;
+			S::load4(at(b, i, 16 * c), b.stride, bx, by, bz, bw);
+			V r[4];
+			for (u32 k = 0; k < 4; k++)
+				r[k] = S::fmadd(A[k], bx, S::fmadd(A[4 + k], by, S::fmadd(A[8 + k], bz, S::mul(A[12 + k], bw))));
+			S::store4(at(out, i, 16 * c), out.stride, r[0], r[1], r[2], r[3]);
+		}
+	}
+	return i;
+}
+
+// out[i] = mat3(inverse(transpose(m[i]))), assuming m[i] is affine: the inverse-transpose of the 3x3 part is its cofactor matrix divided by the determinant
+template <typename S>
+size_t bt_affineNormalMtx(BtOut out, BtIn m, size_t i, size_t n)
+{
+	typedef typename S::V V;
+	const V one = S::set1(1);
+	auto cross = [](V ax, V ay, V az, V bx, V by, V bz, V& cx, V& cy, V& cz) {
+		cx = S::sub(S::mul(ay, bz), S::mul(az, by));
+		cy = S::sub(S::mul(az, bx), S::mul(ax, bz));
+		cz = S::sub(S::mul(ax, by), S::mul(ay, bx));
+	};
+	for (; i + S::N <= n; i += S::N) {
+		V a[3][4];
+		for (u32 c = 0; c < 3; c++)
+			S::load4(at(m, i, 16 * c), m.stride, a[c][0], a[c][1], a[c][2], a[c][3]);
+		V r[3][3];
+		cross(a[1][0], a[1][1], a[1][2], a[2][0], a[2][1], a[2][2], r[0][0], r[0][1], r[0][2]);
+		cross(a[2][0], a[2][1], a[2][2], a[0][0], a[0][1], a[0][2], r[1][0], r[1][1], r[1][2]);
+		cross(a[0][0], a[0][1], a[0][2], a[1][0], a[1][1], a[1][2], r[2][0], r[2][1], r[2][2]);
+		const V det = S::fmadd(a[0][0], r[0][0], S::fmadd(a[0][1], r[0][1], S::mul(a[0][2], r[0][2])));
+		const V invDet = S::div(one, det);
+		for (u32 c = 0; c < 3; c++)
+			S::store3(at(out, i, 12 * c), out.stride, S::mul(r[c][0], invDet), S::mul(r[c][1], invDet), S::mul(r[c][2], invDet));
+	}
+	return i;
+}
+
+// out[i] = the AABB of aabbs[i] transformed by the affine matrix m[i]. The extents are transformed by the absolute value of the 3x3 part (Arvo's method)
+template <typename S>
+size_t bt_transformAABBs(BtOut out, BtIn aabbs, BtIn m, size_t i, size_t n)
+{
+	typedef typename S::V V;
+	const V half = S::set1(0.5f);
+	for (; i + S::N <= n; i += S::N) {
+		V minX, minY, minZ, maxX, maxY, maxZ;
+		S::load3(at(aabbs, i, 0), aabbs.stride, minX, minY, minZ);
+		S::load3(at(aabbs, i, 12), aabbs.stride, maxX, maxY, maxZ);
+		const V c[3] = { S::mul(S::add(minX, maxX), half), S::mul(S::add(minY, maxY), half), S::mul(S::add(minZ, maxZ), half) };
+		const V e[3] = { S::mul(S::sub(maxX, minX), half), S::mul(S::sub(maxY, minY), half), S::mul(S::sub(maxZ, minZ), half) };
+		V a[4][4];
+		for (u32 col = 0; col < 4; col++)
+			S::load4(at(m, i, 16 * col), m.stride, a[col][0], a[col][1], a[col][2], a[col][3]);
+		V nc[3], ne[3];
+		for (u32 k = 0; k < 3; k++) {
+			nc[k] = S::fmadd(a[0][k], c[0], S::fmadd(a[1][k], c[1], S::fmadd(a[2][k], c[2], a[3][k])));
+			ne[k] = S::fmadd(S::abs(a[0][k]), e[0], S::fmadd(S::abs(a[1][k]), e[1], S::mul(S::abs(a[2][k]), e[2])));
+		}
+		S::store3(at(out, i, 0), out.stride, S::sub(nc[0], ne[0]), S::sub(nc[1], ne[1]), S::sub(nc[2], ne[2]));
+		S::store3(at(out, i, 12), out.stride, S::add(nc[0], ne[0]), S::add(nc[1], ne[1]), S::add(nc[2], ne[2]));
+	}
+	return i;
+}
+
+// minMax = { min.xyz, max.xyz } of minMax and the points
+template <typename S>
+size_t bt_pointsMinMax(float (&minMax)[6], BtIn points, size_t i, size_t n)
+{
+	typedef typename S::V V;
+	V mn[3], mx[3];
+	for (u32 k = 0; k < 3; k++) {
+		mn[k] = S::set1(minMax[k]);
+		mx[k] = S::set1(minMax[3 + k]);
+	}
+	for (; i + S::N <= n; i += S::N) {
+		V p[3];
+		S::load3(at(points, i), points.stride, p[0], p[1], p[2]);
+		for (u32 k = 0; k < 3; k++) {
+			mn[k] = S::min(mn[k], p[k]);
+			mx[k] = S::max(mx[k], p[k]);
+		}
+	}
+	for (u32 k = 0; k < 3; k++) {
+		minMax[k] = S::hmin(mn[k]);
+		minMax[3 + k] = S::hmax(mx[k]);
+	}
+	return i;
+}
+
+template <typename S>
+constexpr BatchTransformKernels makeBatchTransformKernels(const char* isa)
+{
+	return {
+		.isa = isa,
+		.buildMtx = [](BtOut out, BtIn positions, BtIn rotations, BtIn scales, size_t n) {
+			const size_t i = bt_buildMtx<S>(out, positions, rotations, scales, 0, n);
+			bt_buildMtx<ScalarOps>(out, positions, rotations, scales, i, n);
+		},
+		.mulMtx = [](BtOut out, const float* a, BtIn b, size_t n) {
+			const size_t i = bt_mulMtx<S>(out, a, b, 0, n);
+			bt_mulMtx<ScalarOps>(out, a, b, i, n);
+		},
+		.affineNormalMtx = [](BtOut out, BtIn m, size_t n) {
+			const size_t i = bt_affineNormalMtx<S>(out, m, 0, n);
+			bt_affineNormalMtx<ScalarOps>(out, m, i, n);
+		},
+		.transformAABBs = [](BtOut out, BtIn aabbs, BtIn m, size_t n) {
+			const size_t i = bt_transformAABBs<S>(out, aabbs, m, 0, n);
+			bt_transformAABBs<ScalarOps>(out, aabbs, m, i, n);
+		},
+		.pointsMinMax = [](float (&minMax)[6], BtIn points, size_t n) {
+			const size_t i = bt_pointsMinMax<S>(minMax, points, 0, n);
+			bt_pointsMinMax<ScalarOps>(minMax, points, i, n);
+		},
+	};
+}
+
+}
+}
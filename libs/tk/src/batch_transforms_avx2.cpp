@@ -0,0 +1,100 @@
+// This file is built with AVX2 and FMA enabled (see CMakeLists.txt). Its kernels are only called if the CPU supports them (see batch_transforms.cpp)
+#include "batch_transforms.hpp"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace tk {
+
+#if defined(__AVX2__)
+namespace {
+
+struct Avx2Ops {
+	typedef __m256 V;
+	static constexpr u32 N = 8;
+	static V set1(float x) { return _mm256_set1_ps(x); }
+	static V add(V a, V b) { return _mm256_add_ps(a, b); }
+	static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+	static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+	static V div(V a, V b) { return _mm256_div_ps(a, b); }
+	static V fmadd(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+	static V abs(V a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a); }
+	static V min(V a, V b) { return _mm256_min_ps(a, b); }
+	static V max(V a, V b) { return _mm256_max_ps(a, b); }
+	static float hmin(V a) {
+		__m128 r = _mm_min_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+		r = _mm_min_ps(r, _mm_movehl_ps(r, r));
+		return _mm_cvtss_f32(_mm_min_ss(r, _mm_shuffle_ps(r, r, 1)));
+	}
+	static float hmax(V a) {
+		__m128 r = _mm_max_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+		r = _mm_max_ps(r, _mm_movehl_ps(r, r));
+		return _mm_cvtss_f32(_mm_max_ss(r, _mm_shuffle_ps(r, r, 1)));
+	}
+
+	// the low half of each register has the elements [0, 4), and the high half the elements [4, 8). So the 4x4 transposes are done in each half
+	static V combine(__m128 lo, __m128 hi) { return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1); }
+	static void transpose(V& r0, V& r1, V& r2, V& r3) {
+		const V t0 = _mm256_unpacklo_ps(r0, r1); // a0 b0 a1 b1
+		const V t1 = _mm256_unpackhi_ps(r0, r1); // a2 b2 a3 b3
+		const V t2 = _mm256_unpacklo_ps(r2, r3); // c0 d0 c1 d1
+		const V t3 = _mm256_unpackhi_ps(r2, r3); // c2 d2 c3 d3
+		r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	}
+	static __m128 loadVec3(const float* p) { return _mm_movelh_ps(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)p), _mm_load_ss(p + 2)); }
+	static void storeVec3(float* p, __m128 v) {
+		_mm_storel_pi((__m64*)p, v);
+		_mm_store_ss(p + 2, _mm_movehl_ps(v, v));
+	}
+
+	static void load3(const float* p, size_t stride, V& x, V& y, V& z) {
+		V r[4];
+		for (u32 k = 0; k < 4; k++)
+			r[k] = combine(loadVec3(byteOffset(p, k * stride)), loadVec3(byteOffset(p, (k + 4) * stride)));
+		transpose(r[0], r[1], r[2], r[3]);
+		x = r[0]; y = r[1]; z = r[2];
+	}
+	static void load4(const float* p, size_t stride, V& x, V& y, V& z, V& w) {
+		V r[4];
+		for (u32 k = 0; k < 4; k++)
+			r[k] = combine(_mm_loadu_ps(byteOffset(p, k * stride)), _mm_loadu_ps(byteOffset(p, (k + 4) * stride)));
+		transpose(r[0], r[1], r[2], r[3]);
+		x = r[0]; y = r[1]; z = r[2]; w = r[3];
+	}
+	static void store3(float* p, size_t stride, V x, V y, V z) {
+		V r[4] = { x, y, z, _mm256_setzero_ps() };
+		transpose(r[0], r[1], r[2], r[3]);
+		for (u32 k = 0; k < 4; k++) {
+			storeVec3(byteOffset(p, k * stride), _mm256_castps256_ps128(r[k]));
+			storeVec3(byteOffset(p, (k + 4) * stride), _mm256_extractf128_ps(r[k], 1));
+		}
+	}
+	static void store4(float* p, size_t stride, V x, V y, V z, V w) {
+		V r[4] = { x, y, z, w };
+		transpose(r[0], r[1], r[2], r[3]);
+		for (u32 k = 0; k < 4; k++) {
+			_mm_storeu_ps(byteOffset(p, k * stride), _mm256_castps256_ps128(r[k]));
+			_mm_storeu_ps(byteOffset(p, (k + 4) * stride), _mm256_extractf128_ps(r[k], 1));
+		}
+	}
+};
+
+const BatchTransformKernels k_avx2Kernels = makeBatchTransformKernels<Avx2Ops>("AVX2+FMA");
+
+}
+
+const BatchTransformKernels* getBatchTransformKernels_avx2()
+{
+	return &k_avx2Kernels;
+}
+#else
+const BatchTransformKernels* getBatchTransformKernels_avx2()
+{
+	return nullptr;
+}
+#endif
+
+}
@@ -0,0 +1,82 @@
+#include "frame_arena.hpp"
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+namespace tk {
+
+static constexpr size_t FRAME_ARENA_INITIAL_BLOCK_SIZE = 64u << 10u;
+
+static std::atomic<u64> g_frameInd = 1;
+static thread_local FrameArena tl_frameArena;
+
+FrameArena::~FrameArena()
+{
+	for (auto& b : blocks)
+		free(b.data);
+}
+
+void FrameArena::reset()
+{
+	if (blocks.size() > 1) {
+		size_t totalSize = 0;
+		for (auto& b : blocks)
+			totalSize += b.size;
+		// if the merged block can't be allocated, we just keep the current blocks
+		if (u8* data = (u8*)malloc(totalSize)) {
+			for (auto& b : blocks)
+				free(b.data);
+			blocks.resize(1);
+			blocks[0] = { data, totalSize };
+		}
+	}
+	blockInd = 0;
+	offset = 0;
+}
+
+void* FrameArena::do_allocate(size_t size, size_t alignment)
+{
+	while (blockInd < blocks.size()) {
+		auto& b = blocks[blockInd];
+		const uintptr_t p = (uintptr_t(b.data) + offset + alignment - 1) & ~uintptr_t(alignment - 1);
+		const size_t o = size_t(p - uintptr_t(b.data));
+		if (o + size <= b.size) {
+			offset = o + size;
+			return b.data + o;
+		}
+		// doesn't fit, try the next block (there can be more if we have rewound)
+		blockInd++;
+		offset = 0;
+	}
+
+	// the new block is at least as big as all the previous ones together, so the number of blocks stays small
+	size_t blockSize = FRAME_ARENA_INITIAL_BLOCK_SIZE;
+	for (auto& b : blocks)
+		blockSize += b.size;
+	blockSize = glm::max(blockSize, size + alignment);
+	u8* data = (u8*)malloc(blockSize);
+	if (!data)
+		throw std::bad_alloc(); // what memory_resource requires
+	blocks.push_back({ data, blockSize });
+	blockInd = u32(blocks.size() - 1);
+	offset = 0;
+	return do_allocate(size, alignment);
+}
+
+FrameArena& getFrameArena()
+{
+	auto& arena = tl_frameArena;
+	const u64 frameInd = g_frameInd.load(std::memory_order_relaxed);
+	if (arena.frameInd != frameInd) {
+		arena.reset();
+		arena.frameInd = frameInd;
+	}
+	return arena;
+}
+
+void frameArenas_nextFrame()
+{
+	g_frameInd.fetch_add(1, std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "utils.hpp"
+#include <memory_resource>
+
+// Linear (bump) allocators for the transient memory of hot paths, so they don't hit the heap every frame.
+// Each thread has its own arena, which is reset at frame boundaries. Use it through std::pmr containers:
+//     FrameArenaScope scratch;
+//     std::pmr::vector<u32> v(n, 0, &scratch.arena);
+// The memory must not outlive the frame, and a scope must not be kept alive across a frame boundary.
+// The scopes also give back their memory when they end, so code that isn't tied to frames can use them too
+namespace tk {
+
+struct FrameArena : std::pmr::memory_resource {
+	struct Block {
+		u8* data;
+		size_t size;
+	};
+	struct Marker {
+		u32 blockInd;
+		size_t offset;
+	};
+
+	std::vector<Block> blocks;
+	u32 blockInd = 0; // the block we are allocating from
+	size_t offset = 0; // inside the current block
+	u64 frameInd = 0; // the frame of the last reset
+
+	FrameArena() {}
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+	~FrameArena() override;
+
+	Marker mark()const { return { blockInd, offset }; }
+	void rewind(Marker m) { blockInd = m.blockInd; offset = m.offset; }
+	// frees all the allocations. If several blocks were needed, they are merged into one big block, so next frames don't need to grow it
+	void reset();
+
+protected:
+	void* do_allocate(size_t size, size_t alignment) override;
+	void do_deallocate(void*, size_t, size_t) override {} // the memory is released by rewind() or reset()
+	bool do_is_equal(const std::pmr::memory_resource& o)const noexcept override { return this == &o; }
+};
+
+// the arena of the calling thread. It's reset the first time it's accessed in each frame
+FrameArena& getFrameArena();
+// marks a frame boundary for the arenas of all the threads (tg::draw calls it)
+void frameArenas_nextFrame();
+
+// gives back the memory allocated in the arena while the scope was alive
+struct FrameArenaScope {
+	FrameArena& arena;
+	FrameArena::Marker marker;
+
+	FrameArenaScope() : arena(getFrameArena()), marker(arena.mark()) {}
+	~FrameArenaScope() { arena.rewind(marker); }
+	FrameArenaScope(const FrameArenaScope&) = delete;
+	FrameArenaScope& operator=(const FrameArenaScope&) = delete;
+};
+
+}
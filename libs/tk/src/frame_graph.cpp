@@ -0,0 +1,185 @@
+#include "frame_graph.hpp"
+
+namespace tk {
+namespace gfx {
+
+struct FgAccessInfo {
+	vk::PipelineStages stages;
+	vk::AccessFlags access;
+	vk::ImageLayout layout; // undefined: the layout is not changed by the graph
+	bool write;
+};
+static const FgAccessInfo k_fgAccessInfos[] = {
+	// transferWrite
+	{ vk::PipelineStages::transfer, vk::AccessFlags::transferWrite, vk::ImageLayout::transferDst, true },
+	// transferRead
+	{ vk::PipelineStages::transfer, vk::AccessFlags::transferRead, vk::ImageLayout::transferSrc, false },
+	// vertexInputRead
+	{ vk::PipelineStages::vertexInput, vk::AccessFlags::vertexAttributeRead | vk::AccessFlags::indexRead, vk::ImageLayout::undefined, false },
+	// shaderUniformRead
+	{ vk::PipelineStages::vertexShader | vk::PipelineStages::fragmentShader, vk::AccessFlags::uniformRead | vk::AccessFlags::shaderRead, vk::ImageLayout::undefined, false },
+	// shaderSampledRead
+	{ vk::PipelineStages::fragmentShader, vk::AccessFlags::shaderRead, vk::ImageLayout::shaderReadOnly, false },
+	// colorAttachmentWrite
+	{ vk::PipelineStages::colorAttachmentOutput, vk::AccessFlags::colorAtachmentRead | vk::AccessFlags::colorAtachmentWrite, vk::ImageLayout::undefined, true },
+	// depthAttachmentWrite
+	{ vk::PipelineStages::earlyFragmentTests | vk::PipelineStages::lateFragmentTests,
+		vk::AccessFlags::depthStencilAtachmentRead | vk::AccessFlags::depthStencilAtachmentWrite, vk::ImageLayout::undefined, true },
+};
+static_assert(std::size(k_fgAccessInfos) == size_t(FgAccess::COUNT));
+
+void FrameGraph::clear()
+{
+	resources.clear();
+	uses.clear();
+	passes.clear();
+	imageBarriers.clear();
+}
+
+FgResource FrameGraph::importMemory(FgAccess lastAccess)
+{
+	const u32 id = u32(resources.size());
+	auto& res = resources.emplace_back();
+	res.memory = id;
+	if (lastAccess != FgAccess::COUNT) {
+		const auto& info = k_fgAccessInfos[u32(lastAccess)];
+		if (info.write) {
+			res.writeStages = info.stages;
+			res.writeAccess = info.access;
+		}
+		else {
+			res.readStages = info.stages;
+		}
+	}
+	return { id };
+}
+
+FgResource FrameGraph::importImage(VkImage image, vk::ImageAspects aspects, vk::ImageLayout layout, FgResource memory)
+{
+	const u32 id = u32(resources.size());
+	auto& res = resources.emplace_back();
+	res.image = image;
+	res.aspects = aspects;
+	res.layout = layout;
+	res.memory = memory.isValid() ? resources[memory.id].memory : id;
+	return { id };
+}
+
+u32 FrameGraph::addPass(const char* name, vk::CmdBuffer& cmdBuffer)
+{
+	const u32 passInd = u32(passes.size());
+	passes.push_back(Pass{
+		.name = name,
+		.cmdBuffer = &cmdBuffer,
+		.firstUse = u32(uses.size()),
+		.numUses = 0,
+	});
+	return passInd;
+}
+
+void FrameGraph::use(FgResource res, FgAccess access, vk::ImageLayout layoutAfter)
+{
+	assert(passes.size() && res.isValid() && access < FgAccess::COUNT);
+	uses.push_back({ res.id, access, layoutAfter });
+	passes.back().numUses++;
+}
+
+void FrameGraph::compile()
+{
+	imageBarriers.clear();
+	for (auto& pass : passes) {
+		pass.srcStages = pass.dstStages = vk::PipelineStages::none;
+		pass.srcAccess = pass.dstAccess = vk::AccessFlags::none;
+		pass.firstImageBarrier = u32(imageBarriers.size());
+
+		for (u32 useI = pass.firstUse; useI < pass.firstUse + pass.numUses; useI++) {
+			const auto& use = uses[useI];
+			auto& res = resources[use.resource];
+			auto& mem = resources[res.memory];
+			const auto& info = k_fgAccessInfos[u32(use.access)];
+			const bool transition = res.image && info.layout != vk::ImageLayout::undefined && res.layout != info.layout;
+
+			vk::PipelineStages srcStages = vk::PipelineStages::none;
+			vk::AccessFlags srcAccess = vk::AccessFlags::none;
+			if (info.write || transition) {
+				// write-after-write and write-after-read. A layout transition counts as a write
+				srcStages = mem.writeStages | mem.readStages;
+				srcAccess = mem.writeAccess;
+				mem.writeStages = info.stages;
+				mem.writeAccess = info.write ? info.access : vk::AccessFlags::none;
+				mem.readStages = info.write ? vk::PipelineStages::none : info.stages;
+				mem.visibleStages = info.write ? vk::PipelineStages::none : info.stages;
+				mem.visibleAccess = info.write ? vk::AccessFlags::none : info.access;
+			}
+			else {
+				// read-after-write. Once the write has been made visible to a stage, it doesn't need more barriers
+				const bool alreadyVisible =
+					(info.stages & ~mem.visibleStages) == vk::PipelineStages::none &&
+					(info.access & ~mem.visibleAccess) == vk::AccessFlags::none;
+				if (mem.writeStages != vk::PipelineStages::none && !alreadyVisible) {
+					srcStages = mem.writeStages;
+					srcAccess = mem.writeAccess;
+					mem.visibleStages |= info.stages;
+					mem.visibleAccess |= info.access;
+				}
+				mem.readStages |= info.stages;
+			}
+
+			if (transition) {
+				imageBarriers.push_back(vk::ImageBarrier{
+					.srcAccess = srcAccess,
+					.dstAccess = info.access,
+					.srcLayout = res.layout,
+					.dstLayout = info.layout,
+					.image = res.image,
+					.subresourceRange = {
+						.aspects = res.aspects,
+						.numMips = VK_REMAINING_MIP_LEVELS,
+						.numLayers = VK_REMAINING_ARRAY_LAYERS,
+					},
+				});
+				pass.srcStages |= srcStages == vk::PipelineStages::none ? vk::PipelineStages::topOfPipe : srcStages;
+				pass.dstStages |= info.stages;
+			}
+			else if (srcStages != vk::PipelineStages::none) {
+				pass.srcStages |= srcStages;
+				pass.dstStages |= info.stages;
+				if (srcAccess != vk::AccessFlags::none) {
+					pass.srcAccess |= srcAccess;
+					pass.dstAccess |= info.access;
+				}
+			}
+
+			if (transition)
+				res.layout = info.layout;
+			if (use.layoutAfter != vk::ImageLayout::undefined)
+				res.layout = use.layoutAfter;
+		}
+
+		pass.numImageBarriers = u32(imageBarriers.size()) - pass.firstImageBarrier;
+	}
+}
+
+void FrameGraph::recordBarriers(u32 passInd)
+{
+	const auto& pass = passes[passInd];
+	if (pass.srcStages == vk::PipelineStages::none)
+		return;
+
+	const vk::MemoryBarrier memoryBarrier = {
+		.srcAccess = pass.srcAccess,
+		.dstAccess = pass.dstAccess,
+	};
+	const bool hasMemoryBarrier = pass.srcAccess != vk::AccessFlags::none;
+	pass.cmdBuffer->cmd_pipelineBarrier({
+		.srcStages = pass.srcStages,
+		.dstStages = pass.dstStages,
+		.dependencyFlags = vk::DependencyFlags::none,
+		.memoryBarriers = {&memoryBarrier, hasMemoryBarrier ? 1u : 0u},
+		.bufferBarriers = {},
+		.imageBarriers = {imageBarriers.data() + pass.firstImageBarrier, pass.numImageBarriers},
+	});
+}
+
+}
+}
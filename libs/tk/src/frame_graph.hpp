@@ -0,0 +1,76 @@
+#pragma once
+
+#include "tvk.hpp"
+
+// A small frame graph. Every frame, the passes are declared in execution order, along with the resources they access.
+// The pipeline barriers (and image layout transitions) between the passes are derived from those declarations, instead of being hand-written
+namespace tk {
+namespace gfx {
+
+enum class FgAccess : u8 {
+	transferWrite,
+	transferRead, // from images, in the transferSrc layout
+	vertexInputRead, // vertex and index buffers
+	shaderUniformRead, // uniform and storage buffers, from the vertex and fragment shaders
+	shaderSampledRead, // sampled images, from the fragment shader
+	colorAttachmentWrite, // the render pass does the layout transitions of its attachments (its external dependency chains with the barriers of the graph)
+	depthAttachmentWrite,
+	COUNT
+};
+
+struct FgResource {
+	u32 id = u32(-1);
+	bool isValid()const { return id != u32(-1); }
+};
+
+struct FrameGraph {
+	struct Resource {
+		VkImage image = VK_NULL_HANDLE; // null for memory resources
+		vk::ImageAspects aspects = vk::ImageAspects::none;
+		vk::ImageLayout layout = vk::ImageLayout::undefined;
+		u32 memory; // the resource that keeps the hazard state. Aliasing images share it
+		// hazard state
+		vk::PipelineStages writeStages = vk::PipelineStages::none;
+		vk::AccessFlags writeAccess = vk::AccessFlags::none;
+		vk::PipelineStages readStages = vk::PipelineStages::none; // since the last write
+		vk::PipelineStages visibleStages = vk::PipelineStages::none; // the last write has already been made visible to these stages
+		vk::AccessFlags visibleAccess = vk::AccessFlags::none;
+	};
+	struct Use {
+		u32 resource;
+		FgAccess access;
+		vk::ImageLayout layoutAfter;
+	};
+	struct Pass {
+		const char* name;
+		vk::CmdBuffer* cmdBuffer;
+		u32 firstUse, numUses;
+		// computed by compile()
+		vk::PipelineStages srcStages, dstStages;
+		vk::AccessFlags srcAccess, dstAccess; // global memory barrier
+		u32 firstImageBarrier, numImageBarriers;
+	};
+
+	std::vector<Resource> resources;
+	std::vector<Use> uses;
+	std::vector<Pass> passes;
+	std::vector<vk::ImageBarrier> imageBarriers;
+
+	void clear(); // call at the beginning of the frame
+
+	// non-image memory (for example, all the buffers written by the staging pass), or the memory shared by aliasing images.
+	// "lastAccess" is an access made by previous submissions that this frame has to wait for
+	FgResource importMemory(FgAccess lastAccess = FgAccess::COUNT);
+	// the image is in "layout" at the beginning of the frame. If "memory" is valid, the image aliases it
+	FgResource importImage(VkImage image, vk::ImageAspects aspects, vk::ImageLayout layout, FgResource memory = {});
+
+	u32 addPass(const char* name, vk::CmdBuffer& cmdBuffer);
+	// declares an access of the last added pass. For the attachments of render passes, "layoutAfter" is the final layout of the render pass
+	void use(FgResource res, FgAccess access, vk::ImageLayout layoutAfter = vk::ImageLayout::undefined);
+
+	void compile();
+	void recordBarriers(u32 passInd); // must be called right before recording the commands of the pass
+};
+
+}
+}
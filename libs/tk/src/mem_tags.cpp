@@ -0,0 +1,102 @@
+#include "mem_tags.hpp"
+#include <stdio.h>
+#include <atomic>
+
+namespace tk {
+namespace mem {
+
+static constexpr u32 NUM_TAGS = u32(Tag::COUNT);
+static constexpr u32 NUM_HEAPS = u32(Heap::COUNT);
+
+const char* toString(Tag tag)
+{
+	static const char* names[] = { "other", "ecs", "renderWorld", "renderUniverse", "renderTargets", "staging", "shaderCompiler" };
+	static_assert(std::size(names) == NUM_TAGS);
+	return names[u32(tag)];
+}
+
+const char* toString(Heap heap)
+{
+	static const char* names[] = { "cpu", "gpu" };
+	static_assert(std::size(names) == NUM_HEAPS);
+	return names[u32(heap)];
+}
+
+// the allocations can happen from any thread, and also during static initialization, so these are plain atomics without constructors that could run late
+struct TagCounters {
+	std::atomic<u64> live;
+	std::atomic<u64> peak;
+	std::atomic<u64> numAllocs;
+	std::atomic<u64> budget;
+	std::atomic<bool> overBudget;
+};
+static TagCounters g_counters[NUM_TAGS][NUM_HEAPS];
+
+static TagCounters& getCounters(Tag tag, Heap heap)
+{
+	assert(tag < Tag::COUNT && heap < Heap::COUNT);
+	return g_counters[u32(tag)][u32(heap)];
+}
+
+static void checkBudget(TagCounters& c, Tag tag, Heap heap, u64 live)
+{
+	const u64 budget = c.budget.load(std::memory_order_relaxed);
+	if (budget && live > budget && !c.overBudget.exchange(true, std::memory_order_relaxed)) {
+		printf("Memory budget exceeded: %s (%s) %.2f MB > %.2f MB\n", toString(tag), toString(heap),
+			double(live) / (1 << 20), double(budget) / (1 << 20));
+	}
+}
+
+TagStats getStats(Tag tag, Heap heap)
+{
+	const auto& c = getCounters(tag, heap);
+	return {
+		.live = c.live.load(std::memory_order_relaxed),
+		.peak = c.peak.load(std::memory_order_relaxed),
+		.numAllocs = c.numAllocs.load(std::memory_order_relaxed),
+		.budget = c.budget.load(std::memory_order_relaxed),
+	};
+}
+
+void setBudget(Tag tag, Heap heap, u64 bytes)
+{
+	auto& c = getCounters(tag, heap);
+	c.budget = bytes;
+	c.overBudget = false; // so we warn again if we are already over the new budget
+	checkBudget(c, tag, heap, c.live.load());
+}
+
+bool isOverBudget(Tag tag, Heap heap)
+{
+	const auto& c = getCounters(tag, heap);
+	const u64 budget = c.budget.load(std::memory_order_relaxed);
+	return budget && c.live.load(std::memory_order_relaxed) > budget;
+}
+
+void resetPeaks()
+{
+	for (auto& tagCounters : g_counters)
+	for (auto& c : tagCounters)
+		c.peak = c.live.load();
+}
+
+void _onAlloc(Tag tag, Heap heap, size_t size)
+{
+	auto& c = getCounters(tag, heap);
+	const u64 live = c.live.fetch_add(size, std::memory_order_relaxed) + size;
+	c.numAllocs.fetch_add(1, std::memory_order_relaxed);
+	u64 peak = c.peak.load(std::memory_order_relaxed);
+	while (live > peak && !c.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed));
+	checkBudget(c, tag, heap, live);
+}
+
+void _onFree(Tag tag, Heap heap, size_t size)
+{
+	auto& c = getCounters(tag, heap);
+	const u64 live = c.live.fetch_sub(size, std::memory_order_relaxed) - size;
+	if (c.overBudget.load(std::memory_order_relaxed) && live <= c.budget.load(std::memory_order_relaxed))
+		c.overBudget.store(false, std::memory_order_relaxed);
+}
+
+}
+}
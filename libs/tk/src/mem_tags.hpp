@@ -0,0 +1,84 @@
+#pragma once
+
+#include "utils.hpp"
+#include <memory>
+
+// Memory accounting by subsystem. The containers of the subsystems use a tagged allocator, and the GPU allocations are tagged through VMA's pUserData.
+// For each tag we keep the live bytes, the peak and the number of allocations. A budget can be set per tag: when the live bytes go over it a warning is printed
+// (once, until they go under it again)
+namespace tk {
+namespace mem {
+
+enum class Tag : u8 {
+	other,
+	ecs, // World: entities, hierarchy and cached matrices
+	renderWorld, // RenderWorld: objects and instances arrays, instancing and uniform buffers
+	renderUniverse, // RenderUniverse: images, meshes, materials and the image name map
+	renderTargets,
+	staging,
+	shaderCompiler, // the GLSL sources cache
+	COUNT
+};
+const char* toString(Tag tag);
+
+enum class Heap : u8 {
+	cpu,
+	gpu,
+	COUNT
+};
+const char* toString(Heap heap);
+
+struct TagStats {
+	u64 live = 0; // bytes
+	u64 peak = 0;
+	u64 numAllocs = 0; // since the start
+	u64 budget = 0; // 0 means no budget
+};
+
+TagStats getStats(Tag tag, Heap heap);
+// 0 disables the budget
+void setBudget(Tag tag, Heap heap, u64 bytes);
+bool isOverBudget(Tag tag, Heap heap);
+void resetPeaks(); // the peaks are set to the current live bytes
+
+void _onAlloc(Tag tag, Heap heap, size_t size);
+void _onFree(Tag tag, Heap heap, size_t size);
+
+// stateless std allocator that accounts its allocations in the given tag
+template <typename T, Tag TAG>
+struct Allocator {
+	typedef T value_type;
+	template <typename U>
+	struct rebind { typedef Allocator<U, TAG> other; };
+
+	Allocator() {}
+	template <typename U>
+	Allocator(const Allocator<U, TAG>&) {}
+
+	T* allocate(size_t n) {
+		_onAlloc(TAG, Heap::cpu, n * sizeof(T));
+		return std::allocator<T>().allocate(n);
+	}
+	void deallocate(T* p, size_t n) {
+		_onFree(TAG, Heap::cpu, n * sizeof(T));
+		std::allocator<T>().deallocate(p, n);
+	}
+
+	template <typename U>
+	bool operator==(const Allocator<U, TAG>&)const { return true; }
+};
+
+template <Tag TAG, typename T>
+using Vector = std::vector<T, Allocator<T, TAG>>;
+
+template <Tag TAG>
+using String = std::basic_string<char, std::char_traits<char>, Allocator<char, TAG>>;
+
+template <Tag TAG, typename K, typename V, typename H = Hash<K>, typename Eq = std::equal_to<>>
+using FlatHashMap = tk::FlatHashMap<K, V, H, Eq, Allocator<std::pair<K, V>, TAG>>;
+
+template <Tag TAG, typename K, typename H = Hash<K>, typename Eq = std::equal_to<>>
+using FlatHashSet = tk::FlatHashSet<K, H, Eq, Allocator<K, TAG>>;
+
+}
+}
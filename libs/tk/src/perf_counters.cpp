@@ -0,0 +1,210 @@
+#include "perf_counters.hpp"
+#include <stdio.h>
+#include <mutex>
+#ifdef __linux__
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace tk {
+namespace perf {
+
+static constexpr u32 NUM_COUNTERS = u32(Counter::COUNT);
+
+const char* toString(Counter c)
+{
+	static const char* names[] = { "cycles", "instructions", "l1dMisses", "llcMisses", "branchMisses" };
+	static_assert(std::size(names) == NUM_COUNTERS);
+	return names[u32(c)];
+}
+
+void Counters::add(const Counters& o)
+{
+	for (u32 i = 0; i < NUM_COUNTERS; i++)
+		values[i] += o.values[i];
+}
+
+std::atomic<bool> _enabled = false;
+
+static struct PerfCounters {
+	std::mutex mutex; // the scopes can be recorded from any thread
+	std::vector<ScopeCounters> currentFrame; // [scopeId]
+	std::vector<ScopeCounters> lastFrame;
+	std::vector<ScopeCounters> totals;
+} P;
+
+u32 registerScope(const char* name)
+{
+	std::lock_guard lock(P.mutex);
+	const u32 id = u32(P.currentFrame.size());
+	P.currentFrame.push_back({ .name = name, .calls = 0, .counters = {} });
+	P.totals.push_back({ .name = name, .calls = 0, .counters = {} });
+	return id;
+}
+
+#ifdef __linux__
+// the counters of a thread are opened as a group, so they are scheduled together and can be read with a single syscall
+struct ThreadGroup {
+	bool initialized = false;
+	bool ok = false;
+	int leaderFd = -1;
+	u32 numOpen = 0;
+	int fds[NUM_COUNTERS];
+	u32 groupInd[NUM_COUNTERS]; // position in the group read. u32(-1) if that counter couldn't be opened
+
+	~ThreadGroup() {
+		for (u32 i = 0; i < numOpen; i++)
+			close(fds[i]);
+	}
+};
+static thread_local ThreadGroup tl_group;
+
+static bool openThreadGroup(ThreadGroup& G)
+{
+	G.initialized = true;
+	const struct { u32 type; u64 config; } configs[NUM_COUNTERS] = {
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+		{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+	};
+	for (u32 i = 0; i < NUM_COUNTERS; i++) {
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = configs[i].type;
+		attr.config = configs[i].config;
+		attr.disabled = G.leaderFd == -1; // the leader starts the whole group
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		const int fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, G.leaderFd, 0));
+		if (fd == -1) {
+			if (G.leaderFd == -1) {
+				const bool permissions = errno == EACCES || errno == EPERM;
+				printf("perf_event_open failed (%s): %s%s\n", toString(Counter(i)), strerror(errno),
+					permissions ? ". Check /proc/sys/kernel/perf_event_paranoid" : "");
+				return false;
+			}
+			// some counters are not supported in every CPU (or VM). We still count the others
+			printf("perf counter not available: %s (%s)\n", toString(Counter(i)), strerror(errno));
+			G.groupInd[i] = u32(-1);
+			continue;
+		}
+		if (G.leaderFd == -1)
+			G.leaderFd = fd;
+		G.fds[G.numOpen] = fd;
+		G.groupInd[i] = G.numOpen++;
+	}
+	ioctl(G.leaderFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(G.leaderFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	G.ok = true;
+	return true;
+}
+
+bool _readCounters(u64 (&values)[NUM_COUNTERS], u64& timeEnabled, u64& timeRunning)
+{
+	auto& G = tl_group;
+	if (!G.initialized)
+		openThreadGroup(G);
+	if (!G.ok)
+		return false;
+
+	// PERF_FORMAT_GROUP layout: nr, time_enabled, time_running, values[nr]
+	u64 buffer[3 + NUM_COUNTERS];
+	const ssize_t readSize = read(G.leaderFd, buffer, sizeof(buffer));
+	if (readSize < ssize_t((3 + G.numOpen) * sizeof(u64)))
+		return false;
+	timeEnabled = buffer[1];
+	timeRunning = buffer[2];
+	for (u32 i = 0; i < NUM_COUNTERS; i++)
+		values[i] = G.groupInd[i] != u32(-1) ? buffer[3 + G.groupInd[i]] : 0;
+	return true;
+}
+#else
+bool _readCounters(u64 (&values)[NUM_COUNTERS], u64& timeEnabled, u64& timeRunning)
+{
+	return false;
+}
+#endif
+
+void _recordScope(u32 scopeId, const u64 (&begin)[NUM_COUNTERS], u64 beginEnabled, u64 beginRunning)
+{
+	u64 end[NUM_COUNTERS];
+	u64 endEnabled, endRunning;
+	if (!_readCounters(end, endEnabled, endRunning))
+		return;
+
+	// when there are more counters than hardware registers, the kernel multiplexes them. We extrapolate to the whole time the scope was enabled
+	const u64 enabled = endEnabled - beginEnabled;
+	const u64 running = endRunning - beginRunning;
+	Counters c;
+	for (u32 i = 0; i < NUM_COUNTERS; i++) {
+		const u64 delta = end[i] - begin[i];
+		c.values[i] = running == 0 ? 0 : running == enabled ? delta : u64(double(delta) * double(enabled) / double(running));
+	}
+
+	std::lock_guard lock(P.mutex);
+	for (auto* s : { &P.currentFrame[scopeId], &P.totals[scopeId] }) {
+		s->calls++;
+		s->counters.add(c);
+	}
+}
+
+bool setEnabled(bool enabled)
+{
+#ifdef __linux__
+	if (enabled) {
+		u64 values[NUM_COUNTERS], timeEnabled, timeRunning;
+		if (!_readCounters(values, timeEnabled, timeRunning))
+			return false;
+	}
+	_enabled = enabled;
+	return true;
+#else
+	if (enabled)
+		printf("perf counters are only supported in Linux\n");
+	return !enabled;
+#endif
+}
+
+bool isEnabled()
+{
+	return _enabled;
+}
+
+void frameMark()
+{
+	if (!_enabled.load(std::memory_order_relaxed))
+		return;
+
+	std::lock_guard lock(P.mutex);
+	P.lastFrame = P.currentFrame;
+	for (auto& s : P.currentFrame)
+		s = { .name = s.name, .calls = 0, .counters = {} };
+}
+
+CSpan<ScopeCounters> getFrameCounters()
+{
+	return P.lastFrame;
+}
+
+CSpan<ScopeCounters> getTotalCounters()
+{
+	return P.totals;
+}
+
+void resetTotals()
+{
+	std::lock_guard lock(P.mutex);
+	for (auto& s : P.totals)
+		s = { .name = s.name, .calls = 0, .counters = {} };
+}
+
+}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "utils.hpp"
+#include <atomic>
+
+// Hardware performance counters (cycles, instructions, cache and branch misses) around named scopes, using Linux's perf_event_open.
+// Meant for verifying data layout changes with IPC and cache misses, instead of just wall-clock time.
+// Reading the counters is a syscall (around a microsecond), so the scopes should be coarse: systems, world updates, render passes.
+// The counters are per thread, and only count user space. In other platforms (or if perf_event_paranoid doesn't allow it) nothing is counted
+namespace tk {
+namespace perf {
+
+enum class Counter : u8 {
+	cycles,
+	instructions,
+	l1dMisses, // L1 data cache read misses
+	llcMisses, // last level cache read misses
+	branchMisses,
+	COUNT
+};
+const char* toString(Counter c);
+
+struct Counters {
+	u64 values[u32(Counter::COUNT)] = {};
+
+	u64 operator[](Counter c)const { return values[u32(c)]; }
+	double ipc()const { return values[u32(Counter::cycles)] ? double(values[u32(Counter::instructions)]) / double(values[u32(Counter::cycles)]) : 0.0; }
+	void add(const Counters& o);
+};
+
+struct ScopeCounters {
+	const char* name;
+	u64 calls = 0;
+	Counters counters; // inclusive: nested scopes are also counted by the outer scope
+};
+
+// returns false if the counters are not available in this system (the reason is printed). Disabled by default
+bool setEnabled(bool enabled);
+bool isEnabled();
+
+void frameMark(); // TK_PROFILE_FRAME calls it
+
+// the vectors are indexed by the scope id. Not thread-safe: call them from the thread that calls frameMark()
+CSpan<ScopeCounters> getFrameCounters(); // of the last frame
+CSpan<ScopeCounters> getTotalCounters(); // since the last resetTotals(), including the frame in progress
+void resetTotals();
+
+extern std::atomic<bool> _enabled;
+u32 registerScope(const char* name); // the name must be a static string
+bool _readCounters(u64 (&values)[u32(Counter::COUNT)], u64& timeEnabled, u64& timeRunning);
+void _recordScope(u32 scopeId, const u64 (&begin)[u32(Counter::COUNT)], u64 beginEnabled, u64 beginRunning);
+
+struct Scope {
+	u32 scopeId;
+	bool active;
+	u64 timeEnabled, timeRunning;
+	u64 begin[u32(Counter::COUNT)];
+
+	explicit Scope(u32 scopeId) : scopeId(scopeId), active(_enabled.load(std::memory_order_relaxed)) {
+		if (active)
+			active = _readCounters(begin, timeEnabled, timeRunning);
+	}
+	~Scope() {
+		if (active)
+			_recordScope(scopeId, begin, timeEnabled, timeRunning);
+	}
+	Scope(const Scope&) = delete;
+	Scope& operator=(const Scope&) = delete;
+};
+
+}
+}
+
+#define TK_PERF_SCOPE(name) tk::perf::Scope DEFER_3(_perfScope_)([]() { static const tk::u32 id = tk::perf::registerScope(name); return id; }())
@@ -0,0 +1,196 @@
+#include "profiler.hpp"
+#include <stdio.h>
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <format>
+#include <algorithm>
+
+namespace tk {
+namespace profiler {
+
+static constexpr u32 EVENTS_PER_THREAD = 1u << 16u; // when full, the oldest events are overwritten
+static constexpr u32 MAX_FRAMES = 1u << 12u;
+
+struct Event {
+	const char* name;
+	u64 begin, end;
+};
+
+struct ThreadBuffer {
+	u32 tid;
+	std::string name;
+	std::mutex mutex; // only contended while dumping
+	u64 numEvents = 0; // total recorded. The ring contains the last min(numEvents, EVENTS_PER_THREAD)
+	std::unique_ptr<Event[]> events = std::make_unique_for_overwrite<Event[]>(EVENTS_PER_THREAD);
+};
+
+static struct Profiler {
+	std::mutex mutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> threads; // never freed, so the events of threads that have finished can still be dumped
+	u64 frames[MAX_FRAMES]; // the timestamps of the frame marks
+	u64 frameInd = 0;
+	u64 firstFrameInd = 0; // the first frame that hasn't been cleared
+	u32 autoDumpEveryNFrames = 0;
+	std::string autoDumpPathPrefix;
+} P;
+
+std::atomic<bool> _enabled = false;
+static thread_local ThreadBuffer* tl_threadBuffer = nullptr;
+
+static ThreadBuffer& getThreadBuffer()
+{
+	if (!tl_threadBuffer) {
+		std::lock_guard lock(P.mutex);
+		auto& buffer = P.threads.emplace_back(std::make_unique<ThreadBuffer>());
+		buffer->tid = u32(P.threads.size());
+		tl_threadBuffer = buffer.get();
+	}
+	return *tl_threadBuffer;
+}
+
+void setEnabled(bool enabled)
+{
+	_enabled = enabled;
+}
+
+bool isEnabled()
+{
+	return _enabled;
+}
+
+void setThreadName(CStr name)
+{
+	auto& buffer = getThreadBuffer();
+	std::lock_guard lock(buffer.mutex);
+	buffer.name = name;
+}
+
+u64 _now()
+{
+	return u64(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void _recordScope(const char* name, u64 begin, u64 end)
+{
+	auto& buffer = getThreadBuffer();
+	std::lock_guard lock(buffer.mutex);
+	buffer.events[buffer.numEvents % EVENTS_PER_THREAD] = { name, begin, end };
+	buffer.numEvents++;
+}
+
+void frameMark()
+{
+	if (!_enabled.load(std::memory_order_relaxed))
+		return;
+
+	u64 frameInd;
+	{
+		std::lock_guard lock(P.mutex);
+		P.frames[P.frameInd % MAX_FRAMES] = _now();
+		P.frameInd++;
+		frameInd = P.frameInd;
+	}
+
+	if (P.autoDumpEveryNFrames && frameInd % P.autoDumpEveryNFrames == 0) {
+		const auto path = std::format("{}_{}.json", P.autoDumpPathPrefix, frameInd);
+		if (dumpChromeTrace(path.c_str()))
+			clear();
+	}
+}
+
+u64 getFrameInd()
+{
+	std::lock_guard lock(P.mutex);
+	return P.frameInd;
+}
+
+void setAutoDump(u32 everyNFrames, CStr pathPrefix)
+{
+	std::lock_guard lock(P.mutex);
+	P.autoDumpEveryNFrames = everyNFrames;
+	P.autoDumpPathPrefix = pathPrefix;
+}
+
+// the names are function names and literals, but we escape them anyway so the JSON is always valid
+static void writeJsonString(FILE* file, const char* s)
+{
+	fputc('"', file);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fputc('\\', file);
+		if (u8(*s) >= 0x20)
+			fputc(*s, file);
+	}
+	fputc('"', file);
+}
+
+bool dumpChromeTrace(CStr path)
+{
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		printf("could not open file for writing: %s\n", path);
+		return false;
+	}
+	defer(fclose(file));
+
+	std::lock_guard lock(P.mutex);
+
+	// the timestamps are relative to the oldest event, in microseconds
+	u64 t0 = u64(-1);
+	const u64 firstFrame = std::max(P.firstFrameInd, P.frameInd > MAX_FRAMES ? P.frameInd - MAX_FRAMES : 0);
+	if (firstFrame < P.frameInd)
+		t0 = P.frames[firstFrame % MAX_FRAMES];
+	for (auto& buffer : P.threads) {
+		std::lock_guard bufferLock(buffer->mutex);
+		const u64 first = buffer->numEvents > EVENTS_PER_THREAD ? buffer->numEvents - EVENTS_PER_THREAD : 0;
+		if (first < buffer->numEvents)
+			t0 = std::min(t0, buffer->events[first % EVENTS_PER_THREAD].begin);
+	}
+	auto toUs = [t0](u64 t) { return double(t - t0) * 1e-3; };
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	// the frames are shown as a separate track (tid 0). Each one goes from a frame mark to the next one
+	fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"frames\"}}");
+	for (u64 f = firstFrame; f + 1 < P.frameInd; f++) {
+		const u64 begin = P.frames[f % MAX_FRAMES];
+		const u64 end = P.frames[(f + 1) % MAX_FRAMES];
+		fprintf(file, ",\n{\"name\":\"frame %llu\",\"cat\":\"frame\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":0}",
+			(unsigned long long)(f + 1), toUs(begin), double(end - begin) * 1e-3);
+	}
+
+	for (auto& buffer : P.threads) {
+		std::lock_guard bufferLock(buffer->mutex);
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", buffer->tid);
+		if (buffer->name.size())
+			writeJsonString(file, buffer->name.c_str());
+		else
+			fprintf(file, "\"thread %u\"", buffer->tid);
+		fprintf(file, "}}");
+
+		const u64 first = buffer->numEvents > EVENTS_PER_THREAD ? buffer->numEvents - EVENTS_PER_THREAD : 0;
+		for (u64 i = first; i < buffer->numEvents; i++) {
+			const auto& e = buffer->events[i % EVENTS_PER_THREAD];
+			fprintf(file, ",\n{\"name\":");
+			writeJsonString(file, e.name);
+			fprintf(file, ",\"cat\":\"cpu\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+				toUs(e.begin), double(e.end - e.begin) * 1e-3, buffer->tid);
+		}
+	}
+	fprintf(file, "\n]}\n");
+	return !ferror(file);
+}
+
+void clear()
+{
+	std::lock_guard lock(P.mutex);
+	for (auto& buffer : P.threads) {
+		std::lock_guard bufferLock(buffer->mutex);
+		buffer->numEvents = 0;
+	}
+	// keep the last frame mark, so the next frame can still be shown
+	P.firstFrameInd = P.frameInd ? P.frameInd - 1 : 0;
+}
+
+}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "utils.hpp"
+#include "perf_counters.hpp"
+#include <atomic>
+#include <Tracy.hpp>
+
+// In-process CPU profiler. It doesn't need a Tracy server, so it can be used in unattended runs (CI, headless rendering).
+// The scopes are recorded in per-thread ring buffers (only the most recent events are kept), and can be exported to the Chrome Trace Event format
+// (open it in chrome://tracing or https://ui.perfetto.dev).
+// When it's disabled (the default) a scope costs an atomic load and a branch. The macros also feed Tracy, so they can replace ZoneScoped and FrameMark.
+// TK_PROFILE_FRAME also ends the frame of the perf counters (see perf_counters.hpp)
+namespace tk {
+namespace profiler {
+
+void setEnabled(bool enabled);
+bool isEnabled();
+
+void setThreadName(CStr name); // the name is copied. Threads without a name are shown as "thread <id>"
+
+// call at the end of every frame (TK_PROFILE_FRAME does it)
+void frameMark();
+u64 getFrameInd();
+
+// every "everyNFrames" frames, the events recorded since the previous automatic dump (or clear) are written to "<pathPrefix>_<frameInd>.json". 0 disables it
+void setAutoDump(u32 everyNFrames, CStr pathPrefix = "trace");
+// writes the events that are in the ring buffers. Returns false if the file can't be written
+bool dumpChromeTrace(CStr path);
+void clear(); // discards the recorded events and frames
+
+extern std::atomic<bool> _enabled;
+u64 _now(); // in nanoseconds
+void _recordScope(const char* name, u64 begin, u64 end);
+
+struct Scope {
+	const char* name; // must be a static string
+	u64 begin;
+
+	explicit Scope(const char* name) : name(name), begin(_enabled.load(std::memory_order_relaxed) ? _now() : 0) {}
+	~Scope() {
+		if (begin)
+			_recordScope(name, begin, _now());
+	}
+	Scope(const Scope&) = delete;
+	Scope& operator=(const Scope&) = delete;
+};
+
+}
+}
+
+#define TK_PROFILE_SCOPE ZoneScoped; tk::profiler::Scope DEFER_3(_profileScope_)(__FUNCTION__)
+#define TK_PROFILE_SCOPE_N(name) ZoneScopedN(name); tk::profiler::Scope DEFER_3(_profileScope_)(name)
+#define TK_PROFILE_FRAME FrameMark; tk::profiler::frameMark(); tk::perf::frameMark()
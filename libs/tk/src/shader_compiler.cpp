@@ -67,9 +67,9 @@ static shaderc_include_result* include_resolve_callback (
 		headerPath =  fs::path(shaderCompiler->rootShadersPath) / requested_source;
 	}
 
-	auto it = shaderCompiler->getOrLoadGlsl(headerPath.string().c_str());
+	auto glsl = shaderCompiler->getOrLoadGlsl(headerPath.string().c_str());
 	auto res = new shaderc_include_result;
-	if (it == shaderCompiler->glslSrcsCache.end()) {
+	if (!glsl) {
 		const size_t errMsgMaxSize = 256;
 		auto errMsg = new char[errMsgMaxSize];
 		int errMsgLen = snprintf(errMsg, errMsgMaxSize, "Failed #include: '%s'", requested_source);
@@ -82,10 +82,10 @@ static shaderc_include_result* include_resolve_callback (
 	}
 	else {
 		*res = {
-			.source_name = it->first.c_str(),
-			.source_name_length = it->first.size(),
-			.content = it->second.c_str(),
-			.content_length = it->second.size(),
+			.source_name = glsl->path.c_str(),
+			.source_name_length = glsl->path.size(),
+			.content = glsl->src.c_str(),
+			.content_length = glsl->src.size(),
 		};
 	}
 
@@ -110,28 +110,29 @@ CompileResult ShaderCompiler::glslToSpv(ZStrView filePath, CSpan<PreprocDefine>
 
 	shaderc_compile_options_set_include_callbacks(options, include_resolve_callback, include_release_callback, this);
 
-	auto it = getOrLoadGlsl(filePath);
-	if (it == glslSrcsCache.end()) {
+	auto glsl = getOrLoadGlsl(filePath);
+	if (!glsl) {
 		return CompileResult { .customErrMsg = std::format("Could not load '{}'\n", filePath.substr()) };
 	}
 	
 	return CompileResult {
-		.result = shaderc_compile_into_spv(compiler, it->second.c_str(), it->second.length(),
+		.result = shaderc_compile_into_spv(compiler, glsl->src.c_str(), glsl->src.length(),
 			shaderc_glsl_infer_from_source, filePath, "main", options)
 	};
 }
 
-ShaderCompiler::CacheMap::const_iterator ShaderCompiler::getOrLoadGlsl(ZStrView filePath)
+const ShaderCompiler::CachedGlsl* ShaderCompiler::getOrLoadGlsl(ZStrView filePath)
 {
-	if (auto it = glslSrcsCache.find(filePath); it == glslSrcsCache.end()) {
+	if (auto it = glslSrcsCache.find(StrView(filePath)); it == glslSrcsCache.end()) {
 		std::string src;
 		if (!loadTextFile(src, filePath))
-			return glslSrcsCache.end();
-		auto insertionResult = glslSrcsCache.insert({ filePath, src });
-		return insertionResult.first;
+			return nullptr;
+		auto glsl = new CachedGlsl{ filePath, GlslSrc(src.begin(), src.end()) };
+		glslSrcsCache.try_emplace(glsl->path, glsl);
+		return glsl;
 	}
 	else {
-		return it;
+		return it->second.get();
 	}
 }
 
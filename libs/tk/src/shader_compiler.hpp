@@ -1,9 +1,10 @@
 #pragma once
 
-#include <unordered_map>
+#include <memory>
 #include <string>
 #include <string_view>
 #include "utils.hpp"
+#include "mem_tags.hpp"
 #include <shaderc/shaderc.h>
 
 namespace tk
@@ -24,7 +25,13 @@ struct PreprocDefine { StrView name, value = ""; };
 
 struct ShaderCompiler
 {
-	typedef std::unordered_map<std::string, std::string> CacheMap;
+	typedef mem::String<mem::Tag::shaderCompiler> GlslSrc;
+	struct CachedGlsl {
+		std::string path;
+		GlslSrc src;
+	};
+	// the entries are boxed: shaderc keeps pointers to them while the #includes of the same compilation add more entries
+	typedef mem::FlatHashMap<mem::Tag::shaderCompiler, std::string, std::unique_ptr<CachedGlsl>> CacheMap;
 
 	shaderc_compiler_t compiler = nullptr;
 	std::string rootShadersPath = "";
@@ -34,7 +41,7 @@ struct ShaderCompiler
 	~ShaderCompiler();
 	void init();
 	CompileResult glslToSpv(ZStrView filePath, CSpan<PreprocDefine> defines);
-	CacheMap::const_iterator getOrLoadGlsl(ZStrView filePath);
+	const CachedGlsl* getOrLoadGlsl(ZStrView filePath); // nullptr if it couldn't be loaded
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,396 @@
+#include "texture_files.hpp"
+#include "tg.hpp"
+#include <string.h>
+#include <stdio.h>
+#include <numeric>
+
+namespace tk {
+namespace gfx {
+
+static const u8 k_ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+template <typename T>
+static T readAt(CSpan<u8> data, size_t offset)
+{
+	T x;
+	memcpy(&x, data.data() + offset, sizeof(T));
+	return x;
+}
+
+template <typename T>
+static void writeAt(std::vector<u8>& data, size_t offset, T x)
+{
+	memcpy(data.data() + offset, &x, sizeof(T));
+}
+
+// ImageInfo stores the dimensions in u16
+constexpr u32 MAX_DIMENSION = 0xFFFF;
+
+// the formats that the upload path handles: 8-bit RGBA, and BC1-BC7
+static bool isSupportedFormat(vk::Format format)
+{
+	using F = vk::Format;
+	switch (format) {
+	case F::RGBA8_UNORM: case F::RGBA8_SRGB:
+	case F::BGRA8_UNORM: case F::BGRA8_SRGB:
+		return true;
+	default:
+		return format >= F::COMPR_BC1_RGB_UNORM && format <= F::COMPR_BC7_SRGB;
+	}
+}
+
+bool isKtx2File(CSpan<u8> fileData)
+{
+	return fileData.size() >= sizeof(k_ktx2Identifier) && memcmp(fileData.data(), k_ktx2Identifier, sizeof(k_ktx2Identifier)) == 0;
+}
+
+bool isDdsFile(CSpan<u8> fileData)
+{
+	return fileData.size() >= 4 && memcmp(fileData.data(), "DDS ", 4) == 0;
+}
+
+// --- KTX2 ---
+// https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html
+namespace ktx2 {
+	constexpr size_t HEADER_SIZE = 80; // identifier + header + index
+	constexpr size_t LEVEL_INDEX_ENTRY_SIZE = 24; // byteOffset, byteLength, uncompressedByteLength
+}
+
+bool parseKtx2(TextureFile& tex, CSpan<u8> fileData)
+{
+	if (!isKtx2File(fileData) || fileData.size() < ktx2::HEADER_SIZE) {
+		printf("Not a KTX2 file\n");
+		return false;
+	}
+	const auto format = vk::Format(readAt<u32>(fileData, 12));
+	const u32 w = readAt<u32>(fileData, 20);
+	const u32 h = readAt<u32>(fileData, 24);
+	const u32 depth = readAt<u32>(fileData, 28);
+	const u32 layerCount = readAt<u32>(fileData, 32);
+	const u32 faceCount = readAt<u32>(fileData, 36);
+	const u32 levelCount = readAt<u32>(fileData, 40);
+	const u32 supercompressionScheme = readAt<u32>(fileData, 44);
+	if (!isSupportedFormat(format)) {
+		printf("KTX2: unsupported format (%d)\n", int(format));
+		return false;
+	}
+	if (depth > 1 || layerCount > 1 || faceCount != 1 || h == 0) {
+		printf("KTX2: only 2D textures are supported\n");
+		return false;
+	}
+	if (w == 0 || w > MAX_DIMENSION || h > MAX_DIMENSION) {
+		printf("KTX2: invalid dimensions (%ux%u)\n", w, h);
+		return false;
+	}
+	if (supercompressionScheme != 0) {
+		printf("KTX2: supercompression is not supported\n");
+		return false;
+	}
+	const u32 numLevels = glm::max(levelCount, 1u); // 0 means that the mip chain should be generated at load time
+	if (numLevels > calcNumMipsFromDimensions(w, h) || fileData.size() < ktx2::HEADER_SIZE + numLevels * ktx2::LEVEL_INDEX_ENTRY_SIZE) {
+		printf("KTX2: invalid level index\n");
+		return false;
+	}
+
+	tex.format = format;
+	tex.w = w;
+	tex.h = h;
+	tex.numMips = u8(numLevels);
+	tex.generateMipChain = levelCount == 0;
+	tex.data.resize(calcImageSize(format, w, h, tex.numMips));
+	size_t dstOffset = 0;
+	for (u32 level = 0; level < numLevels; level++) {
+		const size_t entryOffset = ktx2::HEADER_SIZE + level * ktx2::LEVEL_INDEX_ENTRY_SIZE;
+		const u64 offset = readAt<u64>(fileData, entryOffset);
+		const u64 size = readAt<u64>(fileData, entryOffset + 8);
+		if (size != calcImageLevelSize(format, w, h, u8(level)) || offset > fileData.size() || size > fileData.size() - offset) {
+			printf("KTX2: invalid size of level %d\n", level);
+			return false;
+		}
+		memcpy(tex.data.data() + dstOffset, fileData.data() + offset, size);
+		dstOffset += size;
+	}
+	return true;
+}
+
+// the Data Format Descriptor (DFD) of the block-compressed formats
+// https://registry.khronos.org/DataFormat/specs/1.3/dataformat.1.3.html#CompressedFormatModels
+static std::vector<u8> ktx2_makeBlockCompressedDfd(vk::Format format)
+{
+	enum : u8 {
+		MODEL_BC1A = 128, MODEL_BC2, MODEL_BC3, MODEL_BC4, MODEL_BC5, MODEL_BC6H, MODEL_BC7,
+		PRIMARIES_BT709 = 1,
+		TRANSFER_LINEAR = 1, TRANSFER_SRGB = 2,
+		CHANNEL_COLOR = 0, CHANNEL_RED = 0, CHANNEL_GREEN = 1, CHANNEL_BC1A_ALPHA = 1, CHANNEL_ALPHA = 15,
+		SAMPLE_SIGNED = 0x40, SAMPLE_FLOAT = 0x80, SAMPLE_LINEAR = 0x10,
+	};
+	struct Sample { u16 bitOffset; u8 bitLength; u8 channelType; };
+
+	using F = vk::Format;
+	u8 model = 0;
+	bool isSigned = false;
+	bool isSrgb = false;
+	Sample samples[2];
+	u32 numSamples = 1;
+	switch (format) {
+	case F::COMPR_BC1_RGB_SRGB: isSrgb = true; [[fallthrough]];
+	case F::COMPR_BC1_RGB_UNORM:
+		model = MODEL_BC1A;
+		samples[0] = { 0, 64, CHANNEL_COLOR };
+		break;
+	case F::COMPR_BC1_RGBA_SRGB: isSrgb = true; [[fallthrough]];
+	case F::COMPR_BC1_RGBA_UNORM:
+		model = MODEL_BC1A;
+		samples[0] = { 0, 64, CHANNEL_BC1A_ALPHA };
+		break;
+	case F::COMPR_BC2_SRGB: case F::COMPR_BC3_SRGB: isSrgb = true; [[fallthrough]];
+	case F::COMPR_BC2_UNORM: case F::COMPR_BC3_UNORM:
+		model = format == F::COMPR_BC2_UNORM || format == F::COMPR_BC2_SRGB ? MODEL_BC2 : MODEL_BC3;
+		samples[0] = { 0, 64, u8(CHANNEL_ALPHA | (isSrgb ? SAMPLE_LINEAR : 0)) };
+		samples[1] = { 64, 64, CHANNEL_COLOR };
+		numSamples = 2;
+		break;
+	case F::COMPR_BC4_SNORM: isSigned = true; [[fallthrough]];
+	case F::COMPR_BC4_UNORM:
+		model = MODEL_BC4;
+		samples[0] = { 0, 64, CHANNEL_RED };
+		break;
+	case F::COMPR_BC5_SNORM: isSigned = true; [[fallthrough]];
+	case F::COMPR_BC5_UNORM:
+		model = MODEL_BC5;
+		samples[0] = { 0, 64, CHANNEL_RED };
+		samples[1] = { 64, 64, CHANNEL_GREEN };
+		numSamples = 2;
+		break;
+	case F::COMPR_BC6H_SFLOAT: isSigned = true; [[fallthrough]];
+	case F::COMPR_BC6H_UFLOAT:
+		model = MODEL_BC6H;
+		samples[0] = { 0, 128, u8(CHANNEL_COLOR | SAMPLE_FLOAT) };
+		break;
+	case F::COMPR_BC7_SRGB: isSrgb = true; [[fallthrough]];
+	case F::COMPR_BC7_UNORM:
+		model = MODEL_BC7;
+		samples[0] = { 0, 128, CHANNEL_COLOR };
+		break;
+	default:
+		assert(false && "only BC formats are supported");
+		return {};
+	}
+
+	const u32 blockSize = 24 + 16 * numSamples;
+	std::vector<u8> dfd(4 + blockSize, 0);
+	writeAt<u32>(dfd, 0, u32(dfd.size())); // dfdTotalSize
+	writeAt<u32>(dfd, 4, 0); // vendorId = Khronos, descriptorType = basic
+	writeAt<u16>(dfd, 8, 2); // versionNumber
+	writeAt<u16>(dfd, 10, u16(blockSize));
+	dfd[12] = model;
+	dfd[13] = PRIMARIES_BT709;
+	dfd[14] = isSrgb ? TRANSFER_SRGB : TRANSFER_LINEAR;
+	dfd[15] = 0; // flags: alpha is not premultiplied
+	dfd[16] = 3; dfd[17] = 3; // texelBlockDimension (minus 1): 4x4x1x1
+	dfd[20] = vk::getFormatBlockInfo(format).bytes; // bytesPlane0
+	for (u32 i = 0; i < numSamples; i++) {
+		const size_t o = 28 + 16 * i;
+		const u8 channelType = u8(samples[i].channelType | (isSigned ? SAMPLE_SIGNED : 0));
+		writeAt<u16>(dfd, o, samples[i].bitOffset);
+		dfd[o + 2] = samples[i].bitLength - 1;
+		dfd[o + 3] = channelType;
+		// samplePosition is (0, 0, 0, 0)
+		writeAt<u32>(dfd, o + 8, isSigned ? 0x80000000u : 0u); // sampleLower
+		writeAt<u32>(dfd, o + 12, isSigned ? 0x7FFFFFFFu : 0xFFFFFFFFu); // sampleUpper
+	}
+	return dfd;
+}
+
+std::vector<u8> writeKtx2(const TextureFile& tex)
+{
+	assert(vk::formatIsCompressed(tex.format));
+	assert(tex.data.size() == calcImageSize(tex.format, tex.w, tex.h, tex.numMips));
+	const std::vector<u8> dfd = ktx2_makeBlockCompressedDfd(tex.format);
+	const u32 numLevels = tex.numMips;
+	const size_t dfdOffset = ktx2::HEADER_SIZE + numLevels * ktx2::LEVEL_INDEX_ENTRY_SIZE;
+	const size_t levelAlignment = std::lcm(size_t(4), size_t(vk::getFormatBlockInfo(tex.format).bytes)); // mipPadding
+
+	// the levels are stored from the smallest to the biggest
+	std::vector<size_t> levelOffsets(numLevels);
+	size_t fileSize = dfdOffset + dfd.size();
+	for (u32 i = numLevels; i-- > 0; ) {
+		fileSize = (fileSize + levelAlignment - 1) / levelAlignment * levelAlignment;
+		levelOffsets[i] = fileSize;
+		fileSize += calcImageLevelSize(tex.format, tex.w, tex.h, u8(i));
+	}
+
+	std::vector<u8> file(fileSize, 0);
+	memcpy(file.data(), k_ktx2Identifier, sizeof(k_ktx2Identifier));
+	writeAt<u32>(file, 12, u32(tex.format));
+	writeAt<u32>(file, 16, 1); // typeSize
+	writeAt<u32>(file, 20, tex.w);
+	writeAt<u32>(file, 24, tex.h);
+	writeAt<u32>(file, 28, 0); // pixelDepth
+	writeAt<u32>(file, 32, 0); // layerCount
+	writeAt<u32>(file, 36, 1); // faceCount
+	writeAt<u32>(file, 40, tex.generateMipChain ? 0 : numLevels);
+	writeAt<u32>(file, 44, 0); // supercompressionScheme
+	writeAt<u32>(file, 48, u32(dfdOffset));
+	writeAt<u32>(file, 52, u32(dfd.size()));
+	// no key/value data, nor supercompression global data
+	memcpy(file.data() + dfdOffset, dfd.data(), dfd.size());
+
+	size_t srcOffset = 0;
+	for (u32 i = 0; i < numLevels; i++) {
+		const size_t levelSize = calcImageLevelSize(tex.format, tex.w, tex.h, u8(i));
+		const size_t entryOffset = ktx2::HEADER_SIZE + i * ktx2::LEVEL_INDEX_ENTRY_SIZE;
+		writeAt<u64>(file, entryOffset, levelOffsets[i]);
+		writeAt<u64>(file, entryOffset + 8, levelSize);
+		writeAt<u64>(file, entryOffset + 16, levelSize);
+		memcpy(file.data() + levelOffsets[i], tex.data.data() + srcOffset, levelSize);
+		srcOffset += levelSize;
+	}
+	return file;
+}
+
+// --- DDS ---
+// https://learn.microsoft.com/en-us/windows/win32/direct3ddds/dx-graphics-dds-pguide
+namespace dds {
+	constexpr size_t HEADER_SIZE = 4 + 124; // magic + DDS_HEADER
+	constexpr size_t HEADER_DX10_SIZE = 20;
+	constexpr u32 DDSD_MIPMAPCOUNT = 0x20000;
+	constexpr u32 DDPF_FOURCC = 0x4;
+	constexpr u32 DDPF_RGB = 0x40;
+	constexpr u32 DDSCAPS2_CUBEMAP = 0x200;
+	constexpr u32 DDSCAPS2_VOLUME = 0x200000;
+
+	constexpr u32 fourCC(const char (&s)[5]) { return u32(s[0]) | (u32(s[1]) << 8) | (u32(s[2]) << 16) | (u32(s[3]) << 24); }
+
+	static vk::Format dxgiToVkFormat(u32 dxgiFormat)
+	{
+		using F = vk::Format;
+		switch (dxgiFormat) {
+		case 28: return F::RGBA8_UNORM;
+		case 29: return F::RGBA8_SRGB;
+		case 71: return F::COMPR_BC1_RGBA_UNORM;
+		case 72: return F::COMPR_BC1_RGBA_SRGB;
+		case 74: return F::COMPR_BC2_UNORM;
+		case 75: return F::COMPR_BC2_SRGB;
+		case 77: return F::COMPR_BC3_UNORM;
+		case 78: return F::COMPR_BC3_SRGB;
+		case 80: return F::COMPR_BC4_UNORM;
+		case 81: return F::COMPR_BC4_SNORM;
+		case 83: return F::COMPR_BC5_UNORM;
+		case 84: return F::COMPR_BC5_SNORM;
+		case 95: return F::COMPR_BC6H_UFLOAT;
+		case 96: return F::COMPR_BC6H_SFLOAT;
+		case 98: return F::COMPR_BC7_UNORM;
+		case 99: return F::COMPR_BC7_SRGB;
+		default: return F::undefined;
+		}
+	}
+
+	static vk::Format fourCCToVkFormat(u32 code)
+	{
+		using F = vk::Format;
+		if (code == fourCC("DXT1")) return F::COMPR_BC1_RGBA_UNORM;
+		if (code == fourCC("DXT2") || code == fourCC("DXT3")) return F::COMPR_BC2_UNORM;
+		if (code == fourCC("DXT4") || code == fourCC("DXT5")) return F::COMPR_BC3_UNORM;
+		if (code == fourCC("ATI1") || code == fourCC("BC4U")) return F::COMPR_BC4_UNORM;
+		if (code == fourCC("BC4S")) return F::COMPR_BC4_SNORM;
+		if (code == fourCC("ATI2") || code == fourCC("BC5U")) return F::COMPR_BC5_UNORM;
+		if (code == fourCC("BC5S")) return F::COMPR_BC5_SNORM;
+		return F::undefined;
+	}
+}
+
+bool parseDds(TextureFile& tex, CSpan<u8> fileData)
+{
+	if (!isDdsFile(fileData) || fileData.size() < dds::HEADER_SIZE || readAt<u32>(fileData, 4) != 124) {
+		printf("Not a DDS file\n");
+		return false;
+	}
+	const u32 flags = readAt<u32>(fileData, 4 + 4);
+	const u32 h = readAt<u32>(fileData, 4 + 8);
+	const u32 w = readAt<u32>(fileData, 4 + 12);
+	const u32 mipMapCount = readAt<u32>(fileData, 4 + 24);
+	const u32 pfFlags = readAt<u32>(fileData, 4 + 76);
+	const u32 pfFourCC = readAt<u32>(fileData, 4 + 80);
+	const u32 pfRgbBitCount = readAt<u32>(fileData, 4 + 84);
+	const u32 pfRedMask = readAt<u32>(fileData, 4 + 88);
+	const u32 caps2 = readAt<u32>(fileData, 4 + 108);
+
+	size_t dataOffset = dds::HEADER_SIZE;
+	vk::Format format = vk::Format::undefined;
+	if ((pfFlags & dds::DDPF_FOURCC) && pfFourCC == dds::fourCC("DX10")) {
+		if (fileData.size() < dds::HEADER_SIZE + dds::HEADER_DX10_SIZE) {
+			printf("DDS: truncated DX10 header\n");
+			return false;
+		}
+		const u32 dxgiFormat = readAt<u32>(fileData, dds::HEADER_SIZE);
+		const u32 resourceDimension = readAt<u32>(fileData, dds::HEADER_SIZE + 4);
+		const u32 arraySize = readAt<u32>(fileData, dds::HEADER_SIZE + 12);
+		if (resourceDimension != 3 || arraySize > 1) { // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+			printf("DDS: only 2D textures are supported\n");
+			return false;
+		}
+		format = dds::dxgiToVkFormat(dxgiFormat);
+		dataOffset += dds::HEADER_DX10_SIZE;
+	}
+	else if (pfFlags & dds::DDPF_FOURCC)
+		format = dds::fourCCToVkFormat(pfFourCC);
+	else if ((pfFlags & dds::DDPF_RGB) && pfRgbBitCount == 32 && pfRedMask == 0xFF)
+		format = vk::Format::RGBA8_UNORM;
+
+	if (format == vk::Format::undefined) {
+		printf("DDS: unsupported format\n");
+		return false;
+	}
+	if (caps2 & (dds::DDSCAPS2_CUBEMAP | dds::DDSCAPS2_VOLUME)) {
+		printf("DDS: only 2D textures are supported\n");
+		return false;
+	}
+
+	const u32 numLevels = (flags & dds::DDSD_MIPMAPCOUNT) ? glm::max(mipMapCount, 1u) : 1u;
+	if (w == 0 || h == 0 || w > MAX_DIMENSION || h > MAX_DIMENSION || numLevels > calcNumMipsFromDimensions(w, h)) {
+		printf("DDS: invalid dimensions\n");
+		return false;
+	}
+	// the levels are already tightly packed, starting from level 0
+	const size_t size = calcImageSize(format, w, h, u8(numLevels));
+	if (size > fileData.size() - dataOffset) {
+		printf("DDS: truncated file\n");
+		return false;
+	}
+	tex.format = format;
+	tex.w = w;
+	tex.h = h;
+	tex.numMips = u8(numLevels);
+	tex.generateMipChain = false;
+	tex.data.assign(fileData.begin() + dataOffset, fileData.begin() + dataOffset + size);
+	return true;
+}
+
+bool parseTextureFile(TextureFile& tex, CSpan<u8> fileData)
+{
+	if (isKtx2File(fileData))
+		return parseKtx2(tex, fileData);
+	if (isDdsFile(fileData))
+		return parseDds(tex, fileData);
+	printf("Unknown texture container\n");
+	return false;
+}
+
+vk::Format srgbVariantOfFormat(vk::Format format)
+{
+	using F = vk::Format;
+	switch (format) {
+	case F::RGBA8_UNORM: return F::RGBA8_SRGB;
+	case F::BGRA8_UNORM: return F::BGRA8_SRGB;
+	case F::COMPR_BC1_RGB_UNORM: return F::COMPR_BC1_RGB_SRGB;
+	case F::COMPR_BC1_RGBA_UNORM: return F::COMPR_BC1_RGBA_SRGB;
+	case F::COMPR_BC2_UNORM: return F::COMPR_BC2_SRGB;
+	case F::COMPR_BC3_UNORM: return F::COMPR_BC3_SRGB;
+	case F::COMPR_BC7_UNORM: return F::COMPR_BC7_SRGB;
+	default: return format;
+	}
+}
+
+}
+}
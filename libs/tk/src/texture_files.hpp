@@ -0,0 +1,34 @@
+#pragma once
+
+#include "tvk.hpp"
+
+// Texture containers (KTX2, DDS) that store the whole mip chain, usually block-compressed. They can be uploaded directly, without decoding
+namespace tk {
+namespace gfx {
+
+struct TextureFile {
+	vk::Format format = vk::Format::undefined;
+	u32 w = 0, h = 0;
+	u8 numMips = 1; // the number of levels stored in data
+	bool generateMipChain = false; // the file doesn't contain the mip chain and asks for it to be generated at load time
+	std::vector<u8> data; // the levels are tightly packed, starting from level 0
+};
+
+bool isKtx2File(CSpan<u8> fileData);
+bool isDdsFile(CSpan<u8> fileData);
+
+// only 2D textures without supercompression are supported. Return false on error (and print why)
+bool parseKtx2(TextureFile& tex, CSpan<u8> fileData);
+bool parseDds(TextureFile& tex, CSpan<u8> fileData);
+// detects the container from the file contents
+bool parseTextureFile(TextureFile& tex, CSpan<u8> fileData);
+
+// the SRGB variant of the UNORM color formats (8-bit RGBA/BGRA, BC1, BC2, BC3 and BC7). Legacy DDS files, for example, can't tell that their data is sRGB.
+// The rest of formats are returned as they are
+vk::Format srgbVariantOfFormat(vk::Format format);
+
+// only block-compressed formats (BC1-BC7) are supported, since it's what our offline converter produces
+std::vector<u8> writeKtx2(const TextureFile& tex);
+
+}
+}
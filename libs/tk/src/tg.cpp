@@ -1,54 +1,134 @@
 #include "tg.hpp"
 #include <array>
+#include <algorithm>
+#include <deque>
+#include <numeric>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <stb_image.h>
 #include "tvk.hpp"
 #include "shader_compiler.hpp"
+#include "texture_files.hpp"
+#include "frame_graph.hpp"
+#include "profiler.hpp"
+#include "frame_arena.hpp"
 #include <format>
 #include <physfs.h>
 
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_vulkan.h>
 #include <Tracy.hpp>
+#ifdef TRACY_ENABLE
+#include <TracyC.h>
+#include <client/TracyProfiler.hpp>
+#endif
 
 namespace tk {
 namespace gfx {
 
 static constexpr u32 MAX_SWAPCHAIN_IMAGES = vk::Swapchain::MAX_IMAGES;
-static constexpr u32 STAGING_BUFFER_CAPACITY = 32u << 20u;
-// static constexpr u32 MAX_STAGING_BUFFERS = 32; // TODO: we could have a maximum number of staging buffers. This would help cap the staging memory usage, and also defer some transfer work for future frames. However this would take a big effort to implement right
+static constexpr size_t STAGING_RING_INITIAL_CAPACITY = 8u << 20u; // the staging ring grows (up to InitRenderUniverseParams::stagingMemoryCeiling) when needed
+static constexpr size_t STAGING_ALIGNMENT = 16;
+static constexpr u32 BINDLESS_MAX_TEXTURES = 1u << 17u; // the actual capacity could be smaller, depending on the device limits
+static constexpr u32 BINDLESS_MAX_MATERIALS = 1u << 16u; // per material manager. The uniforms of all the materials live in a storage buffer allocated upfront
+static constexpr u32 RENDER_TARGET_POOL_MAX_SIZE = 8; // when exceeded, the render targets that were released first are freed
+static constexpr u32 GPU_TIMINGS_MAX_QUERIES = 512; // per frame. Each scope uses 2 queries
+static constexpr u64 RENDER_TARGET_POOL_MAX_AGE = 120; // (in frames) pooled render targets that haven't been recycled for this long are freed
 
 static const u32 MAX_DIR_LIGHTS = 4;
 static const auto MAX_DIR_LIGHTS_STR = std::format("{}", MAX_DIR_LIGHTS);
 
+// big images are uploaded in chunks of rows, possibly across several frames. A chunk never spans several mip levels
 struct ImageStagingProc {
 	ImageId img;
 	vk::Buffer stagingBuffer;
 	u32 stagingBufferOffset;
-	u32 dataSize : 31;
+	u16 firstRow;
+	u16 numRows;
+	u8 mipLevel;
+	bool firstChunk : 1; // the image needs to be transitioned to the transferDst layout
+	bool lastChunk : 1; // the image is complete after this chunk: generate the mip chain and transition to the shaderRead layout
 	bool generateMipChain : 1;
 };
 
+// an upload that didn't fit in the frame budget, or in the staging ring. It will be continued in future frames
+struct PendingUpload {
+	std::vector<u8> data;
+	size_t uploadedBytes = 0;
+	// the destination is either a buffer or an image
+	vk::Buffer dstBuffer = {};
+	size_t dstOffset = 0;
+	ImageRC dstImage;
+	bool generateMipChain = false;
+	u64 ticket = 0;
+};
+
+// All the uploads are sub-allocated from a ring buffer. Uploads that don't fit in the frame budget, or in the ring, are queued and continued in future frames.
+// Each upload gets a ticket. Since the uploads are processed in order, we can know if an upload has finished just by comparing its ticket
+struct StagingStream {
+	vk::Buffer buffer = {};
+	u8* memPtr = nullptr;
+	size_t capacity = 0;
+	size_t maxCapacity = 0; // memory ceiling
+	size_t head = 0; // where the next allocation will be placed
+	size_t used = 0; // bytes in use by the submissions in flight (including the padding wasted when wrapping around)
+	size_t usedByFrame[MAX_SWAPCHAIN_IMAGES] = {}; // bytes to reclaim when the frame is finished (only for the graphics stream, the transfer stream keeps track of it per batch)
+	size_t usedThisBatch = 0; // bytes allocated since the last submit
+	vk::BufferUsage dstBufferUsage = {}; // usages of the buffers written since the last submit. Tells the frame graph which stages need to wait for the copies
+	bool overwritesBuffersInUse = false; // some of the buffers written since the last submit could be read by the frames in flight (material parameter changes). The copies need to wait for them
+	size_t frameBudget = 0;
+	size_t budgetUsedThisFrame = 0;
+	u32 imageRowGranularity = 1; // image copies must be made of multiples of this number of rows (of blocks, for compressed formats). 0 means the whole image. It depends on the queue family
+	std::deque<PendingUpload> pending;
+	std::vector<ImageStagingProc> imageProcs; // image copies are recorded when the batch is submitted, because they need layout transitions
+	std::vector<vk::Buffer> completedBuffers; // buffers whose upload has been completely recorded in the current batch
+	u64 lastTicket = 0; // ticket of the last upload
+	u64 recordedTicket = 0; // the uploads with ticket <= recordedTicket have been completely recorded
+	u64 readyTicket = 0; // the uploads with ticket <= readyTicket can be used by the draw commands
+};
+
+// uploads submitted to the transfer queue, waiting for the timeline semaphore to reach "timelineValue"
+struct TransferBatch {
+	u64 timelineValue;
+	vk::CmdBuffer cmdBuffer;
+	vk::Buffer stagingBuffer; // the ring at the time of submission. If the ring was replaced, there is no need to reclaim the bytes
+	size_t stagingBytes;
+	u64 lastTicket;
+	std::vector<vk::Buffer> buffers; // need to be acquired by the graphics queue
+	std::vector<ImageStagingProc> images; // need to be acquired by the graphics queue, and then finalized (mip chain and shaderRead layout)
+	std::vector<ImageRC> imageRefs; // keep the images alive until the batch is finished
+	std::vector<vk::Buffer> buffersToDestroy; // could be in use by this batch, or previous ones
+};
+
 struct RenderTarget {
+	u32 numColorBuffers; // one per swapchain image if autoRedraw. Otherwise, there is just one (the frame graph puts a barrier in case the previous frame is still sampling it)
 	vk::Image colorBuffer[MAX_SWAPCHAIN_IMAGES];
-	vk::Image depthBuffer[MAX_SWAPCHAIN_IMAGES];
 	vk::ImageView colorBufferView[MAX_SWAPCHAIN_IMAGES];
-	vk::ImageView depthBufferView[MAX_SWAPCHAIN_IMAGES];
+	vk::Image depthBuffer; // the depth is not needed after the render pass, so there is just one, shared by all the swapchain images
+	vk::ImageView depthBufferView;
+	u32 depthMemory; // index in RenderUniverse::transientDepthMemories. u32(-1) if the depth buffer has its own memory
 	VkFramebuffer framebuffer[MAX_SWAPCHAIN_IMAGES];
 	u32 w, h;
 	bool autoRedraw; // we can avoid redrawing everyframe if there are no changes
 	u8 needRedraw; // if !autoRedraw, "needRedraw" tells us if we need to redraw because it has been requested.
-		// Since there are use multiple images, we use an integer istead of a boolean.
-		// So this is how many frames we need to redraw. For example, if we are using triple-buffering,
-		// requesting to redraw would set "needRedraw" to 3, and each frame we would draw if(needRedraw > 0), and decrease needRedraw.
-		// We can also set needRedraw to -1 and... when the renderer sees -1 it will change it to the number of swapchain images
+		// It's how many frames we need to redraw: each frame we would draw if(needRedraw > 0), and decrease needRedraw.
+		// We can also set needRedraw to -1 and... when the renderer sees -1 it will change it to the number of color buffers
+		// (that's always 1 for !autoRedraw targets, but it used to be the number of swapchain images)
+
+	u32 colorInd(u32 scImgInd)const { return scImgInd % numColorBuffers; }
+};
+
+// the images of render targets that have been destroyed or resized. They are recycled by new render targets of the same size and kind
+struct PooledRenderTarget {
+	RenderTarget rt; // only the images are relevant
+	u64 releaseFrame;
 };
 
 static constexpr u32 k_anisotropicFractionResolution = 4;
 static constexpr u32 k_maxAnisotropicFiltering = 16; // https://vulkan.gpuinfo.org/displaydevicelimit.php?name=maxSamplerAnisotropy&platform=all
 static constexpr u32 k_anisotropicFilteringNumDiscreteValues = (k_maxAnisotropicFiltering - 1) * k_anisotropicFractionResolution + 1;
 
-struct DescPool_DescSet { DescPoolId descPool; VkDescriptorSet descSet; };
-
 struct RenderUniverse
 {
 	u32 queueFamily;
@@ -62,6 +142,15 @@ struct RenderUniverse
 	u8 msaa = 1;
 	vk::SwapchainOptions swapchainOptions;
 	vk::SwapchainSyncHelper swapchain;
+	// headless: the swapchain is a ring of images that we own. The frames can be copied to CPU memory
+	struct Headless {
+		bool enabled = false;
+		u32 numImages;
+		bool readbackEnabled = false;
+		vk::Buffer readbackBuffers[MAX_SWAPCHAIN_IMAGES]; // the copy of the image with the same index
+		bool readbackValid[MAX_SWAPCHAIN_IMAGES] = {};
+		u32 lastDrawnImgInd = u32(-1);
+	} headless;
 	vk::Image depthStencilImages[MAX_SWAPCHAIN_IMAGES];
 	vk::ImageView depthStencilImageViews[MAX_SWAPCHAIN_IMAGES];
 	VkFramebuffer framebuffers[MAX_SWAPCHAIN_IMAGES];
@@ -69,13 +158,29 @@ struct RenderUniverse
 	VkRenderPass renderPassOffscreen;
 	VkDescriptorSetLayout globalDescSetLayout;
 
-	// staging buffers
-	struct StagingBuffer {
-		vk::Buffer buffer;
-		size_t offset;
-	};
-	std::vector<StagingBuffer> spareStagingBuffers; // these are the staging buffers that can be picked up for future staging processes
-	std::vector<StagingBuffer> bussyStagingBuffers[MAX_SWAPCHAIN_IMAGES]; // here we keep the staging buffers that are in use. After the staging process is finished, we move the stagingBuffer back to spareStagingBuffers
+	// staging
+	// Recorded in the graphics queue, right before the draw commands of the frame. The memory used by a frame is reclaimed when its fence is signaled
+	StagingStream staging;
+
+	// asynchronous uploads
+	// When the device has a dedicated transfer queue, the initial data of images and geoms is uploaded there, so big uploads don't stall the frame.
+	// Each frame we submit a batch that signals a timeline semaphore. When the batch is finished, the resources are acquired by the graphics queue
+	struct Transfer {
+		bool enabled = false;
+		u32 queueFamily;
+		VkQueue queue;
+		VkCommandPool cmdPool;
+		VkSemaphore timeline;
+		u64 timelineValue = 0; // value signaled by the last batch submitted
+		u64 acquiredTimelineValue = 0; // value of the last batch acquired by the graphics queue
+		StagingStream stream;
+		vk::CmdBuffer cmdBuffer; // the cmd buffer of the batch being recorded
+		bool recording = false;
+		std::vector<ImageRC> imageRefs; // of the batch being recorded
+		std::vector<vk::Buffer> buffersToDestroy; // of the batch being recorded
+		std::vector<vk::CmdBuffer> freeCmdBuffers;
+		std::deque<TransferBatch> inFlight;
+	} transfer;
 
 	// resources to destroy
 	struct ToDestroy {
@@ -86,6 +191,8 @@ struct RenderUniverse
 		std::vector<vk::ImageView> imageViews[MAX_SWAPCHAIN_IMAGES];
 		std::vector<VkFramebuffer> framebuffers[MAX_SWAPCHAIN_IMAGES];
 		std::vector<std::array<std::vector<VkDescriptorSet>, MAX_SWAPCHAIN_IMAGES>> descSets; // [descPool][scImgInd][descSet]
+		std::vector<MaterialId> materials[MAX_SWAPCHAIN_IMAGES];
+		std::vector<u32> bindlessTextureSlots[MAX_SWAPCHAIN_IMAGES];
 
 		// here we temporarily queue the resources that need to be destroyed. Later we will transfer these resources to queues above
 		std::vector<vk::Buffer> buffersTmp;
@@ -93,53 +200,116 @@ struct RenderUniverse
 		std::vector<vk::ImageView> imageViewsTmp;
 		std::vector<VkFramebuffer> framebuffersTmp;
 		std::vector<std::vector<VkDescriptorSet>> descSetsTmp; // [descPool][descSet]
+		std::vector<MaterialId> materialsTmp;
+		std::vector<u32> bindlessTextureSlotsTmp;
 		bool pushToTmp = true;
 	} toDestroy;
 
 	// images
-	std::vector<vk::Image> images_vk;
-	std::vector<u32> images_refCount; // when the entry is free, it indicates the next free entry (forming a linked list)
-	std::vector<ImageInfo> images_info;
-	std::vector<u32> images_defaultImageView;
-	std::unordered_map<Path, ImageId> images_nameToId;
-	u32 images_nextFreeEntry = u32(-1);
-	std::vector<ImageStagingProc> images_stagingProcs;
+	SlotMap<> images_slots;
+	mem::Vector<mem::Tag::renderUniverse, vk::Image> images_vk;
+	mem::Vector<mem::Tag::renderUniverse, u32> images_refCount;
+	mem::Vector<mem::Tag::renderUniverse, ImageInfo> images_info;
+	mem::Vector<mem::Tag::renderUniverse, u32> images_defaultImageView;
+	mem::FlatHashMap<mem::Tag::renderUniverse, Path, ImageId> images_nameToId;
+	mem::Vector<mem::Tag::renderUniverse, u64> images_uploadTicket; // the image can't be used until this upload is finished
 
 	// image views
-	std::vector<vk::ImageView> imageViews_vk;
-	std::vector<u32> imageViews_refCount;
-	std::vector<ImageRC> imageViews_image;
-	u32 imageViews_nextFreeEntry = u32(-1);
+	SlotMap<> imageViews_slots;
+	mem::Vector<mem::Tag::renderUniverse, vk::ImageView> imageViews_vk;
+	mem::Vector<mem::Tag::renderUniverse, u32> imageViews_refCount;
+	mem::Vector<mem::Tag::renderUniverse, ImageRC> imageViews_image;
 
 	// descriptor sets
-	std::vector<VkDescriptorPool> descPools;
-	std::vector<std::vector<VkDescriptorSet>> descSets;
-	u32 descPools_nextFreeEntry = u32(-1);
-	std::vector<u32> descSets_nextFreeEntry;
+	struct DescPoolChain {
+		u32 maxSets;
+		std::array<VkDescriptorPoolSize, 3> sizesPerType;
+		u32 sizesPerType_n;
+		vk::DescPoolOptions options;
+		std::vector<VkDescriptorPool> pools; // VK_NULL_HANDLE for pools that have been reclaimed
+		std::vector<u32> pools_numSets; // occupancy of each pool
+		std::unordered_map<VkDescriptorSet, u32> descSet_to_pool; // the sets that were not allocated with allocDescSets (ImGui) belong to the first pool
+	};
+	SlotMap<> descPools_slots;
+	std::vector<DescPoolChain> descPools;
 
 	// geoms
-	std::vector<GeomInfo> geoms_info;
-	std::vector<u32> geoms_refCount;
-	std::vector<vk::Buffer> geoms_buffer;
-	u32 geoms_nextFreeEntry = u32(-1);
+	SlotMap<> geoms_slots;
+	mem::Vector<mem::Tag::renderUniverse, GeomInfo> geoms_info;
+	mem::Vector<mem::Tag::renderUniverse, u32> geoms_refCount;
+	mem::Vector<mem::Tag::renderUniverse, vk::Buffer> geoms_buffer;
+	mem::Vector<mem::Tag::renderUniverse, u64> geoms_uploadTicket;
 	PathBag geoms_pathBag;
 
 	// materials
 	std::vector<MaterialManager> materialManagers;
 	std::vector<std::vector<u32>> materials_refCount;
 
+	// bindless textures: slots of the big array of textures shared by all the bindless materials
+	struct BindlessTextures {
+		u32 capacity = 0; // 0 if bindless is not enabled
+		u32 numSlots = 0;
+		std::vector<u32> freeSlots;
+	} bindlessTextures;
+
 	// meshes
-	std::vector<MeshInfo> meshes_info;
-	std::vector<u32> meshes_refCount;
-	u32 meshes_nextFreeEntry = u32(-1);
+	SlotMap<> meshes_slots; // the generations are also used for detecting MeshInfoViews of released meshes
+	mem::Vector<mem::Tag::renderUniverse, MeshInfo> meshes_info;
+	mem::Vector<mem::Tag::renderUniverse, u32> meshes_refCount;
 
 	// render targets
-	tk::EntriesArray<RenderTarget> renderTargets;
+	SlotMap<RenderTarget> renderTargets;
+	// the depth buffers of the render targets are only used during their render pass (storeOp=dontCare), so all of them alias the same memory.
+	// The last entry is the current one. When a bigger render target is created, it's replaced; the render targets that alias the old ones keep them alive
+	struct TransientDepthMemory {
+		vk::Image image; // owns the memory. {} when it has been freed
+		u32 w, h;
+		u32 numAliases;
+	};
+	std::vector<TransientDepthMemory> transientDepthMemories;
+	std::vector<PooledRenderTarget> renderTargetPool; // sorted by releaseFrame
+
+	// frame graph
+	FrameGraph frameGraph;
+	std::vector<FgResource> frameGraph_depthMemories; // [transientDepthMemory]
+	struct RenderTargetPass { u32 rtvInd; u32 passInd; FgResource color; };
+	std::vector<RenderTargetPass> frameGraph_renderTargetPasses;
 	
 	VkCommandPool cmdPool;
 	vk::CmdBuffer cmdBuffers_staging[MAX_SWAPCHAIN_IMAGES + 1]; // we have one extra buffer because we could have a staging cmd buffer "in use" but we still want to record staging cmd for future frames
 	u32 cmdBuffers_staging_ind = 0; // that's why we need a separate index for it
 	vk::CmdBuffer cmdBuffers_draw[MAX_SWAPCHAIN_IMAGES];
+	u64 frameCounter = 0;
+
+	// GPU timings
+	// There is a timestamp at the beginning and the end of each scope (staging, render passes, viewports, imgui).
+	// They are read back when the frame's fence has been signaled, and sent to Tracy
+	struct GpuTimings {
+		bool enabled = false;
+		float timestampPeriod; // nanoseconds per tick
+		u64 timestampMask; // the valid bits of the timestamps
+		VkQueryPool queryPool = VK_NULL_HANDLE; // GPU_TIMINGS_MAX_QUERIES per swapchain image, and then 2 per staging cmd buffer
+		struct Scope {
+			const char* name;
+			u32 id;
+			u32 depth;
+			u32 beginQuery, endQuery;
+		};
+		std::vector<Scope> scopes[MAX_SWAPCHAIN_IMAGES]; // in the order they were opened
+		u32 numQueries[MAX_SWAPCHAIN_IMAGES] = {};
+		u32 depth = 0; // of the scopes being recorded
+		std::vector<u64> timestamps; // tmp storage for the read back
+		std::vector<GpuTiming> results; // of the last frame that was read back
+#ifdef TRACY_ENABLE
+		u8 tracyContext;
+#endif
+	} gpuTimings;
+
+	// render statistics. They are accumulated in "current" until the end of draw(), and then moved to "last"
+	struct {
+		FrameStats current;
+		FrameStats last;
+	} stats;
 
 	struct DefaultSamplers {
 		// anisotropic can be float, but we will use discrete values [0]=1.0, [1]=1.25, ..., [4]=2.0, [8]=3.0, [15*4]=16.0
@@ -148,13 +318,64 @@ struct RenderUniverse
 	} defaultSamplers = {};
 
 	// RenderWorlds
+	SlotMap<> renderWorlds_slots;
 	std::vector<RenderWorld> renderWorlds;
-	u32 renderWorlds_nextFreeEntry = u32(-1);
+	u32 drawPacketsEpoch = 1; // incremented when the cached draw packets could be stale: the descriptor sets of the materials were replaced, or a geom was reset
+
+	// getOrLoadImage()
+	// The files are read and decoded in worker threads. Meanwhile, the images are bound to a shared 1x1 placeholder.
+	// When the real image has been uploaded, it's swapped in, and the image views and descriptor sets that referenced the placeholder are updated
+	struct ImageLoader {
+		struct Request { ImageId img; std::string path; };
+		struct Decoded {
+			ImageId img;
+			u8* pixels = nullptr; int w = 0, h = 0; // decoded with stb_image
+			bool isTextureFile = false; // KTX2 or DDS: it's uploaded as it is, with the mip chain precomputed
+			TextureFile textureFile;
+		};
+		struct Loading {
+			ImageRC img;
+			std::string path;
+			bool srgb;
+			bool generateMipChain;
+			ImageRC uploading; // the real image, while it's being uploaded
+		};
+
+		// shared with the worker threads
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::deque<Request> requests;
+		std::vector<Decoded> decoded;
+		bool quit = false;
+		std::vector<std::thread> threads;
+
+		ImageRC placeholder;
+		vk::Image placeholderVk; // never destroyed by the images bound to it
+		std::vector<Loading> loading;
+
+		~ImageLoader() {
+			{
+				std::lock_guard lock(mutex);
+				quit = true;
+			}
+			cv.notify_all();
+			for (auto& t : threads)
+				t.join();
+		}
+	} imageLoader;
 
 	// imgui
 	struct ImGui {
 		bool enabled = false;
 		DescPoolId descPool = {};
+		// textures of images that are still loading. When the image is swapped in, a new descriptor set is created, and the draw commands that use the original one are patched
+		struct Texture {
+			VkSampler sampler;
+			ImageViewId imgView;
+			VkImageLayout layout;
+			VkDescriptorSet current;
+		};
+		std::unordered_map<VkDescriptorSet, Texture> textures;
 	} imgui;
 
 	~RenderUniverse() {
@@ -165,102 +386,300 @@ struct RenderUniverse
 
 static RenderUniverse RU;
 
-struct PreparedStagingData {
-	vk::Buffer buffer;
-	u32 offset;
-	u32 dataSize;
-};
+static constexpr size_t STAGING_MIN_CHUNK = 64u << 10u; // we don't split uploads in chunks smaller than this
 
 static vk::CmdBuffer& getCurrentStagingCmdBuffer()
 {
 	return RU.cmdBuffers_staging[RU.cmdBuffers_staging_ind];
 }
 
-static PreparedStagingData prepareStagingData(CSpan<CSpan<u8>> data)
+// the cmd buffer where the copies of the stream are recorded. For the transfer stream, we start recording a new batch if needed
+static vk::CmdBuffer& staging_getCmdBuffer(StagingStream& S)
+{
+	if (&S == &RU.staging)
+		return getCurrentStagingCmdBuffer();
+
+	auto& T = RU.transfer;
+	if (!T.recording) {
+		if (T.freeCmdBuffers.empty()) {
+			T.freeCmdBuffers.emplace_back();
+			RU.device.allocCmdBuffers(T.cmdPool, { &T.freeCmdBuffers.back(), 1 }, false);
+		}
+		T.cmdBuffer = T.freeCmdBuffers.back();
+		T.freeCmdBuffers.pop_back();
+		T.cmdBuffer.begin(vk::CmdBufferUsageFlags{ .oneTimeSubmit = true });
+		T.recording = true;
+	}
+	return T.cmdBuffer;
+}
+
+// the initial data of images and geoms is uploaded in the transfer queue when possible
+static StagingStream& getResourcesStagingStream()
+{
+	return RU.transfer.enabled ? RU.transfer.stream : RU.staging;
+}
+
+static void deferredDestroy_buffer(vk::Buffer id);
+
+static size_t staging_remainingFrameBudget(const StagingStream& S)
+{
+	// we always allow at least one chunk per frame, otherwise we could get stuck with a tiny budget
+	const size_t budget = glm::max(S.frameBudget, STAGING_MIN_CHUNK);
+	return S.budgetUsedThisFrame < budget ? budget - S.budgetUsedThisFrame : 0;
+}
+
+// replaces the ring with a bigger one. The old buffer is destroyed when the submissions that use it are finished
+static bool staging_grow(StagingStream& S, size_t minCapacity)
+{
+	size_t capacity = glm::max(STAGING_RING_INITIAL_CAPACITY, 2 * S.capacity);
+	while (capacity < minCapacity)
+		capacity *= 2;
+	capacity = glm::min(capacity, S.maxCapacity);
+	if (capacity <= S.capacity || capacity < minCapacity)
+		return false;
+
+	if (S.buffer.id) {
+		if (S.usedThisBatch)
+			RU.device.flushBuffer(S.buffer);
+		deferredDestroy_buffer(S.buffer);
+	}
+	S.buffer = RU.device.createBuffer(vk::BufferUsage::transferSrc, capacity, { .sequentialWrite = true }, mem::Tag::staging);
+	S.memPtr = RU.device.getBufferMemPtr(S.buffer);
+	S.capacity = capacity;
+	S.head = 0;
+	S.used = 0;
+	for (auto& x : S.usedByFrame)
+		x = 0;
+	S.usedThisBatch = 0;
+	return true;
+}
+
+// sub-allocates from the staging ring. Returns false if there isn't enough space, even after trying to grow the ring
+static bool staging_alloc(StagingStream& S, size_t size, size_t alignment, size_t& offset)
 {
-	size_t totalSize = 0;
-	for (auto d : data)
-		totalSize += d.size();
-	assert(totalSize <= STAGING_BUFFER_CAPACITY);
+	auto tryAlloc = [&]() {
+		if (S.used == 0)
+			S.head = 0;
+		size_t o = (S.head + alignment - 1) / alignment * alignment;
+		size_t needed = o - S.head + size;
+		if (o + size > S.capacity) { // wrap around, the end of the ring is wasted
+			o = 0;
+			needed = S.capacity - S.head + size;
+		}
+		if (S.used + needed > S.capacity)
+			return false;
+		offset = o;
+		S.head = o + size;
+		S.used += needed;
+		S.usedThisBatch += needed;
+		return true;
+	};
+	if (tryAlloc())
+		return true;
+	return staging_grow(S, size + alignment) && tryAlloc();
+}
 
-	int i;
-	for (i = int(RU.spareStagingBuffers.size()) - 1; i >= 0; i--) {
-		const u32 remainingSpace = STAGING_BUFFER_CAPACITY - RU.spareStagingBuffers[i].offset;
-		if (data.size() <= remainingSpace)
+// uploads as much as the frame budget and the staging ring allow. Returns the number of bytes uploaded so far
+static size_t staging_uploadToBuffer(StagingStream& S, vk::Buffer dst, size_t dstOffset, CSpan<u8> data, size_t uploadedBytes)
+{
+	while (uploadedBytes < data.size()) {
+		const size_t minChunk = glm::min(data.size() - uploadedBytes, STAGING_MIN_CHUNK);
+		size_t chunkSize = glm::min(data.size() - uploadedBytes, staging_remainingFrameBudget(S));
+		size_t offset;
+		while (chunkSize >= minChunk && !staging_alloc(S, chunkSize, STAGING_ALIGNMENT, offset))
+			chunkSize /= 2;
+		if (chunkSize < minChunk || chunkSize == 0)
 			break;
+
+		memcpy(S.memPtr + offset, data.data() + uploadedBytes, chunkSize);
+		staging_getCmdBuffer(S).cmd_copy(RU.device.getVkHandle(S.buffer), RU.device.getVkHandle(dst), offset, dstOffset + uploadedBytes, chunkSize);
+		S.dstBufferUsage |= RU.device.getBufferUsage(dst);
+		S.budgetUsedThisFrame += chunkSize;
+		RU.stats.current.bytesStaged += chunkSize;
+		uploadedBytes += chunkSize;
 	}
-	if (i == -1) { // no spareStagingBuffer found, need to create one
-		i = RU.spareStagingBuffers.size();
-		const vk::Buffer stagingBuffer = RU.device.createBuffer(vk::BufferUsage::transferSrc, STAGING_BUFFER_CAPACITY, { .sequentialWrite = true });
-		RU.spareStagingBuffers.push_back(RenderUniverse::StagingBuffer{
-			.buffer = stagingBuffer,
-			.offset = 0,
-		});
+	return uploadedBytes;
+}
+
+// same as staging_uploadToBuffer, but the chunks are made of whole rows (of blocks, for compressed formats) of one mip level.
+// The data contains the mip levels tightly packed, starting from level 0. It can contain just the first levels.
+// The copies are recorded when the batch is submitted because they need layout transitions
+static size_t staging_uploadToImage(StagingStream& S, ImageId img, CSpan<u8> data, size_t uploadedBytes, bool generateMipChain)
+{
+	const auto& info = RU.images_info[img.id];
+	const auto block = vk::getFormatBlockInfo(info.format);
+	const size_t alignment = std::lcm(STAGING_ALIGNMENT, size_t(block.bytes)); // the offset must be a multiple of the texel (block) size
+
+	// find the level where we left it
+	u8 level = 0;
+	size_t levelStart = 0;
+	while (level + 1 < info.numMips && levelStart + calcImageLevelSize(info.format, info.w, info.h, level) <= uploadedBytes) {
+		levelStart += calcImageLevelSize(info.format, info.w, info.h, level);
+		level++;
 	}
-	auto& sb = RU.spareStagingBuffers[i];
-	auto memPtr = RU.device.getBufferMemPtr(sb.buffer) + sb.offset;
-	for (auto d : data) {
-		memcpy(memPtr, d.data(), d.size());
-		memPtr += d.size();
+
+	while (uploadedBytes < data.size()) {
+		const u32 levelW = glm::max(1u, u32(info.w) >> level);
+		const u32 levelH = glm::max(1u, u32(info.h) >> level);
+		const size_t rowSize = size_t((levelW + block.w - 1) / block.w) * block.bytes;
+		const u32 numLevelRows = (levelH + block.h - 1) / block.h;
+		const u32 rowGranularity = S.imageRowGranularity ? S.imageRowGranularity : numLevelRows;
+		const u32 firstRow = u32((uploadedBytes - levelStart) / rowSize);
+		const u32 remainingRows = numLevelRows - firstRow;
+		u32 numRows = glm::min(remainingRows, u32(staging_remainingFrameBudget(S) / rowSize));
+		if (numRows < remainingRows)
+			numRows = numRows / rowGranularity * rowGranularity; // the chunks must respect the image transfer granularity of the queue
+		if (numRows == 0 && S.budgetUsedThisFrame == 0)
+			numRows = glm::min(rowGranularity, remainingRows); // the smallest chunk is bigger than the budget
+		size_t offset;
+		while (numRows && !staging_alloc(S, numRows * rowSize, alignment, offset))
+			numRows = numRows / 2 / rowGranularity * rowGranularity;
+		if (numRows == 0)
+			break;
+
+		memcpy(S.memPtr + offset, data.data() + uploadedBytes, numRows * rowSize);
+		const bool levelDone = numRows == remainingRows;
+		const bool lastChunk = levelDone && uploadedBytes + numRows * rowSize == data.size();
+		S.imageProcs.push_back(ImageStagingProc{
+			.img = img,
+			.stagingBuffer = S.buffer,
+			.stagingBufferOffset = u32(offset),
+			.firstRow = u16(firstRow * block.h),
+			.numRows = u16(glm::min(numRows * block.h, levelH - firstRow * block.h)), // the last row of blocks can be partial
+			.mipLevel = level,
+			.firstChunk = uploadedBytes == 0,
+			.lastChunk = lastChunk,
+			.generateMipChain = generateMipChain,
+		});
+		if (lastChunk && &S == &RU.transfer.stream)
+			RU.transfer.imageRefs.push_back(ImageRC(img));
+		S.budgetUsedThisFrame += numRows * rowSize;
+		RU.stats.current.bytesStaged += numRows * rowSize;
+		uploadedBytes += numRows * rowSize;
+		if (levelDone) {
+			levelStart = uploadedBytes;
+			level++;
+		}
 	}
+	return uploadedBytes;
+}
+
+static void staging_onUploadRecorded(StagingStream& S, u64 ticket, vk::Buffer dstBuffer)
+{
+	S.recordedTicket = ticket;
+	if (dstBuffer.id && &S == &RU.transfer.stream)
+		S.completedBuffers.push_back(dstBuffer); // the ownership of the buffer will be transferred to the graphics queue
+}
 
-	const size_t offset = sb.offset;
-	sb.offset += totalSize;
+// continues the queued uploads, in order, until the frame budget or the staging ring are exhausted
+static void staging_processPendingUploads(StagingStream& S)
+{
+	auto& pending = S.pending;
+	while (pending.size()) {
+		auto& upload = pending.front();
+		if (upload.dstImage.id.isValid())
+			upload.uploadedBytes = staging_uploadToImage(S, upload.dstImage.id, upload.data, upload.uploadedBytes, upload.generateMipChain);
+		else
+			upload.uploadedBytes = staging_uploadToBuffer(S, upload.dstBuffer, upload.dstOffset, upload.data, upload.uploadedBytes);
 
-	return { sb.buffer, u32(offset), u32(totalSize) };
+		if (upload.uploadedBytes < upload.data.size())
+			break;
+		staging_onUploadRecorded(S, upload.ticket, upload.dstBuffer);
+		pending.pop_front();
+	}
 }
 
-static void stageData(vk::Buffer buffer, CSpan<CSpan<u8>> data, size_t dstOffset = 0)
+// the data is copied, so it can be freed right after calling this function. Returns the ticket of the upload
+static u64 stageData(StagingStream& S, vk::Buffer buffer, CSpan<CSpan<u8>> datas, size_t dstOffset = 0)
 {
-	auto [srcBuffer, srcBufferOffset, dataSize] = prepareStagingData(data);
-	auto& cmdBuffer = getCurrentStagingCmdBuffer();
-	cmdBuffer.cmd_copy(RU.device.getVkHandle(srcBuffer), RU.device.getVkHandle(buffer), srcBufferOffset, dstOffset, dataSize);
+	const u64 ticket = ++S.lastTicket;
+	auto& pending = S.pending;
+	size_t i = 0;
+	size_t uploadedBytes = 0; // of datas[i]
+	if (pending.empty()) { // the uploads must happen in order, so we can only upload right away if there is nothing queued
+		for (; i < datas.size(); i++) {
+			uploadedBytes = staging_uploadToBuffer(S, buffer, dstOffset, datas[i], 0);
+			dstOffset += uploadedBytes;
+			if (uploadedBytes < datas[i].size())
+				break;
+		}
+	}
+	if (i == datas.size()) {
+		staging_onUploadRecorded(S, ticket, buffer);
+		return ticket;
+	}
+
+	auto& upload = pending.emplace_back();
+	upload.data.assign(datas[i].begin() + uploadedBytes, datas[i].end());
+	for (i++; i < datas.size(); i++)
+		upload.data.insert(upload.data.end(), datas[i].begin(), datas[i].end());
+	upload.dstBuffer = buffer;
+	upload.dstOffset = dstOffset;
+	upload.ticket = ticket;
+	return ticket;
 }
 
-static void stageData(vk::Buffer buffer, CSpan<u8> data, size_t dstOffset = 0)
+static u64 stageData(StagingStream& S, vk::Buffer buffer, CSpan<u8> data, size_t dstOffset = 0)
 {
 	const CSpan<u8> datas[] = { data };
-	stageData(buffer, datas, dstOffset);
+	return stageData(S, buffer, datas, dstOffset);
 }
 
-static void stageDataToImage(vk::Image img, CSpan<u8> data)
+// records the whole copy right away, skipping the queue of pending uploads and the frame budget. Only for small copies that don't need to be ordered with the rest of uploads (the material parameters).
+// Returns false if there isn't room in the staging ring
+static bool stageDataNow(StagingStream& S, vk::Buffer buffer, CSpan<u8> data, size_t dstOffset)
 {
-	const CSpan<u8> datas[] = { data };
-	auto [srcBuffer, srcBufferOffset, dataSize] = prepareStagingData(datas);
+	size_t offset;
+	if (!staging_alloc(S, data.size(), STAGING_ALIGNMENT, offset))
+		return false;
+	memcpy(S.memPtr + offset, data.data(), data.size());
+	staging_getCmdBuffer(S).cmd_copy(RU.device.getVkHandle(S.buffer), RU.device.getVkHandle(buffer), offset, dstOffset, data.size());
+	S.dstBufferUsage |= RU.device.getBufferUsage(buffer);
+	S.budgetUsedThisFrame += data.size();
+	RU.stats.current.bytesStaged += data.size();
+	return true;
+}
 
-	const auto& imgInfo = RU.device.getInfo(img);
+// uploads the level 0 of the image, or all its levels. The data is copied, so it can be freed right after calling this function
+static u64 stageDataToImage(StagingStream& S, ImageId img, CSpan<u8> data, bool generateMipChain)
+{
+	const u64 ticket = ++S.lastTicket;
+	auto& pending = S.pending;
+	size_t uploadedBytes = 0;
+	if (pending.empty())
+		uploadedBytes = staging_uploadToImage(S, img, data, 0, generateMipChain);
+	if (uploadedBytes == data.size()) {
+		staging_onUploadRecorded(S, ticket, {});
+		return ticket;
+	}
 
-	auto& cmdBuffer = getCurrentStagingCmdBuffer();
-	const VkBufferImageCopy copy{
-		.bufferOffset = srcBufferOffset,
-		.bufferRowLength = 0, .bufferImageHeight = 0, // when either of these values is 0, the buffer memory is assumed to be tightly packed according to the imageExtent
-		.imageSubresource = {
-			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-			.mipLevel = 0,
-			.baseArrayLayer = 0,
-			.layerCount = imgInfo.getNumLayers(),
-		},
-		.imageOffset = {0, 0, 0},
-		.imageExtent = {imgInfo.size.width, imgInfo.size.height, imgInfo.size.depth},
-	};
-	cmdBuffer.cmd_copy(RU.device.getVkHandle(srcBuffer), RU.device.getVkHandle(img), { &copy, 1 });
+	auto& upload = pending.emplace_back();
+	upload.data.assign(data.begin(), data.end());
+	upload.uploadedBytes = uploadedBytes;
+	upload.dstImage = ImageRC(img);
+	upload.generateMipChain = generateMipChain;
+	upload.ticket = ticket;
+	return ticket;
 }
 
 // --- IMAGES ---
+static bool isBoundToPlaceholder(u32 e);
+
 ImageInfo ImageId::getInfo()const { return RU.images_info[id]; }
 vk::Image ImageId::getHandle()const { return RU.images_vk[id]; }
 void* ImageId::getInternalHandle()const { return RU.device.getVkHandle(getHandle()); }
+bool ImageId::isReady()const { return RU.images_uploadTicket[id] <= getResourcesStagingStream().readyTicket; }
+bool ImageId::isLoaded()const { return !isBoundToPlaceholder(id); }
 
 static u32 acquireImageEntry()
 {
-	const u32 e = acquireReusableEntry(RU.images_nextFreeEntry,
-		RU.images_refCount, 0, RU.images_vk, RU.images_info);
+	const u32 e = RU.images_slots.acquire(RU.images_refCount, RU.images_vk, RU.images_info, RU.images_uploadTicket);
 	return e;
 }
 
 static void releaseImageEntry(u32 e)
 {
-	releaseReusableEntry(RU.images_nextFreeEntry, RU.images_refCount, 0, e);
+	RU.images_slots.release(e);
 }
 
 static void deferredDestroy(auto& frames, auto& tmp, auto id)
@@ -276,6 +695,13 @@ static void deferredDestroy_image(vk::Image id)
 	deferredDestroy(RU.toDestroy.images, RU.toDestroy.imagesTmp, id);
 }
 
+// the image is still being loaded by getOrLoadImage
+static bool isBoundToPlaceholder(u32 e)
+{
+	const auto& L = RU.imageLoader;
+	return RU.images_vk[e].id == L.placeholderVk.id && e != L.placeholder.id.id;
+}
+
 void incRefCount(ImageId id)
 {
 	if (id == ImageId{})
@@ -289,7 +715,8 @@ void decRefCount(ImageId id)
 	auto& c = RU.images_refCount[id.id];
 	c--;
 	if (c == 0) {
-		deferredDestroy_image(RU.images_vk[id.id]);
+		if (!isBoundToPlaceholder(id.id))
+			deferredDestroy_image(RU.images_vk[id.id]);
 		releaseImageEntry(id.id);
 	}
 }
@@ -305,6 +732,22 @@ u8 calcNumMipsFromDimensions(u32 w, u32 h)
 	return n;
 }
 
+size_t calcImageLevelSize(vk::Format format, u32 w, u32 h, u8 level)
+{
+	const auto block = vk::getFormatBlockInfo(format);
+	w = glm::max(1u, w >> level);
+	h = glm::max(1u, h >> level);
+	return size_t((w + block.w - 1) / block.w) * size_t((h + block.h - 1) / block.h) * block.bytes;
+}
+
+size_t calcImageSize(vk::Format format, u32 w, u32 h, u8 numMips)
+{
+	size_t size = 0;
+	for (u8 level = 0; level < numMips; level++)
+		size += calcImageLevelSize(format, w, h, level);
+	return size;
+}
+
 bool nextMipLevelDown(u32& w, u32& h)
 {
 	w = glm::max(u32(1), w / u32(2));
@@ -312,61 +755,127 @@ bool nextMipLevelDown(u32& w, u32& h)
 	return w == u32(1) && h == u32(1);
 }
 
-ImageRC getOrLoadImage(Path path, bool srgb, bool generateMipChain)
+ImageRC makeImage(const ImageInfo& info, CSpan<u8> data, bool generateRemainingMips)
 {
-	auto it = RU.images_nameToId.find(path);
-	if (it != RU.images_nameToId.end())
-		return ImageRC{ it->second };
-
-	auto fileData = tk::loadBinaryFile(path.string().c_str());
-	if(fileData.data == nullptr)
-		return ImageRC({});
-
-	int w, h, nc;
-	u8* imgData = stbi_load_from_memory(fileData.data, fileData.size, &w, &h, &nc, 4);
-	if(imgData == nullptr)
-		return ImageRC({});
-
-	assert(w > 0 && h > 0 && imgData != nullptr);
-	const u8 numMips = calcNumMipsFromDimensions(u32(w), u32(h));
-	const auto format = srgb ? vk::Format::RGBA8_SRGB : vk::Format::RGBA8_UNORM;
+	assert(info.w > 0 && info.h > 0 && info.type == ImageType::_2d); // TODO: other image types
 	vk::Image imageVk = RU.device.createImage({
 		.size = {
-			.width = u16(w),
-			.height = u16(h),
-			.numMips = numMips,
+			.width = info.w,
+			.height = info.h,
+			.numMips = info.numMips,
 		},
-		.format = format,
+		.format = info.format,
 		.dimensions = 2,
 		.numSamples = 1,
 		.usage = vk::ImageUsage::default_texture(),
 		.layout = vk::ImageLayout::undefined,
-	});
+	}, mem::Tag::renderUniverse);
 
 	const u32 e = acquireImageEntry();
-	RU.images_info[e] = ImageInfo {
-		.format = format,
-		.w = u16(w), .h = u16(h),
-		.numMips = numMips,
-	};
+	RU.images_info[e] = info;
 	RU.images_vk[e] = imageVk;
 	RU.images_refCount[e] = 0;
+	RU.images_uploadTicket[e] = 0;
 	ImageId imgId{ e };
 
-	CSpan<u8> datas[] = { { imgData, size_t(w * h * 4) } };
-	auto [stagingBuffer, stagingBufferOffset, dataSize] = prepareStagingData(datas);
-	RU.images_stagingProcs.push_back(ImageStagingProc{
-		.img = imgId,
-		.stagingBuffer = stagingBuffer,
-		.stagingBufferOffset = u32(stagingBufferOffset),
-		.dataSize = dataSize,
-		.generateMipChain = generateMipChain
-	});
+	if (data.size()) {
+		const bool hasAllMips = info.numMips > 1 && data.size() == calcImageSize(info.format, info.w, info.h, info.numMips);
+		assert(hasAllMips || data.size() == calcImageLevelSize(info.format, info.w, info.h, 0));
+		if (hasAllMips)
+			generateRemainingMips = false;
+		assert(!(generateRemainingMips && info.numMips > 1 && vk::formatIsCompressed(info.format)) && "can't blit compressed images, the mips must be precomputed");
+		RU.images_uploadTicket[e] = stageDataToImage(getResourcesStagingStream(), imgId, data, generateRemainingMips);
+	}
 
-	RU.images_nameToId[path] = imgId;
 	return ImageRC{imgId};
 }
 
+static void imageLoader_workerThread()
+{
+	profiler::setThreadName("imageLoader");
+	auto& L = RU.imageLoader;
+	while (true) {
+		RenderUniverse::ImageLoader::Request request;
+		{
+			std::unique_lock lock(L.mutex);
+			L.cv.wait(lock, [&L]() { return L.quit || L.requests.size(); });
+			if (L.quit)
+				return;
+			request = std::move(L.requests.front());
+			L.requests.pop_front();
+		}
+
+		TK_PROFILE_SCOPE_N("imageLoader_decode");
+		RenderUniverse::ImageLoader::Decoded decoded = { .img = request.img };
+		auto fileData = tk::loadBinaryFile(request.path.c_str());
+		if (fileData.data) {
+			const CSpan<u8> fileSpan(fileData.data, fileData.size);
+			if (isKtx2File(fileSpan) || isDdsFile(fileSpan)) {
+				decoded.isTextureFile = true;
+				if (!parseTextureFile(decoded.textureFile, fileSpan))
+					decoded.textureFile.format = vk::Format::undefined;
+			}
+			else {
+				int nc;
+				decoded.pixels = stbi_load_from_memory(fileData.data, fileData.size, &decoded.w, &decoded.h, &nc, 4);
+			}
+			delete[] fileData.data;
+		}
+
+		std::lock_guard lock(L.mutex);
+		L.decoded.push_back(std::move(decoded));
+	}
+}
+
+static void imageLoader_init()
+{
+	auto& L = RU.imageLoader;
+	if (L.threads.size())
+		return;
+
+	const u8 whitePixel[4] = { 255, 255, 255, 255 };
+	L.placeholder = makeImage({ .format = vk::Format::RGBA8_UNORM, .w = 1, .h = 1 }, whitePixel);
+	L.placeholderVk = L.placeholder.id.getHandle();
+
+	// we leave one core for the main thread
+	const u32 numThreads = glm::clamp(std::thread::hardware_concurrency(), 2u, 5u) - 1;
+	for (u32 i = 0; i < numThreads; i++)
+		L.threads.emplace_back(imageLoader_workerThread);
+}
+
+ImageRC getOrLoadImage(Path path, bool srgb, bool generateMipChain)
+{
+	auto it = RU.images_nameToId.find(path);
+	if (it != RU.images_nameToId.end())
+		return ImageRC{ it->second };
+
+	std::string pathStr = path.string();
+	if (!PHYSFS_exists(pathStr.c_str()))
+		return ImageRC({});
+
+	auto& L = RU.imageLoader;
+	imageLoader_init();
+
+	// bind the image to the placeholder until the real one is ready
+	const u32 e = acquireImageEntry();
+	const u32 placeholderE = L.placeholder.id.id;
+	RU.images_info[e] = RU.images_info[placeholderE];
+	RU.images_vk[e] = L.placeholderVk;
+	RU.images_refCount[e] = 0;
+	RU.images_uploadTicket[e] = RU.images_uploadTicket[placeholderE];
+	ImageRC img(ImageId{ e });
+
+	L.loading.push_back({ .img = img, .path = pathStr, .srgb = srgb, .generateMipChain = generateMipChain });
+	{
+		std::lock_guard lock(L.mutex);
+		L.requests.push_back({ img.id, std::move(pathStr) });
+	}
+	L.cv.notify_one();
+
+	RU.images_nameToId[path] = img.id;
+	return img;
+}
+
 // --- IMAGE VIEWS ---
 ImageRC ImageViewId::getImage()const
 {
@@ -387,14 +896,13 @@ void* ImageViewId::getInternalHandle()const
 
 static u32 acquireImageViewEntry()
 {
-	const u32 e = acquireReusableEntry(RU.imageViews_nextFreeEntry,
-		RU.imageViews_refCount, 0, RU.imageViews_vk, RU.imageViews_image);
+	const u32 e = RU.imageViews_slots.acquire(RU.imageViews_refCount, RU.imageViews_vk, RU.imageViews_image);
 	return e;
 }
 
 static void releaseImageViewEntry(u32 e)
 {
-	releaseReusableEntry(RU.imageViews_nextFreeEntry, RU.imageViews_refCount, 0, e);
+	RU.imageViews_slots.release(e);
 }
 
 static void deferredDestroy_imageView(vk::ImageView id)
@@ -416,6 +924,7 @@ void decRefCount(ImageViewId id)
 	c--;
 	if (c == 0) {
 		deferredDestroy_imageView(RU.imageViews_vk[id.id]);
+		RU.imageViews_image[id.id] = ImageRC(); // free entries must not keep the image alive
 		releaseImageViewEntry(id.id);
 	}
 }
@@ -466,35 +975,124 @@ FramebufferId makeFramebuffer(const MakeFramebuffer& info)
 // --- DESCRIPTOR SETS ---
 static u32 acquireDescPoolEntry()
 {
-	return acquireReusableEntry(RU.descPools_nextFreeEntry, RU.descPools, 0, RU.descSets, RU.toDestroy.descSets, RU.toDestroy.descSetsTmp);
+	return RU.descPools_slots.acquire(RU.descPools, RU.toDestroy.descSets, RU.toDestroy.descSetsTmp);
 }
 static void releaseDescPoolEntry(u32 entryToRelease)
 {
-	releaseReusableEntry(RU.descPools_nextFreeEntry, RU.descPools, 0, entryToRelease);
+	RU.descPools_slots.release(entryToRelease);
 }
 
 VkDescriptorPool DescPoolId::getHandleVk()const
 {
-	return RU.descPools[id];
+	return RU.descPools[id].pools[0];
+}
+
+static u32 descPool_addPool(RenderUniverse::DescPoolChain& chain)
+{
+	const VkDescriptorPool pool = RU.device.createDescriptorPool(chain.maxSets, { chain.sizesPerType.data(), chain.sizesPerType_n }, chain.options);
+	for (u32 i = 0; i < u32(chain.pools.size()); i++) {
+		if (!chain.pools[i]) {
+			chain.pools[i] = pool;
+			chain.pools_numSets[i] = 0;
+			return i;
+		}
+	}
+	chain.pools.push_back(pool);
+	chain.pools_numSets.push_back(0);
+	return u32(chain.pools.size() - 1);
 }
 
 DescPoolId makeDescPool(const MakeDescPool& info)
 {
 	const u32 e = acquireDescPoolEntry();
-	std::array<VkDescriptorPoolSize, 2> sizesPerType;
-	u32 sizesPerType_n = 0;
+	auto& chain = RU.descPools[e];
+	chain = {
+		.maxSets = info.maxSets,
+		.sizesPerType_n = 0,
+		.options = info.options,
+	};
 	auto addTypeSize = [&](VkDescriptorType type, u32 count) {
 		if (count) {
-			sizesPerType[sizesPerType_n] = { type, count };
-			sizesPerType_n++;
+			chain.sizesPerType[chain.sizesPerType_n] = { type, count };
+			chain.sizesPerType_n++;
 		}
 	};
 	addTypeSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, info.maxPerType.uniformBuffers);
+	addTypeSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, info.maxPerType.storageBuffers);
 	addTypeSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, info.maxPerType.combinedImageSamplers);
-	RU.descPools[e] = RU.device.createDescriptorPool(info.maxSets, { sizesPerType.data(), sizesPerType_n }, info.options);
+	descPool_addPool(chain);
 	return { e };
 }
 
+VkResult allocDescSets(DescPoolId poolId, VkDescriptorSetLayout layout, std::span<VkDescriptorSet> descSets)
+{
+	auto& chain = RU.descPools[poolId.id];
+	const u32 n = u32(descSets.size());
+	auto tryAlloc = [&](u32 poolI) {
+		const VkResult res = RU.device.allocDescriptorSets(chain.pools[poolI], layout, descSets);
+		if (res != VK_SUCCESS)
+			return res;
+		chain.pools_numSets[poolI] += n;
+		for (VkDescriptorSet descSet : descSets)
+			chain.descSet_to_pool[descSet] = poolI;
+		return res;
+	};
+
+	// the pools can run out of descriptors before running out of sets, so we just try the ones that have room for the sets
+	for (u32 poolI = u32(chain.pools.size()); poolI-- > 0; ) {
+		if (!chain.pools[poolI] || chain.pools_numSets[poolI] + n > chain.maxSets)
+			continue;
+		const VkResult res = tryAlloc(poolI);
+		if (res == VK_SUCCESS)
+			return res;
+		if (res != VK_ERROR_OUT_OF_POOL_MEMORY && res != VK_ERROR_FRAGMENTED_POOL)
+			return res;
+	}
+
+	// all the pools are full: add a new one
+	assert(n <= chain.maxSets);
+	return tryAlloc(descPool_addPool(chain));
+}
+
+// called when the sets are not in use by any frame in flight
+static void descPool_freeSets(u32 chainId, CSpan<VkDescriptorSet> descSets)
+{
+	auto& chain = RU.descPools[chainId];
+	if (chain.pools.size() == 1) {
+		RU.device.freeDescriptorSets(chain.pools[0], descSets);
+		for (VkDescriptorSet descSet : descSets) {
+			if (auto it = chain.descSet_to_pool.find(descSet); it != chain.descSet_to_pool.end()) {
+				chain.pools_numSets[0]--;
+				chain.descSet_to_pool.erase(it);
+			}
+		}
+		return;
+	}
+
+	for (VkDescriptorSet descSet : descSets) {
+		u32 poolI = 0;
+		if (auto it = chain.descSet_to_pool.find(descSet); it != chain.descSet_to_pool.end()) {
+			poolI = it->second;
+			chain.pools_numSets[poolI]--;
+			chain.descSet_to_pool.erase(it);
+		}
+		RU.device.freeDescriptorSet(chain.pools[poolI], descSet);
+	}
+
+	// reclaim the empty pools (but the first one). We keep one of them as a spare, to avoid creating and destroying pools constantly
+	bool keptSpare = false;
+	for (u32 poolI = u32(chain.pools.size()); poolI-- > 1; ) {
+		if (!chain.pools[poolI] || chain.pools_numSets[poolI])
+			continue;
+		if (!keptSpare) {
+			keptSpare = true;
+			continue;
+		}
+		RU.device.destroyDescriptorPool(chain.pools[poolI]);
+		chain.pools[poolI] = VK_NULL_HANDLE;
+	}
+}
+
 void releaseDescSets(DescPoolId descPool, CSpan<VkDescriptorSet> toRelease)
 {
 	auto& descSets = RU.toDestroy.descSets[descPool.id];
@@ -506,6 +1104,11 @@ void releaseDescSets(DescPoolId descPool, CSpan<VkDescriptorSet> toRelease)
 void releaseImguiDescSet(VkDescriptorSet descSet)
 {
 	releaseDescSet(RU.imgui.descPool, descSet);
+	if (auto it = RU.imgui.textures.find(descSet); it != RU.imgui.textures.end()) {
+		if (it->second.current != descSet)
+			releaseDescSet(RU.imgui.descPool, it->second.current);
+		RU.imgui.textures.erase(it);
+	}
 }
 
 // ---
@@ -540,33 +1143,25 @@ VkSampler getAnisotropicFilteringSampler(float maxAniso)
 // --- GEOMETRY ---
 static u32 acquireGeomEntry()
 {
-	if (RU.geoms_nextFreeEntry != u32(-1)) {
-		// the was a free entry
-		const u32 e = RU.geoms_nextFreeEntry;
-		RU.geoms_nextFreeEntry = RU.geoms_refCount[e];
-		return e;
-	}
-
-	// there wasn't a free entry; need to create one
-	const u32 e = RU.geoms_buffer.size();
-	RU.geoms_buffer.emplace_back();
-	RU.geoms_refCount.emplace_back();
-	RU.geoms_info.emplace_back();
-	return e;
+	return RU.geoms_slots.acquire(RU.geoms_buffer, RU.geoms_refCount, RU.geoms_info, RU.geoms_uploadTicket);
 }
 
 static void releaseGeomEntry(u32 e)
 {
-	const u32 e2 = RU.images_nextFreeEntry;
-	RU.geoms_refCount[e] = e2;
-	RU.geoms_nextFreeEntry = e;
-	
-	// TODO: do some safety check in debug mode for detecting double-free
+	RU.geoms_slots.release(e);
 }
 
 static void deferredDestroy_buffer(vk::Buffer id)
 {
-	deferredDestroy(RU.toDestroy.buffers, RU.toDestroy.buffersTmp, id);
+	// the buffer could be in use by a transfer batch in flight. Then it will go through the usual deferred destruction when the batches are finished
+	if (RU.transfer.enabled)
+		RU.transfer.buffersToDestroy.push_back(id);
+	else
+		deferredDestroy(RU.toDestroy.buffers, RU.toDestroy.buffersTmp, id);
+	// the queued uploads to this buffer don't make sense anymore
+	auto isUploadToBuffer = [id](const PendingUpload& upload) { return upload.dstBuffer.id == id.id; };
+	std::erase_if(RU.staging.pending, isUploadToBuffer);
+	std::erase_if(RU.transfer.stream.pending, isUploadToBuffer);
 }
 
 const GeomInfo& GeomId::getInfo()const
@@ -577,6 +1172,10 @@ vk::Buffer GeomId::getBuffer()const
 {
 	return RU.geoms_buffer[id];
 }
+bool GeomId::isReady()const
+{
+	return RU.geoms_uploadTicket[id] <= getResourcesStagingStream().readyTicket;
+}
 
 void incRefCount(GeomId id)
 {
@@ -602,6 +1201,7 @@ GeomRC geom_create()
 	RU.geoms_info[e] = GeomInfo{};
 	RU.geoms_buffer[e] = vk::Buffer{};
 	RU.geoms_refCount[e] = 0;
+	RU.geoms_uploadTicket[e] = 0;
 	return GeomRC(GeomId{ e });
 }
 
@@ -609,12 +1209,14 @@ void geom_resetFromBuffer(const GeomRC& h, const GeomInfo& info, vk::Buffer buff
 {
 	const u32 e = h.id.id;
 	if (RU.geoms_buffer[e].id) {
-		RU.device.destroyBuffer(RU.geoms_buffer[e]);
+		deferredDestroy_buffer(RU.geoms_buffer[e]); // it could still be in use by a frame in flight
 	}
 
 	RU.geoms_info[e] = info;
 	RU.geoms_buffer[e] = buffer;
 	RU.geoms_refCount[e] = 0;
+	RU.geoms_uploadTicket[e] = 0;
+	RU.drawPacketsEpoch++; // the packets of the meshes that use this geom have the old buffer, offsets and counts
 }
 
 void geom_resetFromInfo(const GeomRC& h, const CreateGeomInfo& info, AABB* aabb)
@@ -643,10 +1245,11 @@ void geom_resetFromInfo(const GeomRC& h, const CreateGeomInfo& info, AABB* aabb)
 	geomInfo.numInds = info.numInds;
 
 	auto usage = vk::BufferUsage::indexBuffer | vk::BufferUsage::vertexBuffer | vk::BufferUsage::transferDst;
-	auto buffer = RU.device.createBuffer(usage, offset, vk::BufferHostAccess{});
-	stageData(buffer, { datas.data(), numDatas });
+	auto buffer = RU.device.createBuffer(usage, offset, vk::BufferHostAccess{}, mem::Tag::renderUniverse);
+	const u64 uploadTicket = stageData(getResourcesStagingStream(), buffer, { datas.data(), numDatas });
 
 	geom_resetFromBuffer(h, geomInfo, buffer);
+	RU.geoms_uploadTicket[h.id.id] = uploadTicket;
 
 	if (aabb) {
 		CSpan<glm::vec3> positions((const glm::vec3*)info.positions.data(), info.numVerts);
@@ -776,6 +1379,24 @@ VkDescriptorSet MaterialId::getDescSet()const
 	return mgr.getDescriptorSet(mgr.managerPtr, *this);
 }
 
+u32 MaterialId::getMaterialIndex()const
+{
+	auto& mgr = RU.materialManagers[manager.id];
+	return mgr.getMaterialIndex ? mgr.getMaterialIndex(mgr.managerPtr, *this) : u32(-1);
+}
+
+bool MaterialId::isDoubleSided()const
+{
+	auto& mgr = RU.materialManagers[manager.id];
+	return mgr.isDoubleSided(mgr.managerPtr, *this);
+}
+
+bool MaterialId::isReady()const
+{
+	auto& mgr = RU.materialManagers[manager.id];
+	return !mgr.isReady || mgr.isReady(mgr.managerPtr, *this);
+}
+
 void incRefCount(MaterialId id)
 {
 	if (id.isValid()) {
@@ -787,11 +1408,10 @@ void incRefCount(MaterialId id)
 void decRefCount(MaterialId id)
 {
 	if (id.isValid()) {
-		const auto& materialManagerFns = RU.materialManagers[id.manager.id];
 		u32& rc = RU.materials_refCount[id.manager.id][id.id];
 		rc--;
-		if (rc == 0)
-			materialManagerFns.destroyMaterial(materialManagerFns.managerPtr, id);
+		if (rc == 0) // the material could be in use by a frame in flight
+			deferredDestroy(RU.toDestroy.materials, RU.toDestroy.materialsTmp, id);
 	}
 }
 
@@ -806,23 +1426,109 @@ u32 registerMaterialManager(const MaterialManager& mgr)
 
 // --- PBR MATERIAL ---
 
+static PbrMaterialManager& getPbrMaterialManager(MaterialManagerId id)
+{
+	return *(PbrMaterialManager*)RU.materialManagers[id.id].managerPtr;
+}
+
+glm::vec4 PbrMaterialId::getAlbedo()const { return getPbrMaterialManager(manager).materials_uniforms[id].albedo; }
+float PbrMaterialId::getMetallic()const { return getPbrMaterialManager(manager).materials_uniforms[id].metallic; }
+float PbrMaterialId::getRoughness()const { return getPbrMaterialManager(manager).materials_uniforms[id].roughness; }
+
+void PbrMaterialId::setAlbedo(const glm::vec4& albedo)
+{
+	auto& mgr = getPbrMaterialManager(manager);
+	mgr.materials_uniforms[id].albedo = albedo;
+	mgr.dirtyEntries.push_back(id);
+}
+void PbrMaterialId::setMetallic(float metallic)
+{
+	auto& mgr = getPbrMaterialManager(manager);
+	mgr.materials_uniforms[id].metallic = metallic;
+	mgr.dirtyEntries.push_back(id);
+}
+void PbrMaterialId::setRoughness(float roughness)
+{
+	auto& mgr = getPbrMaterialManager(manager);
+	mgr.materials_uniforms[id].roughness = roughness;
+	mgr.dirtyEntries.push_back(id);
+}
+
+// returns u32(-1) if there is no room left for the material
 static u32 acquireMaterialEntry(PbrMaterialManager& mgr)
 {
-	const u32 e = acquireReusableEntry(mgr.materials_nextFreeEntry,
-		mgr.materials_info, 0, mgr.materials_descSet, RU.materials_refCount[mgr.managerId.id]);
-	assert(e < mgr.maxExpectedMaterials);
+	const u32 e = mgr.materials_slots.acquire(mgr.materials_info, mgr.materials_descSet, mgr.materials_textureSlots, mgr.materials_uniforms, mgr.materials_uploaded, RU.materials_refCount[mgr.managerId.id]);
+	if (mgr.bindless && e >= mgr.maxExpectedMaterials) { // the storage buffer is bound in the descriptor set, so it can't grow
+		mgr.materials_slots.release(e);
+		printf("Error: the bindless material buffer is full (%u materials)\n", mgr.maxExpectedMaterials);
+		return u32(-1);
+	}
+	if (e / mgr.maxExpectedMaterials >= mgr.uniformBuffers.size()) { // need a new page
+		mgr.uniformBuffers.push_back(RU.device.createBuffer(vk::BufferUsage::uniformBuffer | vk::BufferUsage::transferDst,
+			mgr.maxExpectedMaterials * sizeof(PbrUniforms), {}, mem::Tag::renderUniverse));
+	}
 	return e;
 }
 
 void releaseMaterialEntry(PbrMaterialManager& mgr, u32 e)
 {
-	releaseReusableEntry(mgr.materials_nextFreeEntry, mgr.materials_info, 0, e);
+	mgr.materials_slots.release(e);
+}
+
+// returns u32(-1) if there are no slots left
+static u32 bindless_acquireTextureSlot()
+{
+	auto& BT = RU.bindlessTextures;
+	if (BT.freeSlots.size()) {
+		const u32 slot = BT.freeSlots.back();
+		BT.freeSlots.pop_back();
+		return slot;
+	}
+	if (BT.numSlots == BT.capacity) {
+		printf("Error: ran out of bindless texture slots (%u)\n", BT.capacity);
+		return u32(-1);
+	}
+	return BT.numSlots++;
+}
+
+static void bindless_releaseTextureSlot(u32 slot)
+{
+	// the slot could be in use by a frame in flight
+	deferredDestroy(RU.toDestroy.bindlessTextureSlots, RU.toDestroy.bindlessTextureSlotsTmp, slot);
 }
 
-VkDescriptorSetLayout PbrMaterialManager::getCreateDescriptorSetLayout(bool hasAlbedoTexture, bool hasNormalTexture, bool hasMetallicRoughnessTexture)
+// the layout of the data passed to vkUpdateDescriptorSetWithTemplate
+struct PbrDescSetTemplateData {
+	VkDescriptorBufferInfo uniforms;
+	VkDescriptorImageInfo textures[3]; // albedo, normal, metallicRoughness
+};
+
+VkDescriptorSetLayout PbrMaterialManager::getCreateDescriptorSetLayout()
 {
-	auto& dc = descSetLayouts[hasAlbedoTexture][hasNormalTexture][hasMetallicRoughnessTexture];
-	if (!dc) {
+	// all the materials share the same layout. The texture slots that are not used get "defaultTexture"
+	auto& dc = descSetLayout;
+	if (!dc && bindless) {
+		const vk::DescriptorSetLayoutBindingInfo bindings[] = {
+			{
+				.binding = 0,
+				.descriptorType = vk::DescriptorType::storageBuffer,
+				.accessStages = vk::ShaderStages::fragment,
+			},
+			{
+				.binding = 1,
+				.descriptorType = vk::DescriptorType::combinedImageSampler,
+				.descriptorCount = RU.bindlessTextures.capacity,
+				.accessStages = vk::ShaderStages::fragment,
+			},
+		};
+		// we write the slots of new textures while the descriptor set is in use by frames in flight (that don't access those slots)
+		const vk::DescriptorBindingFlags bindingFlags[] = {
+			vk::DescriptorBindingFlags::none,
+			vk::DescriptorBindingFlags::partiallyBound | vk::DescriptorBindingFlags::updateAfterBind | vk::DescriptorBindingFlags::updateUnusedWhilePending,
+		};
+		dc = RU.device.createDescriptorSetLayout(bindings, vk::DescriptorSetLayoutCreateFlags::updateAfterBindPool, bindingFlags);
+	}
+	else if (!dc) {
 		const vk::DescriptorSetLayoutBindingInfo bindings[] = {
 			{
 				.binding = 0,
@@ -846,19 +1552,33 @@ VkDescriptorSetLayout PbrMaterialManager::getCreateDescriptorSetLayout(bool hasA
 			},
 		};
 		dc = RU.device.createDescriptorSetLayout(bindings);
+
+		const vk::DescriptorUpdateTemplateEntry templateEntries[] = {
+			{ .binding = 0, .type = vk::DescriptorType::uniformBuffer, .offset = offsetof(PbrDescSetTemplateData, uniforms) },
+			{ .binding = 1, .type = vk::DescriptorType::combinedImageSampler, .offset = offsetof(PbrDescSetTemplateData, textures[0]) },
+			{ .binding = 2, .type = vk::DescriptorType::combinedImageSampler, .offset = offsetof(PbrDescSetTemplateData, textures[1]) },
+			{ .binding = 3, .type = vk::DescriptorType::combinedImageSampler, .offset = offsetof(PbrDescSetTemplateData, textures[2]) },
+		};
+		descSetUpdateTemplate = RU.device.createDescriptorUpdateTemplate(dc, templateEntries);
 	}
 	return dc;
 }
 
-VkPipelineLayout PbrMaterialManager::getCreatePipelineLayout(bool hasAlbedoTexture, bool hasNormalTexture, bool hasMetallicRoughnessTexture)
+VkPipelineLayout PbrMaterialManager::getCreatePipelineLayout()
 {
-	auto& l = pipelineLayouts[hasAlbedoTexture][hasNormalTexture][hasMetallicRoughnessTexture];
+	auto& l = pipelineLayout;
 	if (!l) {
 		const VkDescriptorSetLayout descSetLayouts[] = {
 			RU.globalDescSetLayout,
-			getCreateDescriptorSetLayout(hasAlbedoTexture, hasNormalTexture, hasMetallicRoughnessTexture),
+			getCreateDescriptorSetLayout(),
+		};
+		// bindless mode: the index of the material is passed as a push constant
+		const VkPushConstantRange pushConstantRange = {
+			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+			.offset = 0,
+			.size = sizeof(u32),
 		};
-		l = RU.device.createPipelineLayout(descSetLayouts, {});
+		l = RU.device.createPipelineLayout(descSetLayouts, bindless ? CSpan<VkPushConstantRange>(&pushConstantRange, 1) : CSpan<VkPushConstantRange>{});
 	}
 	return l;
 }
@@ -866,38 +1586,49 @@ VkPipelineLayout PbrMaterialManager::getCreatePipelineLayout(bool hasAlbedoTextu
 VkPipeline PbrMaterialManager::getCreatePipeline(bool hasAlbedoTexture, bool hasNormalTexture, bool hasMetallicRoughnessTexture,
 	HasVertexNormalsOrTangents hasVertexNormalsOrTangents, bool hasTexCoords, bool hasVertexColors, bool doubleSided)
 {
+	const bool dynamicCullMode = RU.device.enabledFeatures.dynamicCullMode;
+	if (dynamicCullMode)
+		doubleSided = false;
 	VkPipeline& p = pipelines[hasAlbedoTexture][hasNormalTexture][hasMetallicRoughnessTexture]
 		[int(hasVertexNormalsOrTangents)][hasTexCoords][hasVertexColors][doubleSided];
 	if (!p) {
-		const tk::PreprocDefine defines[] = {
-			{"MAX_DIR_LIGHTS", MAX_DIR_LIGHTS_STR.c_str()},
-			{"HAS_ALBEDO_TEX", hasTexCoords && hasAlbedoTexture ? "1" : "0"},
-			{"HAS_NORMAL_TEX", hasTexCoords && hasNormalTexture ? "1" : "0"},
-			{"HAS_METALLIC_ROUGHNESS_TEX", hasTexCoords && hasMetallicRoughnessTexture ? "1" : "0"},
-			{"HAS_NORMAL", hasVertexNormalsOrTangents == HasVertexNormalsOrTangents::no ? "0" : "1"},
-			{"HAS_TANGENT", hasVertexNormalsOrTangents == HasVertexNormalsOrTangents::normalsAndTangents ? "1" : "0"},
-			{"HAS_TEXCOORD_0", hasTexCoords ? "1" : "0"},
-			{"HAS_VERTCOLOR_0", hasVertexColors ? "1" : "0"},
-		};
+		auto& vertShad = vertShaders[int(hasVertexNormalsOrTangents)][hasTexCoords][hasVertexColors];
+		auto& fragShad = fragShaders[int(hasVertexNormalsOrTangents)][hasTexCoords][hasVertexColors];
+		if (!vertShad.handle) {
+			const tk::PreprocDefine defines[] = {
+				{"MAX_DIR_LIGHTS", MAX_DIR_LIGHTS_STR.c_str()},
+				{"HAS_NORMAL", hasVertexNormalsOrTangents == HasVertexNormalsOrTangents::no ? "0" : "1"},
+				{"HAS_TANGENT", hasVertexNormalsOrTangents == HasVertexNormalsOrTangents::normalsAndTangents ? "1" : "0"},
+				{"HAS_TEXCOORD_0", hasTexCoords ? "1" : "0"},
+				{"HAS_VERTCOLOR_0", hasVertexColors ? "1" : "0"},
+				{"BINDLESS", bindless ? "1" : "0"},
+			};
 
-		ZStrView vertShadPath = "shaders/pbr.vert.glsl";
-		ZStrView fragShadPath = "shaders/pbr.frag.glsl";
+			ZStrView vertShadPath = "shaders/pbr.vert.glsl";
+			ZStrView fragShadPath = "shaders/pbr.frag.glsl";
 
-		const auto vertShad_compileResult = RU.shaderCompiler.glslToSpv(vertShadPath, defines);
-		if (!vertShad_compileResult.ok()) {
-			printf("Error compiling VERTEX shader (%s):\n%s\n", vertShadPath.c_str(), vertShad_compileResult.getErrorMsgs().c_str());
-			assert(false);
-			exit(1);
-		}
-		auto vertShad = RU.device.createVertShader(vertShad_compileResult.getSpirvSrc());
+			const auto vertShad_compileResult = RU.shaderCompiler.glslToSpv(vertShadPath, defines);
+			if (!vertShad_compileResult.ok()) {
+				printf("Error compiling VERTEX shader (%s):\n%s\n", vertShadPath.c_str(), vertShad_compileResult.getErrorMsgs().c_str());
+				assert(false);
+				exit(1);
+			}
+			vertShad = RU.device.createVertShader(vertShad_compileResult.getSpirvSrc());
 
-		const auto fragShad_compileResult = RU.shaderCompiler.glslToSpv(fragShadPath, defines);
-		if (!fragShad_compileResult.ok()) {
-			printf("Error compiling FRAGMENT shader (%s):\n%s", fragShadPath.c_str(), fragShad_compileResult.getErrorMsgs().c_str());
-			assert(false);
-			exit(1);
+			const auto fragShad_compileResult = RU.shaderCompiler.glslToSpv(fragShadPath, defines);
+			if (!fragShad_compileResult.ok()) {
+				printf("Error compiling FRAGMENT shader (%s):\n%s", fragShadPath.c_str(), fragShad_compileResult.getErrorMsgs().c_str());
+				assert(false);
+				exit(1);
+			}
+			fragShad = RU.device.createFragShader(fragShad_compileResult.getSpirvSrc());
 		}
-		auto fragShad = RU.device.createFragShader(fragShad_compileResult.getSpirvSrc());
+
+		// the constant_id values must match the ones declared in pbr_uniforms.glsl
+		vk::SpecializationInfoMaker specializationMaker;
+		specializationMaker.add(0, VkBool32(hasTexCoords && hasAlbedoTexture)); // HAS_ALBEDO_TEX
+		specializationMaker.add(1, VkBool32(hasTexCoords && hasNormalTexture)); // HAS_NORMAL_TEX
+		specializationMaker.add(2, VkBool32(hasTexCoords && hasMetallicRoughnessTexture)); // HAS_METALLIC_ROUGHNESS_TEX
 
 		u32 numBindings = 1;
 		std::array<vk::VertexInputBindingInfo, 6> bindings;
@@ -1016,7 +1747,7 @@ VkPipeline PbrMaterialManager::getCreatePipeline(bool hasAlbedoTexture, bool has
 		const vk::GraphicsPipelineInfo info = {
 			.shaderStages = {
 				.vertex = {.shader = vertShad},
-				.fragment = {.shader = fragShad},
+				.fragment = {.shader = fragShad, .specialization = specializationMaker.getInfo()},
 			},
 			.vertexInputBindings = {&bindings[0], numBindings},
 			.vertexInputAttribs = {&attribs[0], numAttribs},
@@ -1024,7 +1755,8 @@ VkPipeline PbrMaterialManager::getCreatePipeline(bool hasAlbedoTexture, bool has
 			.depthTestEnable = true,
 			.depthWriteEnable = true,
 			.colorBlendAttachments = colorBlendAttachments,
-			.layout = getCreatePipelineLayout(hasAlbedoTexture, hasNormalTexture, hasMetallicRoughnessTexture),
+			.dynamicStates = {.viewport = true, .scissor = true, .cullMode = dynamicCullMode},
+			.layout = getCreatePipelineLayout(),
 			.renderPass = RU.renderPass,
 		};
 		vk::ASSERT_VKRES(RU.device.createGraphicsPipelines({ &p, 1 }, { &info, 1 }, nullptr));
@@ -1032,74 +1764,250 @@ VkPipeline PbrMaterialManager::getCreatePipeline(bool hasAlbedoTexture, bool has
 	return p;
 }
 
-PbrMaterialRC PbrMaterialManager::createMaterial(const PbrMaterialInfo& params)
+std::pair<vk::Buffer, size_t> PbrMaterialManager::_getUniformsLocation(u32 entry)
 {
-	const bool hasAlbedoTexture = params.albedoImageView.id.isValid();
-	const bool hasNormalTexture = params.normalImageView.id.isValid();
-	const bool hasMetallicRoughnessTexture = params.metallicRoughnessImageView.id.isValid();
-	const auto descSetLayout = getCreateDescriptorSetLayout(hasAlbedoTexture, hasNormalTexture, hasMetallicRoughnessTexture);
-	VkDescriptorSet descSet;
-	vk::ASSERT_VKRES(RU.device.allocDescriptorSets(descPool.getHandleVk(), descSetLayout, {&descSet, 1}));
-	const u32 entry = acquireMaterialEntry(*this);
-	materials_info[entry] = params;
-	materials_descSet[entry] = descSet;
-
-	const size_t bufferOffset = sizeof(PbrUniforms) * entry;
-	const PbrUniforms values = {
-		.albedo = params.albedo,
-		.metallic = params.metallic,
-		.roughness = params.roughness
-	};
-	stageData(uniformBuffer, tk::asBytesSpan(values), bufferOffset);
-
-	vk::DescriptorSetWrite descSetWrites[4] = {
-		{	.descSet = descSet,
-			.binding = 0,
-			.type = vk::DescriptorType::uniformBuffer,
-			.bufferInfo = {
-				.buffer = RU.device.getVkHandle(uniformBuffer),
-				.offset = bufferOffset,
-				.range = sizeof(PbrUniforms),
-			}
+	return { uniformBuffers[entry / maxExpectedMaterials], sizeof(PbrUniforms) * (entry % maxExpectedMaterials) };
+}
+
+void PbrMaterialManager::_writeDescSet(u32 entry)
+{
+	const auto& params = materials_info[entry];
+	const auto [uniformBuffer, bufferOffset] = _getUniformsLocation(entry);
+	PbrDescSetTemplateData data = {
+		.uniforms = {
+			.buffer = RU.device.getVkHandle(uniformBuffer),
+			.offset = bufferOffset,
+			.range = sizeof(PbrUniforms),
+		},
+	};
+	const VkSampler sampler = getAnisotropicFilteringSampler(params.anisotropicFiltering);
+	const ImageViewRC* imgViews[3] = { &params.albedoImageView, &params.normalImageView, &params.metallicRoughnessImageView };
+	for (int i = 0; i < 3; i++) {
+		// unused slots are not sampled (the shader is specialized), but they still need a valid descriptor
+		const ImageViewId imgView = imgViews[i]->id.isValid() ? imgViews[i]->id : defaultTexture.id;
+		data.textures[i] = {
+			.sampler = sampler,
+			.imageView = RU.device.getVkHandle(imgView.getHandle()),
+			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		};
+	}
+	RU.device.updateDescriptorSetWithTemplate(materials_descSet[entry], descSetUpdateTemplate, &data);
+}
+
+PbrMaterialRC PbrMaterialManager::createMaterial(const PbrMaterialInfo& params)
+{
+	return std::move(createMaterials({ &params, 1 })[0]);
+}
+
+std::vector<PbrMaterialRC> PbrMaterialManager::createMaterials(CSpan<PbrMaterialInfo> infos)
+{
+	TK_PROFILE_SCOPE;
+	const u32 n = u32(infos.size());
+	std::vector<u32> entries(n);
+	for (u32 i = 0; i < n; i++) {
+		const u32 e = acquireMaterialEntry(*this);
+		if (e == u32(-1)) { // the rest of materials are returned as null
+			entries.resize(i);
+			break;
+		}
+		entries[i] = e;
+		materials_info[e] = infos[i];
+		materials_uniforms[e] = {
+			.albedo = infos[i].albedo,
+			.metallic = infos[i].metallic,
+			.roughness = infos[i].roughness,
+		};
+		materials_uploaded[e] = false;
+	}
+
+	if (bindless) {
+		std::vector<vk::DescriptorSetWrite> descSetWrites;
+		descSetWrites.reserve(3 * n);
+		std::vector<u32> failed;
+		for (u32& e : entries) {
+			materials_descSet[e] = VK_NULL_HANDLE;
+			materials_textureSlots[e] = { u32(-1), u32(-1), u32(-1) };
+			if (!_bindless_acquireTextures(e, descSetWrites)) {
+				failed.push_back(e);
+				e = u32(-1);
+			}
+		}
+		if (descSetWrites.size())
+			RU.device.writeDescriptorSets(descSetWrites);
+		// it would be drawn with the default textures instead of its own, so it's returned as null
+		for (u32 e : failed) {
+			printf("Error: couldn't create the material, there are no bindless texture slots left\n");
+			destroyMaterial(MaterialId(managerId, e));
+		}
+	}
+	else {
+		// allocate all the descriptor sets at once (in chunks that fit in a pool of the chain)
+		const auto descSetLayout = getCreateDescriptorSetLayout();
+		std::vector<VkDescriptorSet> descSets(n);
+		for (u32 i = 0; i < n; i += maxExpectedMaterials)
+			vk::ASSERT_VKRES(allocDescSets(descPool, descSetLayout, { &descSets[i], glm::min(maxExpectedMaterials, n - i) }));
+		for (u32 i = 0; i < n; i++) {
+			materials_descSet[entries[i]] = descSets[i];
+			_writeDescSet(entries[i]);
+		}
+	}
+
+	std::vector<PbrMaterialRC> materials;
+	materials.reserve(n);
+	for (u32 e : entries) {
+		if (e == u32(-1)) {
+			materials.emplace_back();
+			continue;
+		}
+		dirtyEntries.push_back(e); // the uniforms are uploaded with the rest of changes of this frame (consecutive entries end up in the same copy)
+		materials.emplace_back(managerId, e);
+	}
+	materials.resize(n); // null materials for the ones that didn't fit
+	return materials;
+}
+
+void PbrMaterialManager::uploadChanges()
+{
+	if (dirtyEntries.empty())
+		return;
+	TK_PROFILE_SCOPE;
+	std::sort(dirtyEntries.begin(), dirtyEntries.end());
+	dirtyEntries.erase(std::unique(dirtyEntries.begin(), dirtyEntries.end()), dirtyEntries.end());
+
+	// coalesce the dirty entries in ranges. Small gaps are uploaded too, it's cheaper than splitting the copy.
+	// The copies go through staging, instead of writing mapped memory directly, because the frames in flight could still be reading the old values. The staging pass waits for them.
+	// They don't wait behind the queue of pending uploads (big images or geoms can take several frames), so the changes are visible in this frame
+	constexpr u32 maxGap = 16;
+	std::vector<u32> notUploaded; // the staging ring is full. They are retried in the next frame
+	auto uploadRange = [&](size_t firstI, size_t lastI) {
+		const u32 first = dirtyEntries[firstI];
+		const u32 last = dirtyEntries[lastI];
+		const auto [uniformBuffer, bufferOffset] = _getUniformsLocation(first);
+		const CSpan<PbrUniforms> data(&materials_uniforms[first], last - first + 1);
+		if (stageDataNow(RU.staging, uniformBuffer, tk::asBytesSpan(data), bufferOffset)) {
+			for (size_t i = firstI; i <= lastI; i++)
+				materials_uploaded[dirtyEntries[i]] = true;
+		}
+		else {
+			notUploaded.insert(notUploaded.end(), dirtyEntries.begin() + firstI, dirtyEntries.begin() + lastI + 1);
 		}
 	};
-	u32 numWrites = 1;
-	auto addWriteImgIfNeeded = [&](const ImageViewRC& img, u32 binding) {
-		if (img.id.isValid()) {
-			descSetWrites[numWrites] = {
-				.descSet = descSet,
-				.binding = numWrites,
-				.type = vk::DescriptorType::combinedImageSampler,
-				.imageInfo = {
-					.sampler = getAnisotropicFilteringSampler(params.anisotropicFiltering),
-					.imageView = RU.device.getVkHandle(img.id.getHandle()),
-					.imageLayout = vk::ImageLayout::shaderReadOnly,
-				}
-			};
-			numWrites++;
+	RU.staging.overwritesBuffersInUse = true;
+	size_t firstI = 0;
+	for (size_t i = 1; i < dirtyEntries.size(); i++) {
+		const u32 e = dirtyEntries[i];
+		if (e - dirtyEntries[i - 1] > maxGap || e / maxExpectedMaterials != dirtyEntries[firstI] / maxExpectedMaterials) {
+			uploadRange(firstI, i - 1);
+			firstI = i;
+		}
+	}
+	uploadRange(firstI, dirtyEntries.size() - 1);
+	dirtyEntries = std::move(notUploaded);
+}
+
+bool PbrMaterialManager::_bindless_acquireTextures(u32 entry, std::vector<vk::DescriptorSetWrite>& descSetWrites)
+{
+	const auto& params = materials_info[entry];
+	auto& slots = materials_textureSlots[entry];
+	const VkSampler sampler = getAnisotropicFilteringSampler(params.anisotropicFiltering);
+	const ImageViewRC* imgViews[3] = { &params.albedoImageView, &params.normalImageView, &params.metallicRoughnessImageView };
+	bool ok = true;
+	for (int i = 0; i < 3; i++) {
+		// the old slots could still be in use by a frame in flight, so we never overwrite them
+		if (slots[i] != u32(-1))
+			bindless_releaseTextureSlot(slots[i]);
+		slots[i] = imgViews[i]->id.isValid() ? bindless_acquireTextureSlot() : u32(-1);
+		if (slots[i] == u32(-1)) {
+			ok &= !imgViews[i]->id.isValid();
+			continue;
 		}
+		descSetWrites.push_back({
+			.descSet = bindlessDescSet,
+			.binding = 1,
+			.arrayElement = slots[i],
+			.type = vk::DescriptorType::combinedImageSampler,
+			.imageInfo = {
+				.sampler = sampler,
+				.imageView = RU.device.getVkHandle(imgViews[i]->id.getHandle()),
+				.imageLayout = vk::ImageLayout::shaderReadOnly,
+			}
+		});
+	}
+
+	auto slotOrDefault = [&](int i, u32 defaultSlot) { return slots[i] != u32(-1) ? slots[i] : defaultTextureSlots[defaultSlot]; };
+	auto& uniforms = materials_uniforms[entry];
+	uniforms.albedoTexture = slotOrDefault(0, 0);
+	uniforms.normalTexture = slotOrDefault(1, 1);
+	uniforms.metallicRoughnessTexture = slotOrDefault(2, 0);
+	if (ok) // otherwise, the material is not ready, so it's not drawn
+		dirtyEntries.push_back(entry);
+	return ok;
+}
+
+void PbrMaterialManager::onImageViewsReplaced(CSpan<ImageViewId> imgViews)
+{
+	auto isReplaced = [imgViews](const ImageViewRC& imgView) {
+		return std::find(imgViews.begin(), imgViews.end(), imgView.id) != imgViews.end();
 	};
-	addWriteImgIfNeeded(params.albedoImageView, 1);
-	addWriteImgIfNeeded(params.normalImageView, 2);
-	addWriteImgIfNeeded(params.metallicRoughnessImageView, 3);
+	std::vector<vk::DescriptorSetWrite> descSetWrites;
+	for (u32 e = 0; e < u32(materials_info.size()); e++) {
+		const auto& info = materials_info[e]; // (the info of free entries is reset, so they never match)
+		if (!isReplaced(info.albedoImageView) && !isReplaced(info.normalImageView) && !isReplaced(info.metallicRoughnessImageView))
+			continue;
 
-	RU.device.writeDescriptorSets({ descSetWrites, numWrites });
-	return PbrMaterialRC(managerId, entry);
+		if (bindless) {
+			if (!_bindless_acquireTextures(e, descSetWrites))
+				printf("Error: material %u won't be drawn, there are no bindless texture slots left for its new textures\n", e);
+			continue;
+		}
+		// the descriptor set could be in use by a frame in flight, so we can't update it. We create a new one instead
+		releaseDescSet(descPool, materials_descSet[e]);
+		vk::ASSERT_VKRES(allocDescSets(descPool, descSetLayout, {&materials_descSet[e], 1}));
+		_writeDescSet(e);
+	}
+	if (descSetWrites.size())
+		RU.device.writeDescriptorSets(descSetWrites);
 }
 
 void PbrMaterialManager::destroyMaterial(MaterialId id)
 {
 	materials_info[id.id] = {};
-	releaseDescSet(descPool, materials_descSet[id.id]);
+	if (bindless) {
+		for (u32& slot : materials_textureSlots[id.id]) {
+			if (slot != u32(-1))
+				bindless_releaseTextureSlot(slot);
+			slot = u32(-1);
+		}
+	}
+	else {
+		releaseDescSet(descPool, materials_descSet[id.id]);
+	}
 	releaseMaterialEntry(*this, id.id);
 }
 
+bool PbrMaterialManager::isReady(MaterialId materialId)
+{
+	if (!materials_uploaded[materialId.id]) // the shader would read zeros, or the parameters of the previous material in the slot
+		return false;
+	const auto& materialInfo = materials_info[materialId.id];
+	const ImageViewRC* imgViews[3] = { &materialInfo.albedoImageView, &materialInfo.normalImageView, &materialInfo.metallicRoughnessImageView };
+	for (int i = 0; i < 3; i++) {
+		if (bindless && imgViews[i]->id.isValid() && materials_textureSlots[materialId.id][i] == u32(-1)) // ran out of slots: it would be drawn with the default texture
+			return false;
+		const ImageViewId imgViewId = imgViews[i]->id.isValid() ? imgViews[i]->id : defaultTexture.id;
+		if (!RU.imageViews_image[imgViewId.id].id.isReady())
+			return false;
+	}
+	return true;
+}
+
 VkPipeline PbrMaterialManager::getPipeline(MaterialId materialId, GeomId geomId)
 {
 	const auto& materialInfo = materials_info[materialId.id];
-	const bool hasAlbedoTexture = materialInfo.albedoImageView.id.isValid();
-	const bool hasNormalTexture = materialInfo.normalImageView.id.isValid();
-	const bool hasMetallicRoughnessTexture = materialInfo.metallicRoughnessImageView.id.isValid();
+	// in bindless mode the missing textures are replaced by neutral defaults, so we don't need to specialize on them
+	const bool hasAlbedoTexture = bindless || materialInfo.albedoImageView.id.isValid();
+	const bool hasNormalTexture = bindless || materialInfo.normalImageView.id.isValid();
+	const bool hasMetallicRoughnessTexture = bindless || materialInfo.metallicRoughnessImageView.id.isValid();
 
 	const auto& geomInfo = geomId.getInfo();
 	const HasVertexNormalsOrTangents hasVertexNormalsOrTangents =
@@ -1112,15 +2020,6 @@ VkPipeline PbrMaterialManager::getPipeline(MaterialId materialId, GeomId geomId)
 		hasVertexNormalsOrTangents, hasTexCoords, hasVertexColors, materialInfo.doubleSided);
 }
 
-VkPipelineLayout PbrMaterialManager::getPipelineLayout(MaterialId materialId)
-{
-	const auto& materialInfo = materials_info[materialId.id];
-	const bool hasAlbedoTexture = materialInfo.albedoImageView.id.isValid();
-	const bool hasNormalTexture = materialInfo.normalImageView.id.isValid();
-	const bool hasMetallicRoughnessTexture = materialInfo.metallicRoughnessImageView.id.isValid();
-	return pipelineLayouts[hasAlbedoTexture][hasNormalTexture][hasMetallicRoughnessTexture];
-}
-
 PbrMaterialManager* PbrMaterialManager::s_getOrCreate(u32 maxExpectedMaterials)
 {
 	static PbrMaterialManager* mgr = nullptr;
@@ -1129,12 +2028,65 @@ PbrMaterialManager* PbrMaterialManager::s_getOrCreate(u32 maxExpectedMaterials)
 
 	assert(maxExpectedMaterials > 0);
 	mgr = new PbrMaterialManager;
+	mgr->bindless = RU.bindlessTextures.capacity > 0;
+	if (mgr->bindless) // the cap is only the size of the storage buffer, so we can afford a big one
+		maxExpectedMaterials = glm::max(maxExpectedMaterials, BINDLESS_MAX_MATERIALS);
 	mgr->maxExpectedMaterials = maxExpectedMaterials;
 	mgr->materials_info.reserve(maxExpectedMaterials);
 	mgr->materials_descSet.reserve(maxExpectedMaterials);
-	mgr->uniformBuffer = RU.device.createBuffer(vk::BufferUsage::uniformBuffer | vk::BufferUsage::transferDst, maxExpectedMaterials * sizeof(PbrUniforms), {});
+	if (mgr->bindless) {
+		mgr->uniformBuffers.push_back(RU.device.createBuffer(vk::BufferUsage::storageBuffer | vk::BufferUsage::transferDst,
+			maxExpectedMaterials * sizeof(PbrUniforms), {}, mem::Tag::renderUniverse));
+	}
+	mgr->getCreatePipelineLayout();
 
-	mgr->descPool = makeDescPool({
+	const u8 whitePixel[4] = { 255, 255, 255, 255 };
+	mgr->defaultTexture = makeImageView({ .image = makeImage({.format = vk::Format::RGBA8_UNORM, .w = 1, .h = 1}, whitePixel) });
+
+	if (mgr->bindless) {
+		const u8 flatNormalPixel[4] = { 128, 128, 255, 255 };
+		mgr->defaultNormalTexture = makeImageView({ .image = makeImage({.format = vk::Format::RGBA8_UNORM, .w = 1, .h = 1}, flatNormalPixel) });
+
+		mgr->descPool = makeDescPool({
+			.maxSets = 1,
+			.maxPerType = {
+				.storageBuffers = 1,
+				.combinedImageSamplers = RU.bindlessTextures.capacity,
+			},
+			.options = {.allowUpdateAfterBind = true}
+		});
+		vk::ASSERT_VKRES(allocDescSets(mgr->descPool, mgr->getCreateDescriptorSetLayout(), { &mgr->bindlessDescSet, 1 }));
+
+		const ImageViewId defaultImgViews[2] = { mgr->defaultTexture.id, mgr->defaultNormalTexture.id };
+		vk::DescriptorSetWrite descSetWrites[3] = {
+			{	.descSet = mgr->bindlessDescSet,
+				.binding = 0,
+				.type = vk::DescriptorType::storageBuffer,
+				.bufferInfo = {
+					.buffer = RU.device.getVkHandle(mgr->uniformBuffers[0]),
+					.offset = 0,
+					.range = maxExpectedMaterials * sizeof(PbrUniforms),
+				}
+			}
+		};
+		for (int i = 0; i < 2; i++) {
+			mgr->defaultTextureSlots[i] = bindless_acquireTextureSlot();
+			assert(mgr->defaultTextureSlots[i] != u32(-1));
+			descSetWrites[1 + i] = {
+				.descSet = mgr->bindlessDescSet,
+				.binding = 1,
+				.arrayElement = mgr->defaultTextureSlots[i],
+				.type = vk::DescriptorType::combinedImageSampler,
+				.imageInfo = {
+					.sampler = getAnisotropicFilteringSampler(1.f),
+					.imageView = RU.device.getVkHandle(defaultImgViews[i].getHandle()),
+					.imageLayout = vk::ImageLayout::shaderReadOnly,
+				}
+			};
+		}
+		RU.device.writeDescriptorSets(descSetWrites);
+	}
+	else mgr->descPool = makeDescPool({
 		.maxSets = maxExpectedMaterials,
 		.maxPerType = {
 			.uniformBuffers = maxExpectedMaterials,
@@ -1143,7 +2095,7 @@ PbrMaterialManager* PbrMaterialManager::s_getOrCreate(u32 maxExpectedMaterials)
 		.options = {.allowFreeIndividualSets = true}
 	});
 
-	registerMaterialManager({
+	MaterialManager callbacks = {
 		.managerPtr = mgr,
 		.setManagerId = [](void* self, u32 id) {
 			((PbrMaterialManager*)self)->managerId = { id };
@@ -1160,7 +2112,25 @@ PbrMaterialManager* PbrMaterialManager::s_getOrCreate(u32 maxExpectedMaterials)
 		.getDescriptorSet = [](void* self, MaterialId materialId) {
 			return ((PbrMaterialManager*)self)->getDescriptorSet(materialId);
 		},
-	});
+		.isDoubleSided = [](void* self, MaterialId materialId) {
+			return ((PbrMaterialManager*)self)->isDoubleSided(materialId);
+		},
+		.isReady = [](void* self, MaterialId materialId) {
+			return ((PbrMaterialManager*)self)->isReady(materialId);
+		},
+		.onImageViewsReplaced = [](void* self, CSpan<ImageViewId> imgViews) {
+			((PbrMaterialManager*)self)->onImageViewsReplaced(imgViews);
+		},
+		.uploadChanges = [](void* self) {
+			((PbrMaterialManager*)self)->uploadChanges();
+		},
+		.getMaterialIndex = [](void* self, MaterialId materialId) {
+			return ((PbrMaterialManager*)self)->getMaterialIndex(materialId);
+		},
+	};
+	if (!mgr->bindless)
+		callbacks.getMaterialIndex = nullptr;
+	registerMaterialManager(callbacks);
 
 	return mgr;
 }
@@ -1169,19 +2139,37 @@ PbrMaterialManager* PbrMaterialManager::s_getOrCreate(u32 maxExpectedMaterials)
 
 static u32 acquireMeshEntry()
 {
-	const u32 e = acquireReusableEntry(RU.meshes_nextFreeEntry, RU.meshes_refCount, 0, RU.meshes_info);
+	const u32 e = RU.meshes_slots.acquire(RU.meshes_refCount, RU.meshes_info);
 	return e;
 }
 
 static void releaseMeshEntry(u32 e)
 {
-	releaseReusableEntry(RU.meshes_nextFreeEntry, RU.meshes_refCount, 0, e);
+	RU.meshes_slots.release(e);
 }
 
-const MeshInfo MeshId::getInfo()const
+const MeshInfo& MeshId::getInfo()const
 {
 	return RU.meshes_info[id];
 }
+MeshInfoView MeshId::getInfoView()const
+{
+	const auto& info = RU.meshes_info[id];
+	MeshInfoView view;
+	view._geom = info.geom.id;
+	view._material = info.material.id;
+#ifndef NDEBUG
+	view._mesh = id;
+	view._generation = RU.meshes_slots.getGeneration(id);
+#endif
+	return view;
+}
+#ifndef NDEBUG
+void MeshInfoView::_check()const
+{
+	assert(RU.meshes_slots.isValid(_mesh, _generation) && "the mesh was released while the view was in use");
+}
+#endif
 VkPipeline MeshId::getPipeline()const
 {
 	const auto& info = RU.meshes_info[id];
@@ -1221,6 +2209,28 @@ ObjectInfo ObjectId::getInfo()const
 	const u32 e = RW.objects_id_to_entry[id];
 	return RW.objects_info[e];
 }
+ObjectInfoView ObjectId::getInfoView()const
+{
+	auto& RW = RU.renderWorlds[_renderWorld.id];
+	const u32 e = RW.objects_id_to_entry[id];
+	const auto& info = RW.objects_info[e];
+	ObjectInfoView view;
+	view._mesh = info.mesh.id;
+	view._numInstances = info.numInstances;
+	view._maxInstances = info.maxInstances;
+#ifndef NDEBUG
+	view._object = *this;
+	view._counter = RW.objects_counter[id];
+#endif
+	return view;
+}
+#ifndef NDEBUG
+void ObjectInfoView::_check()const
+{
+	const auto& RW = RU.renderWorlds[_object._renderWorld.id];
+	assert(_counter == RW.objects_counter[_object.id] && "the object was destroyed while the view was in use");
+}
+#endif
 
 void ObjectId::setModelMatrix(const glm::mat4& m, u32 instanceInd)
 {
@@ -1274,11 +2284,250 @@ void ObjectId::destroyInstance(u32 instanceInd)
 	info.numInstances--;
 }
 
+// --- GPU TIMINGS ---
+static u32 gpuTimings_stagingQuery(u32 stagingCmdBufferInd)
+{
+	return MAX_SWAPCHAIN_IMAGES * GPU_TIMINGS_MAX_QUERIES + 2 * stagingCmdBufferInd;
+}
+
+// opens a scope of the current frame. Returns the index of the scope, or u32(-1) if it's not recorded
+static u32 gpuTimings_begin(vk::CmdBuffer& cmdBuffer, const char* name, u32 id = u32(-1))
+{
+	auto& G = RU.gpuTimings;
+	const u32 scImgInd = RU.swapchain.imgInd;
+	u32& numQueries = G.numQueries[scImgInd];
+	if (!G.enabled || numQueries + 2 > GPU_TIMINGS_MAX_QUERIES)
+		return u32(-1);
+
+	const u32 query = scImgInd * GPU_TIMINGS_MAX_QUERIES + numQueries;
+	numQueries += 2;
+	cmdBuffer.cmd_writeTimestamp(vk::PipelineStages::topOfPipe, G.queryPool, query);
+	auto& scopes = G.scopes[scImgInd];
+	scopes.push_back({ name, id, G.depth, query, query + 1 });
+	G.depth++;
+	return u32(scopes.size() - 1);
+}
+
+static void gpuTimings_end(vk::CmdBuffer& cmdBuffer, u32 scope)
+{
+	auto& G = RU.gpuTimings;
+	if (scope == u32(-1))
+		return;
+	G.depth--;
+	cmdBuffer.cmd_writeTimestamp(vk::PipelineStages::bottomOfPipe, G.queryPool, G.scopes[RU.swapchain.imgInd][scope].endQuery);
+}
+
+#ifdef TRACY_ENABLE
+static void gpuTimings_emitTracyZones(CSpan<RenderUniverse::GpuTimings::Scope> scopes, auto getTimestamp)
+{
+	const auto& G = RU.gpuTimings;
+	auto emitZoneEnd = [&](u32 scopeI) {
+		___tracy_emit_gpu_zone_end({ .queryId = u16(scopes[scopeI].endQuery), .context = G.tracyContext });
+	};
+
+	// the zones must be emitted properly nested
+	u32 openScopes[16];
+	u32 numOpen = 0;
+	for (u32 scopeI = 0; scopeI < u32(scopes.size()); scopeI++) {
+		const auto& scope = scopes[scopeI];
+		while (numOpen > scope.depth)
+			emitZoneEnd(openScopes[--numOpen]);
+
+		char name[64];
+		const int nameLen = scope.id == u32(-1) ?
+			snprintf(name, sizeof(name), "%s", scope.name) :
+			snprintf(name, sizeof(name), "%s %u", scope.name, scope.id);
+		const char* file = __FILE__;
+		const u64 srcloc = ___tracy_alloc_srcloc_name(__LINE__, file, strlen(file), "draw", 4, name, size_t(nameLen));
+		___tracy_emit_gpu_zone_begin_alloc({ .srcloc = srcloc, .queryId = u16(scope.beginQuery), .context = G.tracyContext });
+		if (numOpen < std::size(openScopes))
+			openScopes[numOpen++] = scopeI;
+		else
+			emitZoneEnd(scopeI);
+	}
+	while (numOpen)
+		emitZoneEnd(openScopes[--numOpen]);
+
+	for (const auto& scope : scopes) {
+		___tracy_emit_gpu_time({ .gpuTime = i64(getTimestamp(scope.beginQuery)), .queryId = u16(scope.beginQuery), .context = G.tracyContext });
+		___tracy_emit_gpu_time({ .gpuTime = i64(getTimestamp(scope.endQuery)), .queryId = u16(scope.endQuery), .context = G.tracyContext });
+	}
+}
+#endif
+
+// reads the timings that were recorded the last time this swapchain image was used (its fence must have been signaled),
+// and starts recording the ones of the current frame
+static void gpuTimings_beginFrame(vk::CmdBuffer& cmdBuffer)
+{
+	auto& G = RU.gpuTimings;
+	if (!G.enabled)
+		return;
+
+	const u32 scImgInd = RU.swapchain.imgInd;
+	const u32 firstQuery = scImgInd * GPU_TIMINGS_MAX_QUERIES;
+	auto& scopes = G.scopes[scImgInd];
+	if (scopes.size()) {
+		// the staging scope lives in the queries of its cmd buffer, the rest in the ones of the frame
+		const u32 stagingQuery = scopes[0].beginQuery;
+		u64 stagingTimestamps[2];
+		G.timestamps.resize(G.numQueries[scImgInd]);
+		const bool ready =
+			RU.device.getTimestampQueryResults(G.queryPool, stagingQuery, stagingTimestamps) == VK_SUCCESS &&
+			(G.timestamps.empty() || RU.device.getTimestampQueryResults(G.queryPool, firstQuery, G.timestamps) == VK_SUCCESS);
+		if (ready) {
+			auto getTimestamp = [&](u32 query) -> u64 {
+				if (query >= gpuTimings_stagingQuery(0))
+					return stagingTimestamps[query - stagingQuery];
+				return G.timestamps[query - firstQuery];
+			};
+			G.results.clear();
+			for (const auto& scope : scopes) {
+				const u64 ticks = (getTimestamp(scope.endQuery) - getTimestamp(scope.beginQuery)) & G.timestampMask;
+				G.results.push_back({
+					.name = scope.name,
+					.id = scope.id,
+					.depth = scope.depth,
+					.ms = float(double(ticks) * G.timestampPeriod * 1e-6),
+				});
+			}
+#ifdef TRACY_ENABLE
+			gpuTimings_emitTracyZones(scopes, getTimestamp);
+#endif
+		}
+	}
+
+	scopes.clear();
+	G.numQueries[scImgInd] = 0;
+	G.depth = 0;
+	cmdBuffer.cmd_resetQueryPool(G.queryPool, firstQuery, GPU_TIMINGS_MAX_QUERIES);
+
+	// the staging cmd buffer was started in the previous frame, it's the first scope
+	const u32 stagingQuery = gpuTimings_stagingQuery(RU.cmdBuffers_staging_ind);
+	scopes.push_back({ "staging", u32(-1), 0, stagingQuery, stagingQuery + 1 });
+}
+
+CSpan<GpuTiming> getFrameGpuTimings()
+{
+	return RU.gpuTimings.results;
+}
+
+const FrameStats& getFrameStats()
+{
+	return RU.stats.last;
+}
+
+#ifdef TRACY_ENABLE
+// Tracy needs a GPU timestamp to calibrate against the CPU clock. We use the first draw cmd buffer, which hasn't been used yet
+static void gpuTimings_createTracyContext(VkQueue queue)
+{
+	auto& G = RU.gpuTimings;
+	auto& cmdBuffer = RU.cmdBuffers_draw[0];
+	cmdBuffer.begin(vk::CmdBufferUsageFlags{ .oneTimeSubmit = true });
+	cmdBuffer.cmd_resetQueryPool(G.queryPool, 0, 1);
+	cmdBuffer.cmd_writeTimestamp(vk::PipelineStages::bottomOfPipe, G.queryPool, 0);
+	cmdBuffer.end();
+	RU.device.submit(queue, { vk::SubmitInfo{ .cmdBuffers = {&cmdBuffer, 1} } });
+	RU.device.waitIdle();
+
+	u64 gpuTime = 0;
+	RU.device.getTimestampQueryResults(G.queryPool, 0, { &gpuTime, 1 });
+	G.tracyContext = tracy::GetGpuCtxCounter().fetch_add(1);
+	___tracy_emit_gpu_new_context({
+		.gpuTime = i64(gpuTime),
+		.period = G.timestampPeriod,
+		.context = G.tracyContext,
+		.flags = 0,
+		.type = u8(tracy::GpuContextType::Vulkan),
+	});
+	const char name[] = "tg";
+	___tracy_emit_gpu_context_name({ .context = G.tracyContext, .name = name, .len = u16(strlen(name)) });
+}
+#endif
+
 static void begingStagingCmdRecordingForNextFrame()
 {
 	// begin staging cmd recording for the next frame
 	RU.cmdBuffers_staging_ind = (RU.cmdBuffers_staging_ind + 1) % (RU.swapchain.numImages + 1);
-	getCurrentStagingCmdBuffer().begin(vk::CmdBufferUsageFlags{ .oneTimeSubmit = true });
+	auto& cmdBuffer = getCurrentStagingCmdBuffer();
+	cmdBuffer.begin(vk::CmdBufferUsageFlags{ .oneTimeSubmit = true });
+
+	if (RU.gpuTimings.enabled) {
+		const u32 query = gpuTimings_stagingQuery(RU.cmdBuffers_staging_ind);
+		cmdBuffer.cmd_resetQueryPool(RU.gpuTimings.queryPool, query, 2);
+		cmdBuffer.cmd_writeTimestamp(vk::PipelineStages::topOfPipe, RU.gpuTimings.queryPool, query);
+	}
+}
+
+static VkResult createSwapchain()
+{
+	if (RU.headless.enabled) {
+		for (bool& valid : RU.headless.readbackValid)
+			valid = false;
+		RU.headless.lastDrawnImgInd = u32(-1);
+		return vk::createHeadlessSwapchainSyncHelper(RU.swapchain, RU.device, {
+			.numImages = RU.headless.numImages,
+			.w = RU.screenW,
+			.h = RU.screenH,
+		});
+	}
+	return vk::createSwapchainSyncHelper(RU.swapchain, RU.surface, RU.device, RU.swapchainOptions);
+}
+
+static size_t headless_frameSize()
+{
+	return size_t(RU.swapchain.w) * RU.swapchain.h * vk::getFormatBlockInfo(RU.swapchain.format.format).bytes;
+}
+
+// the image must be in the transferSrc layout. The previous use of the readback buffer has finished, since it's indexed like the swapchain images
+static void headless_recordReadback(vk::CmdBuffer& cmdBuffer, u32 scImgInd)
+{
+	auto& buffer = RU.headless.readbackBuffers[scImgInd];
+	const size_t size = headless_frameSize();
+	if (buffer.id && RU.device.getBufferSize(buffer) != size) {
+		RU.device.destroyBuffer(buffer);
+		buffer = {};
+	}
+	if (!buffer.id)
+		buffer = RU.device.createBuffer(vk::BufferUsage::transferDst, size, { .random = true });
+
+	const VkBufferImageCopy region = {
+		.bufferOffset = 0,
+		.bufferRowLength = 0, // tightly packed
+		.bufferImageHeight = 0,
+		.imageSubresource = {
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.mipLevel = 0,
+			.baseArrayLayer = 0,
+			.layerCount = 1,
+		},
+		.imageOffset = {0, 0, 0},
+		.imageExtent = {RU.swapchain.w, RU.swapchain.h, 1},
+	};
+	cmdBuffer.cmd_copyImageToBuffer(RU.device.getVkHandle(RU.swapchain.images[scImgInd]), RU.device.getVkHandle(buffer), { &region, 1 });
+}
+
+void setFrameReadback(bool enabled)
+{
+	assert(RU.headless.enabled);
+	RU.headless.readbackEnabled = enabled;
+}
+
+bool readBackLastFrame(std::vector<u8>& pixels)
+{
+	TK_PROFILE_SCOPE;
+	auto& H = RU.headless;
+	assert(H.enabled);
+	if (H.lastDrawnImgInd == u32(-1) || !H.readbackValid[H.lastDrawnImgInd])
+		return false;
+
+	const u32 imgInd = H.lastDrawnImgInd;
+	RU.swapchain.waitFrameFinished(RU.device, imgInd);
+	const auto buffer = H.readbackBuffers[imgInd];
+	RU.device.invalidateBuffer(buffer);
+	const size_t size = headless_frameSize();
+	pixels.resize(size);
+	memcpy(pixels.data(), RU.device.getBufferMemPtr(buffer), size);
+	return true;
 }
 
 // *** INIT RENDER UNIVERSE ***
@@ -1287,24 +2536,62 @@ void initRenderUniverse(const InitRenderUniverseParams& params)
 	RU.oldScreenW = RU.screenW = params.screenW;
 	RU.oldScreenH = RU.screenH = params.screenH;
 	RU.surface = params.surface;
+	RU.headless.enabled = params.headless;
+	RU.headless.numImages = params.headlessNumImages;
+	assert(RU.headless.enabled == (RU.surface == VK_NULL_HANDLE));
 	{ // create device
 		std::vector<vk::PhysicalDeviceInfo> physicalDeviceInfos;
 		vk::getPhysicalDeviceInfos(params.instance, physicalDeviceInfos, params.surface);
 		const u32 bestPhysicalDeviceInd = vk::chooseBestPhysicalDevice(physicalDeviceInfos, {});
 		const auto& bestPhysicalDeviceInfo = physicalDeviceInfos[bestPhysicalDeviceInd];
 
-		RU.queueFamily = bestPhysicalDeviceInfo.findGraphicsAndPresentQueueFamily();
+		RU.queueFamily = RU.headless.enabled ?
+			bestPhysicalDeviceInfo.findGraphicsQueueFamily() :
+			bestPhysicalDeviceInfo.findGraphicsAndPresentQueueFamily();
 		assert(RU.queueFamily < bestPhysicalDeviceInfo.queueFamiliesProps.size());
 
+		// async uploads need a dedicated transfer queue family, and timeline semaphores
+		const u32 transferQueueFamily = bestPhysicalDeviceInfo.findTransferOnlyQueueFamily();
+		RU.transfer.enabled = params.asyncTransfers &&
+			transferQueueFamily < bestPhysicalDeviceInfo.queueFamiliesProps.size() &&
+			bestPhysicalDeviceInfo.supportedFeatures.timelineSemaphore;
+
 		const float queuePriorities[] = { 1.f };
-		const vk::QueuesCreateInfo queuesInfos[] = { {
-			.queueFamily = RU.queueFamily,
-			.queuePriorities = queuePriorities,
-		} };
-		vk::ASSERT_VKRES(vk::createDevice(RU.device, params.instance, bestPhysicalDeviceInfo, queuesInfos));
+		const vk::QueuesCreateInfo queuesInfos[] = {
+			{
+				.queueFamily = RU.queueFamily,
+				.queuePriorities = queuePriorities,
+			},
+			{
+				.queueFamily = transferQueueFamily,
+				.queuePriorities = queuePriorities,
+			},
+		};
+		const vk::DeviceFeatures features = {
+			.dynamicCullMode = bestPhysicalDeviceInfo.supportedFeatures.dynamicCullMode,
+			.timelineSemaphore = RU.transfer.enabled,
+			.textureCompressionBC = bestPhysicalDeviceInfo.supportedFeatures.textureCompressionBC,
+			.descriptorIndexing = params.bindlessMaterials && bestPhysicalDeviceInfo.supportedFeatures.descriptorIndexing,
+		};
+		vk::ASSERT_VKRES(vk::createDevice(RU.device, params.instance, bestPhysicalDeviceInfo, { queuesInfos, RU.transfer.enabled ? 2u : 1u },
+			RU.headless.enabled ? CSpan<CStr>{} : CSpan<CStr>(vk::default_deviceExtensions), features));
+
+		if (features.descriptorIndexing) {
+			// the texture array is update-after-bind, so it's limited by those limits instead of the regular ones
+			const auto& limits = bestPhysicalDeviceInfo.descriptorIndexingProps;
+			RU.bindlessTextures.capacity = std::min({ BINDLESS_MAX_TEXTURES,
+				limits.maxPerStageDescriptorUpdateAfterBindSamplers, limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+				limits.maxDescriptorSetUpdateAfterBindSamplers, limits.maxDescriptorSetUpdateAfterBindSampledImages });
+		}
+
+		if (RU.transfer.enabled) {
+			RU.transfer.queueFamily = transferQueueFamily;
+			const VkExtent3D granularity = bestPhysicalDeviceInfo.queueFamiliesProps[transferQueueFamily].minImageTransferGranularity;
+			RU.transfer.stream.imageRowGranularity = granularity.width == 0 ? 0 : granularity.height; // (0, 0, 0) means that only whole images can be copied
+		}
 	}
 
-	const VkQueue mainQueue = RU.device.queues[0][0]; // TODO: more sofisticated queue handling, detect compute queues, transfer queues, etc
+	const VkQueue mainQueue = RU.device.queues[RU.queueFamily][0]; // TODO: more sofisticated queue handling, detect compute queues, etc
 
 	// https://developer.nvidia.com/blog/vulkan-dos-donts/
 	// - Prefer using 24-bit depth formats for optimal performance
@@ -1321,7 +2608,7 @@ void initRenderUniverse(const InitRenderUniverseParams& params)
 
 	// create swapchain
 	RU.swapchainOptions = {};
-	vk::ASSERT_VKRES(vk::createSwapchainSyncHelper(RU.swapchain, RU.surface, RU.device, RU.swapchainOptions));
+	vk::ASSERT_VKRES(createSwapchain());
 
 	auto makeRenderPass = [&](vk::ImageLayout finalLayout) {
 		vk::FbAttachmentInfo attachments[] = {
@@ -1351,12 +2638,12 @@ void initRenderUniverse(const InitRenderUniverseParams& params)
 		});
 	};
 
-	RU.renderPass = makeRenderPass(vk::ImageLayout::presentSrc);
+	RU.renderPass = makeRenderPass(RU.headless.enabled ? vk::ImageLayout::transferSrc : vk::ImageLayout::presentSrc);
 	RU.renderPassOffscreen = makeRenderPass(vk::ImageLayout::shaderReadOnly);
 
 	RU.shaderCompiler.init();
 
-	vk::ASSERT_VKRES(vk::createSwapchainSyncHelper(RU.swapchain, RU.surface, RU.device, RU.swapchainOptions));
+	vk::ASSERT_VKRES(createSwapchain());
 	const u32 numScImages = RU.swapchain.numImages;
 
 	RU.cmdPool = RU.device.createCmdPool(RU.queueFamily, { .transientCmdBuffers = true, .reseteableCmdBuffers = true });
@@ -1364,6 +2651,33 @@ void initRenderUniverse(const InitRenderUniverseParams& params)
 	RU.device.allocCmdBuffers(RU.cmdPool, { RU.cmdBuffers_draw, numScImages }, false);
 	RU.cmdBuffers_staging_ind = 0;
 
+	RU.staging.frameBudget = params.stagingFrameBudget;
+	RU.staging.maxCapacity = params.stagingMemoryCeiling;
+
+	{ // GPU timings
+		auto& G = RU.gpuTimings;
+		const auto& physicalDevice = RU.device.physicalDevice;
+		const u32 timestampValidBits = physicalDevice.queueFamiliesProps[RU.queueFamily].timestampValidBits;
+		G.enabled = params.gpuTimings && timestampValidBits != 0;
+		if (G.enabled) {
+			G.timestampPeriod = physicalDevice.props.limits.timestampPeriod;
+			G.timestampMask = timestampValidBits >= 64 ? u64(-1) : (u64(1) << timestampValidBits) - 1;
+			G.queryPool = RU.device.createTimestampQueryPool(MAX_SWAPCHAIN_IMAGES * GPU_TIMINGS_MAX_QUERIES + 2 * (MAX_SWAPCHAIN_IMAGES + 1));
+#ifdef TRACY_ENABLE
+			gpuTimings_createTracyContext(mainQueue);
+#endif
+		}
+	}
+
+	if (RU.transfer.enabled) {
+		auto& T = RU.transfer;
+		T.queue = RU.device.queues[T.queueFamily][0];
+		T.cmdPool = RU.device.createCmdPool(T.queueFamily, { .transientCmdBuffers = true, .reseteableCmdBuffers = true });
+		T.timeline = RU.device.createTimelineSemaphore(0);
+		T.stream.frameBudget = params.stagingFrameBudget;
+		T.stream.maxCapacity = params.stagingMemoryCeiling;
+	}
+
 	{ // global descset layout
 		const vk::DescriptorSetLayoutBindingInfo bindings[] = {
 			{
@@ -1407,6 +2721,12 @@ void initRenderUniverse(const InitRenderUniverseParams& params)
 	begingStagingCmdRecordingForNextFrame();
 }
 
+void setStagingFrameBudget(size_t bytes)
+{
+	RU.staging.frameBudget = bytes;
+	RU.transfer.stream.frameBudget = bytes;
+}
+
 void onWindowResized(u32 w, u32 h)
 {
 	RU.oldScreenW = RU.screenW;
@@ -1423,7 +2743,7 @@ ShaderCompiler& getShaderCompiler()
 // *** RENDER WORLD ***
 static u32 acquireRenderWorldEntry()
 {
-	const u32 e = acquireReusableEntry(RU.renderWorlds_nextFreeEntry, RU.renderWorlds, 0);
+	const u32 e = RU.renderWorlds_slots.acquire(RU.renderWorlds);
 	return e;
 }
 
@@ -1435,6 +2755,7 @@ RenderWorldId createRenderWorld()
 	const u32 numExpectedObjects = 1 << 10;
 	RW.objects_id_to_entry.reserve(numExpectedObjects);
 	RW.objects_info.reserve(numExpectedObjects);
+	RW.objects_drawPacket.reserve(numExpectedObjects);
 	RW.objects_firstModelMtx.reserve(numExpectedObjects);
 	RW.modelMatrices.reserve(numExpectedObjects);
 	RW.objects_matricesTmp.reserve(numExpectedObjects);
@@ -1447,7 +2768,7 @@ RenderWorldId createRenderWorld()
 		const auto usage = vk::BufferUsage::uniformBuffer;
 		const size_t size = sizeof(GlobalUniforms_Header) + MAX_DIR_LIGHTS * sizeof(GlobalUniforms_DirLight);
 		for (auto& b : RW.global_uniformBuffers) {
-			b = RU.device.createBuffer(usage, size, {.sequentialWrite = true});
+			b = RU.device.createBuffer(usage, size, {.sequentialWrite = true}, mem::Tag::renderWorld);
 		}
 	}
 	RW.global_descSets.resize(numScImages);
@@ -1475,30 +2796,107 @@ RenderWorldId createRenderWorld()
 void destroyRenderWorld(RenderWorldId id)
 {
 	RU.renderWorlds[id.id] = {};
-	releaseReusableEntry(RU.renderWorlds_nextFreeEntry, RU.renderWorlds, 0, id.id);
+	RU.renderWorlds_slots.release(id.id);
 }
 
 // RENDER TARGET
+static vk::ImageInfo makeRenderTargetDepthInfo(u32 w, u32 h)
+{
+	return vk::ImageInfo{
+		.size = {u16(w), u16(h)},
+		.format = RU.depthStencilFormat,
+		.usage = vk::ImageUsage::default_framebuffer(false, false),
+	};
+}
+
+// returns the index of the current transient depth memory, which is big enough for a w x h depth buffer
+static u32 acquireTransientDepthMemory(u32 w, u32 h)
+{
+	auto& mems = RU.transientDepthMemories;
+	if (mems.empty() || mems.back().w < w || mems.back().h < h) {
+		if (mems.size()) {
+			w = glm::max(w, mems.back().w);
+			h = glm::max(h, mems.back().h);
+			if (mems.back().numAliases == 0) {
+				deferredDestroy_image(mems.back().image);
+				mems.back().image = {};
+			}
+		}
+		mems.push_back({
+			.image = RU.device.createImage(makeRenderTargetDepthInfo(w, h), mem::Tag::renderTargets),
+			.w = w, .h = h,
+			.numAliases = 0,
+		});
+	}
+	mems.back().numAliases++;
+	return u32(mems.size() - 1);
+}
+
+static void releaseTransientDepthMemory(u32 memInd)
+{
+	auto& mem = RU.transientDepthMemories[memInd];
+	assert(mem.numAliases);
+	mem.numAliases--;
+	if (mem.numAliases == 0 && memInd + 1 != RU.transientDepthMemories.size()) {
+		deferredDestroy_image(mem.image);
+		mem.image = {};
+	}
+}
+
+static void destroyRenderTargetImages(RenderTarget& rt)
+{
+	for (u32 i = 0; i < rt.numColorBuffers; i++) {
+		deferredDestroy_framebuffer(rt.framebuffer[i]);
+		deferredDestroy_imageView(rt.colorBufferView[i]);
+		deferredDestroy_image(rt.colorBuffer[i]);
+	}
+	deferredDestroy_imageView(rt.depthBufferView);
+	deferredDestroy_image(rt.depthBuffer);
+	if (rt.depthMemory != u32(-1))
+		releaseTransientDepthMemory(rt.depthMemory);
+}
+
 static void createRenderTarget_inPlace(RenderTargetId id, u32 w, u32 h)
 {
 	auto& rt = RU.renderTargets[id.id];
+	rt.numColorBuffers = rt.autoRedraw ? RU.swapchain.numImages : 1;
+	rt.needRedraw = u8(-1);
 
-	for (u32 i = 0; i < RU.swapchain.numImages; i++) {
+	// recycle the images of a pooled render target, starting from the most recently released
+	auto& pool = RU.renderTargetPool;
+	for (size_t i = pool.size(); i-- > 0; ) {
+		const auto& pooled = pool[i].rt;
+		if (pooled.w == w && pooled.h == h && pooled.numColorBuffers == rt.numColorBuffers) {
+			const bool autoRedraw = rt.autoRedraw;
+			const u8 needRedraw = rt.needRedraw;
+			rt = pooled;
+			rt.autoRedraw = autoRedraw;
+			rt.needRedraw = needRedraw;
+			pool.erase(pool.begin() + i);
+			return;
+		}
+	}
+
+	const vk::ImageInfo depthInfo = makeRenderTargetDepthInfo(w, h);
+	rt.depthMemory = acquireTransientDepthMemory(w, h);
+	rt.depthBuffer = RU.device.createAliasingImage(depthInfo, RU.transientDepthMemories[rt.depthMemory].image);
+	if (!rt.depthBuffer.id) {
+		// the memory is not compatible (it shouldn't happen for images of the same format and usage)
+		releaseTransientDepthMemory(rt.depthMemory);
+		rt.depthMemory = u32(-1);
+		rt.depthBuffer = RU.device.createImage(depthInfo, mem::Tag::renderTargets);
+	}
+	rt.depthBufferView = RU.device.createImageView({ .image = rt.depthBuffer });
+
+	for (u32 i = 0; i < rt.numColorBuffers; i++) {
 
 		rt.colorBuffer[i] = RU.device.createImage(vk::ImageInfo{
 			.size = {u16(w), u16(h)},
 			.usage = vk::ImageUsage::default_framebuffer(false, true),
-		});
+		}, mem::Tag::renderTargets);
 		rt.colorBufferView[i] = RU.device.createImageView({ .image = rt.colorBuffer[i] });
 
-		rt.depthBuffer[i] = RU.device.createImage(vk::ImageInfo{
-			.size = {u16(w), u16(h)},
-			.format = RU.depthStencilFormat,
-			.usage = vk::ImageUsage::default_framebuffer(false, true),
-		});
-		rt.depthBufferView[i] = RU.device.createImageView({ .image = rt.depthBuffer[i] });
-
-		std::array<vk::ImageView, 2> attachments = { rt.colorBufferView[i], rt.depthBufferView[i] };
+		std::array<vk::ImageView, 2> attachments = { rt.colorBufferView[i], rt.depthBufferView };
 		rt.framebuffer[i] = RU.device.createFramebuffer(vk::FramebufferInfo{
 			.renderPass = RU.renderPassOffscreen,
 			.attachments = {attachments.data(), 2},
@@ -1508,21 +2906,30 @@ static void createRenderTarget_inPlace(RenderTargetId id, u32 w, u32 h)
 
 	rt.w = w;
 	rt.h = h;
-	rt.needRedraw = u8(-1);
 }
 
+// the images go to the pool, so they can be recycled
 static void destroyRenderTarget_inPlace(RenderTargetId id)
 {
 	assert(id.isValid());
-	auto& rt = RU.renderTargets[id.id];
-	for (u32 i = 0; i < RU.swapchain.numImages; i++) {
-		deferredDestroy_framebuffer(rt.framebuffer[i]);
-		deferredDestroy_imageView(rt.colorBufferView[i]);
-		deferredDestroy_image(rt.colorBuffer[i]);
-		deferredDestroy_imageView(rt.depthBufferView[i]);
-		deferredDestroy_image(rt.depthBuffer[i]);
+	auto& pool = RU.renderTargetPool;
+	pool.push_back({ RU.renderTargets[id.id], RU.frameCounter });
+	if (pool.size() > RENDER_TARGET_POOL_MAX_SIZE) {
+		destroyRenderTargetImages(pool.front().rt);
+		pool.erase(pool.begin());
 	}
+}
 
+// frees the pooled render targets that haven't been recycled for a while
+static void trimRenderTargetPool()
+{
+	auto& pool = RU.renderTargetPool;
+	size_t n = 0;
+	while (n < pool.size() && RU.frameCounter - pool[n].releaseFrame > RENDER_TARGET_POOL_MAX_AGE) {
+		destroyRenderTargetImages(pool[n].rt);
+		n++;
+	}
+	pool.erase(pool.begin(), pool.begin() + n);
 }
 
 RenderTargetId createRenderTarget(const RenderTargetParams& params)
@@ -1530,7 +2937,7 @@ RenderTargetId createRenderTarget(const RenderTargetParams& params)
 	const u32 w = params.w;
 	const u32 h = params.h;
 
-	const u32 rtInd = RU.renderTargets.alloc();
+	const u32 rtInd = RU.renderTargets.acquire();
 	const RenderTargetId id = { rtInd };
 	auto& rt = RU.renderTargets[id.id];
 	rt.autoRedraw = params.autoRedraw;
@@ -1542,7 +2949,7 @@ RenderTargetId createRenderTarget(const RenderTargetParams& params)
 void destroyRenderTarget(RenderTargetId id)
 {
 	destroyRenderTarget_inPlace(id);
-	RU.renderTargets.free(id.id);
+	RU.renderTargets.release(id.id);
 }
 
 vk::Image RenderTargetId::getTextureImage()
@@ -1551,7 +2958,8 @@ vk::Image RenderTargetId::getTextureImage()
 }
 vk::Image RenderTargetId::getTextureImage(u32 scImgInd)
 {
-	return RU.renderTargets[id].colorBuffer[scImgInd];
+	const auto& rt = RU.renderTargets[id];
+	return rt.colorBuffer[rt.colorInd(scImgInd)];
 }
 vk::ImageView RenderTargetId::getTextureImageView()
 {
@@ -1559,7 +2967,8 @@ vk::ImageView RenderTargetId::getTextureImageView()
 }
 vk::ImageView RenderTargetId::getTextureImageView(u32 scImgInd)
 {
-	return RU.renderTargets[id].colorBufferView[scImgInd];
+	const auto& rt = RU.renderTargets[id];
+	return rt.colorBufferView[rt.colorInd(scImgInd)];
 }
 VkImageView RenderTargetId::getTextureImageViewVk()
 {
@@ -1599,6 +3008,7 @@ static u32 acquireObjectEntry(RenderWorld& RW)
 	const u32 e = RW.objects_info.size();
 	RW.objects_entry_to_id.emplace_back();
 	RW.objects_info.emplace_back();
+	RW.objects_drawPacket.emplace_back();
 	RW.objects_firstModelMtx.emplace_back();
 	return e;
 }
@@ -1614,6 +3024,9 @@ static u32 acquireObjectId(RenderWorld& RW)
 
 	const u32 id = RW.objects_id_to_entry.size();
 	RW.objects_id_to_entry.emplace_back();
+#ifndef NDEBUG
+	RW.objects_counter.emplace_back();
+#endif
 	return id;
 }
 
@@ -1621,6 +3034,9 @@ static void releaseObjectId(RenderWorld& RW, u32 id)
 {
 	RW.objects_id_to_entry[id] = RW.objects_nextFreeId;
 	RW.objects_nextFreeId = id;
+#ifndef NDEBUG
+	RW.objects_counter[id]++;
+#endif
 }
 
 ObjectId RenderWorldId::createObject(MeshRC mesh, const glm::mat4& modelMtx, u32 maxInstances)
@@ -1673,6 +3089,7 @@ static ObjectId _createObjectWithInstancing(RenderWorld& RW, MeshRC mesh, u32 nu
 	RW.objects_entry_to_id[e] = oid;
 	RW.objects_id_to_entry[oid] = e;
 	RW.objects_info[e] = { mesh, numInstances, maxInstances };
+	RW.objects_drawPacket[e] = {};
 	RW.objects_firstModelMtx[e] = u32(RW.modelMatrices.size());
 	if constexpr (PROVIDE_DATA) {
 		for (u32 i = 0; i < numInstances; i++) {
@@ -1733,6 +3150,7 @@ void RenderWorld::_defragmentObjects()
 			const u32 firstModelMtx = objects_firstModelMtx[objJ];
 			const u32 numInstances = info.numInstances;
 			objects_info[objI] = std::move(info);
+			objects_drawPacket[objI] = objects_drawPacket[objJ];
 			objects_firstModelMtx[objI] = mtxI;
 			const u32 oid = objects_entry_to_id[objJ];
 			objects_entry_to_id[objI] = oid;
@@ -1749,6 +3167,7 @@ void RenderWorld::_defragmentObjects()
 	}
 
 	objects_info.resize(objI);
+	objects_drawPacket.resize(objI);
 	objects_firstModelMtx.resize(objI);
 	objects_entry_to_id.resize(objI);
 	modelMatrices.resize(mtxI);
@@ -1756,8 +3175,39 @@ void RenderWorld::_defragmentObjects()
 }
 
 // *** DRAW ***
+// returns false if the resources are not ready yet
+static bool resolveDrawPacket(RenderWorld::DrawPacket& packet, MeshId meshId)
+{
+	const MeshInfo& meshInfo = RU.meshes_info[meshId.id];
+	const MaterialId materialId = meshInfo.material.id;
+	const GeomId geomId = meshInfo.geom.id;
+	if (!geomId.isReady() || !materialId.isReady())
+		return false;
+
+	const GeomInfo& geomInfo = geomId.getInfo();
+	const bool indexed = geomInfo.indsOffset != u32(-1);
+	packet = {
+		.pipeline = materialId.getPipeline(geomId),
+		.pipelineLayout = materialId.getPipelineLayout(),
+		.materialDescSet = materialId.getDescSet(),
+		.geomBuffer = RU.device.getVkHandle(geomId.getBuffer()),
+		.materialIndex = materialId.getMaterialIndex(),
+		.attribOffsets = {
+			geomInfo.attribOffset_positions, geomInfo.attribOffset_normals, geomInfo.attribOffset_tangents,
+			geomInfo.attribOffset_texCoords, geomInfo.attribOffset_colors
+		},
+		.indsOffset = geomInfo.indsOffset,
+		.numVertsOrInds = indexed ? geomInfo.numInds : geomInfo.numVerts,
+		.doubleSided = materialId.isDoubleSided(),
+		.epoch = RU.drawPacketsEpoch,
+	};
+	return true;
+}
+
 static void draw_renderWorld(const RenderWorldViewport& rwViewport, u32 renderTargetInd, u32 viewportInd)
 {
+	TK_PROFILE_SCOPE;
+	TK_PERF_SCOPE("draw_renderWorld");
 	const RenderWorldId& renderWorldId = rwViewport.renderWorld;
 	auto& RW = RU.renderWorlds[renderWorldId.id];
 
@@ -1789,17 +3239,20 @@ static void draw_renderWorld(const RenderWorldViewport& rwViewport, u32 renderTa
 	RW.objects_instancesCursorsTmp.resize(numObjects);
 	for (size_t objectI = 0; objectI < numObjects; objectI++) {
 		auto& objInfo = RW.objects_info[objectI];
-		for (size_t instanceI = 0; instanceI < objInfo.numInstances; instanceI++) {
-			const glm::mat4& modelMtx = RW.modelMatrices[instancesCursor_src + instanceI];
-			auto& Ms = RW.objects_matricesTmp[instancesCursor_dst + instanceI];
-			Ms.modelMtx = modelMtx;
-			Ms.modelViewProj = viewProj * modelMtx;
-			Ms.invTransModelView = glm::inverse(glm::transpose(modelMtx));
-		}
+		for (size_t instanceI = 0; instanceI < objInfo.numInstances; instanceI++)
+			RW.objects_matricesTmp[instancesCursor_dst + instanceI].modelMtx = RW.modelMatrices[instancesCursor_src + instanceI];
 		RW.objects_instancesCursorsTmp[objectI] = instancesCursor_dst;
 		instancesCursor_src += RW.objects_info[objectI].maxInstances;
 		instancesCursor_dst += RW.objects_info[objectI].numInstances;
 	}
+	// the other matrices are computed for all the instances at once
+	if (totalInstances) {
+		auto* Ms = RW.objects_matricesTmp.data();
+		const size_t stride = sizeof(RenderWorld::ObjectMatrices);
+		const StridedSpan<const glm::mat4> modelMatrices(&Ms->modelMtx, totalInstances, stride);
+		mulMtx_batch({ &Ms->modelViewProj, totalInstances, stride }, viewProj, modelMatrices);
+		affineNormalMtx_batch({ &Ms->invTransModelView, totalInstances, stride }, modelMatrices);
+	}
 
 	const size_t instancingBufferRequiredSize = 3 * sizeof(glm::mat4) * size_t(totalInstances);
 	const size_t instancingBufferRequiredExtendedSize = 4 * sizeof(glm::mat4) * size_t(totalInstances); // 33% more that the minimum required size
@@ -1813,7 +3266,7 @@ static void draw_renderWorld(const RenderWorldViewport& rwViewport, u32 renderTa
 	auto& instancingBuffers = instancingBuffers_scImg[renderTargetInd];
 	if (instancingBuffers.size() <= viewportInd) {
 		instancingBuffers.resize(viewportInd + 1);
-		vk::Buffer b = RU.device.createBuffer(vk::BufferUsage::vertexBuffer, instancingBufferRequiredExtendedSize, { .sequentialWrite = true });
+		vk::Buffer b = RU.device.createBuffer(vk::BufferUsage::vertexBuffer, instancingBufferRequiredExtendedSize, { .sequentialWrite = true }, mem::Tag::renderWorld);
 		instancingBuffers[viewportInd] = b;
 	}
 	else {
@@ -1822,7 +3275,7 @@ static void draw_renderWorld(const RenderWorldViewport& rwViewport, u32 renderTa
 		if (instancingBufferSize < instancingBufferRequiredSize) {
 			// need a bigger buffer
 			RU.device.destroyBuffer(instancingBuffer);
-			instancingBuffer = RU.device.createBuffer(vk::BufferUsage::vertexBuffer, instancingBufferRequiredExtendedSize, { .sequentialWrite = true });
+			instancingBuffer = RU.device.createBuffer(vk::BufferUsage::vertexBuffer, instancingBufferRequiredExtendedSize, { .sequentialWrite = true }, mem::Tag::renderWorld);
 		}
 	}
 
@@ -1830,60 +3283,545 @@ static void draw_renderWorld(const RenderWorldViewport& rwViewport, u32 renderTa
 	u8* bufferMem = RU.device.getBufferMemPtr(instancingBuffer);
 	memcpy(bufferMem, RW.objects_matricesTmp.data(), instancingBufferRequiredSize);
 	RU.device.flushBuffer(instancingBuffer);
+	auto& stats = RU.stats.current;
+	stats.bytesInstancing += instancingBufferRequiredSize;
 
 	auto& cmdBuffer_draw = RU.cmdBuffers_draw[RU.swapchain.imgInd];
 	cmdBuffer_draw.cmd_viewport(rwViewport.viewport);
 	cmdBuffer_draw.cmd_scissor(rwViewport.scissor);
 
+	// avoid redundant binds: consecutive objects often share the pipeline, layout or material
+	const bool dynamicCullMode = RU.device.enabledFeatures.dynamicCullMode;
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	VkPipelineLayout boundPipelineLayout = VK_NULL_HANDLE;
+	VkDescriptorSet boundMaterialDescSet = VK_NULL_HANDLE;
+	u32 boundMaterialIndex = u32(-1);
+	int boundDoubleSided = -1;
+	const VkBuffer instancingBufferVk = RU.device.getVkHandle(instancingBuffer);
 	for (size_t objectI = 0; objectI < numObjects; objectI++) {
-		auto& objInfo = RW.objects_info[objectI];
-		auto meshId = objInfo.mesh.id;
-		auto meshInfo = meshId.getInfo();
-		auto materialId = meshInfo.material.id;
-		
-		cmdBuffer_draw.cmd_bindGraphicsPipeline(meshId.getPipeline());
-		
-		cmdBuffer_draw.cmd_bindDescriptorSet(vk::PipelineBindPoint::graphics, materialId.getPipelineLayout(), DESCSET_GLOBAL, RW.global_descSets[scImgInd]); // TODO: move outside of the loop
-		cmdBuffer_draw.cmd_bindDescriptorSet(vk::PipelineBindPoint::graphics, materialId.getPipelineLayout(), DESCSET_MATERIAL, materialId.getDescSet());
-		
-		const auto geomId = meshInfo.geom.id;
-		const auto& geomInfo = geomId.getInfo();
-		const auto geomBuffer = RU.device.getVkHandle(geomId.getBuffer());
+		auto& packet = RW.objects_drawPacket[objectI];
+		if (packet.epoch != RU.drawPacketsEpoch && !resolveDrawPacket(packet, RW.objects_info[objectI].mesh.id)) {
+			stats.objectsNotReady++;
+			continue; // the resources are still being uploaded
+		}
+
+		if (packet.pipeline != boundPipeline) {
+			cmdBuffer_draw.cmd_bindGraphicsPipeline(packet.pipeline);
+			stats.pipelineBinds++;
+			boundPipeline = packet.pipeline;
+			boundDoubleSided = -1; // binding a pipeline with static cull mode would invalidate the dynamic state
+		}
+
+		const VkPipelineLayout pipelineLayout = packet.pipelineLayout;
+		if (pipelineLayout != boundPipelineLayout) {
+			cmdBuffer_draw.cmd_bindDescriptorSet(vk::PipelineBindPoint::graphics, pipelineLayout, DESCSET_GLOBAL, RW.global_descSets[scImgInd]);
+			stats.descriptorSetBinds++;
+			boundPipelineLayout = pipelineLayout;
+			boundMaterialDescSet = VK_NULL_HANDLE;
+			boundMaterialIndex = u32(-1);
+		}
+		if (packet.materialDescSet != boundMaterialDescSet) {
+			cmdBuffer_draw.cmd_bindDescriptorSet(vk::PipelineBindPoint::graphics, pipelineLayout, DESCSET_MATERIAL, packet.materialDescSet);
+			stats.descriptorSetBinds++;
+			boundMaterialDescSet = packet.materialDescSet;
+		}
+		// bindless materials share the descriptor set, and select their uniforms and textures with this index
+		if (packet.materialIndex != boundMaterialIndex) {
+			cmdBuffer_draw.cmd_pushConstants(pipelineLayout, vk::ShaderStages::vertex | vk::ShaderStages::fragment, 0, tk::asBytesSpan(packet.materialIndex));
+			boundMaterialIndex = packet.materialIndex;
+		}
+
+		if (dynamicCullMode && int(packet.doubleSided) != boundDoubleSided) {
+			cmdBuffer_draw.cmd_setCullMode(false, !packet.doubleSided);
+			boundDoubleSided = packet.doubleSided;
+		}
 
 		// instancing buffer
-		cmdBuffer_draw.cmd_bindVertexBuffer(0, RU.device.getVkHandle(instancingBuffer), sizeof(RenderWorld::ObjectMatrices) * RW.objects_instancesCursorsTmp[objectI]);
-		// positions
-		cmdBuffer_draw.cmd_bindVertexBuffer(1, geomBuffer, geomInfo.attribOffset_positions);
-		// normals
-		if(geomInfo.attribOffset_normals != u32(-1))
-			cmdBuffer_draw.cmd_bindVertexBuffer(2, geomBuffer, geomInfo.attribOffset_normals);
-		// tangents
-		if (geomInfo.attribOffset_tangents != u32(-1))
-			cmdBuffer_draw.cmd_bindVertexBuffer(3, geomBuffer, geomInfo.attribOffset_tangents);
-		// texCoords
-		if (geomInfo.attribOffset_texCoords != u32(-1))
-			cmdBuffer_draw.cmd_bindVertexBuffer(4, geomBuffer, geomInfo.attribOffset_texCoords);
-		// colors
-		if (geomInfo.attribOffset_colors != u32(-1))
-			cmdBuffer_draw.cmd_bindVertexBuffer(5, geomBuffer, geomInfo.attribOffset_colors);
+		cmdBuffer_draw.cmd_bindVertexBuffer(0, instancingBufferVk, sizeof(RenderWorld::ObjectMatrices) * RW.objects_instancesCursorsTmp[objectI]);
+		stats.vertexBufferBinds++;
+		// positions, normals, tangents, texCoords, colors
+		for (u32 attribI = 0; attribI < 5; attribI++) {
+			if (packet.attribOffsets[attribI] != u32(-1)) {
+				cmdBuffer_draw.cmd_bindVertexBuffer(1 + attribI, packet.geomBuffer, packet.attribOffsets[attribI]);
+				stats.vertexBufferBinds++;
+			}
+		}
 
 		// index buffer
-		if (geomInfo.indsOffset == u32(-1)) {
-			cmdBuffer_draw.cmd_draw(geomInfo.numVerts, objInfo.numInstances, 0, 0);
+		const u32 numInstances = RW.objects_info[objectI].numInstances;
+		if (packet.indsOffset == u32(-1)) {
+			cmdBuffer_draw.cmd_draw(packet.numVertsOrInds, numInstances, 0, 0);
 		}
 		else {
-			cmdBuffer_draw.cmd_bindIndexBuffer(geomBuffer, VK_INDEX_TYPE_UINT32, geomInfo.indsOffset);
-			cmdBuffer_draw.cmd_drawIndexed(geomInfo.numInds, objInfo.numInstances);
+			cmdBuffer_draw.cmd_bindIndexBuffer(packet.geomBuffer, VK_INDEX_TYPE_UINT32, packet.indsOffset);
+			stats.indexBufferBinds++;
+			cmdBuffer_draw.cmd_drawIndexed(packet.numVertsOrInds, numInstances);
+		}
+		stats.drawCalls++;
+		stats.instances += numInstances;
+		stats.triangles += u64(packet.numVertsOrInds / 3) * numInstances; // the PBR pipelines draw triangle lists
+	}
+}
+
+// records the copies from the staging buffer to the images. The images of the first chunks are transitioned to the transferDst layout
+// (the images that were already being uploaded in previous batches are in that layout already)
+static void staging_recordImageCopies(vk::CmdBuffer& cmdBuffer, CSpan<ImageStagingProc> procs)
+{
+	const size_t N = procs.size();
+	if (N == 0)
+		return;
+
+	FrameArenaScope scratch;
+	std::pmr::vector<vk::Image> images(&scratch.arena);
+	images.reserve(N);
+	for (size_t i = 0; i < N; i++) {
+		const auto& proc = procs[i];
+		if (proc.firstChunk)
+			images.push_back(proc.img.getHandle());
+	}
+	if (images.size())
+		cmdBuffer.cmd_pipelineBarrier_imagesToTransferDstLayout(RU.device, images);
+
+	for (size_t i = 0; i < N; i++) {
+		const auto& proc = procs[i];
+		const auto& imgInfo = proc.img.getInfo();
+		const VkBufferImageCopy copy = {
+			.bufferOffset = proc.stagingBufferOffset,
+			.bufferRowLength = 0, .bufferImageHeight = 0, // tightly packed
+			.imageSubresource = {
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.mipLevel = proc.mipLevel,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+			.imageOffset = {0, proc.firstRow, 0},
+			.imageExtent = {glm::max(1u, u32(imgInfo.w) >> proc.mipLevel), proc.numRows, 1},
+		};
+		cmdBuffer.cmd_copy(RU.device.getVkHandle(proc.stagingBuffer), RU.device.getVkHandle(proc.img.getHandle()), { &copy, 1 });
+	}
+}
+
+// for the images that have been completely uploaded (lastChunk): generate the mip chain, and transition to the shaderRead layout.
+// Needs a graphics queue because of the blits
+static void staging_recordImagesFinalization(vk::CmdBuffer& cmdBuffer, CSpan<ImageStagingProc> procs)
+{
+	u8 maxLevels = 1;
+	u32 numGenerateMipChains = 0;
+	for (const auto& proc : procs) {
+		if (proc.lastChunk && proc.generateMipChain) {
+			maxLevels = glm::max(proc.img.getInfo().numMips, maxLevels);
+			numGenerateMipChains++;
+		}
+	}
+
+	// generate the mipchain with blit operations (and the necessary layout transitions)
+	// in order to minimize the number of barriers, we place one shared(among different images) barrier per lvl. This should also allow the blit of separate images to run in parallel
+	FrameArenaScope scratch;
+	std::pmr::vector<vk::ImageBarrier> imgBarriers(&scratch.arena);
+	imgBarriers.reserve(numGenerateMipChains);
+	for (u8 invLevel = maxLevels-1; invLevel; invLevel--) {
+		// transition to transferRead layout
+		imgBarriers.resize(0);
+		for (size_t i = 0; i < procs.size(); i++) {
+			const auto& proc = procs[i];
+			const auto& imgInfo = proc.img.getInfo();
+			const u8 numMips = imgInfo.numMips;
+			if (proc.lastChunk && proc.generateMipChain && invLevel < numMips) {
+				const u8 lvl = numMips - invLevel - 1;
+				const vk::Image imgVk = proc.img.getHandle();
+
+				imgBarriers.push_back(vk::ImageBarrier{
+					.srcAccess = vk::AccessFlags::transferWrite,
+					.dstAccess = vk::AccessFlags::transferRead,
+					.srcLayout = vk::ImageLayout::transferDst,
+					.dstLayout = vk::ImageLayout::transferSrc,
+					.image = RU.device.getVkHandle(imgVk),
+					.subresourceRange = {
+						.baseMip = lvl,
+						.numLayers = imgInfo.getNumLayers(),
+					},
+				});
+			}
+		}
+		const vk::PipelineBarrier pipelineBarrier = {
+			.srcStages = vk::PipelineStages::transfer,
+			.dstStages = vk::PipelineStages::transfer,
+			.imageBarriers = imgBarriers
+		};
+		cmdBuffer.cmd_pipelineBarrier(pipelineBarrier);
+
+		// blit!
+		for (size_t i = 0; i < procs.size(); i++) {
+			const auto& proc = procs[i];
+			const auto& imgInfo = proc.img.getInfo();
+			const u8 numMips = imgInfo.numMips;
+			if (proc.lastChunk && proc.generateMipChain && invLevel < numMips) {
+				const u8 lvl = numMips - invLevel - 1;
+				const vk::Image imgVk = proc.img.getHandle();
+
+				cmdBuffer.cmd_blitToNextMip(RU.device, imgVk, lvl);
+			}
+		}
+	}
+
+	// transtion to shaderRead layout
+	imgBarriers.resize(0);
+	for (size_t i = 0; i < procs.size(); i++) {
+		const auto& proc = procs[i];
+		if (proc.lastChunk) {
+			const auto& imgInfo = proc.img.getInfo();
+			const u8 numMips = imgInfo.numMips;
+			const vk::Image imgVk = proc.img.getHandle();
+
+			if (!proc.generateMipChain) {
+				// all the levels are in the transferDst layout
+				imgBarriers.push_back(vk::ImageBarrier{
+					.srcAccess = vk::AccessFlags::transferWrite,
+					.dstAccess = vk::AccessFlags::shaderRead,
+					.srcLayout = vk::ImageLayout::transferDst,
+					.dstLayout = vk::ImageLayout::shaderReadOnly,
+					.image = RU.device.getVkHandle(imgVk),
+					.subresourceRange = {
+						.baseMip = 0,
+						.numMips = numMips,
+						.numLayers = imgInfo.getNumLayers(),
+					},
+				});
+				continue;
+			}
+
+			// most levels are in the transferSrc layout...
+			if (numMips > 1) {
+				imgBarriers.push_back(vk::ImageBarrier{
+					.srcAccess = vk::AccessFlags::transferRead,
+					.dstAccess = vk::AccessFlags::shaderRead,
+					.srcLayout = vk::ImageLayout::transferSrc,
+					.dstLayout = vk::ImageLayout::shaderReadOnly,
+					.image = RU.device.getVkHandle(imgVk),
+					.subresourceRange = {
+						.baseMip = 0,
+						.numMips = numMips - 1u,
+						.numLayers = imgInfo.getNumLayers(),
+					},
+				});
+			}
+
+			// ...but the smallest one is in the transferDst layout
+			imgBarriers.push_back(vk::ImageBarrier{
+				.srcAccess = vk::AccessFlags::transferWrite,
+				.dstAccess = vk::AccessFlags::shaderRead,
+				.srcLayout = vk::ImageLayout::transferDst,
+				.dstLayout = vk::ImageLayout::shaderReadOnly,
+				.image = RU.device.getVkHandle(imgVk),
+				.subresourceRange = {
+					.baseMip = numMips - 1u,
+					.numMips = 1,
+					.numLayers = imgInfo.getNumLayers(),
+				},
+			});
+		}
+	}
+	if (imgBarriers.size()) {
+		cmdBuffer.cmd_pipelineBarrier({
+			.srcStages = vk::PipelineStages::transfer,
+			.dstStages = vk::PipelineStages::fragmentShader, // assuming that images are just needed in the frament shader
+			.memoryBarriers = {},
+			.bufferBarriers = {},
+			.imageBarriers = imgBarriers,
+		});
+	}
+}
+
+// creates the real images of the decoded files, and swaps in the ones that have been uploaded
+static void imageLoader_update()
+{
+	auto& L = RU.imageLoader;
+	if (L.loading.empty())
+		return;
+
+	std::vector<RenderUniverse::ImageLoader::Decoded> decoded;
+	{
+		std::lock_guard lock(L.mutex);
+		std::swap(decoded, L.decoded);
+	}
+	for (auto& d : decoded) {
+		auto it = std::find_if(L.loading.begin(), L.loading.end(), [&d](const auto& x) { return x.img.id == d.img; });
+		assert(it != L.loading.end());
+		if (d.isTextureFile) {
+			const auto& tex = d.textureFile;
+			const bool isCompressed = vk::formatIsCompressed(tex.format);
+			if (tex.format == vk::Format::undefined) {
+				printf("Error loading image (%s)\n", it->path.c_str()); // the reason has been printed by the parser
+				L.loading.erase(it);
+				continue;
+			}
+			if (isCompressed && !(tex.format <= vk::Format::COMPR_BC7_SRGB && RU.device.enabledFeatures.textureCompressionBC)) {
+				printf("Error loading image (%s): the compressed format is not supported by the device\n", it->path.c_str());
+				L.loading.erase(it);
+				continue;
+			}
+			const u32 maxDimension = RU.device.physicalDevice.props.limits.maxImageDimension2D;
+			if (tex.w > maxDimension || tex.h > maxDimension) {
+				printf("Error loading image (%s): %ux%u is bigger than the maximum supported by the device (%u)\n", it->path.c_str(), tex.w, tex.h, maxDimension);
+				L.loading.erase(it);
+				continue;
+			}
+			// the mip chain can only be generated (with blits) for uncompressed formats
+			const bool generateMipChain = tex.generateMipChain && it->generateMipChain && !isCompressed;
+			const ImageInfo info = {
+				.format = it->srgb ? srgbVariantOfFormat(tex.format) : tex.format, // same as the images decoded with stb
+				.w = u16(tex.w), .h = u16(tex.h),
+				.numMips = generateMipChain ? calcNumMipsFromDimensions(tex.w, tex.h) : tex.numMips,
+			};
+			it->uploading = makeImage(info, tex.data, generateMipChain);
+			continue;
 		}
+		if (d.pixels == nullptr) {
+			printf("Error loading image (%s): %s\n", it->path.c_str(), stbi_failure_reason());
+			L.loading.erase(it); // it will stay bound to the placeholder
+			continue;
+		}
+		const ImageInfo info = {
+			.format = it->srgb ? vk::Format::RGBA8_SRGB : vk::Format::RGBA8_UNORM,
+			.w = u16(d.w), .h = u16(d.h),
+			.numMips = calcNumMipsFromDimensions(u32(d.w), u32(d.h)),
+		};
+		it->uploading = makeImage(info, { d.pixels, size_t(d.w * d.h * 4) }, it->generateMipChain);
+		stbi_image_free(d.pixels); // the pixels have been copied to the staging memory
+	}
+
+	FrameArenaScope scratch;
+	std::pmr::vector<ImageViewId> replacedViews(&scratch.arena);
+	std::erase_if(L.loading, [&replacedViews](const auto& x) {
+		if (!x.uploading.id.isValid() || !x.uploading.id.isReady())
+			return false;
+
+		// the real image is moved to the entry that the user has; the temporary entry is left bound to the placeholder, so releasing it doesn't destroy anything
+		const u32 dst = x.img.id.id;
+		const u32 src = x.uploading.id.id;
+		RU.images_vk[dst] = RU.images_vk[src];
+		RU.images_info[dst] = RU.images_info[src];
+		RU.images_uploadTicket[dst] = RU.images_uploadTicket[src];
+		RU.images_vk[src] = RU.imageLoader.placeholderVk;
+
+		for (const u32 v : RU.imageViews_slots.getLiveSlots()) {
+			if (RU.imageViews_image[v].id == x.img.id) {
+				deferredDestroy_imageView(RU.imageViews_vk[v]); // could be in use by a frame in flight
+				RU.imageViews_vk[v] = RU.device.createImageView({ .image = RU.images_vk[dst] });
+				replacedViews.push_back(ImageViewId{ v });
+			}
+		}
+		return true;
+	});
+	if (replacedViews.empty())
+		return;
+
+	// update the descriptor sets that referenced the old image views
+	RU.drawPacketsEpoch++;
+	for (const auto& mgr : RU.materialManagers) {
+		if (mgr.onImageViewsReplaced)
+			mgr.onImageViewsReplaced(mgr.managerPtr, replacedViews);
+	}
+	for (auto& [descSet, tex] : RU.imgui.textures) {
+		if (std::find(replacedViews.begin(), replacedViews.end(), tex.imgView) == replacedViews.end())
+			continue;
+		if (tex.current != descSet)
+			releaseDescSet(RU.imgui.descPool, tex.current);
+		tex.current = ImGui_ImplVulkan_AddTexture(tex.sampler, RU.device.getVkHandle(tex.imgView.getHandle()), tex.layout);
 	}
 }
 
+// submits the uploads recorded in the transfer queue since the last frame. The ownership of the resources is released to the graphics queue
+static void transfer_submitBatch()
+{
+	auto& T = RU.transfer;
+	auto& S = T.stream;
+	staging_processPendingUploads(S);
+	S.budgetUsedThisFrame = 0;
+
+	// the image copies are only recorded here, and the buffers of empty uploads still need their ownership released, so they also need a batch
+	if (!T.recording && (S.imageProcs.size() || S.completedBuffers.size()))
+		staging_getCmdBuffer(S);
+
+	if (!T.recording) {
+		// nothing to submit: the buffers to destroy, and the uploads without any data, can go with the last batch in flight
+		if (T.inFlight.size()) {
+			auto& lastBatch = T.inFlight.back();
+			lastBatch.buffersToDestroy.insert(lastBatch.buffersToDestroy.end(), T.buffersToDestroy.begin(), T.buffersToDestroy.end());
+			lastBatch.lastTicket = S.recordedTicket;
+		}
+		else {
+			for (vk::Buffer buffer : T.buffersToDestroy)
+				deferredDestroy(RU.toDestroy.buffers, RU.toDestroy.buffersTmp, buffer);
+			S.readyTicket = S.recordedTicket;
+		}
+		T.buffersToDestroy.clear();
+		return;
+	}
+
+	if (S.usedThisBatch)
+		RU.device.flushBuffer(S.buffer);
+
+	auto& cmdBuffer = T.cmdBuffer;
+	staging_recordImageCopies(cmdBuffer, S.imageProcs);
+
+	// release the completed resources
+	std::vector<ImageStagingProc> completedImages;
+	for (const auto& proc : S.imageProcs) {
+		if (proc.lastChunk)
+			completedImages.push_back(proc);
+	}
+	FrameArenaScope scratch;
+	std::pmr::vector<vk::BufferBarrier> bufferBarriers(S.completedBuffers.size(), &scratch.arena);
+	for (size_t i = 0; i < S.completedBuffers.size(); i++) {
+		bufferBarriers[i] = {
+			.srcAccess = vk::AccessFlags::transferWrite,
+			.srcQueueFamily = T.queueFamily,
+			.dstQueueFamily = RU.queueFamily,
+			.buffer = RU.device.getVkHandle(S.completedBuffers[i]),
+		};
+	}
+	std::pmr::vector<vk::ImageBarrier> imageBarriers(completedImages.size(), &scratch.arena);
+	for (size_t i = 0; i < completedImages.size(); i++) {
+		const auto& imgInfo = completedImages[i].img.getInfo();
+		imageBarriers[i] = {
+			.srcAccess = vk::AccessFlags::transferWrite,
+			.srcLayout = vk::ImageLayout::transferDst,
+			.dstLayout = vk::ImageLayout::transferDst,
+			.srcQueueFamily = T.queueFamily,
+			.dstQueueFamily = RU.queueFamily,
+			.image = RU.device.getVkHandle(completedImages[i].img.getHandle()),
+			.subresourceRange = {
+				.numMips = imgInfo.numMips,
+				.numLayers = imgInfo.getNumLayers(),
+			},
+		};
+	}
+	if (bufferBarriers.size() || imageBarriers.size()) {
+		cmdBuffer.cmd_pipelineBarrier({
+			.srcStages = vk::PipelineStages::transfer,
+			.dstStages = vk::PipelineStages::bottomOfPipe, // ignored for the release
+			.bufferBarriers = bufferBarriers,
+			.imageBarriers = imageBarriers,
+		});
+	}
+	cmdBuffer.end();
+
+	T.timelineValue++;
+	RU.device.submit(T.queue, {
+		vk::SubmitInfo {
+			.cmdBuffers = {&cmdBuffer, 1},
+			.signalSemaphores = {&T.timeline, 1},
+			.signalSemaphoreValues = {&T.timelineValue, 1},
+		},
+	});
+
+	T.inFlight.push_back(TransferBatch{
+		.timelineValue = T.timelineValue,
+		.cmdBuffer = cmdBuffer,
+		.stagingBuffer = S.buffer,
+		.stagingBytes = S.usedThisBatch,
+		.lastTicket = S.recordedTicket,
+		.buffers = std::move(S.completedBuffers),
+		.images = std::move(completedImages),
+		.imageRefs = std::move(T.imageRefs),
+		.buffersToDestroy = std::move(T.buffersToDestroy),
+	});
+	S.completedBuffers.clear();
+	S.imageProcs.resize(0);
+	S.usedThisBatch = 0;
+	T.imageRefs.clear();
+	T.buffersToDestroy.clear();
+	T.recording = false;
+}
+
+// the resources of the batches finished by the transfer queue are acquired by the graphics queue, and the images are finalized.
+// Returns the timeline value the graphics submission needs to wait for (0 if none)
+static u64 transfer_acquireFinishedBatches(vk::CmdBuffer& cmdBuffer)
+{
+	auto& T = RU.transfer;
+	auto& S = T.stream;
+	if (T.inFlight.empty())
+		return 0;
+
+	const u64 finishedValue = RU.device.getTimelineSemaphoreValue(T.timeline);
+	u64 waitValue = 0;
+	FrameArenaScope scratch;
+	std::pmr::vector<vk::BufferBarrier> bufferBarriers(&scratch.arena);
+	std::pmr::vector<vk::ImageBarrier> imageBarriers(&scratch.arena);
+	std::pmr::vector<ImageStagingProc> images(&scratch.arena);
+	std::pmr::vector<ImageRC> imageRefs(&scratch.arena); // keep the images alive until they are finalized
+	vk::PipelineStages dstStages = vk::PipelineStages::none; // the stages that consume the acquired resources
+	while (T.inFlight.size() && T.inFlight.front().timelineValue <= finishedValue) {
+		auto& batch = T.inFlight.front();
+		for (vk::Buffer buffer : batch.buffers) {
+			const vk::BufferUsage usage = RU.device.getBufferUsage(buffer);
+			vk::PipelineStages stages = vk::PipelineStages::none;
+			vk::AccessFlags access = vk::AccessFlags::none;
+			if ((usage & (vk::BufferUsage::vertexBuffer | vk::BufferUsage::indexBuffer)) != vk::BufferUsage{}) {
+				stages |= vk::PipelineStages::vertexInput;
+				access |= vk::AccessFlags::vertexAttributeRead | vk::AccessFlags::indexRead;
+			}
+			if ((usage & (vk::BufferUsage::uniformBuffer | vk::BufferUsage::storageBuffer)) != vk::BufferUsage{}) {
+				stages |= vk::PipelineStages::vertexShader | vk::PipelineStages::fragmentShader;
+				access |= vk::AccessFlags::uniformRead | vk::AccessFlags::shaderRead;
+			}
+			dstStages |= stages == vk::PipelineStages::none ? vk::PipelineStages::transfer : stages;
+			bufferBarriers.push_back({
+				.dstAccess = access,
+				.srcQueueFamily = T.queueFamily,
+				.dstQueueFamily = RU.queueFamily,
+				.buffer = RU.device.getVkHandle(buffer),
+			});
+		}
+		for (const auto& proc : batch.images) {
+			const auto& imgInfo = proc.img.getInfo();
+			dstStages |= vk::PipelineStages::transfer; // consumed by the finalization (mip blits and the transition to shaderReadOnly), whose barriers chain from the transfer stage
+			imageBarriers.push_back({
+				.dstAccess = vk::AccessFlags::transferRead | vk::AccessFlags::transferWrite,
+				.srcLayout = vk::ImageLayout::transferDst,
+				.dstLayout = vk::ImageLayout::transferDst,
+				.srcQueueFamily = T.queueFamily,
+				.dstQueueFamily = RU.queueFamily,
+				.image = RU.device.getVkHandle(proc.img.getHandle()),
+				.subresourceRange = {
+					.numMips = imgInfo.numMips,
+					.numLayers = imgInfo.getNumLayers(),
+				},
+			});
+		}
+		images.insert(images.end(), batch.images.begin(), batch.images.end());
+		imageRefs.insert(imageRefs.end(), batch.imageRefs.begin(), batch.imageRefs.end());
+
+		if (batch.stagingBuffer.id == S.buffer.id) // otherwise, the ring has been replaced in the meantime
+			S.used -= batch.stagingBytes;
+		for (vk::Buffer buffer : batch.buffersToDestroy)
+			deferredDestroy(RU.toDestroy.buffers, RU.toDestroy.buffersTmp, buffer);
+		T.freeCmdBuffers.push_back(batch.cmdBuffer);
+		S.readyTicket = batch.lastTicket;
+		waitValue = T.acquiredTimelineValue = batch.timelineValue;
+		T.inFlight.pop_front();
+	}
+
+	if (bufferBarriers.size() || imageBarriers.size()) {
+		cmdBuffer.cmd_pipelineBarrier({
+			.srcStages = vk::PipelineStages::transfer,
+			.dstStages = dstStages,
+			.bufferBarriers = bufferBarriers,
+			.imageBarriers = imageBarriers,
+		});
+	}
+	staging_recordImagesFinalization(cmdBuffer, images);
+	return waitValue;
+}
+
 void prepareDraw()
 {
+	TK_PROFILE_SCOPE;
 	if (RU.screenW != RU.oldScreenW || RU.screenH != RU.oldScreenH) {
 		// detect window resize -> recreate the swapchain
 		RU.device.waitIdle();
-		vk::createSwapchainSyncHelper(RU.swapchain, RU.surface, RU.device, RU.swapchainOptions);
+		createSwapchain();
 		for (u32 i = 0; i < RU.swapchain.numImages; i++) {
 			RU.device.destroyImage(RU.depthStencilImages[i]);
 			RU.device.destroyImageView(RU.depthStencilImageViews[i]);
@@ -1902,16 +3840,19 @@ void draw(
 	CSpan<RenderTargetWorldViewports> renderTargetsViewports
 )
 {
-	ZoneScoped;
+	TK_PROFILE_SCOPE;
+	TK_PERF_SCOPE("draw");
 	RU.swapchain.waitCanStartFrame(RU.device);
 
-	const auto mainQueue = RU.device.queues[0][0];
+	const auto mainQueue = RU.device.queues[RU.queueFamily][0];
 	const u32 scImgInd = RU.swapchain.imgInd;
 
 	// destroy resources that had been scheduled
-	auto handleDeferredDestroys = [scImgInd](auto& frames, auto& tmp, auto destroyFn) {
+	auto& stats = RU.stats.current;
+	auto handleDeferredDestroys = [scImgInd, &stats](auto& frames, auto& tmp, auto destroyFn) {
 		for (auto& x : frames[scImgInd])
 			destroyFn(x);
+		stats.deferredDestroys += u32(frames[scImgInd].size());
 		frames[scImgInd].clear();
 		std::swap(frames[scImgInd], tmp);
 	};
@@ -1919,18 +3860,30 @@ void draw(
 	handleDeferredDestroys(RU.toDestroy.framebuffers, RU.toDestroy.framebuffersTmp, [](auto x) { RU.device.destroyFramebuffer(x); });
 	handleDeferredDestroys(RU.toDestroy.imageViews, RU.toDestroy.imageViewsTmp, [](auto x) { RU.device.destroyImageView(x); });
 	handleDeferredDestroys(RU.toDestroy.images, RU.toDestroy.imagesTmp, [](auto x) { RU.device.destroyImage(x); });
+	handleDeferredDestroys(RU.toDestroy.bindlessTextureSlots, RU.toDestroy.bindlessTextureSlotsTmp, [](u32 slot) { RU.bindlessTextures.freeSlots.push_back(slot); });
+	handleDeferredDestroys(RU.toDestroy.materials, RU.toDestroy.materialsTmp, [](MaterialId id) {
+		const auto& mgr = RU.materialManagers[id.manager.id];
+		mgr.destroyMaterial(mgr.managerPtr, id);
+	});
 	for (size_t poolI = 0; poolI < RU.toDestroy.descSets.size(); poolI++) {
-		const auto& pool = RU.descPools[poolI];
 		auto& descSets = RU.toDestroy.descSets[poolI][scImgInd];
 		auto& descSetsTmp = RU.toDestroy.descSetsTmp[poolI];
 		if (descSets.size()) {
-			RU.device.freeDescriptorSets(pool, descSets);
+			descPool_freeSets(u32(poolI), descSets);
+			stats.deferredDestroys += u32(descSets.size());
 			descSets.clear();
 		}
 		std::swap(descSets, descSetsTmp);
 	}
 	RU.toDestroy.pushToTmp = false;
 
+	trimRenderTargetPool();
+	imageLoader_update();
+
+	// the staging memory used by this frame's previous submission can be reused now
+	RU.staging.used -= RU.staging.usedByFrame[scImgInd];
+	RU.staging.usedByFrame[scImgInd] = 0;
+
 	auto& framebuffer = RU.framebuffers[scImgInd];
 	if (!framebuffer) {
 		RU.depthStencilImages[scImgInd] = RU.device.createImage({
@@ -1938,7 +3891,7 @@ void draw(
 			.format = RU.depthStencilFormat,
 			.numSamples = RU.msaa,
 			.usage = vk::ImageUsage::default_framebuffer(false, false),
-		});
+		}, mem::Tag::renderTargets);
 		RU.depthStencilImageViews[scImgInd] = RU.device.createImageView({ .image = RU.depthStencilImages[scImgInd]	});
 
 		const vk::ImageView attachments[] = {
@@ -1952,175 +3905,122 @@ void draw(
 		});
 	}
 
-	// flush staging buffers
-	for (const auto& sb : RU.spareStagingBuffers) {
-		if (sb.offset)
-			RU.device.flushBuffer(sb.buffer);
+	// the material parameters that changed since the last frame
+	for (const auto& mgr : RU.materialManagers) {
+		if (mgr.uploadChanges)
+			mgr.uploadChanges(mgr.managerPtr);
 	}
 
+	// continue the uploads that didn't fit in previous frames, and flush the staging ring
+	staging_processPendingUploads(RU.staging);
+	if (RU.staging.usedThisBatch)
+		RU.device.flushBuffer(RU.staging.buffer);
+	RU.staging.readyTicket = RU.staging.recordedTicket; // the staging cmd buffer is executed before the draw cmd buffer
+
 	auto& cmdBuffer_staging = getCurrentStagingCmdBuffer();
+
+	// async uploads
+	u64 transferWaitValue = 0;
+	if (RU.transfer.enabled) {
+		transfer_submitBatch();
+		transferWaitValue = transfer_acquireFinishedBatches(cmdBuffer_staging);
+	}
 	auto& cmdBuffer_draw = RU.cmdBuffers_draw[scImgInd];
 	cmdBuffer_draw.begin(vk::CmdBufferUsageFlags{ .oneTimeSubmit = true });
+	gpuTimings_beginFrame(cmdBuffer_draw);
+
+	// frame graph: declare the passes, and the resources they access, so the barriers between them can be computed
+	auto& fg = RU.frameGraph;
+	fg.clear();
+
+	// the buffers written by the staging cmd buffer. The image uploads do their own layout transitions
+	const FgResource fgStagedBuffers = fg.importMemory(RU.staging.overwritesBuffersInUse ? FgAccess::shaderUniformRead : FgAccess::COUNT);
+	const vk::BufferUsage stagedUsage = RU.staging.dstBufferUsage;
+	RU.staging.dstBufferUsage = {};
+	RU.staging.overwritesBuffersInUse = false;
+	auto useStagedBuffers = [&]() {
+		if ((stagedUsage & (vk::BufferUsage::vertexBuffer | vk::BufferUsage::indexBuffer)) != vk::BufferUsage{})
+			fg.use(fgStagedBuffers, FgAccess::vertexInputRead);
+		if ((stagedUsage & (vk::BufferUsage::uniformBuffer | vk::BufferUsage::storageBuffer)) != vk::BufferUsage{})
+			fg.use(fgStagedBuffers, FgAccess::shaderUniformRead);
+	};
 
-	// staging to buffers
-	const vk::MemoryBarrier stagingMemoryBarriers[] = { {
-		.srcAccess = vk::AccessFlags::transferWrite,
-		.dstAccess = vk::AccessFlags::vertexAttributeRead | vk::AccessFlags::indexRead | vk::AccessFlags::shaderRead,
-	} };
-	cmdBuffer_staging.cmd_pipelineBarrier({
-		.srcStages = vk::PipelineStages::transfer,
-		.dstStages = vk::PipelineStages::allCmds, // TODO: keep trach of what kind of destination resources have been staged and build a proper mask. Also, if there hasn't been any staging operation, we can avoid putting the barrier
-		.dependencyFlags = vk::DependencyFlags::none,
-		.memoryBarriers = stagingMemoryBarriers,
-		.bufferBarriers = {},
-		.imageBarriers = {}, // TODO
-	});
+	// the depth memory of the render targets was written by the previous frames
+	RU.frameGraph_depthMemories.resize(RU.transientDepthMemories.size());
+	for (auto& fgMem : RU.frameGraph_depthMemories)
+		fgMem = fg.importMemory(FgAccess::depthAttachmentWrite);
 
-	// staging to images
-	if (const size_t N = RU.images_stagingProcs.size(); N != 0) {
-		// - images to transferDst layout
-		std::vector<vk::Image> images(N);
-		for (size_t i = 0; i < N; i++) {
-			const auto& proc = RU.images_stagingProcs[i];
-			images[i] = proc.img.getHandle();
-		}
-		cmdBuffer_staging.cmd_pipelineBarrier_imagesToTransferDstLayout(RU.device, images);
-
-		// copy data to images
-		for (size_t i = 0; i < N; i++) {
-			const auto& proc = RU.images_stagingProcs[i];
-			cmdBuffer_staging.cmd_copy(proc.stagingBuffer, proc.img.getHandle(), RU.device, proc.stagingBufferOffset);
-		}
-
-		u8 maxLevels = 1;
-		u32 numGenerateMipChains = 0;
-		for (const auto& proc : RU.images_stagingProcs) {
-			if (proc.generateMipChain) {
-				maxLevels = glm::max(proc.img.getInfo().numMips, maxLevels);
-				numGenerateMipChains++;
-			}
-		}
+	const u32 stagingPass = fg.addPass("staging", cmdBuffer_staging);
+	if (stagedUsage != vk::BufferUsage{})
+		fg.use(fgStagedBuffers, FgAccess::transferWrite);
 
-		// generate the mipchain with blit operations (and the necessary layout transitions)
-		// in order to minimize the number of barriers, we place one shared(among different images) barrier per lvl. This should also allow the blit of separate images to run in parallel
-		std::vector<vk::ImageBarrier> imgBarriers;
-		imgBarriers.reserve(numGenerateMipChains);
-		for (u8 invLevel = maxLevels-1; invLevel; invLevel--) {
-			// transition to transferRead layout
-			imgBarriers.resize(0);
-			for (size_t i = 0; i < RU.images_stagingProcs.size(); i++) {
-				const auto& proc = RU.images_stagingProcs[i];
-				const auto& imgInfo = proc.img.getInfo();
-				const u8 numMips = imgInfo.numMips;
-				if (proc.generateMipChain && invLevel <= numMips) {
-					const u8 lvl = numMips - invLevel - 1;
-					const vk::Image imgVk = proc.img.getHandle();
-
-					imgBarriers.push_back(vk::ImageBarrier{
-						.srcAccess = vk::AccessFlags::transferWrite,
-						.dstAccess = vk::AccessFlags::transferRead,
-						.srcLayout = vk::ImageLayout::transferDst,
-						.dstLayout = vk::ImageLayout::transferSrc,
-						.image = RU.device.getVkHandle(imgVk),
-						.subresourceRange = {
-							.baseMip = lvl,
-							.numLayers = imgInfo.getNumLayers(),
-						},
-					});
-				}
-			}
-			const vk::PipelineBarrier pipelineBarrier = {
-				.srcStages = vk::PipelineStages::transfer,
-				.dstStages = vk::PipelineStages::transfer,
-				.imageBarriers = imgBarriers
-			};
-			cmdBuffer_staging.cmd_pipelineBarrier(pipelineBarrier);
-
-			// blit!
-			for (size_t i = 0; i < RU.images_stagingProcs.size(); i++) {
-				const auto& proc = RU.images_stagingProcs[i];
-				const auto& imgInfo = proc.img.getInfo();
-				const u8 numMips = imgInfo.numMips;
-				if (proc.generateMipChain && invLevel <= numMips) {
-					const u8 lvl = numMips - invLevel - 1;
-					const vk::Image imgVk = proc.img.getHandle();
-
-					cmdBuffer_staging.cmd_blitToNextMip(RU.device, imgVk, lvl);
-				}
+	auto& rtPasses = RU.frameGraph_renderTargetPasses;
+	rtPasses.clear();
+	for (u32 rtvI = 0; rtvI < u32(renderTargetsViewports.size()); rtvI++) {
+		auto& rt = RU.renderTargets[renderTargetsViewports[rtvI].renderTarget.id];
+		if (!rt.autoRedraw) {
+			if (rt.needRedraw == 0) {
+				stats.renderTargetsSkipped++;
+				continue;
 			}
+			else if (rt.needRedraw == u8(-1))
+				rt.needRedraw = rt.numColorBuffers;
+
+			rt.needRedraw--;
 		}
 
-		// transtion to shaderRead layout
-		imgBarriers.resize(0);
-		for (size_t i = 0; i < RU.images_stagingProcs.size(); i++) {
-			const auto& proc = RU.images_stagingProcs[i];
-			if (proc.generateMipChain) {
-				const auto& imgInfo = proc.img.getInfo();
-				const u8 numMips = imgInfo.numMips;
-				const vk::Image imgVk = proc.img.getHandle();
+		stats.renderTargetsDrawn++;
+		const u32 passInd = fg.addPass("renderTarget", cmdBuffer_draw);
+		useStagedBuffers();
+		// the render pass discards the previous contents, and leaves the color buffer ready to be sampled.
+		// When there is a single color buffer, the previous frame could still be sampling it
+		const FgResource colorMemory = rt.numColorBuffers == 1 ? fg.importMemory(FgAccess::shaderSampledRead) : FgResource{};
+		const FgResource color = fg.importImage(RU.device.getVkHandle(rt.colorBuffer[rt.colorInd(scImgInd)]), vk::ImageAspects::color, vk::ImageLayout::shaderReadOnly, colorMemory);
+		fg.use(color, FgAccess::colorAttachmentWrite, vk::ImageLayout::shaderReadOnly);
+		const FgResource depthMemory = rt.depthMemory != u32(-1) ?
+			RU.frameGraph_depthMemories[rt.depthMemory] : fg.importMemory(FgAccess::depthAttachmentWrite);
+		const FgResource depth = fg.importImage(RU.device.getVkHandle(rt.depthBuffer), vk::ImageAspects::depth, vk::ImageLayout::undefined, depthMemory);
+		fg.use(depth, FgAccess::depthAttachmentWrite);
+		rtPasses.push_back({ rtvI, passInd, color });
+	}
 
-				// most levels are in the transferSrc layout...
-				if (numMips > 1) {
-					imgBarriers.push_back(vk::ImageBarrier{
-						.srcAccess = vk::AccessFlags::transferRead,
-						.dstAccess = vk::AccessFlags::shaderRead,
-						.srcLayout = vk::ImageLayout::transferSrc,
-						.dstLayout = vk::ImageLayout::shaderReadOnly,
-						.image = RU.device.getVkHandle(imgVk),
-						.subresourceRange = {
-							.baseMip = 0,
-							.numMips = numMips - 1u,
-							.numLayers = imgInfo.getNumLayers(),
-						},
-					});
-				}
+	// the swapchain image and the main depth buffer are synchronized with the imageAvailable semaphore
+	const u32 mainPass = fg.addPass("main", cmdBuffer_draw);
+	useStagedBuffers();
+	for (const auto& rtPass : rtPasses)
+		fg.use(rtPass.color, FgAccess::shaderSampledRead); // the render targets can be displayed with ImGui
+
+	// headless: copy the frame to CPU memory
+	const bool readback = RU.headless.enabled && RU.headless.readbackEnabled;
+	u32 readbackPass = u32(-1);
+	if (readback) {
+		const FgResource scImage = fg.importImage(RU.device.getVkHandle(RU.swapchain.images[scImgInd]), vk::ImageAspects::color, vk::ImageLayout::undefined);
+		fg.use(scImage, FgAccess::colorAttachmentWrite, vk::ImageLayout::transferSrc);
+		readbackPass = fg.addPass("readback", cmdBuffer_draw);
+		fg.use(scImage, FgAccess::transferRead);
+	}
 
-				// ...but the smallest one is in the transferDst layout
-				imgBarriers.push_back(vk::ImageBarrier{
-					.srcAccess = vk::AccessFlags::transferWrite,
-					.dstAccess = vk::AccessFlags::shaderRead,
-					.srcLayout = vk::ImageLayout::transferDst,
-					.dstLayout = vk::ImageLayout::shaderReadOnly,
-					.image = RU.device.getVkHandle(imgVk),
-					.subresourceRange = {
-						.baseMip = numMips - 1u,
-						.numMips = 1,
-						.numLayers = imgInfo.getNumLayers(),
-					},
-				});
-			}
-		}
-		if (imgBarriers.size()) {
-			cmdBuffer_staging.cmd_pipelineBarrier({
-				.srcStages = vk::PipelineStages::transfer,
-				.dstStages = vk::PipelineStages::fragmentShader, // assuming that images are just needed in the frament shader
-				.memoryBarriers = {},
-				.bufferBarriers = {},
-				.imageBarriers = imgBarriers,
-			});
-		}
+	fg.compile();
 
-		RU.images_stagingProcs.resize(0);
-	}
+	// staging to buffers
+	fg.recordBarriers(stagingPass);
 
+	// staging to images
+	staging_recordImageCopies(cmdBuffer_staging, RU.staging.imageProcs);
+	staging_recordImagesFinalization(cmdBuffer_staging, RU.staging.imageProcs);
+	RU.staging.imageProcs.resize(0);
+
+	if (RU.gpuTimings.enabled)
+		cmdBuffer_staging.cmd_writeTimestamp(vk::PipelineStages::bottomOfPipe, RU.gpuTimings.queryPool, gpuTimings_stagingQuery(RU.cmdBuffers_staging_ind) + 1);
 	cmdBuffer_staging.end();
 	
 	// renderTargets
-	for (u32 rtI = 0; rtI < u32(renderTargetsViewports.size()); rtI++) {
-		auto& rtv = renderTargetsViewports[rtI];
+	for (const auto& rtPass : rtPasses) {
+		auto& rtv = renderTargetsViewports[rtPass.rtvInd];
 		auto& rt = RU.renderTargets[rtv.renderTarget.id];
 
-		if (!rt.autoRedraw) {
-			if (rt.needRedraw == 0)
-				continue;
-			else if (rt.needRedraw == u8(-1))
-				rt.needRedraw = RU.swapchain.numImages;
-
-			rt.needRedraw--;
-		}
-
-		//const vk::Image attachments[] = { rt.colorBuffer[scImgInd], rt.depthBuffer[scImgInd] };
-		//cmdBuffer_draw.cmd_pipelineBarrier_imagesToColorAttachment(RU.device, attachments);
+		fg.recordBarriers(rtPass.passInd);
+		const u32 rtTimingScope = gpuTimings_begin(cmdBuffer_draw, "renderTarget", rtv.renderTarget.id);
 
 		// renderTargets - begin renderPass
 		const glm::vec4& c = rtv.clearColor;
@@ -2130,23 +4030,26 @@ void draw(
 		};
 		cmdBuffer_draw.cmd_beginRenderPass({
 			.renderPass = RU.renderPassOffscreen,
-			.framebuffer = rt.framebuffer[scImgInd],
+			.framebuffer = rt.framebuffer[rt.colorInd(scImgInd)],
 			.renderArea = {0, 0, rt.w, rt.h},
 			.clearValues = clearValues,
 		});
 
 		for (u32 viewportInd = 0; viewportInd < u32(rtv.viewports.size()); viewportInd++) {
 			const auto& viewport = rtv.viewports[viewportInd];
+			const u32 timingScope = gpuTimings_begin(cmdBuffer_draw, "viewport", viewportInd);
 			draw_renderWorld(viewport, rtv.renderTarget.id + 1, viewportInd);
+			gpuTimings_end(cmdBuffer_draw, timingScope);
 		}
 
 		// end render pass
 		cmdBuffer_draw.cmd_endRenderPass();
-
-		//cmdBuffer_draw.cmd_pipelineBarrier_images_colorAttachment_to_shaderRead(RU.device, { &rt.colorBuffer[scImgInd], 1 });
+		gpuTimings_end(cmdBuffer_draw, rtTimingScope);
 	}
 
 	// main - begin renderPass
+	fg.recordBarriers(mainPass);
+	const u32 mainTimingScope = gpuTimings_begin(cmdBuffer_draw, "main");
 	const VkClearValue clearValues[] = {
 		{.color = {.float32 = {0.1f, 0.1f, 0.1f, 0.f}}},
 		{.depthStencil = {.depth = 1.f, .stencil = 0}}
@@ -2163,59 +4066,81 @@ void draw(
 		const auto& viewport = mainViewports[viewportI];
 		const RenderWorldId renderWorldId = viewport.renderWorld;
 		RenderWorld& RW = RU.renderWorlds[renderWorldId.id];
+		const u32 timingScope = gpuTimings_begin(cmdBuffer_draw, "viewport", viewportI);
 		draw_renderWorld(viewport, /*main*/ 0, viewportI);
+		gpuTimings_end(cmdBuffer_draw, timingScope);
 	}
 
 	// imgui
 	if(RU.imgui.enabled) {
 		ImGui::Render();
 		ImDrawData* drawData = ImGui::GetDrawData();
+		if (RU.imgui.textures.size()) {
+			// the descriptor sets of the images that have been swapped in by the loader
+			for (int listI = 0; listI < drawData->CmdListsCount; listI++) {
+				for (auto& cmd : drawData->CmdLists[listI]->CmdBuffer) {
+					auto it = RU.imgui.textures.find(VkDescriptorSet(cmd.TextureId));
+					if (it != RU.imgui.textures.end())
+						cmd.TextureId = ImTextureID(it->second.current);
+				}
+			}
+		}
+		const u32 timingScope = gpuTimings_begin(cmdBuffer_draw, "imgui");
 		ImGui_ImplVulkan_RenderDrawData(drawData, cmdBuffer_draw.handle);
+		gpuTimings_end(cmdBuffer_draw, timingScope);
 	}
 	
 	// end render pass
 	cmdBuffer_draw.cmd_endRenderPass();
+	gpuTimings_end(cmdBuffer_draw, mainTimingScope);
+
+	if (RU.headless.enabled) {
+		RU.headless.lastDrawnImgInd = scImgInd;
+		RU.headless.readbackValid[scImgInd] = readback;
+		if (readback) {
+			fg.recordBarriers(readbackPass);
+			headless_recordReadback(cmdBuffer_draw, scImgInd);
+		}
+	}
 
 	// submit everything
 	cmdBuffer_draw.end();
 	{
+		// headless: there is no presentation engine to synchronize with
+		const u32 firstWaitSemaphore = RU.headless.enabled ? 1 : 0;
 		const std::tuple<VkSemaphore, vk::PipelineStages> waitSemaphores[] = {
 			{
 				RU.swapchain.semaphore_imageAvailable[RU.swapchain.imageAvailableSemaphoreInd],
 				vk::PipelineStages::colorAttachmentOutput
-			}
+			},
+			{ RU.transfer.timeline, vk::PipelineStages::transfer }, // the queue ownership acquire needs to happen after the release
 		};
+		const u64 waitSemaphoreValues[] = { 0, transferWaitValue };
+		const u32 numWaitSemaphores = transferWaitValue ? 2 : 1;
 		const vk::CmdBuffer cmdBuffers[] = { cmdBuffer_staging, cmdBuffer_draw };
 		RU.device.submit(mainQueue, {
 			vk::SubmitInfo {
-				.waitSemaphores = waitSemaphores,
+				.waitSemaphores = {waitSemaphores + firstWaitSemaphore, numWaitSemaphores - firstWaitSemaphore},
 				.cmdBuffers = cmdBuffers,
-				.signalSemaphores = {&RU.swapchain.semaphore_drawFinished[scImgInd], 1},
+				.signalSemaphores = {&RU.swapchain.semaphore_drawFinished[scImgInd], RU.headless.enabled ? 0u : 1u},
+				.waitSemaphoreValues = transferWaitValue ? CSpan<u64>(waitSemaphoreValues + firstWaitSemaphore, numWaitSemaphores - firstWaitSemaphore) : CSpan<u64>{},
 			},
 		}, RU.swapchain.fence_drawFinished[scImgInd]);
 	}
 	RU.toDestroy.pushToTmp = true;
 
-	// move staging buffers around: spareStagingBuffers <--> bussyStagingBuffers
-	{
-		// TODO: optimize?
-		static std::vector<RenderUniverse::StagingBuffer> newBussy;
-		newBussy.resize(0);
-		for (int i = int(RU.spareStagingBuffers.size()) - 1; i >= 0; i--) {
-			if (RU.spareStagingBuffers[i].offset) {
-				newBussy.push_back(RU.spareStagingBuffers[i]);
-				RU.spareStagingBuffers.erase(RU.spareStagingBuffers.begin() + i);
-			}
-		}
-
-		auto& bussy = RU.bussyStagingBuffers[scImgInd];
-		for (const auto& b : bussy)
-			RU.spareStagingBuffers.push_back(b);
-		std::swap(bussy, newBussy);
-	}
+	// the staging memory allocated since the last submit will be reclaimed when this frame is finished
+	RU.staging.usedByFrame[scImgInd] = RU.staging.usedThisBatch;
+	RU.staging.usedThisBatch = 0;
+	RU.staging.budgetUsedThisFrame = 0;
 
 	// present
 	RU.swapchain.present(mainQueue);
+	RU.frameCounter++;
+
+	RU.stats.last = RU.stats.current;
+	RU.stats.current = {};
+	frameArenas_nextFrame();
 
 	begingStagingCmdRecordingForNextFrame();
 }
@@ -2223,7 +4148,12 @@ void draw(
 // --- imgui ---
 VkDescriptorSet createImGuiTextureDescSet(VkSampler sampler, ImageViewId imgView, VkImageLayout layout)
 {
-	return ImGui_ImplVulkan_AddTexture(sampler, VkImageView(imgView.getInternalHandle()), layout);
+	const VkDescriptorSet descSet = ImGui_ImplVulkan_AddTexture(sampler, VkImageView(imgView.getInternalHandle()), layout);
+	if (!imgView.getImage().id.isLoaded()) {
+		// we will need to replace it when the image is loaded
+		RU.imgui.textures[descSet] = { sampler, imgView, layout, descSet };
+	}
+	return descSet;
 }
 
 
@@ -2237,5 +4167,93 @@ void imgui_newFrame()
 	ImGui::NewFrame();
 }
 
+void imgui_frameStatsOverlay()
+{
+	if (!RU.imgui.enabled)
+		return;
+
+	const auto& stats = RU.stats.last;
+	ImGui::SetNextWindowBgAlpha(0.7f);
+	ImGui::Begin("Frame stats", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav);
+	ImGui::Text("draw calls: %u", stats.drawCalls);
+	ImGui::Text("instances: %u", stats.instances);
+	ImGui::Text("triangles: %llu", (unsigned long long)stats.triangles);
+	ImGui::Text("objects not ready: %u", stats.objectsNotReady);
+	ImGui::Separator();
+	ImGui::Text("pipeline binds: %u", stats.pipelineBinds);
+	ImGui::Text("descriptor set binds: %u", stats.descriptorSetBinds);
+	ImGui::Text("vertex buffer binds: %u", stats.vertexBufferBinds);
+	ImGui::Text("index buffer binds: %u", stats.indexBufferBinds);
+	ImGui::Separator();
+	ImGui::Text("staged: %.1f KB", double(stats.bytesStaged) / 1024);
+	ImGui::Text("instancing: %.1f KB", double(stats.bytesInstancing) / 1024);
+	ImGui::Text("deferred destroys: %u", stats.deferredDestroys);
+	ImGui::Text("render targets: %u drawn, %u skipped", stats.renderTargetsDrawn, stats.renderTargetsSkipped);
+	if (perf::isEnabled()) {
+		ImGui::Separator();
+		for (const auto& s : perf::getFrameCounters()) {
+			if (s.calls == 0)
+				continue;
+			const auto& c = s.counters;
+			ImGui::Text("%s: IPC %.2f, L1D miss %llu, LLC miss %llu, branch miss %llu", s.name, c.ipc(),
+				(unsigned long long)c[perf::Counter::l1dMisses], (unsigned long long)c[perf::Counter::llcMisses], (unsigned long long)c[perf::Counter::branchMisses]);
+		}
+	}
+	if (RU.gpuTimings.results.size()) {
+		ImGui::Separator();
+		for (const auto& t : RU.gpuTimings.results) {
+			if (t.id != u32(-1))
+				ImGui::Text("%*s%s %u: %.3f ms", int(2 * t.depth), "", t.name, t.id, t.ms);
+			else
+				ImGui::Text("%*s%s: %.3f ms", int(2 * t.depth), "", t.name, t.ms);
+		}
+	}
+	ImGui::End();
+}
+
+void imgui_memoryStats()
+{
+	if (!RU.imgui.enabled)
+		return;
+
+	ImGui::Begin("Memory");
+	if (ImGui::Button("reset peaks"))
+		mem::resetPeaks();
+	const ImGuiTableFlags tableFlags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+	if (ImGui::BeginTable("memTags", 5, tableFlags)) {
+		ImGui::TableSetupColumn("tag");
+		ImGui::TableSetupColumn("heap");
+		ImGui::TableSetupColumn("live (MB)");
+		ImGui::TableSetupColumn("peak (MB)");
+		ImGui::TableSetupColumn("budget (MB)");
+		ImGui::TableHeadersRow();
+		for (u32 tagI = 0; tagI < u32(mem::Tag::COUNT); tagI++)
+		for (u32 heapI = 0; heapI < u32(mem::Heap::COUNT); heapI++) {
+			const auto tag = mem::Tag(tagI);
+			const auto heap = mem::Heap(heapI);
+			const auto stats = mem::getStats(tag, heap);
+			if (stats.peak == 0 && stats.budget == 0)
+				continue;
+			const bool overBudget = mem::isOverBudget(tag, heap);
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(mem::toString(tag));
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(mem::toString(heap));
+			ImGui::TableNextColumn();
+			if (overBudget)
+				ImGui::TextColored({ 1, 0.3f, 0.3f, 1 }, "%.2f", double(stats.live) / (1 << 20));
+			else
+				ImGui::Text("%.2f", double(stats.live) / (1 << 20));
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", double(stats.peak) / (1 << 20));
+			ImGui::TableNextColumn();
+			if (stats.budget)
+				ImGui::Text("%.2f", double(stats.budget) / (1 << 20));
+			else
+				ImGui::TextUnformatted("-");
+		}
+		ImGui::EndTable();
+	}
+	ImGui::End();
+}
+
 }
 }
\ No newline at end of file
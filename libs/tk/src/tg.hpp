@@ -1,6 +1,8 @@
 #pragma once
 
+#include <array>
 #include "tvk.hpp"
+#include "mem_tags.hpp"
 #include "shader_compiler.hpp"
 #include "delegate.hpp"
 
@@ -82,12 +84,23 @@ struct RefCounted {
 // we need to all this at the beginning of the application
 struct InitRenderUniverseParams {
     VkInstance instance;
-    VkSurfaceKHR surface;
+    VkSurfaceKHR surface; // VK_NULL_HANDLE in headless mode
     u32 screenW, screenH;
+    // headless: no surface, the frames are rendered to a ring of "headlessNumImages" images of size screenW x screenH (RGBA8). See readBackLastFrame
+    bool headless = false;
+    u32 headlessNumImages = 2;
     bool enableImgui = false;
+    size_t stagingFrameBudget = 16u << 20u; // max bytes uploaded to the GPU per frame. Bigger uploads are split in chunks across frames
+    size_t stagingMemoryCeiling = 128u << 20u; // max size of the staging ring. The uploads that don't fit wait for future frames
+    bool asyncTransfers = true; // upload images and geoms in a dedicated transfer queue, if the device has one. The objects are not drawn until their resources are ready
+    bool bindlessMaterials = true; // all the PBR materials share one descriptor set (requires descriptor indexing, it's disabled if the device doesn't support it)
+    bool gpuTimings = true; // timestamp queries around the passes of the frame. See getFrameGpuTimings
 };
 void initRenderUniverse(const InitRenderUniverseParams& params);
 
+// can be changed at any time. For example, we might want a bigger budget while showing a loading screen
+void setStagingFrameBudget(size_t bytes);
+
 // call this when the size of the window changes
 void onWindowResized(u32 w, u32 h);
 
@@ -100,6 +113,8 @@ struct ImageId : IdU32 {
     ImageInfo getInfo()const;
     vk::Image getHandle()const;
     void* getInternalHandle()const;
+    bool isReady()const; // the data has been uploaded. Uploads can take several frames, specially in the async transfer queue
+    bool isLoaded()const; // false while getOrLoadImage() is still loading it (meanwhile, it's bound to a 1x1 placeholder)
 };
 
 void incRefCount(ImageId id);
@@ -108,7 +123,14 @@ typedef RefCounted<ImageId> ImageRC;
 
 u8 calcNumMipsFromDimensions(u32 w, u32 h);
 bool nextMipLevelDown(u32& w, u32& h); // return true when reached the 1x1 level
+size_t calcImageLevelSize(vk::Format format, u32 w, u32 h, u8 level); // in bytes, tightly packed (works for block-compressed formats)
+size_t calcImageSize(vk::Format format, u32 w, u32 h, u8 numMips); // all the levels, tightly packed
+// the data can contain just the level 0, or all the levels tightly packed (then generateRemainingMips is ignored).
+// Compressed formats can't generate mips, they must be precomputed
 ImageRC makeImage(const ImageInfo& info, CSpan<u8> data = {}, bool generateRemainingMips = true);
+// returns immediately. The file is decoded in a worker thread, and the image is swapped in when it has been uploaded.
+// The image views and descriptor sets (materials, imgui textures) that reference it are updated automatically.
+// KTX2 and DDS files are uploaded as they are (usually block-compressed, with the mip chain precomputed). If srgb is requested, their UNORM color formats are sampled as their SRGB variants
 ImageRC getOrLoadImage(Path path, bool srgb, bool generateMipChain = true);
 
 // IMAGE VIEWS
@@ -145,9 +167,10 @@ void destroyFramebuffer(FramebufferId id);
 */
 
 // DESCRIPTOR SETS
+// a chain of VkDescriptorPools of the same size. When all the pools are full, a new one is added. Empty pools are reclaimed
 struct DescPoolId : IdU32 {
     auto operator<=>(const DescPoolId& o)const { return id <=> o.id; };
-    VkDescriptorPool getHandleVk()const;
+    VkDescriptorPool getHandleVk()const; // the first pool of the chain, for APIs that allocate by themselves (ImGui). Prefer allocDescSets()
 };
 struct PoolDescSetId : IdU32 {
     auto operator<=>(const PoolDescSetId& o)const { return id <=> o.id; };
@@ -160,14 +183,16 @@ struct DescSetId {
 };
 
 struct MakeDescPool {
-    u32 maxSets = 0;
+    u32 maxSets = 0; // per pool of the chain
     struct MaxPerType {
         u32 uniformBuffers = 0;
+        u32 storageBuffers = 0;
         u32 combinedImageSamplers = 0;
     } maxPerType;
     vk::DescPoolOptions options;
 };
 DescPoolId makeDescPool(const MakeDescPool& info);
+VkResult allocDescSets(DescPoolId poolId, VkDescriptorSetLayout layout, std::span<VkDescriptorSet> descSets);
 
 void releaseDescSets(DescPoolId poolId, CSpan<VkDescriptorSet> descSets);
 inline void releaseDescSet(DescPoolId poolId, VkDescriptorSet descSet) { releaseDescSets(poolId, {&descSet, 1}); }
@@ -213,6 +238,7 @@ struct GeomId : IdU32
     static constexpr GeomId invalid() { return GeomId{ u32(-1) }; }
     const GeomInfo& getInfo()const;
     vk::Buffer getBuffer()const;
+    bool isReady()const; // the data has been uploaded
 };
 void incRefCount(GeomId id);
 void decRefCount(GeomId id);
@@ -251,6 +277,9 @@ struct MaterialId : IdU32
     VkPipeline getPipeline(GeomId geomId)const;
     VkPipelineLayout getPipelineLayout()const;
     VkDescriptorSet getDescSet()const;
+    bool isDoubleSided()const;
+    bool isReady()const; // all the resources used by the material have been uploaded
+    u32 getMaterialIndex()const; // u32(-1) if the manager is not bindless
     //vk::Buffer getBuffer(u32 binding);
     //vk::Image getImage(u32 binding);
 };
@@ -262,6 +291,7 @@ typedef RefCounted<MaterialId> MaterialRC;
     struct T##RC : MaterialRC { \
         T##RC() : MaterialRC(MaterialId(MaterialManagerId{}, u32(-1))) {} \
         T##RC(MaterialManagerId manager, u32 id = u32(-1)) : MaterialRC(MaterialId(manager, id)) {} \
+        T##Id& typedId() { return static_cast<T##Id&>(id); } \
     }
 
 struct MaterialManager {
@@ -271,6 +301,11 @@ struct MaterialManager {
     VkPipeline(*getPipeline)(void*, MaterialId, GeomId);
     VkPipelineLayout(*getPipelineLayout)(void*, MaterialId);
     VkDescriptorSet(*getDescriptorSet)(void*, MaterialId);
+    bool(*isDoubleSided)(void*, MaterialId); // the cull mode is set dynamically when supported, so it's not part of the pipeline
+    bool(*isReady)(void*, MaterialId); // can be null if the materials are always ready
+    void(*onImageViewsReplaced)(void*, CSpan<ImageViewId>); // the image views have new handles (an image loaded by getOrLoadImage has been swapped in). Can be null
+    void(*uploadChanges)(void*); // called once per frame, before drawing, for uploading the parameters that changed. Can be null
+    u32(*getMaterialIndex)(void*, MaterialId); // bindless managers: the index of the material in its storage buffer. It's passed as a u32 push constant (vertex and fragment stages, offset 0). Can be null
     //AttribLocations(*getAttibLocations)(void*, MaterialId);
 };
 u32 registerMaterialManager(const MaterialManager& backbacks);
@@ -284,6 +319,10 @@ struct PbrUniforms {
     alignas(16) glm::vec4 albedo = glm::vec4(1.f);
     float metallic = 0.f;
     float roughness = 1.f;
+    // bindless mode: slots of the textures in the big texture array
+    u32 albedoTexture = 0;
+    u32 normalTexture = 0;
+    u32 metallicRoughnessTexture = 0;
 };
 struct PbrMaterialInfo {
     glm::vec4 albedo = glm::vec4(1.f);
@@ -300,35 +339,65 @@ struct PbrMaterialId : MaterialId {
     glm::vec4 getAlbedo()const;
     float getMetallic()const;
     float getRoughness()const;
+    // the changes are uploaded once per frame, batched with the changes of other materials
+    void setAlbedo(const glm::vec4& albedo);
+    void setMetallic(float metallic);
+    void setRoughness(float roughness);
 };
 DERIVED_MATERIAL_RC(PbrMaterial);
 
 struct PbrMaterialManager {
     MaterialManagerId managerId;
-    u32 maxExpectedMaterials = 0;
+    u32 maxExpectedMaterials = 0; // not a hard limit (except in bindless mode): the uniform buffers and descriptor pools grow in pages of this size
+    // Bindless mode (InitRenderUniverseParams::bindlessMaterials): all the materials share one descriptor set. The uniforms live in a storage buffer indexed by a push constant,
+    // and the textures in a big array. The texture presence is not part of the pipeline: the missing textures use neutral defaults
+    bool bindless = false;
+    VkDescriptorSet bindlessDescSet = VK_NULL_HANDLE;
+    ImageViewRC defaultNormalTexture; // flat normal (bindless mode)
+    u32 defaultTextureSlots[2] = {}; // [white, flat normal] (bindless mode)
     DescPoolId descPool;
-    VkDescriptorSetLayout descSetLayouts[/*hasAlbedoTexture*/ 2][/*hasNormalTexture*/ 2][/*hasMetallicRoughnessTexture*/ 2] = {};
-    VkPipelineLayout pipelineLayouts[/*hasAlbedoTexture*/ 2][/*hasNormalTexture*/ 2][/*hasMetallicRoughnessTexture*/ 2] = {};
+    VkDescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
+    VkDescriptorUpdateTemplate descSetUpdateTemplate = VK_NULL_HANDLE; // writes all the bindings of a material's descriptor set in one call (not used in bindless mode)
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    // the texture presence is passed to the fragment shader as specialization constants, so we only compile one shader per vertex layout
+    vk::VertShader vertShaders[/*hasVertexNormalsOrTangents*/ 3][/*hasTexCoords*/2][/*hasVertexColors*/ 2] = {};
+    vk::FragShader fragShaders[/*hasVertexNormalsOrTangents*/ 3][/*hasTexCoords*/2][/*hasVertexColors*/ 2] = {};
     VkPipeline pipelines
         [/*hasAlbedoTexture*/ 2][/*hasNormalTexture*/ 2][/*hasMetallicRoughnessTexture*/ 2]
-        [/*hasVertexNormalsOrTangents*/ 3][/*hasTexCoords*/2][/*hasVertexColors*/ 2][/*doubleSided*/ 2] = {};
+        [/*hasVertexNormalsOrTangents*/ 3][/*hasTexCoords*/2][/*hasVertexColors*/ 2]
+        [/*doubleSided*/ 2] = {}; // doubleSided is always 0 when the cull mode is dynamic
+    ImageViewRC defaultTexture; // bound to the texture slots that the material doesn't use
 
+    SlotMap<> materials_slots;
     std::vector<PbrMaterialInfo> materials_info;
     std::vector<VkDescriptorSet> materials_descSet;
+    std::vector<PbrUniforms> materials_uniforms; // CPU copy of what we have uploaded (or will upload at the end of the frame)
+    std::vector<u32> dirtyEntries; // the entries of materials_uniforms that need to be uploaded
+    std::vector<bool> materials_uploaded; // the uniforms have been copied to the GPU at least once. Until then, the material is not ready
+    std::vector<std::array<u32, 3>> materials_textureSlots; // bindless mode: the slots owned by the material (u32(-1) when using a default texture)
     //std::vector<u32> materials_customSamplers; // shall be not null when we are not using a sampler from "defaultSamplers". When using custom samplers, we would need to delete the sampler when the material is destroyed
-    vk::Buffer uniformBuffer; // a large uniform buffer contaning the data for all materials
-    u32 materials_nextFreeEntry = -1;
+    std::vector<vk::Buffer> uniformBuffers; // pages of "maxExpectedMaterials" materials, added when needed. In bindless mode there is only one (a storage buffer)
     
-    VkDescriptorSetLayout getCreateDescriptorSetLayout(bool hasAlbedoTexture, bool hasNormalTexture, bool hasMetallicRoughnessTexture);
-    VkPipelineLayout getCreatePipelineLayout(bool hasAlbedoTexture, bool hasNormalTexture, bool hasMetallicRoughnessTexture);
+    VkDescriptorSetLayout getCreateDescriptorSetLayout();
+    VkPipelineLayout getCreatePipelineLayout();
     VkPipeline getCreatePipeline(bool hasAlbedoTexture, bool hasNormalTexture, bool hasMetallicRoughnessTexture,
         HasVertexNormalsOrTangents hasVertexNormalsOrTangents, bool hasTexCoords, bool hasVertexColors, bool doubleSided);
 
     PbrMaterialRC createMaterial(const PbrMaterialInfo& params);
+    // prefer this for creating many materials at once (e.g. importing a scene): the descriptor sets are allocated together, and the uniforms are uploaded in one copy
+    std::vector<PbrMaterialRC> createMaterials(CSpan<PbrMaterialInfo> infos);
     void destroyMaterial(MaterialId id);
     VkPipeline getPipeline(MaterialId materialId, GeomId geomId);
-    VkPipelineLayout getPipelineLayout(MaterialId materialId);
-    VkDescriptorSet getDescriptorSet(MaterialId materialId) { return materials_descSet[materialId.id]; }
+    VkPipelineLayout getPipelineLayout(MaterialId materialId) { return pipelineLayout; }
+    VkDescriptorSet getDescriptorSet(MaterialId materialId) { return bindless ? bindlessDescSet : materials_descSet[materialId.id]; }
+    bool isDoubleSided(MaterialId materialId) { return materials_info[materialId.id].doubleSided; }
+    bool isReady(MaterialId materialId);
+    void onImageViewsReplaced(CSpan<ImageViewId> imgViews);
+    u32 getMaterialIndex(MaterialId materialId) { return materialId.id; }
+    void _writeDescSet(u32 entry);
+    std::pair<vk::Buffer, size_t> _getUniformsLocation(u32 entry); // buffer page and offset
+    void uploadChanges();
+    bool _bindless_acquireTextures(u32 entry, std::vector<vk::DescriptorSetWrite>& descSetWrites); // acquires new slots for the textures of the material, and marks its uniforms as dirty. Returns false if there are no slots left
 
     static PbrMaterialManager* s_getOrCreate(u32 maxExpectedMaterials = 4 << 10);
 
@@ -342,9 +411,26 @@ struct MeshInfo {
     GeomRC geom = GeomRC{};
     MaterialRC material = MaterialRC{};
 };
+// non-owning view of a MeshInfo: it doesn't touch the refcounts, so it's cheap to use in hot loops. It must not outlive the mesh
+// (in debug builds, accessing it after the mesh has been released asserts)
+struct MeshInfoView {
+    GeomId geom()const { _check(); return _geom; }
+    MaterialId material()const { _check(); return _material; }
+
+    GeomId _geom;
+    MaterialId _material;
+#ifndef NDEBUG
+    u32 _mesh;
+    u32 _generation;
+    void _check()const;
+#else
+    void _check()const {}
+#endif
+};
 struct MeshId : IdU32
 {
-    const MeshInfo getInfo()const;
+    const MeshInfo& getInfo()const; // the reference is invalidated when new meshes are created
+    MeshInfoView getInfoView()const;
     VkPipeline getPipeline()const;
 };
 void incRefCount(MeshId id);
@@ -355,6 +441,7 @@ MeshRC makeMesh(MeshInfo&& info);
 
 // OBJECT
 struct RenderWorldId;
+struct ObjectInfoView;
 struct ObjectInfo {
     MeshRC mesh;
     u32 numInstances = 1;
@@ -367,12 +454,30 @@ struct ObjectId : IdU32 {
     ObjectId(IdU32 worldId, IdU32 id) : IdU32(id), _renderWorld(worldId) {}
     const RenderWorldId& renderWorld()const { return *(const RenderWorldId*)&_renderWorld; }
     ObjectInfo getInfo()const;
+    ObjectInfoView getInfoView()const;
     void setModelMatrix(const glm::mat4& m, u32 instanceInd = 0);
     void setModelMatrices(CSpan<glm::mat4> matrices, u32 firstInstanceInd = 0);
     bool addInstances(u32 n);
     bool changeNumInstances(u32 n);
     void destroyInstance(u32 instanceInd);
 };
+// non-owning snapshot of an ObjectInfo (see MeshInfoView). The number of instances is not updated if it changes later
+struct ObjectInfoView {
+    MeshId mesh()const { _check(); return _mesh; }
+    u32 numInstances()const { _check(); return _numInstances; }
+    u32 maxInstances()const { _check(); return _maxInstances; }
+
+    MeshId _mesh;
+    u32 _numInstances;
+    u32 _maxInstances;
+#ifndef NDEBUG
+    ObjectId _object;
+    u32 _counter;
+    void _check()const;
+#else
+    void _check()const {}
+#endif
+};
 
 // RENDER WORLDS
 struct RenderWorld;
@@ -391,15 +496,32 @@ struct RenderWorld {
         glm::mat4 modelViewProj;
         glm::mat3 invTransModelView;
     };
+    // everything needed for drawing an object, resolved in advance so the draw loop doesn't need to chase the mesh, material and geom
+    struct DrawPacket {
+        VkPipeline pipeline;
+        VkPipelineLayout pipelineLayout;
+        VkDescriptorSet materialDescSet;
+        VkBuffer geomBuffer;
+        u32 materialIndex; // u32(-1) if the material is not bindless
+        u32 attribOffsets[5]; // positions, normals, tangents, texCoords, colors. u32(-1) if not present
+        u32 indsOffset; // u32(-1) if not indexed
+        u32 numVertsOrInds;
+        bool doubleSided;
+        u32 epoch = 0; // the packet is valid while it matches the global epoch. 0 means not resolved (the resources are still being uploaded)
+    };
 
     RenderWorldId id = {};
-    std::vector<u32> objects_id_to_entry;
-    std::vector<u32> objects_entry_to_id;
-    std::vector<ObjectInfo> objects_info;
-    std::vector<u32> objects_firstModelMtx;
-    std::vector<glm::mat4> modelMatrices;
-    std::vector<ObjectMatrices> objects_matricesTmp;
-    std::vector<u32> objects_instancesCursorsTmp;
+    mem::Vector<mem::Tag::renderWorld, u32> objects_id_to_entry;
+    mem::Vector<mem::Tag::renderWorld, u32> objects_entry_to_id;
+#ifndef NDEBUG
+    mem::Vector<mem::Tag::renderWorld, u32> objects_counter; // [id] how many times the id has been released. Used for detecting ObjectInfoViews of destroyed objects
+#endif
+    mem::Vector<mem::Tag::renderWorld, ObjectInfo> objects_info;
+    mem::Vector<mem::Tag::renderWorld, DrawPacket> objects_drawPacket;
+    mem::Vector<mem::Tag::renderWorld, u32> objects_firstModelMtx;
+    mem::Vector<mem::Tag::renderWorld, glm::mat4> modelMatrices;
+    mem::Vector<mem::Tag::renderWorld, ObjectMatrices> objects_matricesTmp;
+    mem::Vector<mem::Tag::renderWorld, u32> objects_instancesCursorsTmp;
     u32 numObjects = 0;
     u32 objects_nextFreeId = u32(-1);
     bool needDefragmentObjects = false;
@@ -469,9 +591,49 @@ void draw(
     CSpan<RenderTargetWorldViewports> renderTargetsViewports
 );
 
+// GPU timings
+struct GpuTiming {
+    const char* name; // "staging", "renderTarget", "main", "viewport" or "imgui"
+    u32 id; // the render target id, or the viewport index. u32(-1) if it doesn't apply
+    u32 depth; // nesting level. For example, the viewports are inside the render pass that draws them
+    float ms;
+};
+// the timings of the last frame whose results are available (usually, a few frames behind), in the order they were recorded.
+// Empty if the device doesn't support timestamps
+CSpan<GpuTiming> getFrameGpuTimings();
+
+// render statistics
+struct FrameStats {
+    u32 drawCalls = 0;
+    u32 pipelineBinds = 0;
+    u32 descriptorSetBinds = 0;
+    u32 vertexBufferBinds = 0; // the instancing buffer and the vertex attributes
+    u32 indexBufferBinds = 0;
+    u32 objectsNotReady = 0; // skipped because their resources are still being uploaded
+    u32 instances = 0;
+    u64 triangles = 0;
+    u64 bytesStaged = 0; // copied to the staging memory since the previous frame (including the transfer queue uploads)
+    u64 bytesInstancing = 0; // written to the instancing buffers
+    u32 deferredDestroys = 0; // resources whose destruction had been deferred until no frame in flight could use them
+    u32 renderTargetsDrawn = 0;
+    u32 renderTargetsSkipped = 0; // on-demand render targets that didn't need a redraw
+};
+// the statistics of the last frame drawn. Watching the draw calls and binds per frame helps catching batching regressions
+const FrameStats& getFrameStats();
+
+// headless mode only. When enabled, the frames drawn are copied to CPU memory (which has a cost, so it's disabled by default)
+void setFrameReadback(bool enabled);
+// waits until the last drawn frame is finished, and copies its pixels (tightly packed rows). Returns false if that frame wasn't read back
+bool readBackLastFrame(std::vector<u8>& pixels);
+
 // imgui
+// if the image is still being loaded, the returned descriptor set will show the real image when it gets swapped in
 VkDescriptorSet createImGuiTextureDescSet(VkSampler sampler, ImageViewId imgView, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 void imgui_newFrame();
+// a small window with the stats of the last frame, its perf counters (if enabled) and its GPU timings. Call it between imgui_newFrame() and draw()
+void imgui_frameStatsOverlay();
+// a window with the live/peak memory of each subsystem (mem::Tag), in the CPU and GPU. The ones over budget are highlighted
+void imgui_memoryStats();
 
 }
 }
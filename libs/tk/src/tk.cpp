@@ -3,12 +3,14 @@
 #include <glm/gtx/quaternion.hpp>
 #include <imgui.h>
 #include <physfs.h>
-#include <Tracy.hpp>
+#include "profiler.hpp"
+#include "frame_arena.hpp"
 
 namespace tk {
 
 bool init(CStr argv0, CStr rootShadersPath)
 {
+    profiler::setThreadName("main");
     if (!PHYSFS_init(argv0)) {
         printf("PHYSFS_init() failed!\n  reason: %s.\n", PHYSFS_getLastError());
         return false;
@@ -58,15 +60,15 @@ EntityId EntityFactory_Renderable3d::create(const Create& info)
         gfxObjectInd = _gfxObjectInd;
         auto& gfxObject = gfxObjects[gfxObjectInd];
         tg::ObjectId oldGfxObject = gfxObject;
-        auto gfxObjectInfo = gfxObject.getInfo();
-        instanceInd = gfxObjectInfo.numInstances;
-        gfxObjectInfo.numInstances++;
-        if (gfxObjectInfo.numInstances > gfxObjectInfo.maxInstances) {
+        const auto gfxObjectInfo = gfxObject.getInfoView(); // (a view, so we don't touch the mesh refcount)
+        instanceInd = gfxObjectInfo.numInstances();
+        const u32 numInstances = instanceInd + 1;
+        if (numInstances > gfxObjectInfo.maxInstances()) {
             const u32 newMaxInstances =
-                gfxObjectInfo.numInstances > 64 ? nextPowerOf2(gfxObjectInfo.numInstances) :
-                gfxObjectInfo.numInstances > 16 ? 64 :
-                gfxObjectInfo.numInstances > 4 ? 16 : 4;
-            auto newGfxObject = system_render.RW.createObjectWithInstancing(gfxObjectInfo.mesh, gfxObjectInfo.numInstances, newMaxInstances);
+                numInstances > 64 ? nextPowerOf2(numInstances) :
+                numInstances > 16 ? 64 :
+                numInstances > 4 ? 16 : 4;
+            auto newGfxObject = system_render.RW.createObjectWithInstancing(gfx::MeshRC(gfxObjectInfo.mesh()), numInstances, newMaxInstances);
             gfxObject = newGfxObject;
             system_render.RW.destroyObject(oldGfxObject);
         }
@@ -144,7 +146,8 @@ void EntityFactory_Renderable3d::s_releaseEntitiesFn(EntityFactory* self, CSpan<
     }
 
     { // now let's find unused gfxObjects and delete them
-        std::vector<u32> useCount(factory.gfxObjects.size(), 0);
+        FrameArenaScope scratch;
+        std::pmr::vector<u32> useCount(factory.gfxObjects.size(), 0, &scratch.arena);
         for (auto& rm : factory.components_renderableMesh) {
             rm.instanceInd = useCount[rm.gfxObjectInd]++;
         }
@@ -158,7 +161,7 @@ void EntityFactory_Renderable3d::s_releaseEntitiesFn(EntityFactory* self, CSpan<
             const bool ok = factory.gfxObjects[i].changeNumInstances(useCount[i]);
             assert(ok);
         }
-        std::vector<u32> gfxObjectIndRemapping(factory.gfxObjects.size(), u32(-1));
+        std::pmr::vector<u32> gfxObjectIndRemapping(factory.gfxObjects.size(), u32(-1), &scratch.arena);
         u32 j; // we use index j to find gfxObjects with useCount != 0, then we copy from [j] to [i]
         for (j = i + 1; j < useCount.size(); j++) {
             if (useCount[j] == 0) {
@@ -211,16 +214,17 @@ System_Render::~System_Render()
 
 void System_Render::update(float dt)
 {
-    ZoneScoped;
-    for (size_t i = 0; i < factory_renderable3d->components_position3d.size(); i++) {
-        const glm::vec3& position = factory_renderable3d->components_position3d[i];
-        const glm::quat& rotation = factory_renderable3d->components_rotation3d[i];
-        const glm::vec3& scale = factory_renderable3d->components_scale3d[i];
-
-        const auto& rendMeshComp = factory_renderable3d->components_renderableMesh[i];
+    TK_PROFILE_SCOPE;
+    TK_PERF_SCOPE("System_Render::update");
+    auto& F = *factory_renderable3d;
+    FrameArenaScope scratch;
+    std::pmr::vector<glm::mat4> matrices(F.components_position3d.size(), &scratch.arena);
+    buildMtx_batch(matrices, F.components_position3d, F.components_rotation3d, F.components_scale3d);
+    for (size_t i = 0; i < matrices.size(); i++) {
+        const auto& rendMeshComp = F.components_renderableMesh[i];
         const u32 gfxObjectInd = rendMeshComp.gfxObjectInd;
-        auto& gfxObject = factory_renderable3d->gfxObjects[gfxObjectInd];
-        gfxObject.setModelMatrix(buildMtx(position, rotation, scale), rendMeshComp.instanceInd);
+        auto& gfxObject = F.gfxObjects[gfxObjectInd];
+        gfxObject.setModelMatrix(matrices[i], rendMeshComp.instanceInd);
     }
 
 #if 1
@@ -241,8 +245,8 @@ void DefaultBasicWorldSystems::destroy()
 }
 
 // -- WORLD --
+static SlotMap<> g_worlds_slots;
 static std::vector<World> g_worlds;
-static u16 g_worlds_nextFreeEntry = u16(-1);
 
 World::World()
 {
@@ -266,10 +270,12 @@ WorldId World::id()const
 
 void World::update(float dt)
 {
-    ZoneScoped;
+    TK_PROFILE_SCOPE;
+    TK_PERF_SCOPE("World::update");
     if (entitiesToDelete.size()) {
         // 1) delete the entities in the factories
-        auto sortedByType = entitiesToDelete;
+        FrameArenaScope scratch;
+        std::pmr::vector<u32> sortedByType(entitiesToDelete.begin(), entitiesToDelete.end(), &scratch.arena);
         std::sort(sortedByType.begin(), sortedByType.end(), [this](u32 a, u32 b) {
             return entities_type[a] < entities_type[b];
         });
@@ -331,40 +337,37 @@ const glm::mat4& World::getMatrix(u32 entityInd)
 
 static void assertEntityIsValidInWorld(EntityId e, const World& W)
 {
-    assert(e.world == W.id());
-    assert(e.counter == W.entities_counter[e.ind]);
+    assert(W.isAlive(e));
     assert(e.type == W.entities_type[e.ind]);
 }
 
 EntityId World::_createEntity(EntityTypeU16 entityType, u32 indInFactory, u32 parent)
 {
-    const u32 e = acquireReusableEntry(entities_nextFreeEntry,
-        entities_indInFactory, 0,
+    const u32 e = entities_slots.acquire(
+        entities_indInFactory,
         entities_type,
-        entities_parent, entities_firstChild, entities_lastChild, entities_nextSibling, entities_prevSibling
-#ifndef NDEBUG
-        , entities_counter
-#endif
-    );
+        entities_parent, entities_firstChild, entities_lastChild, entities_nextSibling, entities_prevSibling);
     entities_type[e] = entityType;
     entities_indInFactory[e] = indInFactory;
 
-    const EntityId eid = { id(), entityType, e,
-#ifndef NDEBUG
-        entities_counter[e]
-#endif
-    };
+    const EntityId eid = { id(), entityType, e, entities_slots.getGeneration(e) };
     setEntityAsLastChildOf(eid, getRootEntity());
 
     return eid;
 }
 
+bool World::isAlive(EntityId e)const
+{
+    return e.world == id() && entities_slots.isValid(e.ind, e.generation);
+}
+
 EntityId World::getRootEntity()const
 {
     return EntityId{
         .world = id().ind,
         .type = 0,
         .ind = 0,
+        .generation = entities_slots.getGeneration(0),
     };
 }
 
@@ -382,9 +385,7 @@ EntityId World::getEntityByInd(u32 ind)const
         .world = id(),
         .type = entities_type[ind],
         .ind = ind,
-#ifndef NDEBUG
-        .counter = entities_counter[ind],
-#endif
+        .generation = entities_slots.getGeneration(ind),
     };
 }
 
@@ -408,10 +409,7 @@ EntityId World::nextSibling(EntityId e)const
 
 void World::_destroyIsolatedEntity(u32 indInWorld)
 {
-#ifndef NDEBUG
-    entities_counter[indInWorld]++;
-#endif
-    releaseReusableEntry(entities_nextFreeEntry, entities_indInFactory, 0, indInWorld);
+    entities_slots.release(indInWorld);
 }
 
 void World::_breakEntityLinks(u32 ei)
@@ -495,7 +493,7 @@ DefaultBasicWorldSystems World::createDefaultBasicSystems()
 
 WorldId createWorld()
 {
-    const u16 slot = tk::acquireReusableEntry(g_worlds_nextFreeEntry, g_worlds, offsetof(World, entities_nextFreeEntry));
+    const u16 slot = u16(g_worlds_slots.acquire(g_worlds));
     return WorldId{ slot };
 }
 
@@ -503,7 +501,7 @@ void destroyWorld(WorldId worldId)
 {
     auto& W = g_worlds[worldId.ind];
     W = {};
-    tk::releaseReusableEntry(g_worlds_nextFreeEntry, g_worlds, offsetof(World, entities_nextFreeEntry), worldId.ind);
+    g_worlds_slots.release(worldId.ind);
 }
 
 World* WorldId::operator->()
@@ -520,6 +518,10 @@ bool EntityId::valid()const
 {
     return ind != u32(-1);
 }
+bool EntityId::isAlive()const
+{
+    return valid() && world->isAlive(*this);
+}
 EntityId EntityId::parent()const
 {
     return world->getParent(*this);
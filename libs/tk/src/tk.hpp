@@ -3,6 +3,7 @@
 #include "utils.hpp"
 
 #include "tg.hpp"
+#include "mem_tags.hpp"
 #include <glm/gtc/quaternion.hpp>
 
 namespace tk {
@@ -39,11 +40,10 @@ struct EntityId {
     WorldId world;
     EntityTypeU16 type;
     u32 ind = u32(-1);
-#ifndef NDEBUG
-    u32 counter;
-#endif
+    u32 generation = 0; // of the entity slot. Used for detecting ids of released entities
 
     bool valid()const;
+    bool isAlive()const; // false if the entity has been destroyed
     EntityId parent()const;
     EntityId firstChild()const;
     EntityId nextSibling()const;
@@ -145,10 +145,10 @@ struct EntityFactory_Node : EntityFactory
         return id;
     }
 
-    std::vector<u32> indsInWorld; // indInFactory -> indInWorld
-    std::vector<Component_Position3d> components_position3d; // [indInFactory]
-    std::vector<Component_Rotation3d> components_rotation3d; // [indInFactory]
-    std::vector<Component_Scale3d> components_scale3d; // [indInFactory]
+    mem::Vector<mem::Tag::ecs, u32> indsInWorld; // indInFactory -> indInWorld
+    mem::Vector<mem::Tag::ecs, Component_Position3d> components_position3d; // [indInFactory]
+    mem::Vector<mem::Tag::ecs, Component_Rotation3d> components_rotation3d; // [indInFactory]
+    mem::Vector<mem::Tag::ecs, Component_Scale3d> components_scale3d; // [indInFactory]
 
     EntityFactory_Node(WorldId world, System_Render& system_render)
         : EntityFactory(world, "Renderable3d", {}, s_releaseEntitiesFn, s_accessComponentByIndFn)
@@ -181,16 +181,16 @@ struct EntityFactory_Renderable3d : EntityFactory
 
     System_Render& system_render;
 
-    std::vector<u32> indsInWorld; // indInFactory -> indInWorld
-    std::vector<Component_Position3d> components_position3d; // [indInFactory]
-    std::vector<Component_Rotation3d> components_rotation3d; // [indInFactory]
-    std::vector<Component_Scale3d> components_scale3d; // [indInFactory]
-    std::vector<Component_RenderableMesh3d> components_renderableMesh; // [indInFactory]
+    mem::Vector<mem::Tag::ecs, u32> indsInWorld; // indInFactory -> indInWorld
+    mem::Vector<mem::Tag::ecs, Component_Position3d> components_position3d; // [indInFactory]
+    mem::Vector<mem::Tag::ecs, Component_Rotation3d> components_rotation3d; // [indInFactory]
+    mem::Vector<mem::Tag::ecs, Component_Scale3d> components_scale3d; // [indInFactory]
+    mem::Vector<mem::Tag::ecs, Component_RenderableMesh3d> components_renderableMesh; // [indInFactory]
     
-    std::vector<gfx::ObjectId> gfxObjects; // [gfxObjectInd]
+    mem::Vector<mem::Tag::ecs, gfx::ObjectId> gfxObjects; // [gfxObjectInd]
 
-    std::unordered_map<u32, u32> mesh_to_gfxObjectInd;
-    std::unordered_map<u64, u32> geomAndMaterial_to_gfxObjectInd;
+    mem::FlatHashMap<mem::Tag::ecs, u32, u32> mesh_to_gfxObjectInd;
+    mem::FlatHashMap<mem::Tag::ecs, u64, u32> geomAndMaterial_to_gfxObjectInd;
 
     EntityFactory_Renderable3d(WorldId world, System_Render& system_render)
         : EntityFactory(world, "Renderable3d", k_componentTypes, s_releaseEntitiesFn, s_accessComponentByIndFn)
@@ -258,27 +258,23 @@ struct World
     std::vector<std::unique_ptr<EntityFactory>> entityFactories; // [entityType]
     std::vector<std::string> componentNames; // (I belive the cstr pointer should keep valid if the vector resizes)
 
-    std::vector<EntityTypeU16> entities_type; // [entity.ind]
-    std::vector<u32> entities_indInFactory; // [entity.ind]
-#ifndef NDEBUG
-    std::vector<u32> entities_counter; // [entity.ind] keep track of how many times the entry has been reused. Useful for verifying if a EntityId refers to an old released entity
-#endif
+    SlotMap<> entities_slots; // the generations are used for verifying if a EntityId refers to an old released entity
+    mem::Vector<mem::Tag::ecs, EntityTypeU16> entities_type; // [entity.ind]
+    mem::Vector<mem::Tag::ecs, u32> entities_indInFactory; // [entity.ind]
 
     // entity hierarchy
-    std::vector<u32> entities_parent; // [entity.ind]
-    std::vector<u32> entities_firstChild;
-    std::vector<u32> entities_lastChild;
-    std::vector<u32> entities_nextSibling; // [entity.ind]
-    std::vector<u32> entities_prevSibling; // [entity.ind]
-
-    std::vector<glm::mat4> cachedEntityMatrices;
-    std::vector<bool> cachedEntityMatrices_isValid;
-    std::vector<u32> entitiesToDelete;
+    mem::Vector<mem::Tag::ecs, u32> entities_parent; // [entity.ind]
+    mem::Vector<mem::Tag::ecs, u32> entities_firstChild;
+    mem::Vector<mem::Tag::ecs, u32> entities_lastChild;
+    mem::Vector<mem::Tag::ecs, u32> entities_nextSibling; // [entity.ind]
+    mem::Vector<mem::Tag::ecs, u32> entities_prevSibling; // [entity.ind]
 
-    u32 entities_nextFreeEntry = u32(-1);
+    mem::Vector<mem::Tag::ecs, glm::mat4> cachedEntityMatrices;
+    mem::Vector<mem::Tag::ecs, bool> cachedEntityMatrices_isValid;
+    mem::Vector<mem::Tag::ecs, u32> entitiesToDelete;
 
     // component hierarchy
-    std::vector<std::vector<u32>> entitiesComponents; // [entityType][i]
+    mem::Vector<mem::Tag::ecs, mem::Vector<mem::Tag::ecs, u32>> entitiesComponents; // [entityType][i]
 
 
     World();
@@ -298,6 +294,7 @@ struct World
     void _destroyIsolatedEntity(u32 indInWorld); // meant to be used by EntityFactories (?)
 
     // functions querying the scene hierarchy
+    bool isAlive(EntityId e)const;
     EntityId getRootEntity()const;
     EntityId getEntityByInd(u32 ind)const;
     EntityId getParent(EntityId e)const;
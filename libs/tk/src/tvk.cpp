@@ -4,6 +4,11 @@
 #include <glm/glm.hpp>
 #include <shaderc/shaderc.h>
 
+#ifdef TVK_NULL_BACKEND
+#define TVK_NULL_REDIRECT_CALLS
+#include "tvk_null.hpp"
+#endif
+
 namespace tk {
 namespace vk {
 namespace
@@ -32,6 +37,7 @@ auto toVk(BlendOp op) { return VkBlendOp(op); }
 auto toVk(AccessFlags f) { return VkAccessFlags(f); }
 auto toVk(DescriptorType t) { return VkDescriptorType(t); }
 auto toVk(DescriptorSetLayoutCreateFlags f) { return VkDescriptorSetLayoutCreateFlags(f); }
+auto toVk(ShaderStages s) { return VkShaderStageFlags(s); }
 auto toVk(Filter f) { return VkFilter(f); }
 auto toVk(SamplerMipmapMode m) { return VkSamplerMipmapMode(m); }
 auto toVk(SamplerAddressMode m) { return VkSamplerAddressMode(m); }
@@ -123,6 +129,11 @@ std::vector<u8> loadBinaryFile(CStr fileName)
 	return data;
 }
 
+// entry points of optional features, loaded in createDevice
+PFN_vkCmdSetCullMode s_vkCmdSetCullMode = nullptr;
+PFN_vkGetSemaphoreCounterValue s_vkGetSemaphoreCounterValue = nullptr;
+PFN_vkWaitSemaphores s_vkWaitSemaphores = nullptr;
+
 } // namespace (static funcs)
 
 // -----------------------------------------------------------------------------------------
@@ -141,6 +152,36 @@ u32 PhysicalDeviceInfo::findGraphicsAndPresentQueueFamily()const {
 	return i;
 }
 
+u32 PhysicalDeviceInfo::findGraphicsQueueFamily()const {
+	const u32 n = queueFamiliesProps.size();
+	u32 i = 0;
+	for (i = 0; i < n; i++) {
+		if (queueFamiliesProps[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+			break;
+	}
+	return i;
+}
+
+u32 PhysicalDeviceInfo::findTransferOnlyQueueFamily()const
+{
+	const u32 n = queueFamiliesProps.size();
+	u32 i;
+	for (i = 0; i < n; i++) {
+		const auto flags = queueFamiliesProps[i].queueFlags;
+		if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+			break;
+	}
+	return i;
+}
+
+bool PhysicalDeviceInfo::supportsExtension(CStr name)const {
+	for (const auto& ext : extensions) {
+		if (StrView(ext.extensionName) == name)
+			return true;
+	}
+	return false;
+}
+
 void Device::waitIdle()
 {
 	ASSERT_VKRES(vkDeviceWaitIdle(device));
@@ -155,11 +196,47 @@ VkSemaphore Device::createSemaphore()
 	return semaphore;
 }
 
+VkSemaphore Device::createTimelineSemaphore(u64 initialValue)
+{
+	assert(enabledFeatures.timelineSemaphore);
+	const VkSemaphoreTypeCreateInfo typeInfo = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+		.initialValue = initialValue,
+	};
+	const VkSemaphoreCreateInfo info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = &typeInfo,
+	};
+	VkSemaphore semaphore;
+	const VkResult vkRes = vkCreateSemaphore(device, &info, nullptr, &semaphore);
+	ASSERT_VKRES(vkRes);
+	return semaphore;
+}
+
 void Device::destroySemaphore(VkSemaphore semaphore)
 {
 	vkDestroySemaphore(device, VkSemaphore(semaphore), nullptr);
 }
 
+u64 Device::getTimelineSemaphoreValue(VkSemaphore semaphore)
+{
+	u64 value;
+	ASSERT_VKRES(s_vkGetSemaphoreCounterValue(device, semaphore, &value));
+	return value;
+}
+
+void Device::waitTimelineSemaphore(VkSemaphore semaphore, u64 value, u64 timeout)
+{
+	const VkSemaphoreWaitInfo info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+		.semaphoreCount = 1,
+		.pSemaphores = &semaphore,
+		.pValues = &value,
+	};
+	ASSERT_VKRES(s_vkWaitSemaphores(device, &info, timeout));
+}
+
 VkFence Device::createFence(bool signaled)
 {
 	const VkFenceCreateInfo info = {
@@ -177,6 +254,30 @@ void Device::destroyFence(VkFence fence)
 	vkDestroyFence(device, fence, nullptr);
 }
 
+VkQueryPool Device::createTimestampQueryPool(u32 numQueries)
+{
+	const VkQueryPoolCreateInfo info = {
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = numQueries,
+	};
+	VkQueryPool pool;
+	VkResult vkRes = vkCreateQueryPool(device, &info, nullptr, &pool);
+	ASSERT_VKRES(vkRes);
+	return pool;
+}
+
+void Device::destroyQueryPool(VkQueryPool pool)
+{
+	vkDestroyQueryPool(device, pool, nullptr);
+}
+
+VkResult Device::getTimestampQueryResults(VkQueryPool pool, u32 firstQuery, std::span<u64> results)
+{
+	return vkGetQueryPoolResults(device, pool, firstQuery, u32(results.size()),
+		results.size_bytes(), results.data(), sizeof(u64), VK_QUERY_RESULT_64_BIT);
+}
+
 static VmaAllocationCreateFlags toVma(BufferHostAccess hostAccess) {
 	VmaAllocationCreateFlags flags = 0;
 	if (hostAccess.sequentialWrite)
@@ -207,9 +308,9 @@ u32 Device::getMemTypeInd(BufferUsage usage, BufferHostAccess hostAccess, size_t
 	}*/
 }
 
-Buffer Device::createBuffer(BufferUsage usage, size_t size, BufferHostAccess hostAccess)
+Buffer Device::createBuffer(BufferUsage usage, size_t size, BufferHostAccess hostAccess, mem::Tag memTag)
 {
-	const u32 slot = tk::acquireReusableEntry(buffers_nextFreeSlot, buffers, 0);
+	const u32 slot = buffers.acquire();
 
 	const u32 memType = getMemTypeInd(usage, hostAccess, size);
 	VmaAllocationCreateFlags flags = toVma(hostAccess);
@@ -218,6 +319,7 @@ Buffer Device::createBuffer(BufferUsage usage, size_t size, BufferHostAccess hos
 		.flags = flags,
 		.usage = VMA_MEMORY_USAGE_AUTO,
 		.memoryTypeBits = u32(1) << memType,
+		.pUserData = (void*)uintptr_t(memTag),
 	};
 	const auto bufferCreateInfo = makeBufferCreateInfo(usage, size);
 
@@ -228,10 +330,12 @@ Buffer Device::createBuffer(BufferUsage usage, size_t size, BufferHostAccess hos
 		vmaGetAllocationMemoryProperties(allocator, buffer.alloc, &memPropFlags);
 		if (memPropFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
 			vmaMapMemory(allocator, buffer.alloc, &buffer.allocInfo.pMappedData);
+		mem::_onAlloc(memTag, mem::Heap::gpu, buffer.allocInfo.size);
 		buffer.allocInfo.pUserData = (void*)(uintptr_t)usage;
-		return { slot + 1 };
+		return { slot + 1, buffers.getGeneration(slot) };
 	}
 
+	buffers.release(slot);
 	return { 0 };
 }
 
@@ -241,10 +345,13 @@ void Device::destroyBuffer(Buffer buffer)
 		assert(false);
 		return;
 	}
-	const u32 slot = buffer.id - 1;
+	const u32 slot = slotOf(buffer);
 	BufferData& bufferData = buffers[slot];
+	VmaAllocationInfo allocInfo; // our copy of the pUserData holds the usage, VMA's one holds the tag
+	vmaGetAllocationInfo(allocator, bufferData.alloc, &allocInfo);
+	mem::_onFree(mem::Tag(uintptr_t(allocInfo.pUserData)), mem::Heap::gpu, allocInfo.size);
 	vmaDestroyBuffer(allocator, bufferData.handle, bufferData.alloc);
-	tk::releaseReusableEntry(buffers_nextFreeSlot, buffers, 0, slot);
+	buffers.release(slot);
 }
 
 u8* Device::getBufferMemPtr(Buffer buffer)
@@ -254,10 +361,21 @@ u8* Device::getBufferMemPtr(Buffer buffer)
 		return nullptr;
 	}
 
-	const u32 slot = buffer.id - 1;
+	const u32 slot = slotOf(buffer);
 	return (u8*)buffers[slot].allocInfo.pMappedData;
 }
 
+BufferUsage Device::getBufferUsage(Buffer buffer)const
+{
+	if (buffer.id == 0) {
+		assert(false);
+		return {};
+	}
+
+	const u32 slot = slotOf(buffer);
+	return BufferUsage(uintptr_t(buffers[slot].allocInfo.pUserData));
+}
+
 size_t Device::getBufferSize(Buffer buffer)const
 {
 	if (buffer.id == 0) {
@@ -265,7 +383,7 @@ size_t Device::getBufferSize(Buffer buffer)const
 		return 0;
 	}
 
-	const u32 slot = buffer.id - 1;
+	const u32 slot = slotOf(buffer);
 	return buffers[slot].allocInfo.size;
 }
 
@@ -276,17 +394,27 @@ void Device::flushBuffer(Buffer buffer)
 		return;
 	}
 
-	ASSERT_VKRES(vmaFlushAllocation(allocator, buffers[buffer.id - 1].alloc, 0, VK_WHOLE_SIZE));
+	ASSERT_VKRES(vmaFlushAllocation(allocator, buffers[slotOf(buffer)].alloc, 0, VK_WHOLE_SIZE));
+}
+
+void Device::invalidateBuffer(Buffer buffer)
+{
+	if (buffer.id == 0) {
+		assert(false);
+		return;
+	}
+
+	ASSERT_VKRES(vmaInvalidateAllocation(allocator, buffers[slotOf(buffer)].alloc, 0, VK_WHOLE_SIZE));
 }
 
 Image Device::registerImage(VkImage img, const ImageInfo& info, VmaAllocation alloc)
 {
-	const u32 e = tk::acquireReusableEntry(images.nextFreeSlot, images.handles, 0, images.infos, images.allocs);
+	const u32 e = images.slots.acquire(images.handles, images.infos, images.allocs);
 	images.handles[e] = img;
 	images.infos[e] = info;
 	images.allocs[e] = alloc;
 
-	return { e + 1 };
+	return { e + 1, images.slots.getGeneration(e) };
 }
 
 void Device::deregisterImage(Image img)
@@ -296,13 +424,10 @@ void Device::deregisterImage(Image img)
 		return;
 	}
 
-	const u32 slot = img.id - 1;
-	assert(images.infos[slot].dimensions != 0 && "double free?");
-	images.infos[slot].dimensions = 0;
-	tk::releaseReusableEntry(images.nextFreeSlot, images.handles, 0, slot);
+	images.slots.release(slotOf(img));
 }
 
-Image Device::createImage(const ImageInfo& info)
+static VkImageCreateInfo makeImageCreateInfo(const ImageInfo& info)
 {
 	assert(info.dimensions >= 1 && info.dimensions <= 3);
 	assert(info.size.width > 0 && info.size.height > 0 && info.size.depth > 0 && info.size.numMips > 0);
@@ -322,7 +447,7 @@ Image Device::createImage(const ImageInfo& info)
 		| (info.usage.transient ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0)
 	;
 
-	const VkImageCreateInfo info2 = {
+	return VkImageCreateInfo {
 		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
 		.flags = 0, // VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT
 		.imageType = VkImageType(info.dimensions - 1),
@@ -342,30 +467,69 @@ Image Device::createImage(const ImageInfo& info)
 		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
 		.initialLayout = toVk(info.layout),
 	};
+}
+
+Image Device::createImage(const ImageInfo& info, mem::Tag memTag)
+{
+	const VkImageCreateInfo info2 = makeImageCreateInfo(info);
 	VkImage image;
 	const VmaAllocationCreateInfo allocCreateInfo = {
 		.usage = VMA_MEMORY_USAGE_AUTO,
+		.pUserData = (void*)uintptr_t(memTag),
 	};
 	VmaAllocation alloc;
 	VmaAllocationInfo allocInfo;
 	VkResult vkRes = vmaCreateImage(allocator, &info2, &allocCreateInfo, &image, &alloc, &allocInfo);
 	ASSERT_VKRES(vkRes);
+	mem::_onAlloc(memTag, mem::Heap::gpu, allocInfo.size);
 	return registerImage(image, info, alloc);
 }
 
+Image Device::createAliasingImage(const ImageInfo& info, Image memoryOwner)
+{
+	assert(memoryOwner.id);
+	const VmaAllocation ownerAlloc = images.allocs[slotOf(memoryOwner)];
+	assert(ownerAlloc && "the owner must be an image with its own memory");
+
+	const VkImageCreateInfo info2 = makeImageCreateInfo(info);
+	VkImage image;
+	VkResult vkRes = vkCreateImage(device, &info2, nullptr, &image);
+	ASSERT_VKRES(vkRes);
+
+	// the memory of the owner must be big enough, and of a compatible type
+	VkMemoryRequirements memReqs;
+	vkGetImageMemoryRequirements(device, image, &memReqs);
+	VmaAllocationInfo allocInfo;
+	vmaGetAllocationInfo(allocator, ownerAlloc, &allocInfo);
+	if (memReqs.size > allocInfo.size || !(memReqs.memoryTypeBits & (1u << allocInfo.memoryType))) {
+		vkDestroyImage(device, image, nullptr);
+		return {};
+	}
+
+	vkRes = vmaBindImageMemory(allocator, ownerAlloc, image);
+	ASSERT_VKRES(vkRes);
+	return registerImage(image, info, nullptr);
+}
+
 void Device::destroyImage(Image img)
 {
 	assert(img.id);
-	const u32 slot = img.id - 1;
-	assert(images.allocs[slot]);
-	vmaDestroyImage(allocator, images.handles[slot], images.allocs[slot]);
+	const u32 slot = slotOf(img);
+	if (images.allocs[slot]) {
+		VmaAllocationInfo allocInfo;
+		vmaGetAllocationInfo(allocator, images.allocs[slot], &allocInfo);
+		mem::_onFree(mem::Tag(uintptr_t(allocInfo.pUserData)), mem::Heap::gpu, allocInfo.size);
+		vmaDestroyImage(allocator, images.handles[slot], images.allocs[slot]);
+	}
+	else // aliasing image: the memory belongs to another image
+		vkDestroyImage(device, images.handles[slot], nullptr);
 	deregisterImage(img);
 }
 
 ImageView Device::createImageView(ImageViewInfo& info)
 {
 	assert(info.image.id);
-	const u32 imgSlot = info.image.id - 1;
+	const u32 imgSlot = slotOf(info.image);
 	const auto& imgInfo = images.infos[imgSlot];
 	ImageViewType& type = info.type;
 	if (type == ImageViewType::count) {
@@ -386,7 +550,7 @@ ImageView Device::createImageView(ImageViewInfo& info)
 
 	Format& format = info.format;
 	if (format == Format::undefined)
-		format = images.infos[info.image.id - 1].format;
+		format = images.infos[slotOf(info.image)].format;
 
 	auto& aspects = info.aspects;
 	if (aspects == ImageAspects::none) {
@@ -427,10 +591,10 @@ ImageView Device::createImageView(ImageViewInfo& info)
 	VkImageView view;
 	ASSERT_VKRES(vkCreateImageView(device, &infoVk, nullptr, &view));
 	
-	const u32 slot = tk::acquireReusableEntry(imageViews.nextFreeSlot, imageViews.handles, 0, imageViews.infos);
+	const u32 slot = imageViews.slots.acquire(imageViews.handles, imageViews.infos);
 	imageViews.handles[slot] = view;
 	imageViews.infos[slot] = info;
-	return { slot + 1 };
+	return { slot + 1, imageViews.slots.getGeneration(slot) };
 }
 
 void Device::destroyImageView(ImageView imgView)
@@ -439,12 +603,9 @@ void Device::destroyImageView(ImageView imgView)
 		assert(false);
 		return;
 	}
-	const u32 slot = imgView.id - 1;
+	const u32 slot = slotOf(imgView);
 	vkDestroyImageView(device, imageViews.handles[slot], nullptr);
-
-	assert(imageViews.infos[slot].image.id != 0 && "double free?");
-	imageViews.infos[slot].image = { 0 };
-	tk::releaseReusableEntry(imageViews.nextFreeSlot, imageViews.handles, 0, slot);
+	imageViews.slots.release(slot);
 }
 
 VkSampler Device::createSampler(const SamplerInfo& info)
@@ -525,10 +686,17 @@ void Device::allocCmdBuffers(VkCommandPool pool, std::span<CmdBuffer> cmdBuffers
 		cmdBuffers[i].handle = tmp_cmdBuffers[i];
 }
 
-VkDescriptorSetLayout Device::createDescriptorSetLayout(CSpan<DescriptorSetLayoutBindingInfo> bindings, DescriptorSetLayoutCreateFlags flags)
+VkDescriptorSetLayout Device::createDescriptorSetLayout(CSpan<DescriptorSetLayoutBindingInfo> bindings, DescriptorSetLayoutCreateFlags flags, CSpan<DescriptorBindingFlags> bindingFlags)
 {
+	assert(bindingFlags.empty() || bindingFlags.size() == bindings.size());
+	const VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+		.bindingCount = u32(bindingFlags.size()),
+		.pBindingFlags = (const VkDescriptorBindingFlags*)bindingFlags.data(),
+	};
 	const VkDescriptorSetLayoutCreateInfo info = {
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = bindingFlags.empty() ? nullptr : &bindingFlagsInfo,
 		.flags = toVk(flags),
 		.bindingCount = u32(bindings.size()),
 		.pBindings = (const VkDescriptorSetLayoutBinding*)bindings.data(),
@@ -591,6 +759,42 @@ void Device::freeDescriptorSets(VkDescriptorPool pool, CSpan<VkDescriptorSet> de
 	ASSERT_VKRES(vkFreeDescriptorSets(device, pool, u32(descSets.size()), descSets.data()));
 }
 
+VkDescriptorUpdateTemplate Device::createDescriptorUpdateTemplate(VkDescriptorSetLayout layout, CSpan<DescriptorUpdateTemplateEntry> entries)
+{
+	std::vector<VkDescriptorUpdateTemplateEntry> entriesVk(entries.size());
+	for (size_t i = 0; i < entries.size(); i++) {
+		const auto& e = entries[i];
+		entriesVk[i] = {
+			.dstBinding = e.binding,
+			.dstArrayElement = e.arrayElement,
+			.descriptorCount = e.count,
+			.descriptorType = toVk(e.type),
+			.offset = e.offset,
+			.stride = e.stride,
+		};
+	}
+	const VkDescriptorUpdateTemplateCreateInfo info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO,
+		.descriptorUpdateEntryCount = u32(entriesVk.size()),
+		.pDescriptorUpdateEntries = entriesVk.data(),
+		.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET,
+		.descriptorSetLayout = layout,
+	};
+	VkDescriptorUpdateTemplate updateTemplate;
+	ASSERT_VKRES(vkCreateDescriptorUpdateTemplate(device, &info, nullptr, &updateTemplate));
+	return updateTemplate;
+}
+
+void Device::destroyDescriptorUpdateTemplate(VkDescriptorUpdateTemplate updateTemplate)
+{
+	vkDestroyDescriptorUpdateTemplate(device, updateTemplate, nullptr);
+}
+
+void Device::updateDescriptorSetWithTemplate(VkDescriptorSet descSet, VkDescriptorUpdateTemplate updateTemplate, const void* data)
+{
+	vkUpdateDescriptorSetWithTemplate(device, descSet, updateTemplate, data);
+}
+
 void Device::updateDescriptorSets(CSpan<DescriptorSetArrayWrite> writes, CSpan<DescriptorSetArrayCopy> copies)
 {
 	std::vector<VkWriteDescriptorSet> writesVk(writes.size());
@@ -668,7 +872,7 @@ void Device::writeDescriptorSets(CSpan<DescriptorSetWrite> writes)
 		writes2[i] = {
 			.descSet = write.descSet,
 			.binding = write.binding,
-			.startElem = 0,
+			.startElem = write.arrayElement,
 			.type = write.type,
 			.imageInfos = { &write.imageInfo, 1 }, // assuming this works for the union type
 		};
@@ -776,6 +980,18 @@ VkRenderPass Device::createRenderPass(const RenderPassInfo& info)
 			.dependencyFlags = VkDependencyFlags(dep.supportRegionTiling ? VK_DEPENDENCY_BY_REGION_BIT : 0),
 		};
 	}
+	// the layout transitions at the beginning of the render pass must happen after the attachment accesses of the previous commands.
+	// The implicit external dependency has TOP_OF_PIPE as source scope, so it wouldn't chain with the barriers recorded before the render pass
+	assert(numDeps < deps.size());
+	deps[numDeps] = {
+		.srcSubpass = VK_SUBPASS_EXTERNAL,
+		.dstSubpass = 0,
+		.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		.dependencyFlags = 0,
+	};
 
 	const VkRenderPassCreateInfo info2 = {
 		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
@@ -783,7 +999,7 @@ VkRenderPass Device::createRenderPass(const RenderPassInfo& info)
 		.pAttachments = attachments,
 		.subpassCount = numSubpasses,
 		.pSubpasses = subpasses,
-		.dependencyCount = numDeps,
+		.dependencyCount = numDeps + 1,
 		.pDependencies = &deps[0],
 	};
 	VkRenderPass handle;
@@ -839,10 +1055,10 @@ VkFramebuffer Device::createFramebuffer(const FramebufferInfo& info)
 		if (d != 0)
 			continue;
 		for (auto& a : info.attachments) {
-			auto& imgViewInfo = imageViews.infos[a.id - 1];
+			auto& imgViewInfo = imageViews.infos[slotOf(a)];
 			assert(imgViewInfo.numMipLevels == 1);
 			assert(imgViewInfo.type == ImageViewType::_2d); // TODO: maybe accept ImageViewType::_2d_array as well
-			const u32 imgInd = imgViewInfo.image.id - 1;
+			const u32 imgInd = slotOf(imgViewInfo.image);
 			const u32 d2 = images.infos[imgInd].size.vec()[i];
 			if (d == 0)
 				d = d2;
@@ -855,7 +1071,7 @@ VkFramebuffer Device::createFramebuffer(const FramebufferInfo& info)
 	std::array<VkImageView, 16> attachments;
 	for (size_t i = 0; i < info.attachments.size(); i++) {
 		const ImageView imgView = info.attachments[i];
-		attachments[i] = imageViews.handles[imgView.id - 1];
+		attachments[i] = imageViews.handles[slotOf(imgView)];
 	}
 
 	const VkFramebufferCreateInfo info2 = {
@@ -1088,6 +1304,8 @@ VkResult Device::createGraphicsPipelines(std::span<VkPipeline> pipelines, CSpan<
 			fn(VK_DYNAMIC_STATE_STENCIL_WRITE_MASK);
 		if (s.stencilReference)
 			fn(VK_DYNAMIC_STATE_STENCIL_REFERENCE);
+		if (s.cullMode)
+			fn(VK_DYNAMIC_STATE_CULL_MODE);
 	};
 	u32 totalDynamicStates = 0;
 	for (size_t i = 0; i < N; i++)
@@ -1180,7 +1398,7 @@ void Device::submit(VkQueue queue, CSpan<SubmitInfo> submits, VkFence signalFenc
 	indWaitSemaphores = indCmdBuffers = indSignalSemaphores = 0;
 	for (u32 i = 0; i < N; i++) {
 		const auto& submit = submits[i];
-		for (u32 j = 0; j < u32(submit.signalSemaphores.size()); j++) {
+		for (u32 j = 0; j < u32(submit.waitSemaphores.size()); j++) {
 			waitSemaphores[indWaitSemaphores + j] = std::get<0>(submit.waitSemaphores[j]);
 			waitStagesMasks[indWaitSemaphores + j] = toVk(std::get<1>(submit.waitSemaphores[j]));
 		}
@@ -1198,10 +1416,22 @@ void Device::submit(VkQueue queue, CSpan<SubmitInfo> submits, VkFence signalFenc
 
 	indWaitSemaphores = indCmdBuffers = indSignalSemaphores = 0;
 	std::vector<VkSubmitInfo> infos(N);
+	std::vector<VkTimelineSemaphoreSubmitInfo> timelineInfos(N);
 	for (u32 i = 0; i < N; i++) {
 		const auto& submit = submits[i];
+		const bool hasTimelineValues = submit.waitSemaphoreValues.size() || submit.signalSemaphoreValues.size();
+		assert(submit.waitSemaphoreValues.empty() || submit.waitSemaphoreValues.size() == submit.waitSemaphores.size());
+		assert(submit.signalSemaphoreValues.empty() || submit.signalSemaphoreValues.size() == submit.signalSemaphores.size());
+		timelineInfos[i] = {
+			.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+			.waitSemaphoreValueCount = u32(submit.waitSemaphoreValues.size()),
+			.pWaitSemaphoreValues = submit.waitSemaphoreValues.data(),
+			.signalSemaphoreValueCount = u32(submit.signalSemaphoreValues.size()),
+			.pSignalSemaphoreValues = submit.signalSemaphoreValues.data(),
+		};
 		infos[i] = {
 			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.pNext = hasTimelineValues ? &timelineInfos[i] : nullptr,
 			.waitSemaphoreCount = u32(submit.waitSemaphores.size()),
 			.pWaitSemaphores = waitSemaphores.data() + indWaitSemaphores,
 			.pWaitDstStageMask = waitStagesMasks.data() + indWaitSemaphores,
@@ -1366,6 +1596,11 @@ void CmdBuffer::cmd_copy(VkBuffer src, VkImage dst, CSpan<VkBufferImageCopy> reg
 	vkCmdCopyBufferToImage(handle, src, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, u32(regions.size()), regions.data());
 }
 
+void CmdBuffer::cmd_copyImageToBuffer(VkImage src, VkBuffer dst, CSpan<VkBufferImageCopy> regions)
+{
+	vkCmdCopyImageToBuffer(handle, src, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst, u32(regions.size()), regions.data());
+}
+
 void CmdBuffer::cmd_copy(Buffer src, Image dst, const Device& device, size_t bufferOffset, u32 mipLevel)
 {
 	const VkImage dstVk = device.getVkHandle(dst);
@@ -1591,6 +1826,12 @@ void CmdBuffer::cmd_viewport(Viewport vp)
 	vkCmdSetViewport(handle, 0, 1, (const VkViewport*)&vp);
 }
 
+void CmdBuffer::cmd_setCullMode(bool cullFront, bool cullBack)
+{
+	assert(s_vkCmdSetCullMode && "DeviceFeatures::dynamicCullMode not enabled");
+	s_vkCmdSetCullMode(handle, VkCullModeFlags((cullBack ? VK_CULL_MODE_BACK_BIT : 0) | (cullFront ? VK_CULL_MODE_FRONT_BIT : 0)));
+}
+
 void CmdBuffer::cmd_bindDescriptorSets(PipelineBindPoint bindPoint, VkPipelineLayout layout, u32 firstBinding, CSpan<VkDescriptorSet> descSets, CSpan<u32> dynamicOffsets)
 {
 	vkCmdBindDescriptorSets(handle, toVk(bindPoint), layout, firstBinding, u32(descSets.size()), descSets.data(), u32(dynamicOffsets.size()), dynamicOffsets.data());
@@ -1600,6 +1841,21 @@ void CmdBuffer::cmd_bindDescriptorSet(PipelineBindPoint bindPoint, VkPipelineLay
 	vkCmdBindDescriptorSets(handle, toVk(bindPoint), layout, binding, 1, &descSet, 0, nullptr);
 }
 
+void CmdBuffer::cmd_pushConstants(VkPipelineLayout layout, ShaderStages stages, u32 offset, CSpan<u8> data)
+{
+	vkCmdPushConstants(handle, layout, toVk(stages), offset, u32(data.size()), data.data());
+}
+
+void CmdBuffer::cmd_resetQueryPool(VkQueryPool pool, u32 firstQuery, u32 numQueries)
+{
+	vkCmdResetQueryPool(handle, pool, firstQuery, numQueries);
+}
+
+void CmdBuffer::cmd_writeTimestamp(PipelineStages stage, VkQueryPool pool, u32 query)
+{
+	vkCmdWriteTimestamp(handle, VkPipelineStageFlagBits(stage), pool, query);
+}
+
 void CmdBuffer::cmd_bindVertexBuffers(u32 firstBinding, CSpan<VkBuffer> vbs, CSpan<size_t> offsets)
 {
 	vkCmdBindVertexBuffers(handle, firstBinding, u32(vbs.size()), vbs.data(), offsets.data());
@@ -1695,6 +1951,45 @@ void getPhysicalDeviceInfos(VkInstance instance, std::vector<PhysicalDeviceInfo>
 				infos[i].queueFamiliesPresentSupported[j] = supported;
 			}
 		}
+
+		u32 numExtensions;
+		ASSERT_VKRES(vkEnumerateDeviceExtensionProperties(physicalDevices[i], nullptr, &numExtensions, nullptr));
+		infos[i].extensions.resize(numExtensions);
+		ASSERT_VKRES(vkEnumerateDeviceExtensionProperties(physicalDevices[i], nullptr, &numExtensions, infos[i].extensions.data()));
+
+		// query optional features. We only chain the structs of the extensions that are available
+		VkPhysicalDeviceFeatures2 features2 = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+		VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT };
+		VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES };
+		VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES };
+		if (infos[i].supportsExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME)) {
+			extendedDynamicStateFeatures.pNext = features2.pNext;
+			features2.pNext = &extendedDynamicStateFeatures;
+		}
+		if (infos[i].props.apiVersion >= VK_API_VERSION_1_2 || infos[i].supportsExtension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+			timelineSemaphoreFeatures.pNext = features2.pNext;
+			features2.pNext = &timelineSemaphoreFeatures;
+		}
+		if (infos[i].props.apiVersion >= VK_API_VERSION_1_2 || infos[i].supportsExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+			descriptorIndexingFeatures.pNext = features2.pNext;
+			features2.pNext = &descriptorIndexingFeatures;
+		}
+		vkGetPhysicalDeviceFeatures2(physicalDevices[i], &features2);
+
+		infos[i].descriptorIndexingProps = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES };
+		if (descriptorIndexingFeatures.runtimeDescriptorArray) {
+			VkPhysicalDeviceProperties2 props2 = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &infos[i].descriptorIndexingProps };
+			vkGetPhysicalDeviceProperties2(physicalDevices[i], &props2);
+			infos[i].descriptorIndexingProps.pNext = nullptr;
+		}
+
+		auto& supported = infos[i].supportedFeatures;
+		supported.dynamicCullMode = infos[i].props.apiVersion >= VK_API_VERSION_1_3 || extendedDynamicStateFeatures.extendedDynamicState;
+		supported.timelineSemaphore = timelineSemaphoreFeatures.timelineSemaphore;
+		supported.textureCompressionBC = features2.features.textureCompressionBC;
+		supported.descriptorIndexing = features2.features.shaderSampledImageArrayDynamicIndexing && descriptorIndexingFeatures.runtimeDescriptorArray && descriptorIndexingFeatures.descriptorBindingPartiallyBound &&
+			descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind && descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending &&
+			infos[i].descriptorIndexingProps.maxPerStageDescriptorUpdateAfterBindSampledImages > 0;
 	}
 }
 
@@ -1763,7 +2058,7 @@ u32 chooseBestPhysicalDevice(CSpan<PhysicalDeviceInfo> infos, PhysicalDeviceFilt
 }
 
 VkResult createDevice(Device& device, VkInstance instance, const PhysicalDeviceInfo& physicalDeviceInfo,
-	CSpan<QueuesCreateInfo> queuesInfos, CSpan<CStr> extensions)
+	CSpan<QueuesCreateInfo> queuesInfos, CSpan<CStr> extensions, const DeviceFeatures& features)
 {
 	assert(device.device == VK_NULL_HANDLE && "device created twice?");
 	device.instance = instance;
@@ -1782,28 +2077,84 @@ VkResult createDevice(Device& device, VkInstance instance, const PhysicalDeviceI
 		};
 	}
 
-	const VkPhysicalDeviceFeatures features = {
+	const VkPhysicalDeviceFeatures features10 = {
 		.samplerAnisotropy = VK_TRUE,
+		.textureCompressionBC = features.textureCompressionBC,
+		.shaderSampledImageArrayDynamicIndexing = features.descriptorIndexing,
+	};
+
+	// optional features
+	assert(!features.dynamicCullMode || physicalDeviceInfo.supportedFeatures.dynamicCullMode);
+	assert(!features.timelineSemaphore || physicalDeviceInfo.supportedFeatures.timelineSemaphore);
+	assert(!features.textureCompressionBC || physicalDeviceInfo.supportedFeatures.textureCompressionBC);
+	assert(!features.descriptorIndexing || physicalDeviceInfo.supportedFeatures.descriptorIndexing);
+	const bool isVulkan12 = physicalDeviceInfo.props.apiVersion >= VK_API_VERSION_1_2;
+	const bool isVulkan13 = physicalDeviceInfo.props.apiVersion >= VK_API_VERSION_1_3;
+	std::vector<CStr> allExtensions(extensions.begin(), extensions.end());
+	const void* pNext = nullptr;
+	VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT,
+		.extendedDynamicState = VK_TRUE,
+	};
+	if (features.dynamicCullMode && !isVulkan13) { // in 1.3 this is core and doesn't need to be enabled
+		allExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+		extendedDynamicStateFeatures.pNext = (void*)pNext;
+		pNext = &extendedDynamicStateFeatures;
+	}
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+		.timelineSemaphore = VK_TRUE,
+	};
+	if (features.timelineSemaphore) { // core in 1.2, but it still needs to be enabled
+		if (!isVulkan12)
+			allExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+		timelineSemaphoreFeatures.pNext = (void*)pNext;
+		pNext = &timelineSemaphoreFeatures;
+	}
+	VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
+		.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+		.descriptorBindingUpdateUnusedWhilePending = VK_TRUE,
+		.descriptorBindingPartiallyBound = VK_TRUE,
+		.runtimeDescriptorArray = VK_TRUE,
 	};
+	if (features.descriptorIndexing) { // core in 1.2, but it still needs to be enabled
+		if (!isVulkan12) {
+			allExtensions.push_back(VK_KHR_MAINTENANCE_3_EXTENSION_NAME);
+			allExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+		}
+		descriptorIndexingFeatures.pNext = (void*)pNext;
+		pNext = &descriptorIndexingFeatures;
+	}
 
 	const VkDeviceCreateInfo info = {
 		.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+		.pNext = pNext,
 		.queueCreateInfoCount = numFamilies,
 		.pQueueCreateInfos = queuesInfosVk,
-		.enabledExtensionCount = u32(extensions.size()),
-		.ppEnabledExtensionNames = extensions.data(),
-		.pEnabledFeatures = &features,
+		.enabledExtensionCount = u32(allExtensions.size()),
+		.ppEnabledExtensionNames = allExtensions.data(),
+		.pEnabledFeatures = &features10,
 	};
 	VkResult vkRes = vkCreateDevice(device.physicalDevice.handle, &info, nullptr, &device.device);
 	if (vkRes != VK_SUCCESS)
 		return vkRes;
 
-	device.queues.resize(numFamilies);
+	device.enabledFeatures = features;
+	if (features.dynamicCullMode)
+		s_vkCmdSetCullMode = (PFN_vkCmdSetCullMode)vkGetDeviceProcAddr(device.device, isVulkan13 ? "vkCmdSetCullMode" : "vkCmdSetCullModeEXT");
+	if (features.timelineSemaphore) {
+		s_vkGetSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValue)vkGetDeviceProcAddr(device.device, isVulkan12 ? "vkGetSemaphoreCounterValue" : "vkGetSemaphoreCounterValueKHR");
+		s_vkWaitSemaphores = (PFN_vkWaitSemaphores)vkGetDeviceProcAddr(device.device, isVulkan12 ? "vkWaitSemaphores" : "vkWaitSemaphoresKHR");
+	}
+
+	device.queues.resize(physicalDeviceInfo.queueFamiliesProps.size());
 	for (u32 i = 0; i < numFamilies; i++) {
+		const u32 family = queuesInfos[i].queueFamily;
 		const u32 numQueues = queuesInfos[i].queuePriorities.size();
-		device.queues[i].resize(numQueues);
+		device.queues[family].resize(numQueues);
 		for(u32 j = 0; j < numQueues; j++)
-			vkGetDeviceQueue(device.device, i, j, &device.queues[i][j]);
+			vkGetDeviceQueue(device.device, family, j, &device.queues[family][j]);
 	}
 
 	const VmaAllocatorCreateInfo allocatorInfo = {
@@ -1914,8 +2265,55 @@ VkResult createSwapchainSyncHelper(SwapchainSyncHelper& o, VkSurfaceKHR surface,
 	return vkRes;
 }
 
+VkResult createHeadlessSwapchainSyncHelper(SwapchainSyncHelper& o, Device& device, const HeadlessSwapchainOptions& options)
+{
+	assert(options.numImages >= 1 && options.numImages <= Swapchain::MAX_IMAGES);
+	if (o.headless) {
+		// destroy old stuff
+		for (u32 i = 0; i < o.numImages; i++) {
+			device.destroyImageView(o.imageViews[i]);
+			device.destroyImage(o.images[i]);
+			device.destroySemaphore(o.semaphore_imageAvailable[i]);
+			device.destroySemaphore(o.semaphore_drawFinished[i]);
+			device.destroyFence(o.fence_drawFinished[i]);
+		}
+		device.destroySemaphore(o.semaphore_imageAvailable[o.numImages]);
+	}
+
+	o.headless = true;
+	o.numImages = options.numImages;
+	o.w = options.w;
+	o.h = options.h;
+	o.format = { .format = options.format, .colorSpace = VK_COLORSPACE_SRGB_NONLINEAR_KHR };
+	o.imgInd = 0;
+	o.imageAvailableSemaphoreInd = 0;
+
+	for (u32 i = 0; i < o.numImages; i++) {
+		o.images[i] = device.createImage({
+			.size = {u16(o.w), u16(o.h)},
+			.format = o.format.format,
+			.usage = {.transfer_src = true, .output_attachment = true}, // transfer_src for reading the frames back
+		});
+		o.imageViews[i] = device.createImageView({ .image = o.images[i], .type = ImageViewType::_2d });
+	}
+
+	// the semaphores are not used, but we create them anyway so the rest of the code doesn't need to care
+	for (u32 i = 0; i < o.numImages; i++) {
+		o.semaphore_imageAvailable[i] = device.createSemaphore();
+		o.semaphore_drawFinished[i] = device.createSemaphore();
+		o.fence_drawFinished[i] = device.createFence(true);
+	}
+	o.semaphore_imageAvailable[o.numImages] = device.createSemaphore();
+
+	return VK_SUCCESS;
+}
+
 void SwapchainSyncHelper::acquireNextImage(Device& device)
 {
+	if (headless) {
+		imgInd = (imgInd + 1) % numImages;
+		return;
+	}
 	ASSERT_VKRES(vkAcquireNextImageKHR(device.device, swapchain, u64(-1), semaphore_imageAvailable[imageAvailableSemaphoreInd], VK_NULL_HANDLE, &imgInd));
 }
 
@@ -1926,8 +2324,16 @@ void SwapchainSyncHelper::waitCanStartFrame(Device& device)
 	ASSERT_VKRES(vkResetFences(device.device, 1, &fence));
 }
 
+void SwapchainSyncHelper::waitFrameFinished(Device& device, u32 ind)
+{
+	ASSERT_VKRES(vkWaitForFences(device.device, 1, &fence_drawFinished[ind], VK_FALSE, u64(-1)));
+}
+
 void SwapchainSyncHelper::present(VkQueue queue)
 {
+	if (headless)
+		return;
+
 	VkResult vkRes;
 	const VkPresentInfoKHR info = {
 		.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -1948,6 +2354,54 @@ bool formatIsColor(Format format)
 	return format != Format::undefined && !formatIsDepth(format) && !formatIsStencil(format);
 }
 
+bool formatIsCompressed(Format format)
+{
+	return format >= Format::COMPR_BC1_RGB_UNORM && format <= Format::COMPR_ASTC_12x12_SRGB;
+}
+
+FormatBlockInfo getFormatBlockInfo(Format format)
+{
+	const auto f = std::underlying_type_t<Format>(format);
+	auto inRange = [f](Format first, Format last) {
+		return f >= std::underlying_type_t<Format>(first) && f <= std::underlying_type_t<Format>(last);
+	};
+	// the enum follows the order of VkFormat, where the formats of the same size are contiguous
+	if (inRange(Format::R4G4_UNORM, Format::R4G4_UNORM)) return { .bytes = 1 };
+	if (inRange(Format::R4G4B4A4_UNORM, Format::A1R5G5B5_UNORM)) return { .bytes = 2 };
+	if (inRange(Format::R8_UNORM, Format::R8_SRGB)) return { .bytes = 1 };
+	if (inRange(Format::RG8_UNORM, Format::RG8_SRGB)) return { .bytes = 2 };
+	if (inRange(Format::RGB8_UNORM, Format::BGR8_SRGB)) return { .bytes = 3 };
+	if (inRange(Format::RGBA8_UNORM, Format::A2BGR10_SINT)) return { .bytes = 4 };
+	if (inRange(Format::R16_UNORM, Format::R16_SFLOAT)) return { .bytes = 2 };
+	if (inRange(Format::RG16_UNORM, Format::RG16_SFLOAT)) return { .bytes = 4 };
+	if (inRange(Format::RGB16_UNORM, Format::RGB16_SFLOAT)) return { .bytes = 6 };
+	if (inRange(Format::RGBA16_UNORM, Format::RGBA16_SFLOAT)) return { .bytes = 8 };
+	if (inRange(Format::R32_UINT, Format::R32_SFLOAT)) return { .bytes = 4 };
+	if (inRange(Format::RG32_UINT, Format::RG32_SFLOAT)) return { .bytes = 8 };
+	if (inRange(Format::RGB32_UINT, Format::RGB32_SFLOAT)) return { .bytes = 12 };
+	if (inRange(Format::RGBA32_UINT, Format::RGBA32_SFLOAT)) return { .bytes = 16 };
+	if (inRange(Format::R64_UINT, Format::R64_SFLOAT)) return { .bytes = 8 };
+	if (inRange(Format::RG64_UINT, Format::RG64_SFLOAT)) return { .bytes = 16 };
+	if (inRange(Format::RGB64_UINT, Format::RGB64_SFLOAT)) return { .bytes = 24 };
+	if (inRange(Format::RGBA64_UINT, Format::RGBA64_SFLOAT)) return { .bytes = 32 };
+	if (inRange(Format::B10G11R11_UFLOAT, Format::E5B9G9R9_UFLOAT)) return { .bytes = 4 };
+	if (inRange(Format::COMPR_BC1_RGB_UNORM, Format::COMPR_BC1_RGBA_SRGB)) return { 4, 4, 8 };
+	if (inRange(Format::COMPR_BC2_UNORM, Format::COMPR_BC3_SRGB)) return { 4, 4, 16 };
+	if (inRange(Format::COMPR_BC4_UNORM, Format::COMPR_BC4_SNORM)) return { 4, 4, 8 };
+	if (inRange(Format::COMPR_BC5_UNORM, Format::COMPR_BC7_SRGB)) return { 4, 4, 16 };
+	if (inRange(Format::COMPR_ETC2_R8G8B8_UNORM, Format::COMPR_ETC2_R8G8B8A1_SRGB)) return { 4, 4, 8 };
+	if (inRange(Format::COMPR_ETC2_R8G8B8A8_UNORM, Format::COMPR_ETC2_R8G8B8A8_SRGB)) return { 4, 4, 16 };
+	if (inRange(Format::COMPR_EAC_R11_UNORM, Format::COMPR_EAC_R11_SNORM)) return { 4, 4, 8 };
+	if (inRange(Format::COMPR_EAC_R11G11_UNORM, Format::COMPR_EAC_R11G11_SNORM)) return { 4, 4, 16 };
+	if (formatIsCompressed(format)) { // ASTC: always 16 bytes, but the block dimensions vary
+		static const u8 k_astcBlockDims[][2] = { {4,4}, {5,4}, {5,5}, {6,5}, {6,6}, {8,5}, {8,6}, {8,8}, {10,5}, {10,6}, {10,8}, {10,10}, {12,10}, {12,12} };
+		const auto& dims = k_astcBlockDims[(f - std::underlying_type_t<Format>(Format::COMPR_ASTC_4x4_UNORM)) / 2];
+		return { dims[0], dims[1], 16 };
+	}
+	assert(false && "not a color format");
+	return { .bytes = 0 };
+}
+
 bool formatIsDepth(Format format)
 {
 	static const Format k_depthFormats[] = {
@@ -12,6 +12,7 @@
 #include "vma.h"
 #include "utils.hpp"
 #include "delegate.hpp"
+#include "mem_tags.hpp"
 
 namespace tk {
 namespace vk {
@@ -264,9 +265,10 @@ enum class Format : std::underlying_type_t<VkFormat> {
 	COMPR_ASTC_12x12_SFLOAT = 1000066013, // Provided by VK_VERSION_1_3
 };
 
-struct Buffer { u32 id = 0; };
-struct Image { u32 id = 0; };
-struct ImageView { u32 id = 0; };
+// id 0 is null. The generation of the slot is used for detecting handles of destroyed objects
+struct Buffer { u32 id = 0; u32 generation = 0; };
+struct Image { u32 id = 0; u32 generation = 0; };
+struct ImageView { u32 id = 0; u32 generation = 0; };
 
 enum class BufferUsage : u16 {
 	transferSrc = 1,
@@ -460,15 +462,31 @@ struct BufferData {
 	VmaAllocationInfo allocInfo;
 };
 
+// optional features that can be enabled at device creation. Check PhysicalDeviceInfo::supportedFeatures before requesting them
+struct DeviceFeatures {
+	bool dynamicCullMode : 1 = false; // VK_EXT_extended_dynamic_state (core in Vulkan 1.3)
+	bool timelineSemaphore : 1 = false; // VK_KHR_timeline_semaphore (core in Vulkan 1.2)
+	bool textureCompressionBC : 1 = false; // BC1-BC7 formats
+	bool descriptorIndexing : 1 = false; // runtime-sized descriptor arrays that are partially bound, and sampled images that can be updated after bind (core in Vulkan 1.2)
+};
+
 struct PhysicalDeviceInfo {
 	VkPhysicalDevice handle;
 	VkPhysicalDeviceFeatures features;
 	VkPhysicalDeviceProperties props;
+	VkPhysicalDeviceDescriptorIndexingProperties descriptorIndexingProps; // the limits of the update-after-bind descriptors. Zeroed if descriptor indexing isn't supported
 	VkPhysicalDeviceMemoryProperties memProps;
 	std::vector<VkQueueFamilyProperties> queueFamiliesProps;
 	std::vector<bool> queueFamiliesPresentSupported;
+	std::vector<VkExtensionProperties> extensions;
+	DeviceFeatures supportedFeatures;
 
 	u32 findGraphicsAndPresentQueueFamily()const;
+	u32 findGraphicsQueueFamily()const; // for headless rendering, where there is nothing to present
+	// a family that supports transfer but not graphics or compute. These are usually backed by dedicated DMA engines.
+	// Returns queueFamiliesProps.size() if there isn't any
+	u32 findTransferOnlyQueueFamily()const;
+	bool supportsExtension(CStr name)const;
 };
 
 enum class PipelineBindPoint {
@@ -524,6 +542,17 @@ struct PipelineBarrier {
 	CSpan<BufferBarrier> bufferBarriers;
 	CSpan<ImageBarrier> imageBarriers;
 };
+struct VertexInputBindingInfo {
+	u32 binding;
+	u32 stride;
+	bool perInstance = false;
+};
+struct VertexInputAttribInfo {
+	u32 location;
+	u32 binding;
+	Format format;
+	u32 offset = 0;
+};
 struct RenderPassBegin {
 	VkRenderPass renderPass = VK_NULL_HANDLE;
 	VkFramebuffer framebuffer = VK_NULL_HANDLE;
@@ -551,6 +580,7 @@ struct CmdBuffer {
 
 	void cmd_copy(VkBuffer src, VkImage dst, CSpan<VkBufferImageCopy> regions);
 	void cmd_copy(Buffer src, Image dst, const Device& device, size_t bufferOffset = 0, u32 mipLevel = 0);
+	void cmd_copyImageToBuffer(VkImage src, VkBuffer dst, CSpan<VkBufferImageCopy> regions); // the image must be in the transferSrc layout
 
 	void cmd_blitToNextMip(const Device& device, Image img, u32 srcMip);
 
@@ -571,9 +601,14 @@ struct CmdBuffer {
 
 	void cmd_scissor(Rect2d r);
 	void cmd_viewport(Viewport vp);
+	void cmd_setCullMode(bool cullFront, bool cullBack); // the pipeline must have been created with PipelineDynamicStates::cullMode
 
 	void cmd_bindDescriptorSets(PipelineBindPoint bindPoint, VkPipelineLayout layout, u32 firstBinding, CSpan<VkDescriptorSet> descSets, CSpan<u32> dynamicOffsets);
 	void cmd_bindDescriptorSet(PipelineBindPoint bindPoint, VkPipelineLayout layout, u32 binding, VkDescriptorSet descSet);
+	void cmd_pushConstants(VkPipelineLayout layout, ShaderStages stages, u32 offset, CSpan<u8> data);
+
+	void cmd_resetQueryPool(VkQueryPool pool, u32 firstQuery, u32 numQueries); // (outside of render passes)
+	void cmd_writeTimestamp(PipelineStages stage, VkQueryPool pool, u32 query); // "stage" must be a single stage
 
 	void cmd_bindVertexBuffers(u32 firstBinding, CSpan<VkBuffer> vbs, CSpan<size_t> offsets);
 	void cmd_bindVertexBuffers(u32 firstBinding, CSpan<VkBuffer> vbs);
@@ -757,17 +792,6 @@ struct ImageViewInfo {
 	VkComponentMapping components = {};
 	ImageAspects aspects = ImageAspects::none; // none means automatically determine the aspect from the image
 };
-struct VertexInputBindingInfo {
-	u32 binding;
-	u32 stride;
-	bool perInstance = false;
-};
-struct VertexInputAttribInfo {
-	u32 location;
-	u32 binding;
-	Format format;
-	u32 offset = 0;
-};
 struct PipelineDynamicStates {
 	bool viewport : 1;
 	bool scissor : 1;
@@ -778,6 +802,7 @@ struct PipelineDynamicStates {
 	bool stencilComapreMask : 1;
 	bool stencilWriteMask : 1;
 	bool stencilReference : 1;
+	bool cullMode : 1; // requires DeviceFeatures::dynamicCullMode
 };
 enum class Topology : u8 { points, lines, line_strip, triangles, triangle_strip, triangle_fan, /* lines_withadj ... */ };
 enum class PolygonMode : u8 { fill, line, point, };
@@ -833,6 +858,9 @@ struct SubmitInfo {
 	CSpan<std::tuple<VkSemaphore, PipelineStages>> waitSemaphores;
 	CSpan<CmdBuffer> cmdBuffers;
 	CSpan<VkSemaphore> signalSemaphores;
+	// values for timeline semaphores. If not empty, they must have the same size as waitSemaphores/signalSemaphores (the values for binary semaphores are ignored)
+	CSpan<u64> waitSemaphoreValues = {};
+	CSpan<u64> signalSemaphoreValues = {};
 };
 
 struct Version {
@@ -908,6 +936,7 @@ struct DescriptorSetArrayWrite {
 struct DescriptorSetWrite {
 	VkDescriptorSet descSet = VK_NULL_HANDLE;
 	u32 binding = u32(-1);
+	u32 arrayElement = 0;
 	DescriptorType type = DescriptorType::maxEnum;
 	union {
 		DescriptorImageInfo imageInfo = {};
@@ -916,6 +945,15 @@ struct DescriptorSetWrite {
 	};
 };
 
+struct DescriptorUpdateTemplateEntry {
+	u32 binding;
+	u32 arrayElement = 0;
+	u32 count = 1;
+	DescriptorType type;
+	size_t offset; // in the data passed to updateDescriptorSetWithTemplate
+	size_t stride = 0; // between array elements
+};
+
 struct DescriptorSetArrayCopy {
 	VkDescriptorSet srcSet = VK_NULL_HANDLE;
 	u32 srcBinding = -1;
@@ -963,59 +1001,90 @@ enum class DescriptorSetLayoutCreateFlags : std::underlying_type_t<VkDescriptorS
 };
 DEFINE_ENUM_CLASS_LOGIC_OPS(DescriptorSetLayoutCreateFlags)
 
+// requires DeviceFeatures::descriptorIndexing
+enum class DescriptorBindingFlags : VkDescriptorBindingFlags {
+	none = 0,
+	updateAfterBind = 0x00000001,
+	updateUnusedWhilePending = 0x00000002,
+	partiallyBound = 0x00000004,
+	variableDescriptorCount = 0x00000008,
+};
+DEFINE_ENUM_CLASS_LOGIC_OPS(DescriptorBindingFlags)
+
 struct Device
 {
 	VkInstance instance;
 	VkDevice device = VK_NULL_HANDLE;
 	PhysicalDeviceInfo physicalDevice;
+	DeviceFeatures enabledFeatures;
 	VmaAllocator allocator;
 	std::vector<std::vector<VkQueue>> queues; // [queueFamily][queue]
-	std::vector<BufferData> buffers;
-	u32 buffers_nextFreeSlot = u32(-1);
+	SlotMap<BufferData> buffers;
 	//std::unordered_map<std::tuple<BufferUsage, BufferHostAccess>, u8> bufferMemTypeInds;
 	struct Images {
+		SlotMap<> slots;
 		std::vector<VkImage> handles;
 		std::vector<ImageInfo> infos;
 		std::vector<VmaAllocation> allocs;
-		u32 nextFreeSlot = u32(-1);
 	} images;
 	struct ImageViews {
+		SlotMap<> slots;
 		std::vector<VkImageView> handles;
 		std::vector<ImageViewInfo> infos;
-		u32 nextFreeSlot = u32(-1);
 	} imageViews;
 	std::vector<VkCommandBuffer> tmp_cmdBuffers; // just to avoid memory allocations... Maybe we should use a scratch buffer for this kind of thing, or use a stack allocator of some kind
 
 	void waitIdle();
 
 	VkSemaphore createSemaphore();
+	VkSemaphore createTimelineSemaphore(u64 initialValue = 0); // requires DeviceFeatures::timelineSemaphore
 	void destroySemaphore(VkSemaphore semaphore);
+	u64 getTimelineSemaphoreValue(VkSemaphore semaphore);
+	void waitTimelineSemaphore(VkSemaphore semaphore, u64 value, u64 timeout = u64(-1));
 
 	VkFence createFence(bool signaled);
 	void destroyFence(VkFence fence);
 
+	VkQueryPool createTimestampQueryPool(u32 numQueries);
+	void destroyQueryPool(VkQueryPool pool);
+	// doesn't wait: returns VK_NOT_READY if some of the results are not available
+	VkResult getTimestampQueryResults(VkQueryPool pool, u32 firstQuery, std::span<u64> results);
+
 	u32 getMemTypeInd(BufferUsage usage, BufferHostAccess hostAccess, size_t size = 1);
 
-	Buffer createBuffer(BufferUsage usage, size_t size, BufferHostAccess hostAccess);
+	// the memory is accounted in the given tag (through VMA's pUserData)
+	bool isAlive(Buffer buffer)const { return buffer.id && buffers.isValid(buffer.id - 1, buffer.generation); }
+	bool isAlive(Image image)const { return image.id && images.slots.isValid(image.id - 1, image.generation); }
+	bool isAlive(ImageView view)const { return view.id && imageViews.slots.isValid(view.id - 1, view.generation); }
+	// the slot of the handle in the arrays of the device. It must be alive
+	u32 slotOf(Buffer buffer)const { assert(isAlive(buffer)); return buffer.id - 1; }
+	u32 slotOf(Image image)const { assert(isAlive(image)); return image.id - 1; }
+	u32 slotOf(ImageView view)const { assert(isAlive(view)); return view.id - 1; }
+
+	Buffer createBuffer(BufferUsage usage, size_t size, BufferHostAccess hostAccess, mem::Tag memTag = mem::Tag::other);
 	void destroyBuffer(Buffer buffer);
-	VkBuffer getVkHandle(Buffer buffer)const { assert(buffer.id); return buffers[buffer.id - 1].handle; }
+	VkBuffer getVkHandle(Buffer buffer)const { return buffers[slotOf(buffer)].handle; }
 
 	u8* getBufferMemPtr(Buffer buffer);
+	BufferUsage getBufferUsage(Buffer buffer)const;
 	size_t getBufferSize(Buffer buffer)const;
 	void flushBuffer(Buffer buffer);
+	void invalidateBuffer(Buffer buffer); // before reading, from the CPU, what the GPU has written
 
 	Image registerImage(VkImage imgVk, const ImageInfo& info, VmaAllocation alloc);
 	void deregisterImage(Image img);
-	Image createImage(const ImageInfo& info);
+	Image createImage(const ImageInfo& info, mem::Tag memTag = mem::Tag::other);
+	// the image is bound to the memory of "memoryOwner" (which must outlive it). Returns {} if the memory is not big enough, or not compatible
+	Image createAliasingImage(const ImageInfo& info, Image memoryOwner);
 	void destroyImage(Image img);
-	VkImage getVkHandle(Image image)const { assert(image.id); return images.handles[image.id - 1]; }
-	const ImageInfo& getInfo(Image image)const { assert(image.id); return images.infos[image.id - 1]; }
+	VkImage getVkHandle(Image image)const { return images.handles[slotOf(image)]; }
+	const ImageInfo& getInfo(Image image)const { return images.infos[slotOf(image)]; }
 
 	ImageView createImageView(const ImageViewInfo& info) { ImageViewInfo info2 = info; return createImageView(info2); }
 	ImageView createImageView(ImageViewInfo& info);
 	void destroyImageView(ImageView imgView);
-	VkImageView getVkHandle(ImageView view)const { assert(view.id); return imageViews.handles[view.id - 1]; }
-	const ImageViewInfo& getInfo(ImageView view)const { assert(view.id); return imageViews.infos[view.id - 1]; }
+	VkImageView getVkHandle(ImageView view)const { return imageViews.handles[slotOf(view)]; }
+	const ImageViewInfo& getInfo(ImageView view)const { return imageViews.infos[slotOf(view)]; }
 
 	VkSampler createSampler(const SamplerInfo& info);
 	VkSampler createSampler(Filter minFilter, Filter magFilter, SamplerMipmapMode mipmapMode, SamplerAddressMode addressMode, float maxAnisotropy = 1.f);
@@ -1024,7 +1093,8 @@ struct Device
 	VkCommandPool createCmdPool(u32 queueFamily, CmdPoolOptions options);
 	void allocCmdBuffers(VkCommandPool pool, std::span<CmdBuffer> cmdBuffers, bool secondary = false);
 
-	VkDescriptorSetLayout createDescriptorSetLayout(CSpan<DescriptorSetLayoutBindingInfo> bindings, DescriptorSetLayoutCreateFlags flags = {});
+	// bindingFlags is either empty or has one element per binding
+	VkDescriptorSetLayout createDescriptorSetLayout(CSpan<DescriptorSetLayoutBindingInfo> bindings, DescriptorSetLayoutCreateFlags flags = {}, CSpan<DescriptorBindingFlags> bindingFlags = {});
 	void destroyDescriptorSetLayout(VkDescriptorSetLayout descSetLayout);
 
 	VkDescriptorPool createDescriptorPool(u32 maxSets, CSpan<VkDescriptorPoolSize> maxPerType, DescPoolOptions options);
@@ -1033,6 +1103,9 @@ struct Device
 	VkResult allocDescriptorSets(VkDescriptorPool pool, CSpan<VkDescriptorSetLayout> layouts, std::span<VkDescriptorSet> descSets);
 	VkResult allocDescriptorSets(VkDescriptorPool pool, VkDescriptorSetLayout layout, std::span<VkDescriptorSet> descSets);
 	void freeDescriptorSets(VkDescriptorPool pool, CSpan<VkDescriptorSet> descSets);
+	VkDescriptorUpdateTemplate createDescriptorUpdateTemplate(VkDescriptorSetLayout layout, CSpan<DescriptorUpdateTemplateEntry> entries);
+	void destroyDescriptorUpdateTemplate(VkDescriptorUpdateTemplate updateTemplate);
+	void updateDescriptorSetWithTemplate(VkDescriptorSet descSet, VkDescriptorUpdateTemplate updateTemplate, const void* data);
 	void freeDescriptorSet(VkDescriptorPool pool, VkDescriptorSet descSet) { freeDescriptorSets(pool, { &descSet, 1 }); }
 
 	void updateDescriptorSets(CSpan<DescriptorSetArrayWrite> writes, CSpan<DescriptorSetArrayCopy> copies);
@@ -1069,7 +1142,7 @@ struct Device
 	void destroyPipeline(VkPipeline pipeline);
 
 	void submit(VkQueue queue, CSpan<SubmitInfo> submits, VkFence signalFence = VK_NULL_HANDLE);
-	void submit(VkQueue queue, std::initializer_list<SubmitInfo> submits, VkFence signalFence = VK_NULL_HANDLE) { submit(queue, CSpan(submits.begin(), submits.end()), signalFence); }
+	void submit(VkQueue queue, std::initializer_list<SubmitInfo> submits, VkFence signalFence = VK_NULL_HANDLE) { submit(queue, CSpan<SubmitInfo>(submits.begin(), submits.end()), signalFence); }
 
 	void getSupportedSurfaceFormats(VkSurfaceKHR surface, u32& count, SurfaceFormat* formats);
 	SurfaceFormat getBasicSupportedSurfaceFormat(VkSurfaceKHR surface);
@@ -1085,9 +1158,17 @@ struct SwapchainOptions {
 	SurfaceFormat format = { .format = Format::undefined, .colorSpace = VK_COLORSPACE_SRGB_NONLINEAR_KHR };
 };
 
+// headless mode: there is no surface, we render to a ring of images that we own
+struct HeadlessSwapchainOptions {
+	u32 numImages = 2;
+	u32 w, h;
+	Format format = Format::RGBA8_SRGB;
+};
+
 struct Swapchain {
 	static constexpr u32 MAX_IMAGES = 4;
 	VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+	bool headless = false;
 	u32 numImages = 0;
 	u32 w, h;
 	VkSurfaceKHR surface = VK_NULL_HANDLE;
@@ -1107,9 +1188,10 @@ struct SwapchainSyncHelper : Swapchain {
 	//VkCommandBuffer cmdBuffers_draw[MAX_IMAGES];
 	//VkCommandBuffer cmdBuffers_transfer[MAX_IMAGES];
 
-	void acquireNextImage(Device& device);
+	void acquireNextImage(Device& device); // (headless: just advances to the next image of the ring)
 	void waitCanStartFrame(Device& device);
-	void present(VkQueue queue);
+	void waitFrameFinished(Device& device, u32 ind); // waits for the last submission that used the image "ind". Doesn't reset the fence
+	void present(VkQueue queue); // (headless: does nothing)
 };
 
 static constexpr CStr default_deviceExtensions[] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
@@ -1138,14 +1220,22 @@ struct PhysicalDeviceFilterAndCompare {
 u32 chooseBestPhysicalDevice(CSpan<PhysicalDeviceInfo> infos, PhysicalDeviceFilterAndCompare fns);
 
 VkResult createDevice(Device& device, VkInstance instance, const PhysicalDeviceInfo& physicalDeviceInfo,
-	CSpan<QueuesCreateInfo> queuesInfos, CSpan<CStr> extensions = default_deviceExtensions);
+	CSpan<QueuesCreateInfo> queuesInfos, CSpan<CStr> extensions = default_deviceExtensions, const DeviceFeatures& features = {});
 
 // create a simple swapchain. If you need also help with synchronization use createSwapchainSynHelper instead
 VkResult createSwapchain(Swapchain& o, VkSurfaceKHR surface, Device& device, const SwapchainOptions& options);
 // create a swapchain with synchronization helpers. Yuo can use createSwapchain instead if you don't want synchronization help done for you
 VkResult createSwapchainSyncHelper(SwapchainSyncHelper& o, VkSurfaceKHR surface, Device& device, const SwapchainOptions& options);
+VkResult createHeadlessSwapchainSyncHelper(SwapchainSyncHelper& o, Device& device, const HeadlessSwapchainOptions& options);
 
 bool formatIsColor(Format format);
+bool formatIsCompressed(Format format);
+// the size of a texel. For compressed formats, the size of a block of texels
+struct FormatBlockInfo {
+	u8 w = 1, h = 1;
+	u8 bytes;
+};
+FormatBlockInfo getFormatBlockInfo(Format format);
 bool formatIsDepth(Format format);
 bool formatIsStencil(Format format);
 
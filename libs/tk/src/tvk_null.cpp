@@ -0,0 +1,881 @@
+#ifdef TVK_NULL_BACKEND
+
+#include "tvk_null.hpp"
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+namespace tk {
+namespace vk {
+namespace null {
+
+namespace
+{
+
+struct NullCmdBuffer {
+	std::vector<u32> stream;
+};
+
+struct NullAllocation {
+	u32 memoryType;
+	VkDeviceSize size;
+	void* userData;
+	std::unique_ptr<u8[]> mem; // only for host-visible memory
+};
+
+// memory type 0 is device local, and memory type 1 is host visible
+const VkMemoryPropertyFlags k_memTypeProps[] = {
+	VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+	VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+};
+
+const VkExtensionProperties k_deviceExtensions[] = {
+	{ VK_KHR_SWAPCHAIN_EXTENSION_NAME, 1 },
+	{ VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME, 1 },
+};
+
+// the queue families are ordered like in most desktop drivers: the first one can do everything, and the second one is transfer-only
+const VkQueueFamilyProperties k_queueFamilies[] = {
+	{ .queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT, .queueCount = 1, .timestampValidBits = 64, .minImageTransferGranularity = {1, 1, 1} },
+	{ .queueFlags = VK_QUEUE_TRANSFER_BIT, .queueCount = 1, .timestampValidBits = 64, .minImageTransferGranularity = {1, 1, 1} },
+};
+
+std::atomic<u64> s_lastHandle = 0;
+
+// the state that the fake objects need. They can be created from any thread
+std::mutex s_mutex;
+std::unordered_map<VkImage, VkDeviceSize> s_imageSizes;
+std::unordered_map<VkSemaphore, u64> s_semaphoreValues; // timeline semaphores
+std::unordered_map<VkSwapchainKHR, std::pair<u32, u32>> s_swapchains; // numImages, last acquired image
+SubmitStats s_submitStats;
+
+// the non-dispatchable handles are just increasing ids
+template <typename H>
+H makeHandle()
+{
+	return H(uintptr_t(++s_lastHandle));
+}
+
+template <typename H>
+void makeHandles(H* handles, u32 count)
+{
+	for (u32 i = 0; i < count; i++)
+		handles[i] = makeHandle<H>();
+}
+
+template <typename H>
+u32 handleId(H handle)
+{
+	return u32(uintptr_t(handle));
+}
+
+NullCmdBuffer& getCmdBuffer(VkCommandBuffer cmdBuffer)
+{
+	return *reinterpret_cast<NullCmdBuffer*>(cmdBuffer);
+}
+
+void record(VkCommandBuffer cmdBuffer, Cmd cmd, std::initializer_list<u32> args)
+{
+	auto& stream = getCmdBuffer(cmdBuffer).stream;
+	stream.push_back(u32(cmd) | (u32(args.size()) << 8));
+	stream.insert(stream.end(), args.begin(), args.end());
+}
+
+template <typename H>
+void recordWithHandles(VkCommandBuffer cmdBuffer, Cmd cmd, u32 first, u32 count, const H* handles)
+{
+	auto& stream = getCmdBuffer(cmdBuffer).stream;
+	stream.push_back(u32(cmd) | ((2 + count) << 8));
+	stream.push_back(first);
+	stream.push_back(count);
+	for (u32 i = 0; i < count; i++)
+		stream.push_back(handleId(handles[i]));
+}
+
+VkDeviceSize computeImageSize(const VkImageCreateInfo& info)
+{
+	const Format format = Format(info.format);
+	FormatBlockInfo block;
+	if (formatIsDepth(format) || formatIsStencil(format))
+		block = { .bytes = u8(format == Format::D32_SFLOAT_S8_UINT ? 8 : 4) };
+	else
+		block = getFormatBlockInfo(format);
+
+	VkDeviceSize size = 0;
+	u32 w = info.extent.width, h = info.extent.height, d = info.extent.depth;
+	for (u32 mip = 0; mip < info.mipLevels; mip++) {
+		size += VkDeviceSize((w + block.w - 1) / block.w) * ((h + block.h - 1) / block.h) * d * block.bytes;
+		w = std::max(1u, w / 2);
+		h = std::max(1u, h / 2);
+		d = std::max(1u, d / 2);
+	}
+	return size * info.arrayLayers * info.samples;
+}
+
+NullAllocation* makeAllocation(u32 memoryType, VkDeviceSize size, void* userData, VmaAllocation* pAllocation, VmaAllocationInfo* pAllocationInfo)
+{
+	auto alloc = new NullAllocation{ memoryType, size, userData };
+	if (k_memTypeProps[memoryType] & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		alloc->mem.reset(new u8[size]);
+	*pAllocation = reinterpret_cast<VmaAllocation>(alloc);
+	if (pAllocationInfo)
+		null::vmaGetAllocationInfo(VK_NULL_HANDLE, *pAllocation, pAllocationInfo);
+	return alloc;
+}
+
+NullAllocation& getAllocation(VmaAllocation allocation)
+{
+	return *reinterpret_cast<NullAllocation*>(allocation);
+}
+
+u32 chooseMemoryType(const VmaAllocationCreateInfo& info)
+{
+	if (info.memoryTypeBits) {
+		const u32 memoryType = u32(std::countr_zero(info.memoryTypeBits));
+		assert(memoryType < std::size(k_memTypeProps));
+		return memoryType;
+	}
+	const VmaAllocationCreateFlags hostAccess = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
+	return (info.flags & hostAccess) ? 1 : 0;
+}
+
+} // namespace (static funcs)
+
+const char* toString(Cmd cmd)
+{
+	static const char* k_names[] = {
+		"beginRenderPass",
+		"endRenderPass",
+		"bindPipeline",
+		"bindDescriptorSets",
+		"bindVertexBuffers",
+		"bindIndexBuffer",
+		"pushConstants",
+		"setViewport",
+		"setScissor",
+		"setCullMode",
+		"draw",
+		"drawIndexed",
+		"pipelineBarrier",
+		"copyBuffer",
+		"copyBufferToImage",
+		"copyImageToBuffer",
+		"blitImage",
+		"resetQueryPool",
+		"writeTimestamp",
+	};
+	static_assert(std::size(k_names) == size_t(Cmd::COUNT));
+	assert(cmd < Cmd::COUNT);
+	return k_names[u32(cmd)];
+}
+
+CSpan<u32> getCmdStream(VkCommandBuffer cmdBuffer)
+{
+	return getCmdBuffer(cmdBuffer).stream;
+}
+
+u32 CmdCounts::total()const
+{
+	u32 n = 0;
+	for (u32 c : counts)
+		n += c;
+	return n;
+}
+
+void CmdCounts::add(const CmdCounts& o)
+{
+	for (u32 i = 0; i < u32(Cmd::COUNT); i++)
+		counts[i] += o.counts[i];
+}
+
+CmdCounts countCmds(CSpan<u32> stream)
+{
+	CmdCounts counts;
+	forEachCmd(stream, [&](Cmd cmd, CSpan<u32>) {
+		counts.counts[u32(cmd)]++;
+	});
+	return counts;
+}
+
+SubmitStats getSubmitStats()
+{
+	std::lock_guard lock(s_mutex);
+	return s_submitStats;
+}
+
+void resetSubmitStats()
+{
+	std::lock_guard lock(s_mutex);
+	s_submitStats = {};
+}
+
+// --- instance and physical device ---
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(const VkInstanceCreateInfo*, const VkAllocationCallbacks*, VkInstance* pInstance)
+{
+	*pInstance = makeHandle<VkInstance>();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyInstance(VkInstance, const VkAllocationCallbacks*) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumeratePhysicalDevices(VkInstance, uint32_t* pPhysicalDeviceCount, VkPhysicalDevice* pPhysicalDevices)
+{
+	if (pPhysicalDevices) {
+		if (*pPhysicalDeviceCount < 1)
+			return VK_INCOMPLETE;
+		static const VkPhysicalDevice physicalDevice = makeHandle<VkPhysicalDevice>();
+		pPhysicalDevices[0] = physicalDevice;
+	}
+	*pPhysicalDeviceCount = 1;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceFeatures(VkPhysicalDevice, VkPhysicalDeviceFeatures* pFeatures)
+{
+	*pFeatures = {
+		.independentBlend = VK_TRUE,
+		.fillModeNonSolid = VK_TRUE,
+		.samplerAnisotropy = VK_TRUE,
+		.textureCompressionBC = VK_TRUE,
+		.shaderSampledImageArrayDynamicIndexing = VK_TRUE,
+	};
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceFeatures2(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures2* pFeatures)
+{
+	null::vkGetPhysicalDeviceFeatures(physicalDevice, &pFeatures->features);
+	for (auto p = (VkBaseOutStructure*)pFeatures->pNext; p; p = p->pNext) {
+		switch (p->sType) {
+		case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT:
+			((VkPhysicalDeviceExtendedDynamicStateFeaturesEXT*)p)->extendedDynamicState = VK_TRUE;
+			break;
+		case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES:
+			((VkPhysicalDeviceTimelineSemaphoreFeatures*)p)->timelineSemaphore = VK_TRUE;
+			break;
+		case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES: {
+			auto& f = *(VkPhysicalDeviceDescriptorIndexingFeatures*)p;
+			f.runtimeDescriptorArray = VK_TRUE;
+			f.descriptorBindingPartiallyBound = VK_TRUE;
+			f.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+			f.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+			break;
+		}
+		default:
+			break;
+		}
+	}
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties(VkPhysicalDevice, VkPhysicalDeviceProperties* pProperties)
+{
+	*pProperties = {
+		.apiVersion = VK_API_VERSION_1_3,
+		.driverVersion = 1,
+		.deviceType = VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU,
+		.deviceName = "tvk null device",
+	};
+	auto& limits = pProperties->limits;
+	limits.maxImageDimension2D = 16384;
+	limits.maxUniformBufferRange = 65536;
+	limits.maxStorageBufferRange = 1u << 30;
+	limits.maxPushConstantsSize = 256;
+	limits.maxPerStageDescriptorSamplers = 1u << 20;
+	limits.maxPerStageDescriptorSampledImages = 1u << 20;
+	limits.maxDescriptorSetSamplers = 1u << 20;
+	limits.maxDescriptorSetSampledImages = 1u << 20;
+	limits.maxSamplerAnisotropy = 16;
+	limits.minUniformBufferOffsetAlignment = 64;
+	limits.minStorageBufferOffsetAlignment = 64;
+	limits.nonCoherentAtomSize = 64;
+	limits.timestampComputeAndGraphics = VK_TRUE;
+	limits.timestampPeriod = 1;
+	limits.framebufferColorSampleCounts = limits.framebufferDepthSampleCounts = VK_SAMPLE_COUNT_1_BIT | VK_SAMPLE_COUNT_4_BIT;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties2(VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties2* pProperties)
+{
+	null::vkGetPhysicalDeviceProperties(physicalDevice, &pProperties->properties);
+	for (auto p = (VkBaseOutStructure*)pProperties->pNext; p; p = p->pNext) {
+		if (p->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES) {
+			auto& props = *(VkPhysicalDeviceDescriptorIndexingProperties*)p;
+			props.maxPerStageDescriptorUpdateAfterBindSamplers = 1u << 20;
+			props.maxPerStageDescriptorUpdateAfterBindSampledImages = 1u << 20;
+			props.maxDescriptorSetUpdateAfterBindSamplers = 1u << 20;
+			props.maxDescriptorSetUpdateAfterBindSampledImages = 1u << 20;
+		}
+	}
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(VkPhysicalDevice, VkPhysicalDeviceMemoryProperties* pMemoryProperties)
+{
+	*pMemoryProperties = {
+		.memoryTypeCount = u32(std::size(k_memTypeProps)),
+		.memoryHeapCount = 2,
+	};
+	for (u32 i = 0; i < u32(std::size(k_memTypeProps)); i++)
+		pMemoryProperties->memoryTypes[i] = { .propertyFlags = k_memTypeProps[i], .heapIndex = i };
+	pMemoryProperties->memoryHeaps[0] = { .size = 8ull << 30, .flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT };
+	pMemoryProperties->memoryHeaps[1] = { .size = 8ull << 30, .flags = 0 };
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceQueueFamilyProperties(VkPhysicalDevice, uint32_t* pQueueFamilyPropertyCount, VkQueueFamilyProperties* pQueueFamilyProperties)
+{
+	if (pQueueFamilyProperties) {
+		*pQueueFamilyPropertyCount = std::min(*pQueueFamilyPropertyCount, u32(std::size(k_queueFamilies)));
+		for (u32 i = 0; i < *pQueueFamilyPropertyCount; i++)
+			pQueueFamilyProperties[i] = k_queueFamilies[i];
+	}
+	else {
+		*pQueueFamilyPropertyCount = u32(std::size(k_queueFamilies));
+	}
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceImageFormatProperties(VkPhysicalDevice, VkFormat, VkImageType, VkImageTiling,
+	VkImageUsageFlags, VkImageCreateFlags, VkImageFormatProperties* pImageFormatProperties)
+{
+	*pImageFormatProperties = {
+		.maxExtent = {16384, 16384, 1},
+		.maxMipLevels = 15,
+		.maxArrayLayers = 2048,
+		.sampleCounts = VK_SAMPLE_COUNT_1_BIT,
+		.maxResourceSize = 1ull << 32,
+	};
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceExtensionProperties(VkPhysicalDevice, const char*, uint32_t* pPropertyCount, VkExtensionProperties* pProperties)
+{
+	if (pProperties) {
+		const u32 n = std::min(*pPropertyCount, u32(std::size(k_deviceExtensions)));
+		for (u32 i = 0; i < n; i++)
+			pProperties[i] = k_deviceExtensions[i];
+		const bool incomplete = n < std::size(k_deviceExtensions);
+		*pPropertyCount = n;
+		return incomplete ? VK_INCOMPLETE : VK_SUCCESS;
+	}
+	*pPropertyCount = u32(std::size(k_deviceExtensions));
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceSupportKHR(VkPhysicalDevice, uint32_t queueFamilyIndex, VkSurfaceKHR, VkBool32* pSupported)
+{
+	*pSupported = queueFamilyIndex == 0;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceCapabilitiesKHR(VkPhysicalDevice, VkSurfaceKHR, VkSurfaceCapabilitiesKHR* pSurfaceCapabilities)
+{
+	*pSurfaceCapabilities = {
+		.minImageCount = 2,
+		.maxImageCount = Swapchain::MAX_IMAGES,
+		.currentExtent = {u32(-1), u32(-1)}, // the size is decided by the swapchain
+		.minImageExtent = {1, 1},
+		.maxImageExtent = {16384, 16384},
+		.maxImageArrayLayers = 1,
+		.supportedTransforms = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
+		.currentTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
+		.supportedCompositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
+		.supportedUsageFlags = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+	};
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceFormatsKHR(VkPhysicalDevice, VkSurfaceKHR, uint32_t* pSurfaceFormatCount, VkSurfaceFormatKHR* pSurfaceFormats)
+{
+	if (pSurfaceFormats) {
+		if (*pSurfaceFormatCount < 1)
+			return VK_INCOMPLETE;
+		pSurfaceFormats[0] = { VK_FORMAT_B8G8R8A8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
+	}
+	*pSurfaceFormatCount = 1;
+	return VK_SUCCESS;
+}
+
+// --- device ---
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(VkPhysicalDevice, const VkDeviceCreateInfo*, const VkAllocationCallbacks*, VkDevice* pDevice)
+{
+	*pDevice = makeHandle<VkDevice>();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(VkDevice, const char* pName)
+{
+	const std::string_view name = pName;
+	if (name == "vkCmdSetCullMode" || name == "vkCmdSetCullModeEXT")
+		return PFN_vkVoidFunction(&vkCmdSetCullMode);
+	if (name == "vkGetSemaphoreCounterValue" || name == "vkGetSemaphoreCounterValueKHR")
+		return PFN_vkVoidFunction(&vkGetSemaphoreCounterValue);
+	if (name == "vkWaitSemaphores" || name == "vkWaitSemaphoresKHR")
+		return PFN_vkVoidFunction(&vkWaitSemaphores);
+	printf("the null backend doesn't implement %s\n", pName);
+	return nullptr;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetDeviceQueue(VkDevice, uint32_t, uint32_t, VkQueue* pQueue)
+{
+	*pQueue = makeHandle<VkQueue>();
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkDeviceWaitIdle(VkDevice) { return VK_SUCCESS; }
+
+// --- swapchain ---
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSwapchainKHR(VkDevice, const VkSwapchainCreateInfoKHR* pCreateInfo, const VkAllocationCallbacks*, VkSwapchainKHR* pSwapchain)
+{
+	*pSwapchain = makeHandle<VkSwapchainKHR>();
+	std::lock_guard lock(s_mutex);
+	s_swapchains[*pSwapchain] = { pCreateInfo->minImageCount, pCreateInfo->minImageCount - 1 };
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetSwapchainImagesKHR(VkDevice, VkSwapchainKHR swapchain, uint32_t* pSwapchainImageCount, VkImage* pSwapchainImages)
+{
+	std::lock_guard lock(s_mutex);
+	const u32 numImages = s_swapchains[swapchain].first;
+	if (pSwapchainImages) {
+		if (*pSwapchainImageCount < numImages)
+			return VK_INCOMPLETE;
+		makeHandles(pSwapchainImages, numImages);
+	}
+	*pSwapchainImageCount = numImages;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAcquireNextImageKHR(VkDevice, VkSwapchainKHR swapchain, uint64_t, VkSemaphore, VkFence, uint32_t* pImageIndex)
+{
+	std::lock_guard lock(s_mutex);
+	auto& [numImages, imgInd] = s_swapchains[swapchain];
+	imgInd = (imgInd + 1) % numImages;
+	*pImageIndex = imgInd;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueuePresentKHR(VkQueue, const VkPresentInfoKHR* pPresentInfo)
+{
+	if (pPresentInfo->pResults) {
+		for (u32 i = 0; i < pPresentInfo->swapchainCount; i++)
+			pPresentInfo->pResults[i] = VK_SUCCESS;
+	}
+	return VK_SUCCESS;
+}
+
+// --- synchronization ---
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSemaphore(VkDevice, const VkSemaphoreCreateInfo* pCreateInfo, const VkAllocationCallbacks*, VkSemaphore* pSemaphore)
+{
+	*pSemaphore = makeHandle<VkSemaphore>();
+	for (auto p = (const VkBaseInStructure*)pCreateInfo->pNext; p; p = p->pNext) {
+		if (p->sType == VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO) {
+			std::lock_guard lock(s_mutex);
+			s_semaphoreValues[*pSemaphore] = ((const VkSemaphoreTypeCreateInfo*)p)->initialValue;
+		}
+	}
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySemaphore(VkDevice, VkSemaphore semaphore, const VkAllocationCallbacks*)
+{
+	std::lock_guard lock(s_mutex);
+	s_semaphoreValues.erase(semaphore);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetSemaphoreCounterValue(VkDevice, VkSemaphore semaphore, uint64_t* pValue)
+{
+	std::lock_guard lock(s_mutex);
+	*pValue = s_semaphoreValues[semaphore];
+	return VK_SUCCESS;
+}
+
+// the values are signaled at submit time, so there is never anything to wait for
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitSemaphores(VkDevice, const VkSemaphoreWaitInfo*, uint64_t) { return VK_SUCCESS; }
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateFence(VkDevice, const VkFenceCreateInfo*, const VkAllocationCallbacks*, VkFence* pFence)
+{
+	*pFence = makeHandle<VkFence>();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyFence(VkDevice, VkFence, const VkAllocationCallbacks*) {}
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitForFences(VkDevice, uint32_t, const VkFence*, VkBool32, uint64_t) { return VK_SUCCESS; }
+VKAPI_ATTR VkResult VKAPI_CALL vkResetFences(VkDevice, uint32_t, const VkFence*) { return VK_SUCCESS; }
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence)
+{
+	std::lock_guard lock(s_mutex);
+	for (u32 submitI = 0; submitI < submitCount; submitI++) {
+		const auto& submit = pSubmits[submitI];
+		for (u32 i = 0; i < submit.commandBufferCount; i++)
+			s_submitStats.cmdCounts.add(countCmds(getCmdStream(submit.pCommandBuffers[i])));
+		s_submitStats.numCmdBuffers += submit.commandBufferCount;
+
+		for (auto p = (const VkBaseInStructure*)submit.pNext; p; p = p->pNext) {
+			if (p->sType == VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO) {
+				const auto& timelineInfo = *(const VkTimelineSemaphoreSubmitInfo*)p;
+				for (u32 i = 0; i < timelineInfo.signalSemaphoreValueCount; i++) {
+					auto it = s_semaphoreValues.find(submit.pSignalSemaphores[i]);
+					if (it != s_semaphoreValues.end())
+						it->second = timelineInfo.pSignalSemaphoreValues[i];
+				}
+			}
+		}
+	}
+	s_submitStats.numSubmits++;
+	return VK_SUCCESS;
+}
+
+// --- queries ---
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateQueryPool(VkDevice, const VkQueryPoolCreateInfo*, const VkAllocationCallbacks*, VkQueryPool* pQueryPool)
+{
+	*pQueryPool = makeHandle<VkQueryPool>();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyQueryPool(VkDevice, VkQueryPool, const VkAllocationCallbacks*) {}
+
+// the GPU takes no time
+VKAPI_ATTR VkResult VKAPI_CALL vkGetQueryPoolResults(VkDevice, VkQueryPool, uint32_t, uint32_t, size_t dataSize, void* pData, VkDeviceSize, VkQueryResultFlags)
+{
+	memset(pData, 0, dataSize);
+	return VK_SUCCESS;
+}
+
+// --- images and samplers ---
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateImage(VkDevice, const VkImageCreateInfo* pCreateInfo, const VkAllocationCallbacks*, VkImage* pImage)
+{
+	*pImage = makeHandle<VkImage>();
+	std::lock_guard lock(s_mutex);
+	s_imageSizes[*pImage] = computeImageSize(*pCreateInfo);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyImage(VkDevice, VkImage image, const VkAllocationCallbacks*)
+{
+	std::lock_guard lock(s_mutex);
+	s_imageSizes.erase(image);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements(VkDevice, VkImage image, VkMemoryRequirements* pMemoryRequirements)
+{
+	std::lock_guard lock(s_mutex);
+	*pMemoryRequirements = {
+		.size = s_imageSizes[image],
+		.alignment = 256,
+		.memoryTypeBits = 1u << 0,
+	};
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateImageView(VkDevice, const VkImageViewCreateInfo*, const VkAllocationCallbacks*, VkImageView* pView)
+{
+	*pView = makeHandle<VkImageView>();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyImageView(VkDevice, VkImageView, const VkAllocationCallbacks*) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSampler(VkDevice, const VkSamplerCreateInfo*, const VkAllocationCallbacks*, VkSampler* pSampler)
+{
+	*pSampler = makeHandle<VkSampler>();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySampler(VkDevice, VkSampler, const VkAllocationCallbacks*) {}
+
+// --- cmd buffers ---
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateCommandPool(VkDevice, const VkCommandPoolCreateInfo*, const VkAllocationCallbacks*, VkCommandPool* pCommandPool)
+{
+	*pCommandPool = makeHandle<VkCommandPool>();
+	return VK_SUCCESS;
+}
+
+// tvk never frees cmd buffers, they live as long as the device
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers(VkDevice, const VkCommandBufferAllocateInfo* pAllocateInfo, VkCommandBuffer* pCommandBuffers)
+{
+	for (u32 i = 0; i < pAllocateInfo->commandBufferCount; i++)
+		pCommandBuffers[i] = reinterpret_cast<VkCommandBuffer>(new NullCmdBuffer);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBeginCommandBuffer(VkCommandBuffer commandBuffer, const VkCommandBufferBeginInfo*)
+{
+	getCmdBuffer(commandBuffer).stream.clear();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEndCommandBuffer(VkCommandBuffer) { return VK_SUCCESS; }
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetCommandBuffer(VkCommandBuffer commandBuffer, VkCommandBufferResetFlags)
+{
+	getCmdBuffer(commandBuffer).stream.clear();
+	return VK_SUCCESS;
+}
+
+// --- descriptors ---
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorSetLayout(VkDevice, const VkDescriptorSetLayoutCreateInfo*, const VkAllocationCallbacks*, VkDescriptorSetLayout* pSetLayout)
+{
+	*pSetLayout = makeHandle<VkDescriptorSetLayout>();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorSetLayout(VkDevice, VkDescriptorSetLayout, const VkAllocationCallbacks*) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorPool(VkDevice, const VkDescriptorPoolCreateInfo*, const VkAllocationCallbacks*, VkDescriptorPool* pDescriptorPool)
+{
+	*pDescriptorPool = makeHandle<VkDescriptorPool>();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorPool(VkDevice, VkDescriptorPool, const VkAllocationCallbacks*) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateDescriptorSets(VkDevice, const VkDescriptorSetAllocateInfo* pAllocateInfo, VkDescriptorSet* pDescriptorSets)
+{
+	makeHandles(pDescriptorSets, pAllocateInfo->descriptorSetCount);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkFreeDescriptorSets(VkDevice, VkDescriptorPool, uint32_t, const VkDescriptorSet*) { return VK_SUCCESS; }
+VKAPI_ATTR void VKAPI_CALL vkUpdateDescriptorSets(VkDevice, uint32_t, const VkWriteDescriptorSet*, uint32_t, const VkCopyDescriptorSet*) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorUpdateTemplate(VkDevice, const VkDescriptorUpdateTemplateCreateInfo*, const VkAllocationCallbacks*,
+	VkDescriptorUpdateTemplate* pDescriptorUpdateTemplate)
+{
+	*pDescriptorUpdateTemplate = makeHandle<VkDescriptorUpdateTemplate>();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorUpdateTemplate(VkDevice, VkDescriptorUpdateTemplate, const VkAllocationCallbacks*) {}
+VKAPI_ATTR void VKAPI_CALL vkUpdateDescriptorSetWithTemplate(VkDevice, VkDescriptorSet, VkDescriptorUpdateTemplate, const void*) {}
+
+// --- render passes and pipelines ---
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateRenderPass(VkDevice, const VkRenderPassCreateInfo*, const VkAllocationCallbacks*, VkRenderPass* pRenderPass)
+{
+	*pRenderPass = makeHandle<VkRenderPass>();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyRenderPass(VkDevice, VkRenderPass, const VkAllocationCallbacks*) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateFramebuffer(VkDevice, const VkFramebufferCreateInfo*, const VkAllocationCallbacks*, VkFramebuffer* pFramebuffer)
+{
+	*pFramebuffer = makeHandle<VkFramebuffer>();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyFramebuffer(VkDevice, VkFramebuffer, const VkAllocationCallbacks*) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateShaderModule(VkDevice, const VkShaderModuleCreateInfo*, const VkAllocationCallbacks*, VkShaderModule* pShaderModule)
+{
+	*pShaderModule = makeHandle<VkShaderModule>();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreatePipelineLayout(VkDevice, const VkPipelineLayoutCreateInfo*, const VkAllocationCallbacks*, VkPipelineLayout* pPipelineLayout)
+{
+	*pPipelineLayout = makeHandle<VkPipelineLayout>();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipelineLayout(VkDevice, VkPipelineLayout, const VkAllocationCallbacks*) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateGraphicsPipelines(VkDevice, VkPipelineCache, uint32_t createInfoCount, const VkGraphicsPipelineCreateInfo*,
+	const VkAllocationCallbacks*, VkPipeline* pPipelines)
+{
+	makeHandles(pPipelines, createInfoCount);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipeline(VkDevice, VkPipeline, const VkAllocationCallbacks*) {}
+
+// --- commands ---
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBeginRenderPass(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo* pRenderPassBegin, VkSubpassContents)
+{
+	const auto& info = *pRenderPassBegin;
+	record(commandBuffer, Cmd::beginRenderPass, { handleId(info.renderPass), handleId(info.framebuffer), info.renderArea.extent.width, info.renderArea.extent.height });
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdEndRenderPass(VkCommandBuffer commandBuffer)
+{
+	record(commandBuffer, Cmd::endRenderPass, {});
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipeline pipeline)
+{
+	record(commandBuffer, Cmd::bindPipeline, { u32(pipelineBindPoint), handleId(pipeline) });
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint, VkPipelineLayout,
+	uint32_t firstSet, uint32_t descriptorSetCount, const VkDescriptorSet* pDescriptorSets, uint32_t, const uint32_t*)
+{
+	recordWithHandles(commandBuffer, Cmd::bindDescriptorSets, firstSet, descriptorSetCount, pDescriptorSets);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindVertexBuffers(VkCommandBuffer commandBuffer, uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* pBuffers, const VkDeviceSize*)
+{
+	recordWithHandles(commandBuffer, Cmd::bindVertexBuffers, firstBinding, bindingCount, pBuffers);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindIndexBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType)
+{
+	record(commandBuffer, Cmd::bindIndexBuffer, { handleId(buffer), u32(offset), u32(indexType) });
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPushConstants(VkCommandBuffer commandBuffer, VkPipelineLayout, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void*)
+{
+	record(commandBuffer, Cmd::pushConstants, { stageFlags, offset, size });
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetViewport(VkCommandBuffer commandBuffer, uint32_t firstViewport, uint32_t viewportCount, const VkViewport*)
+{
+	record(commandBuffer, Cmd::setViewport, { firstViewport, viewportCount });
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetScissor(VkCommandBuffer commandBuffer, uint32_t firstScissor, uint32_t scissorCount, const VkRect2D*)
+{
+	record(commandBuffer, Cmd::setScissor, { firstScissor, scissorCount });
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetCullMode(VkCommandBuffer commandBuffer, VkCullModeFlags cullMode)
+{
+	record(commandBuffer, Cmd::setCullMode, { cullMode });
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+{
+	record(commandBuffer, Cmd::draw, { vertexCount, instanceCount, firstVertex, firstInstance });
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance)
+{
+	record(commandBuffer, Cmd::drawIndexed, { indexCount, instanceCount, firstIndex, u32(vertexOffset), firstInstance });
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags,
+	uint32_t memoryBarrierCount, const VkMemoryBarrier*,
+	uint32_t bufferMemoryBarrierCount, const VkBufferMemoryBarrier*,
+	uint32_t imageMemoryBarrierCount, const VkImageMemoryBarrier*)
+{
+	record(commandBuffer, Cmd::pipelineBarrier, { srcStageMask, dstStageMask, memoryBarrierCount, bufferMemoryBarrierCount, imageMemoryBarrierCount });
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, uint32_t regionCount, const VkBufferCopy*)
+{
+	record(commandBuffer, Cmd::copyBuffer, { handleId(srcBuffer), handleId(dstBuffer), regionCount });
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkImage dstImage, VkImageLayout,
+	uint32_t regionCount, const VkBufferImageCopy*)
+{
+	record(commandBuffer, Cmd::copyBufferToImage, { handleId(srcBuffer), handleId(dstImage), regionCount });
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyImageToBuffer(VkCommandBuffer commandBuffer, VkImage srcImage, VkImageLayout, VkBuffer dstBuffer,
+	uint32_t regionCount, const VkBufferImageCopy*)
+{
+	record(commandBuffer, Cmd::copyImageToBuffer, { handleId(srcImage), handleId(dstBuffer), regionCount });
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBlitImage(VkCommandBuffer commandBuffer, VkImage srcImage, VkImageLayout, VkImage dstImage, VkImageLayout,
+	uint32_t regionCount, const VkImageBlit*, VkFilter)
+{
+	record(commandBuffer, Cmd::blitImage, { handleId(srcImage), handleId(dstImage), regionCount });
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdResetQueryPool(VkCommandBuffer commandBuffer, VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount)
+{
+	record(commandBuffer, Cmd::resetQueryPool, { handleId(queryPool), firstQuery, queryCount });
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdWriteTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits pipelineStage, VkQueryPool queryPool, uint32_t query)
+{
+	record(commandBuffer, Cmd::writeTimestamp, { u32(pipelineStage), handleId(queryPool), query });
+}
+
+// --- VMA ---
+
+VkResult vmaCreateAllocator(const VmaAllocatorCreateInfo*, VmaAllocator* pAllocator)
+{
+	*pAllocator = makeHandle<VmaAllocator>();
+	return VK_SUCCESS;
+}
+
+VkResult vmaFindMemoryTypeIndexForBufferInfo(VmaAllocator, const VkBufferCreateInfo*, const VmaAllocationCreateInfo* pAllocationCreateInfo, uint32_t* pMemoryTypeIndex)
+{
+	*pMemoryTypeIndex = chooseMemoryType(*pAllocationCreateInfo);
+	return VK_SUCCESS;
+}
+
+VkResult vmaCreateBuffer(VmaAllocator, const VkBufferCreateInfo* pBufferCreateInfo, const VmaAllocationCreateInfo* pAllocationCreateInfo,
+	VkBuffer* pBuffer, VmaAllocation* pAllocation, VmaAllocationInfo* pAllocationInfo)
+{
+	*pBuffer = makeHandle<VkBuffer>();
+	makeAllocation(chooseMemoryType(*pAllocationCreateInfo), pBufferCreateInfo->size, pAllocationCreateInfo->pUserData, pAllocation, pAllocationInfo);
+	return VK_SUCCESS;
+}
+
+void vmaDestroyBuffer(VmaAllocator, VkBuffer, VmaAllocation allocation)
+{
+	delete &getAllocation(allocation);
+}
+
+VkResult vmaCreateImage(VmaAllocator, const VkImageCreateInfo* pImageCreateInfo, const VmaAllocationCreateInfo* pAllocationCreateInfo,
+	VkImage* pImage, VmaAllocation* pAllocation, VmaAllocationInfo* pAllocationInfo)
+{
+	null::vkCreateImage(VK_NULL_HANDLE, pImageCreateInfo, nullptr, pImage);
+	VkMemoryRequirements memReqs;
+	null::vkGetImageMemoryRequirements(VK_NULL_HANDLE, *pImage, &memReqs);
+	makeAllocation(0, memReqs.size, pAllocationCreateInfo->pUserData, pAllocation, pAllocationInfo);
+	return VK_SUCCESS;
+}
+
+void vmaDestroyImage(VmaAllocator, VkImage image, VmaAllocation allocation)
+{
+	null::vkDestroyImage(VK_NULL_HANDLE, image, nullptr);
+	delete &getAllocation(allocation);
+}
+
+VkResult vmaBindImageMemory(VmaAllocator, VmaAllocation, VkImage) { return VK_SUCCESS; }
+
+void vmaGetAllocationInfo(VmaAllocator, VmaAllocation allocation, VmaAllocationInfo* pAllocationInfo)
+{
+	const auto& alloc = getAllocation(allocation);
+	*pAllocationInfo = {
+		.memoryType = alloc.memoryType,
+		.size = alloc.size,
+		.pMappedData = alloc.mem.get(),
+		.pUserData = alloc.userData,
+	};
+}
+
+void vmaGetAllocationMemoryProperties(VmaAllocator, VmaAllocation allocation, VkMemoryPropertyFlags* pFlags)
+{
+	*pFlags = k_memTypeProps[getAllocation(allocation).memoryType];
+}
+
+VkResult vmaMapMemory(VmaAllocator, VmaAllocation allocation, void** ppData)
+{
+	auto& alloc = getAllocation(allocation);
+	if (!alloc.mem)
+		return VK_ERROR_MEMORY_MAP_FAILED;
+	*ppData = alloc.mem.get();
+	return VK_SUCCESS;
+}
+
+// the memory is coherent
+VkResult vmaFlushAllocation(VmaAllocator, VmaAllocation, VkDeviceSize, VkDeviceSize) { return VK_SUCCESS; }
+VkResult vmaInvalidateAllocation(VmaAllocator, VmaAllocation, VkDeviceSize, VkDeviceSize) { return VK_SUCCESS; }
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,300 @@
+#pragma once
+
+#ifdef TVK_NULL_BACKEND
+
+#include "tvk.hpp"
+
+// Null backend, enabled with the TK_VK_NULL_BACKEND cmake option. The Vulkan (and VMA) entry points used by tvk are replaced by a fake device, so no driver is needed:
+// - the objects are just fake handles
+// - the buffer memory is host memory, so mapping works
+// - the GPU work finishes instantly: fences and semaphores are signaled at submit time
+// - the commands are recorded into a compact stream, which can be inspected and counted
+// It's meant for measuring the CPU cost of the renderer, and checking how many commands it records
+namespace tk {
+namespace vk {
+namespace null {
+
+enum class Cmd : u8 {
+	beginRenderPass, // renderPass, framebuffer, w, h
+	endRenderPass,
+	bindPipeline, // bindPoint, pipeline
+	bindDescriptorSets, // firstSet, numSets, descSets...
+	bindVertexBuffers, // firstBinding, numBindings, buffers...
+	bindIndexBuffer, // buffer, offset, indexType
+	pushConstants, // stages, offset, size
+	setViewport, // first, count
+	setScissor, // first, count
+	setCullMode, // cullMode
+	draw, // numVertices, numInstances, firstVertex, firstInstance
+	drawIndexed, // numIndices, numInstances, firstIndex, vertexOffset, firstInstance
+	pipelineBarrier, // srcStages, dstStages, numMemoryBarriers, numBufferBarriers, numImageBarriers
+	copyBuffer, // src, dst, numRegions
+	copyBufferToImage, // src, dst, numRegions
+	copyImageToBuffer, // src, dst, numRegions
+	blitImage, // src, dst, numRegions
+	resetQueryPool, // pool, firstQuery, numQueries
+	writeTimestamp, // stage, pool, query
+	COUNT
+};
+const char* toString(Cmd cmd);
+
+// Each command is a header word, with the Cmd in the low byte and the number of argument words in the rest, followed by its arguments.
+// The handles are stored as 32-bit ids
+CSpan<u32> getCmdStream(VkCommandBuffer cmdBuffer); // the commands recorded since the last vkBeginCommandBuffer
+
+template <typename F> // f(Cmd cmd, CSpan<u32> args)
+void forEachCmd(CSpan<u32> stream, F&& f)
+{
+	size_t i = 0;
+	while (i < stream.size()) {
+		const u32 header = stream[i];
+		const u32 numArgs = header >> 8;
+		f(Cmd(header & 0xFF), stream.subspan(i + 1, numArgs));
+		i += 1 + numArgs;
+	}
+}
+
+struct CmdCounts {
+	u32 counts[u32(Cmd::COUNT)] = {};
+
+	u32 operator[](Cmd cmd)const { return counts[u32(cmd)]; }
+	u32 total()const;
+	void add(const CmdCounts& o);
+};
+CmdCounts countCmds(CSpan<u32> stream);
+
+// the commands of all the cmd buffers submitted since the last reset
+struct SubmitStats {
+	u64 numSubmits = 0;
+	u64 numCmdBuffers = 0;
+	CmdCounts cmdCounts;
+};
+SubmitStats getSubmitStats();
+void resetSubmitStats();
+
+// Vulkan
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(const VkInstanceCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkInstance* pInstance);
+VKAPI_ATTR void VKAPI_CALL vkDestroyInstance(VkInstance instance, const VkAllocationCallbacks* pAllocator);
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumeratePhysicalDevices(VkInstance instance, uint32_t* pPhysicalDeviceCount, VkPhysicalDevice* pPhysicalDevices);
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceFeatures(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures* pFeatures);
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceFeatures2(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures2* pFeatures);
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties(VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties* pProperties);
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties2(VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties2* pProperties);
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(VkPhysicalDevice physicalDevice, VkPhysicalDeviceMemoryProperties* pMemoryProperties);
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceQueueFamilyProperties(VkPhysicalDevice physicalDevice, uint32_t* pQueueFamilyPropertyCount, VkQueueFamilyProperties* pQueueFamilyProperties);
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceImageFormatProperties(VkPhysicalDevice physicalDevice, VkFormat format, VkImageType type, VkImageTiling tiling,
+	VkImageUsageFlags usage, VkImageCreateFlags flags, VkImageFormatProperties* pImageFormatProperties);
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceExtensionProperties(VkPhysicalDevice physicalDevice, const char* pLayerName, uint32_t* pPropertyCount, VkExtensionProperties* pProperties);
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceSupportKHR(VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex, VkSurfaceKHR surface, VkBool32* pSupported);
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceCapabilitiesKHR(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, VkSurfaceCapabilitiesKHR* pSurfaceCapabilities);
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceFormatsKHR(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, uint32_t* pSurfaceFormatCount, VkSurfaceFormatKHR* pSurfaceFormats);
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDevice* pDevice);
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(VkDevice device, const char* pName);
+VKAPI_ATTR void VKAPI_CALL vkGetDeviceQueue(VkDevice device, uint32_t queueFamilyIndex, uint32_t queueIndex, VkQueue* pQueue);
+VKAPI_ATTR VkResult VKAPI_CALL vkDeviceWaitIdle(VkDevice device);
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSwapchainKHR(VkDevice device, const VkSwapchainCreateInfoKHR* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkSwapchainKHR* pSwapchain);
+VKAPI_ATTR VkResult VKAPI_CALL vkGetSwapchainImagesKHR(VkDevice device, VkSwapchainKHR swapchain, uint32_t* pSwapchainImageCount, VkImage* pSwapchainImages);
+VKAPI_ATTR VkResult VKAPI_CALL vkAcquireNextImageKHR(VkDevice device, VkSwapchainKHR swapchain, uint64_t timeout, VkSemaphore semaphore, VkFence fence, uint32_t* pImageIndex);
+VKAPI_ATTR VkResult VKAPI_CALL vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* pPresentInfo);
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSemaphore(VkDevice device, const VkSemaphoreCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkSemaphore* pSemaphore);
+VKAPI_ATTR void VKAPI_CALL vkDestroySemaphore(VkDevice device, VkSemaphore semaphore, const VkAllocationCallbacks* pAllocator);
+VKAPI_ATTR VkResult VKAPI_CALL vkGetSemaphoreCounterValue(VkDevice device, VkSemaphore semaphore, uint64_t* pValue);
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitSemaphores(VkDevice device, const VkSemaphoreWaitInfo* pWaitInfo, uint64_t timeout);
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateFence(VkDevice device, const VkFenceCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkFence* pFence);
+VKAPI_ATTR void VKAPI_CALL vkDestroyFence(VkDevice device, VkFence fence, const VkAllocationCallbacks* pAllocator);
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitForFences(VkDevice device, uint32_t fenceCount, const VkFence* pFences, VkBool32 waitAll, uint64_t timeout);
+VKAPI_ATTR VkResult VKAPI_CALL vkResetFences(VkDevice device, uint32_t fenceCount, const VkFence* pFences);
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence);
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateQueryPool(VkDevice device, const VkQueryPoolCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkQueryPool* pQueryPool);
+VKAPI_ATTR void VKAPI_CALL vkDestroyQueryPool(VkDevice device, VkQueryPool queryPool, const VkAllocationCallbacks* pAllocator);
+VKAPI_ATTR VkResult VKAPI_CALL vkGetQueryPoolResults(VkDevice device, VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount,
+	size_t dataSize, void* pData, VkDeviceSize stride, VkQueryResultFlags flags);
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateImage(VkDevice device, const VkImageCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkImage* pImage);
+VKAPI_ATTR void VKAPI_CALL vkDestroyImage(VkDevice device, VkImage image, const VkAllocationCallbacks* pAllocator);
+VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements(VkDevice device, VkImage image, VkMemoryRequirements* pMemoryRequirements);
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateImageView(VkDevice device, const VkImageViewCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkImageView* pView);
+VKAPI_ATTR void VKAPI_CALL vkDestroyImageView(VkDevice device, VkImageView imageView, const VkAllocationCallbacks* pAllocator);
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSampler(VkDevice device, const VkSamplerCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkSampler* pSampler);
+VKAPI_ATTR void VKAPI_CALL vkDestroySampler(VkDevice device, VkSampler sampler, const VkAllocationCallbacks* pAllocator);
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateCommandPool(VkDevice device, const VkCommandPoolCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkCommandPool* pCommandPool);
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers(VkDevice device, const VkCommandBufferAllocateInfo* pAllocateInfo, VkCommandBuffer* pCommandBuffers);
+VKAPI_ATTR VkResult VKAPI_CALL vkBeginCommandBuffer(VkCommandBuffer commandBuffer, const VkCommandBufferBeginInfo* pBeginInfo);
+VKAPI_ATTR VkResult VKAPI_CALL vkEndCommandBuffer(VkCommandBuffer commandBuffer);
+VKAPI_ATTR VkResult VKAPI_CALL vkResetCommandBuffer(VkCommandBuffer commandBuffer, VkCommandBufferResetFlags flags);
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorSetLayout(VkDevice device, const VkDescriptorSetLayoutCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDescriptorSetLayout* pSetLayout);
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorSetLayout(VkDevice device, VkDescriptorSetLayout descriptorSetLayout, const VkAllocationCallbacks* pAllocator);
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorPool(VkDevice device, const VkDescriptorPoolCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDescriptorPool* pDescriptorPool);
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorPool(VkDevice device, VkDescriptorPool descriptorPool, const VkAllocationCallbacks* pAllocator);
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateDescriptorSets(VkDevice device, const VkDescriptorSetAllocateInfo* pAllocateInfo, VkDescriptorSet* pDescriptorSets);
+VKAPI_ATTR VkResult VKAPI_CALL vkFreeDescriptorSets(VkDevice device, VkDescriptorPool descriptorPool, uint32_t descriptorSetCount, const VkDescriptorSet* pDescriptorSets);
+VKAPI_ATTR void VKAPI_CALL vkUpdateDescriptorSets(VkDevice device, uint32_t descriptorWriteCount, const VkWriteDescriptorSet* pDescriptorWrites,
+	uint32_t descriptorCopyCount, const VkCopyDescriptorSet* pDescriptorCopies);
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorUpdateTemplate(VkDevice device, const VkDescriptorUpdateTemplateCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator,
+	VkDescriptorUpdateTemplate* pDescriptorUpdateTemplate);
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorUpdateTemplate(VkDevice device, VkDescriptorUpdateTemplate descriptorUpdateTemplate, const VkAllocationCallbacks* pAllocator);
+VKAPI_ATTR void VKAPI_CALL vkUpdateDescriptorSetWithTemplate(VkDevice device, VkDescriptorSet descriptorSet, VkDescriptorUpdateTemplate descriptorUpdateTemplate, const void* pData);
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateRenderPass(VkDevice device, const VkRenderPassCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkRenderPass* pRenderPass);
+VKAPI_ATTR void VKAPI_CALL vkDestroyRenderPass(VkDevice device, VkRenderPass renderPass, const VkAllocationCallbacks* pAllocator);
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateFramebuffer(VkDevice device, const VkFramebufferCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkFramebuffer* pFramebuffer);
+VKAPI_ATTR void VKAPI_CALL vkDestroyFramebuffer(VkDevice device, VkFramebuffer framebuffer, const VkAllocationCallbacks* pAllocator);
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateShaderModule(VkDevice device, const VkShaderModuleCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkShaderModule* pShaderModule);
+VKAPI_ATTR VkResult VKAPI_CALL vkCreatePipelineLayout(VkDevice device, const VkPipelineLayoutCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkPipelineLayout* pPipelineLayout);
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipelineLayout(VkDevice device, VkPipelineLayout pipelineLayout, const VkAllocationCallbacks* pAllocator);
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateGraphicsPipelines(VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount, const VkGraphicsPipelineCreateInfo* pCreateInfos,
+	const VkAllocationCallbacks* pAllocator, VkPipeline* pPipelines);
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipeline(VkDevice device, VkPipeline pipeline, const VkAllocationCallbacks* pAllocator);
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBeginRenderPass(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo* pRenderPassBegin, VkSubpassContents contents);
+VKAPI_ATTR void VKAPI_CALL vkCmdEndRenderPass(VkCommandBuffer commandBuffer);
+VKAPI_ATTR void VKAPI_CALL vkCmdBindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipeline pipeline);
+VKAPI_ATTR void VKAPI_CALL vkCmdBindDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipelineLayout layout,
+	uint32_t firstSet, uint32_t descriptorSetCount, const VkDescriptorSet* pDescriptorSets, uint32_t dynamicOffsetCount, const uint32_t* pDynamicOffsets);
+VKAPI_ATTR void VKAPI_CALL vkCmdBindVertexBuffers(VkCommandBuffer commandBuffer, uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* pBuffers, const VkDeviceSize* pOffsets);
+VKAPI_ATTR void VKAPI_CALL vkCmdBindIndexBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+VKAPI_ATTR void VKAPI_CALL vkCmdPushConstants(VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void* pValues);
+VKAPI_ATTR void VKAPI_CALL vkCmdSetViewport(VkCommandBuffer commandBuffer, uint32_t firstViewport, uint32_t viewportCount, const VkViewport* pViewports);
+VKAPI_ATTR void VKAPI_CALL vkCmdSetScissor(VkCommandBuffer commandBuffer, uint32_t firstScissor, uint32_t scissorCount, const VkRect2D* pScissors);
+VKAPI_ATTR void VKAPI_CALL vkCmdSetCullMode(VkCommandBuffer commandBuffer, VkCullModeFlags cullMode);
+VKAPI_ATTR void VKAPI_CALL vkCmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance);
+VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance);
+VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlags,
+	uint32_t memoryBarrierCount, const VkMemoryBarrier* pMemoryBarriers,
+	uint32_t bufferMemoryBarrierCount, const VkBufferMemoryBarrier* pBufferMemoryBarriers,
+	uint32_t imageMemoryBarrierCount, const VkImageMemoryBarrier* pImageMemoryBarriers);
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, uint32_t regionCount, const VkBufferCopy* pRegions);
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkImage dstImage, VkImageLayout dstImageLayout,
+	uint32_t regionCount, const VkBufferImageCopy* pRegions);
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyImageToBuffer(VkCommandBuffer commandBuffer, VkImage srcImage, VkImageLayout srcImageLayout, VkBuffer dstBuffer,
+	uint32_t regionCount, const VkBufferImageCopy* pRegions);
+VKAPI_ATTR void VKAPI_CALL vkCmdBlitImage(VkCommandBuffer commandBuffer, VkImage srcImage, VkImageLayout srcImageLayout, VkImage dstImage, VkImageLayout dstImageLayout,
+	uint32_t regionCount, const VkImageBlit* pRegions, VkFilter filter);
+VKAPI_ATTR void VKAPI_CALL vkCmdResetQueryPool(VkCommandBuffer commandBuffer, VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount);
+VKAPI_ATTR void VKAPI_CALL vkCmdWriteTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits pipelineStage, VkQueryPool queryPool, uint32_t query);
+
+// VMA
+VkResult vmaCreateAllocator(const VmaAllocatorCreateInfo* pCreateInfo, VmaAllocator* pAllocator);
+VkResult vmaFindMemoryTypeIndexForBufferInfo(VmaAllocator allocator, const VkBufferCreateInfo* pBufferCreateInfo, const VmaAllocationCreateInfo* pAllocationCreateInfo, uint32_t* pMemoryTypeIndex);
+VkResult vmaCreateBuffer(VmaAllocator allocator, const VkBufferCreateInfo* pBufferCreateInfo, const VmaAllocationCreateInfo* pAllocationCreateInfo,
+	VkBuffer* pBuffer, VmaAllocation* pAllocation, VmaAllocationInfo* pAllocationInfo);
+void vmaDestroyBuffer(VmaAllocator allocator, VkBuffer buffer, VmaAllocation allocation);
+VkResult vmaCreateImage(VmaAllocator allocator, const VkImageCreateInfo* pImageCreateInfo, const VmaAllocationCreateInfo* pAllocationCreateInfo,
+	VkImage* pImage, VmaAllocation* pAllocation, VmaAllocationInfo* pAllocationInfo);
+void vmaDestroyImage(VmaAllocator allocator, VkImage image, VmaAllocation allocation);
+VkResult vmaBindImageMemory(VmaAllocator allocator, VmaAllocation allocation, VkImage image);
+void vmaGetAllocationInfo(VmaAllocator allocator, VmaAllocation allocation, VmaAllocationInfo* pAllocationInfo);
+void vmaGetAllocationMemoryProperties(VmaAllocator allocator, VmaAllocation allocation, VkMemoryPropertyFlags* pFlags);
+VkResult vmaMapMemory(VmaAllocator allocator, VmaAllocation allocation, void** ppData);
+VkResult vmaFlushAllocation(VmaAllocator allocator, VmaAllocation allocation, VkDeviceSize offset, VkDeviceSize size);
+VkResult vmaInvalidateAllocation(VmaAllocator allocator, VmaAllocation allocation, VkDeviceSize offset, VkDeviceSize size);
+
+}
+}
+}
+
+// Only defined by tvk.cpp, after all the includes: from there on, the calls go to the null backend. The VMA implementation is compiled before this point, but it's never called.
+// We can't simply shadow the global functions with the ones in our namespace: argument-dependent lookup would find both
+#ifdef TVK_NULL_REDIRECT_CALLS
+#define vkCreateInstance null::vkCreateInstance
+#define vkDestroyInstance null::vkDestroyInstance
+#define vkEnumeratePhysicalDevices null::vkEnumeratePhysicalDevices
+#define vkGetPhysicalDeviceFeatures null::vkGetPhysicalDeviceFeatures
+#define vkGetPhysicalDeviceFeatures2 null::vkGetPhysicalDeviceFeatures2
+#define vkGetPhysicalDeviceProperties null::vkGetPhysicalDeviceProperties
+#define vkGetPhysicalDeviceProperties2 null::vkGetPhysicalDeviceProperties2
+#define vkGetPhysicalDeviceMemoryProperties null::vkGetPhysicalDeviceMemoryProperties
+#define vkGetPhysicalDeviceQueueFamilyProperties null::vkGetPhysicalDeviceQueueFamilyProperties
+#define vkGetPhysicalDeviceImageFormatProperties null::vkGetPhysicalDeviceImageFormatProperties
+#define vkEnumerateDeviceExtensionProperties null::vkEnumerateDeviceExtensionProperties
+#define vkGetPhysicalDeviceSurfaceSupportKHR null::vkGetPhysicalDeviceSurfaceSupportKHR
+#define vkGetPhysicalDeviceSurfaceCapabilitiesKHR null::vkGetPhysicalDeviceSurfaceCapabilitiesKHR
+#define vkGetPhysicalDeviceSurfaceFormatsKHR null::vkGetPhysicalDeviceSurfaceFormatsKHR
+#define vkCreateDevice null::vkCreateDevice
+#define vkGetDeviceProcAddr null::vkGetDeviceProcAddr
+#define vkGetDeviceQueue null::vkGetDeviceQueue
+#define vkDeviceWaitIdle null::vkDeviceWaitIdle
+#define vkCreateSwapchainKHR null::vkCreateSwapchainKHR
+#define vkGetSwapchainImagesKHR null::vkGetSwapchainImagesKHR
+#define vkAcquireNextImageKHR null::vkAcquireNextImageKHR
+#define vkQueuePresentKHR null::vkQueuePresentKHR
+#define vkCreateSemaphore null::vkCreateSemaphore
+#define vkDestroySemaphore null::vkDestroySemaphore
+#define vkCreateFence null::vkCreateFence
+#define vkDestroyFence null::vkDestroyFence
+#define vkWaitForFences null::vkWaitForFences
+#define vkResetFences null::vkResetFences
+#define vkQueueSubmit null::vkQueueSubmit
+#define vkCreateQueryPool null::vkCreateQueryPool
+#define vkDestroyQueryPool null::vkDestroyQueryPool
+#define vkGetQueryPoolResults null::vkGetQueryPoolResults
+#define vkCreateImage null::vkCreateImage
+#define vkDestroyImage null::vkDestroyImage
+#define vkGetImageMemoryRequirements null::vkGetImageMemoryRequirements
+#define vkCreateImageView null::vkCreateImageView
+#define vkDestroyImageView null::vkDestroyImageView
+#define vkCreateSampler null::vkCreateSampler
+#define vkDestroySampler null::vkDestroySampler
+#define vkCreateCommandPool null::vkCreateCommandPool
+#define vkAllocateCommandBuffers null::vkAllocateCommandBuffers
+#define vkBeginCommandBuffer null::vkBeginCommandBuffer
+#define vkEndCommandBuffer null::vkEndCommandBuffer
+#define vkResetCommandBuffer null::vkResetCommandBuffer
+#define vkCreateDescriptorSetLayout null::vkCreateDescriptorSetLayout
+#define vkDestroyDescriptorSetLayout null::vkDestroyDescriptorSetLayout
+#define vkCreateDescriptorPool null::vkCreateDescriptorPool
+#define vkDestroyDescriptorPool null::vkDestroyDescriptorPool
+#define vkAllocateDescriptorSets null::vkAllocateDescriptorSets
+#define vkFreeDescriptorSets null::vkFreeDescriptorSets
+#define vkUpdateDescriptorSets null::vkUpdateDescriptorSets
+#define vkCreateDescriptorUpdateTemplate null::vkCreateDescriptorUpdateTemplate
+#define vkDestroyDescriptorUpdateTemplate null::vkDestroyDescriptorUpdateTemplate
+#define vkUpdateDescriptorSetWithTemplate null::vkUpdateDescriptorSetWithTemplate
+#define vkCreateRenderPass null::vkCreateRenderPass
+#define vkDestroyRenderPass null::vkDestroyRenderPass
+#define vkCreateFramebuffer null::vkCreateFramebuffer
+#define vkDestroyFramebuffer null::vkDestroyFramebuffer
+#define vkCreateShaderModule null::vkCreateShaderModule
+#define vkCreatePipelineLayout null::vkCreatePipelineLayout
+#define vkDestroyPipelineLayout null::vkDestroyPipelineLayout
+#define vkCreateGraphicsPipelines null::vkCreateGraphicsPipelines
+#define vkDestroyPipeline null::vkDestroyPipeline
+#define vkCmdBeginRenderPass null::vkCmdBeginRenderPass
+#define vkCmdEndRenderPass null::vkCmdEndRenderPass
+#define vkCmdBindPipeline null::vkCmdBindPipeline
+#define vkCmdBindDescriptorSets null::vkCmdBindDescriptorSets
+#define vkCmdBindVertexBuffers null::vkCmdBindVertexBuffers
+#define vkCmdBindIndexBuffer null::vkCmdBindIndexBuffer
+#define vkCmdPushConstants null::vkCmdPushConstants
+#define vkCmdSetViewport null::vkCmdSetViewport
+#define vkCmdSetScissor null::vkCmdSetScissor
+#define vkCmdDraw null::vkCmdDraw
+#define vkCmdDrawIndexed null::vkCmdDrawIndexed
+#define vkCmdPipelineBarrier null::vkCmdPipelineBarrier
+#define vkCmdCopyBuffer null::vkCmdCopyBuffer
+#define vkCmdCopyBufferToImage null::vkCmdCopyBufferToImage
+#define vkCmdCopyImageToBuffer null::vkCmdCopyImageToBuffer
+#define vkCmdBlitImage null::vkCmdBlitImage
+#define vkCmdResetQueryPool null::vkCmdResetQueryPool
+#define vkCmdWriteTimestamp null::vkCmdWriteTimestamp
+#define vmaCreateAllocator null::vmaCreateAllocator
+#define vmaFindMemoryTypeIndexForBufferInfo null::vmaFindMemoryTypeIndexForBufferInfo
+#define vmaCreateBuffer null::vmaCreateBuffer
+#define vmaDestroyBuffer null::vmaDestroyBuffer
+#define vmaCreateImage null::vmaCreateImage
+#define vmaDestroyImage null::vmaDestroyImage
+#define vmaBindImageMemory null::vmaBindImageMemory
+#define vmaGetAllocationInfo null::vmaGetAllocationInfo
+#define vmaGetAllocationMemoryProperties null::vmaGetAllocationMemoryProperties
+#define vmaMapMemory null::vmaMapMemory
+#define vmaFlushAllocation null::vmaFlushAllocation
+#define vmaInvalidateAllocation null::vmaInvalidateAllocation
+#endif
+
+#endif
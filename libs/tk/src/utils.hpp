@@ -11,6 +11,16 @@
 #include <filesystem>
 #include <utility>
 #include <unordered_map>
+#include <memory>
+#include <tuple>
+#include <bit>
+#include <concepts>
+#include <string.h>
+#include <wyhash.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TK_FLAT_HASH_SSE2
+#include <emmintrin.h>
+#endif
 
 namespace tk
 {
@@ -49,17 +59,7 @@ struct AABB {
     glm::vec3 center()const { return 0.5f * (min + max); }
     glm::vec3 size()const { return max - min; }
 };
-inline AABB pointCloudToAABB(CSpan<glm::vec3> positions) {
-    AABB b{};
-    if (positions.size()) {
-        b.min = b.max = positions[0];
-        for (size_t i = 0; i < positions.size(); i++) {
-            b.min = glm::min(b.min, positions[i]);
-            b.max = glm::max(b.max, positions[i]);
-        }
-    }
-    return b;
-}
+AABB pointCloudToAABB(CSpan<glm::vec3> positions); // SIMD (see the batch transforms below)
 
 struct FpsCamera {
     glm::vec3 position = { 0, 0, 0 };
@@ -100,6 +100,40 @@ inline glm::mat4 buildMtx(const glm::vec3& position, const glm::quat& rotation,
     return m;
 }
 
+// --- batch transforms ---
+// SIMD kernels for transforming many objects in a single call (batch_transforms.cpp). The instruction set is selected at runtime:
+// AVX2+FMA or SSE2 in x86, NEON in ARM, scalar otherwise. The inputs are separate arrays for each attribute, which can be members of arrays of structs (StridedSpan)
+
+// a span with a stride in bytes. Useful for reading or writing one member of an array of structs
+template <typename T>
+struct StridedSpan {
+    typedef std::conditional_t<std::is_const_v<T>, const u8, u8> Byte;
+    T* first = nullptr;
+    size_t count = 0;
+    size_t stride = sizeof(T);
+
+    StridedSpan() {}
+    StridedSpan(T* first, size_t count, size_t stride = sizeof(T)) : first(first), count(count), stride(stride) {}
+    // contiguous containers of T, or of a type derived from T
+    template <typename R>
+        requires requires (R& r) { { std::data(r) } -> std::convertible_to<T*>; std::size(r); }
+    StridedSpan(R&& r) : first(std::data(r)), count(std::size(r)), stride(sizeof(*std::data(r))) {}
+
+    size_t size()const { return count; }
+    bool empty()const { return count == 0; }
+    T& operator[](size_t i)const { return *(T*)((Byte*)first + i * stride); }
+};
+
+// out[i] = buildMtx(positions[i], rotations[i], scales[i])
+void buildMtx_batch(StridedSpan<glm::mat4> out, StridedSpan<const glm::vec3> positions, StridedSpan<const glm::quat> rotations, StridedSpan<const glm::vec3> scales);
+// out[i] = a * b[i]. "out" can be the same array as "b"
+void mulMtx_batch(StridedSpan<glm::mat4> out, const glm::mat4& a, StridedSpan<const glm::mat4> b);
+// out[i] = glm::mat3(glm::inverse(glm::transpose(m[i]))), for transforming normals. m[i] must be affine, which allows computing it with a 3x3 cofactor matrix
+void affineNormalMtx_batch(StridedSpan<glm::mat3> out, StridedSpan<const glm::mat4> m);
+// out[i] = the AABB that contains aabbs[i] transformed by m[i]. m[i] must be affine
+void transformAABB_batch(StridedSpan<AABB> out, StridedSpan<const AABB> aabbs, StridedSpan<const glm::mat4> m);
+CStr batchTransforms_isa(); // the name of the instruction set that was selected
+
 template <typename T>
 std::span<u8> asBytesSpan(std::span<T> v) { return { (u8*)v.data(), v.size_bytes() }; }
 template <typename T>
@@ -131,6 +165,357 @@ auto make_vector(const T& t, const Ts&... ts) {
 
 struct DumbHash { u64 operator()(u64 x)const { return x; } };
 
+// --- FlatHashMap / FlatHashSet ---
+// Open-addressing hash tables in the style of Swiss tables: the slots are in a flat array, and a parallel array of control bytes holds
+// 7 bits of the hash of each slot (or empty/deleted). Lookups compare 16 control bytes at once with SSE2, so they rarely touch the slots of other keys.
+// Insertions invalidate the iterators and references (the slots move when the table grows). The iteration order is arbitrary
+
+// the default hasher, based on wyhash. The strings hasher is transparent, so string tables can be searched with a std::string_view
+template <typename T, typename = void>
+struct Hash {
+    u64 operator()(const T& x)const { return _wymix(u64(std::hash<T>{}(x)) ^ _wyp[0], _wyp[1]); }
+};
+template <typename T>
+struct Hash<T, std::enable_if_t<std::is_integral_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>>> {
+    u64 operator()(T x)const { return _wymix((u64)x ^ _wyp[0], _wyp[1]); }
+};
+struct StringHash {
+    typedef void is_transparent;
+    u64 operator()(std::string_view s)const { return wyhash(s.data(), s.size(), 0, _wyp); }
+};
+template <typename Alloc>
+struct Hash<std::basic_string<char, std::char_traits<char>, Alloc>> : StringHash {};
+template <>
+struct Hash<std::string_view> : StringHash {};
+// paths that compare equal can have different spellings, so we hash them the way std does
+template <>
+struct Hash<std::filesystem::path> {
+    u64 operator()(const std::filesystem::path& p)const { return _wymix(u64(std::filesystem::hash_value(p)) ^ _wyp[0], _wyp[1]); }
+};
+
+namespace _flat_hash {
+    static constexpr size_t GROUP_SIZE = 16;
+    static constexpr size_t MIN_CAPACITY = GROUP_SIZE;
+    static constexpr i8 EMPTY = -128;
+    static constexpr i8 DELETED = -2;
+    // full slots have the 7 low bits of the hash, so their control byte is positive
+
+    // bit i of the masks corresponds to the control byte i of the group
+    struct Group {
+#ifdef TK_FLAT_HASH_SSE2
+        __m128i ctrl;
+        explicit Group(const i8* p) : ctrl(_mm_loadu_si128((const __m128i*)p)) {}
+        u32 match(i8 h)const { return u32(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h), ctrl))); }
+        u32 matchEmptyOrDeleted()const { return u32(_mm_movemask_epi8(ctrl)); } // the sign bit
+#else
+        i8 ctrl[GROUP_SIZE];
+        explicit Group(const i8* p) { memcpy(ctrl, p, GROUP_SIZE); }
+        u32 match(i8 h)const {
+            u32 m = 0;
+            for (u32 i = 0; i < GROUP_SIZE; i++)
+                m |= u32(ctrl[i] == h) << i;
+            return m;
+        }
+        u32 matchEmptyOrDeleted()const {
+            u32 m = 0;
+            for (u32 i = 0; i < GROUP_SIZE; i++)
+                m |= u32(ctrl[i] < 0) << i;
+            return m;
+        }
+#endif
+        u32 matchEmpty()const { return match(EMPTY); }
+    };
+
+    // 7/8 max load factor
+    static constexpr size_t maxLoad(size_t capacity) { return capacity - capacity / 8; }
+}
+
+// Slot is std::pair<K, V> for maps, and K for sets
+template <typename K, typename Slot, typename H, typename Eq, typename Alloc>
+struct _FlatHashTable {
+    typedef K key_type;
+    typedef Slot value_type;
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Slot> SlotAlloc;
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<i8> CtrlAlloc;
+    static constexpr size_t NOT_FOUND = size_t(-1);
+
+    template <bool CONST>
+    struct Iterator {
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Slot value_type;
+        typedef ptrdiff_t difference_type;
+        typedef std::conditional_t<CONST, const Slot, Slot>* pointer;
+        typedef std::conditional_t<CONST, const Slot, Slot>& reference;
+
+        const i8* ctrl = nullptr;
+        const i8* ctrlEnd = nullptr;
+        pointer slot = nullptr;
+
+        Iterator() {}
+        Iterator(const i8* ctrl, const i8* ctrlEnd, pointer slot) : ctrl(ctrl), ctrlEnd(ctrlEnd), slot(slot) { skipFree(); }
+        operator Iterator<true>()const requires (!CONST) { return { ctrl, ctrlEnd, slot }; }
+
+        reference operator*()const { return *slot; }
+        pointer operator->()const { return slot; }
+        Iterator& operator++() { ctrl++; slot++; skipFree(); return *this; }
+        Iterator operator++(int) { auto it = *this; ++*this; return it; }
+        bool operator==(const Iterator& o)const { return slot == o.slot; }
+
+        void skipFree() {
+            while (ctrl != ctrlEnd && *ctrl < 0) {
+                ctrl++;
+                slot++;
+            }
+        }
+    };
+    typedef Iterator<false> iterator;
+    typedef Iterator<true> const_iterator;
+
+    i8* _ctrl = nullptr; // [_capacity + GROUP_SIZE] the last GROUP_SIZE bytes mirror the first ones, so groups can be loaded from any position
+    Slot* _slots = nullptr; // [_capacity]
+    size_t _capacity = 0; // 0 or a power of 2 >= MIN_CAPACITY
+    size_t _size = 0;
+    size_t _growthLeft = 0; // how many more empty slots we can fill before rehashing
+    [[no_unique_address]] H _hasher;
+    [[no_unique_address]] Eq _eq;
+    [[no_unique_address]] Alloc _alloc;
+
+    _FlatHashTable() {}
+    _FlatHashTable(const _FlatHashTable& o) : _hasher(o._hasher), _eq(o._eq), _alloc(o._alloc) {
+        reserve(o._size);
+        for (const Slot& s : o)
+            new (_slots + _prepareInsert(_hasher(_slotKey(s)))) Slot(s);
+    }
+    _FlatHashTable(_FlatHashTable&& o) noexcept { swap(o); }
+    _FlatHashTable& operator=(const _FlatHashTable& o) { _FlatHashTable tmp(o); swap(tmp); return *this; }
+    _FlatHashTable& operator=(_FlatHashTable&& o) noexcept { swap(o); return *this; }
+    ~_FlatHashTable() { _free(); }
+
+    void swap(_FlatHashTable& o) noexcept {
+        std::swap(_ctrl, o._ctrl);
+        std::swap(_slots, o._slots);
+        std::swap(_capacity, o._capacity);
+        std::swap(_size, o._size);
+        std::swap(_growthLeft, o._growthLeft);
+        std::swap(_hasher, o._hasher);
+        std::swap(_eq, o._eq);
+        std::swap(_alloc, o._alloc);
+    }
+
+    size_t size()const { return _size; }
+    bool empty()const { return _size == 0; }
+    size_t capacity()const { return _capacity; }
+
+    iterator begin() { return { _ctrl, _ctrl + _capacity, _slots }; }
+    iterator end() { return { _ctrl + _capacity, _ctrl + _capacity, _slots + _capacity }; }
+    const_iterator begin()const { return { _ctrl, _ctrl + _capacity, _slots }; }
+    const_iterator end()const { return { _ctrl + _capacity, _ctrl + _capacity, _slots + _capacity }; }
+
+    template <typename Q>
+    iterator find(const Q& key) { const size_t i = _find(key, _hasher(key)); return i == NOT_FOUND ? end() : _iteratorAt(i); }
+    template <typename Q>
+    const_iterator find(const Q& key)const { const size_t i = _find(key, _hasher(key)); return i == NOT_FOUND ? end() : _iteratorAt(i); }
+    template <typename Q>
+    bool contains(const Q& key)const { return _find(key, _hasher(key)) != NOT_FOUND; }
+    template <typename Q>
+    size_t count(const Q& key)const { return contains(key) ? 1 : 0; }
+
+    template <typename Q>
+    size_t erase(const Q& key) {
+        const size_t i = _find(key, _hasher(key));
+        if (i == NOT_FOUND)
+            return 0;
+        _eraseAt(i);
+        return 1;
+    }
+    void erase(iterator it) { _eraseAt(size_t(it.slot - _slots)); }
+    void erase(const_iterator it) { _eraseAt(size_t(it.slot - _slots)); }
+
+    void clear() {
+        if (_capacity == 0)
+            return;
+        _destroySlots();
+        memset(_ctrl, _flat_hash::EMPTY, _capacity + _flat_hash::GROUP_SIZE);
+        _size = 0;
+        _growthLeft = _flat_hash::maxLoad(_capacity);
+    }
+
+    // makes room for n elements without rehashing
+    void reserve(size_t n) {
+        if (n > _size + _growthLeft)
+            _resize(glm::max(_flat_hash::MIN_CAPACITY, std::bit_ceil(n + n / 7 + 1)));
+    }
+
+    static const K& _slotKey(const Slot& s) {
+        if constexpr (std::is_same_v<Slot, K>)
+            return s;
+        else
+            return s.first;
+    }
+
+    iterator _iteratorAt(size_t i) { return { _ctrl + i, _ctrl + _capacity, _slots + i }; }
+    const_iterator _iteratorAt(size_t i)const { return { _ctrl + i, _ctrl + _capacity, _slots + i }; }
+
+    void _setCtrl(size_t i, i8 c) {
+        _ctrl[i] = c;
+        if (i < _flat_hash::GROUP_SIZE)
+            _ctrl[_capacity + i] = c;
+    }
+
+    // the groups are probed in triangular steps, which visits all of them when the number of groups is a power of 2
+    template <typename Q>
+    size_t _find(const Q& key, u64 h)const {
+        if (_capacity == 0)
+            return NOT_FOUND;
+        const size_t mask = _capacity - 1;
+        const i8 h2 = i8(h & 0x7F);
+        size_t pos = size_t(h >> 7) & mask;
+        for (size_t step = _flat_hash::GROUP_SIZE; ; step += _flat_hash::GROUP_SIZE) {
+            const _flat_hash::Group g(_ctrl + pos);
+            for (u32 m = g.match(h2); m; m &= m - 1) {
+                const size_t i = (pos + std::countr_zero(m)) & mask;
+                if (_eq(_slotKey(_slots[i]), key))
+                    return i;
+            }
+            if (g.matchEmpty())
+                return NOT_FOUND;
+            assert(step <= _capacity);
+            pos = (pos + step) & mask;
+        }
+    }
+
+    size_t _findFirstFree(u64 h)const {
+        const size_t mask = _capacity - 1;
+        size_t pos = size_t(h >> 7) & mask;
+        for (size_t step = _flat_hash::GROUP_SIZE; ; step += _flat_hash::GROUP_SIZE) {
+            if (const u32 m = _flat_hash::Group(_ctrl + pos).matchEmptyOrDeleted())
+                return (pos + std::countr_zero(m)) & mask;
+            assert(step <= _capacity);
+            pos = (pos + step) & mask;
+        }
+    }
+
+    // claims a slot for a key that is not in the table. The caller must construct the slot
+    size_t _prepareInsert(u64 h) {
+        size_t i = _capacity ? _findFirstFree(h) : 0;
+        if (_growthLeft == 0 && (_capacity == 0 || _ctrl[i] != _flat_hash::DELETED)) {
+            // if more than half of the used slots are tombstones, we rehash in place, to avoid growing the table with insert/erase cycles
+            if (_capacity && _size <= _flat_hash::maxLoad(_capacity) / 2)
+                _resize(_capacity);
+            else
+                _resize(glm::max(_flat_hash::MIN_CAPACITY, 2 * _capacity));
+            i = _findFirstFree(h);
+        }
+        if (_ctrl[i] == _flat_hash::EMPTY)
+            _growthLeft--;
+        _setCtrl(i, i8(h & 0x7F));
+        _size++;
+        return i;
+    }
+
+    template <typename Q, typename... Args>
+    std::pair<iterator, bool> _tryEmplace(Q&& key, Args&&... args) {
+        const u64 h = _hasher(key);
+        if (const size_t i = _find(key, h); i != NOT_FOUND)
+            return { _iteratorAt(i), false };
+        const size_t i = _prepareInsert(h);
+        if constexpr (std::is_same_v<Slot, K>)
+            new (_slots + i) Slot(std::forward<Q>(key));
+        else
+            new (_slots + i) Slot(std::piecewise_construct, std::forward_as_tuple(std::forward<Q>(key)), std::forward_as_tuple(std::forward<Args>(args)...));
+        return { _iteratorAt(i), true };
+    }
+
+    void _eraseAt(size_t i) {
+        using namespace _flat_hash;
+        _slots[i].~Slot();
+        _size--;
+        // if the slot is not inside a window of GROUP_SIZE consecutive non-empty slots, no probe has ever continued past it, so it can be marked as empty
+        const u32 emptyBefore = Group(_ctrl + ((i - GROUP_SIZE) & (_capacity - 1))).matchEmpty();
+        const u32 emptyAfter = Group(_ctrl + i).matchEmpty();
+        const bool wasNeverFull = emptyBefore && emptyAfter &&
+            size_t(std::countr_zero(emptyAfter) + std::countl_zero(u16(emptyBefore))) < GROUP_SIZE;
+        _setCtrl(i, wasNeverFull ? EMPTY : DELETED);
+        if (wasNeverFull)
+            _growthLeft++;
+    }
+
+    void _resize(size_t newCapacity) {
+        assert(newCapacity >= _flat_hash::MIN_CAPACITY && (newCapacity & (newCapacity - 1)) == 0);
+        i8* oldCtrl = _ctrl;
+        Slot* oldSlots = _slots;
+        const size_t oldCapacity = _capacity;
+
+        CtrlAlloc ctrlAlloc(_alloc);
+        SlotAlloc slotAlloc(_alloc);
+        _ctrl = ctrlAlloc.allocate(newCapacity + _flat_hash::GROUP_SIZE);
+        _slots = slotAlloc.allocate(newCapacity);
+        _capacity = newCapacity;
+        memset(_ctrl, _flat_hash::EMPTY, newCapacity + _flat_hash::GROUP_SIZE);
+        _growthLeft = _flat_hash::maxLoad(newCapacity) - _size;
+
+        for (size_t oldI = 0; oldI < oldCapacity; oldI++) {
+            if (oldCtrl[oldI] < 0)
+                continue;
+            const u64 h = _hasher(_slotKey(oldSlots[oldI]));
+            const size_t i = _findFirstFree(h);
+            _setCtrl(i, i8(h & 0x7F));
+            new (_slots + i) Slot(std::move(oldSlots[oldI]));
+            oldSlots[oldI].~Slot();
+        }
+        if (oldCapacity) {
+            ctrlAlloc.deallocate(oldCtrl, oldCapacity + _flat_hash::GROUP_SIZE);
+            slotAlloc.deallocate(oldSlots, oldCapacity);
+        }
+    }
+
+    void _destroySlots() {
+        if constexpr (!std::is_trivially_destructible_v<Slot>) {
+            for (size_t i = 0; i < _capacity; i++) {
+                if (_ctrl[i] >= 0)
+                    _slots[i].~Slot();
+            }
+        }
+    }
+
+    void _free() {
+        if (_capacity == 0)
+            return;
+        _destroySlots();
+        CtrlAlloc(_alloc).deallocate(_ctrl, _capacity + _flat_hash::GROUP_SIZE);
+        SlotAlloc(_alloc).deallocate(_slots, _capacity);
+        _ctrl = nullptr;
+        _slots = nullptr;
+        _capacity = _size = _growthLeft = 0;
+    }
+};
+
+template <typename K, typename V, typename H = Hash<K>, typename Eq = std::equal_to<>, typename Alloc = std::allocator<std::pair<K, V>>>
+struct FlatHashMap : _FlatHashTable<K, std::pair<K, V>, H, Eq, Alloc> {
+    typedef V mapped_type;
+    typedef _FlatHashTable<K, std::pair<K, V>, H, Eq, Alloc> Base;
+    typedef typename Base::iterator iterator;
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const K& key, Args&&... args) { return this->_tryEmplace(key, std::forward<Args>(args)...); }
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(K&& key, Args&&... args) { return this->_tryEmplace(std::move(key), std::forward<Args>(args)...); }
+    std::pair<iterator, bool> insert(const std::pair<K, V>& kv) { return this->_tryEmplace(kv.first, kv.second); }
+    std::pair<iterator, bool> insert(std::pair<K, V>&& kv) { return this->_tryEmplace(std::move(kv.first), std::move(kv.second)); }
+
+    V& operator[](const K& key) { return this->_tryEmplace(key).first->second; }
+    V& operator[](K&& key) { return this->_tryEmplace(std::move(key)).first->second; }
+};
+
+template <typename K, typename H = Hash<K>, typename Eq = std::equal_to<>, typename Alloc = std::allocator<K>>
+struct FlatHashSet : _FlatHashTable<K, K, H, Eq, Alloc> {
+    typedef _FlatHashTable<K, K, H, Eq, Alloc> Base;
+    typedef typename Base::iterator iterator;
+
+    std::pair<iterator, bool> insert(const K& key) { return this->_tryEmplace(key); }
+    std::pair<iterator, bool> insert(K&& key) { return this->_tryEmplace(std::move(key)); }
+};
+
 bool loadTextFile(std::string& str, CStr path);
 
 struct LoadedBinaryFile {
@@ -142,70 +527,108 @@ struct LoadedBinaryFile {
 struct PathBag
 {
     std::vector<std::string> paths;
-    std::unordered_map<u64, u32, DumbHash> hashToEntry;
+    FlatHashMap<u64, u32, DumbHash> hashToEntry;
 
     u32 getEntry(std::string_view path)const;
     void addPath(std::string_view path, u32 entry);
     void deleteEntry(u32 entry);
 };
 
-template <typename Int, typename FirstVector, typename... Vectors>
-Int acquireReusableEntry(Int& nextFreeEntry, FirstVector& firstVector, size_t firstVectorOffset, Vectors&... vectors)
-{
-    assert(firstVectorOffset + sizeof(Int) <= sizeof(FirstVector::value_type));
-    if (nextFreeEntry != Int(-1)) {
-        // there was a free entry
-        const Int e = nextFreeEntry;
-        u8* ptr = (u8*)&firstVector[e];
-        ptr += firstVectorOffset;
-        nextFreeEntry = *(Int*)ptr;
-        return e;
-    }
-
-    const Int e = firstVector.size();
-    firstVector.emplace_back();
-    (vectors.emplace_back(), ...);
-    return e;
-}
-
-template <typename Int, typename FirstVector, typename... Vectors>
-void releaseReusableEntry(Int& nextFreeEntry, FirstVector& firstVector, size_t firstVectorOffset, u32 entryToRelase)
+// --- SlotMap ---
+// Generational slot map with SoA columns: SlotMap<A, B> has a std::vector<A> and a std::vector<B>, indexed by slot
+// - the slot of an entry doesn't change while it's alive, so it can be used as an index into other arrays
+// - the generation of a slot is incremented when it's acquired and when it's released (odd means alive). Ids that keep the generation can be validated in O(1), also in release builds
+// - the live slots are also kept in a dense array, so they can be iterated without walking the holes
+// - acquire() and release() are O(1). compact() gives back the free slots at the end of the columns
+// Columns that are not owned by the SlotMap (like the named arrays of a struct) can be passed to acquire() and compact(), so they stay in sync with the slots.
+// The columns of a released slot keep their values until the slot is reused
+template <typename... Ts>
+struct SlotMap
 {
-    assert(firstVectorOffset + sizeof(Int) <= sizeof(FirstVector::value_type));
-    u8* ptr = (u8*)&firstVector[entryToRelase];
-    ptr += firstVectorOffset;
-    *(Int*)ptr = nextFreeEntry;
-    nextFreeEntry = entryToRelase;
-    // TODO: do some safety check in debug mode for detecting double-free
-}
-
-template <typename T, size_t offset = 0>
-struct EntriesArray
-{
-    std::vector<T> entries;
-    u32 nextFreeEntry = u32(-1);
-    static_assert(sizeof(T) >= sizeof(u32));
-
-    u32 alloc()
+    std::tuple<std::vector<Ts>...> columns; // [slot]
+    std::vector<u32> generations; // [slot]
+    std::vector<u32> slotToDense; // [slot] the position in liveSlots. For free slots, the next free slot (forming a linked list)
+    std::vector<u32> liveSlots; // dense
+    u32 firstFree = u32(-1);
+    u32 compactedGeneration = 0; // the highest generation of the slots removed by compact(), so the new slots don't match ids from before the compaction
+
+    template <typename... ExternalColumns>
+    u32 acquire(ExternalColumns&... externalColumns)
     {
-        const u32 e = acquireReusableEntry(nextFreeEntry, entries, offset);
-        return e;
+        u32 slot;
+        if (firstFree != u32(-1)) {
+            slot = firstFree;
+            firstFree = slotToDense[slot];
+        }
+        else {
+            slot = u32(generations.size());
+            generations.push_back(compactedGeneration);
+            slotToDense.emplace_back();
+            std::apply([](auto&... cols) { (cols.emplace_back(), ...); }, columns);
+            (externalColumns.emplace_back(), ...);
+        }
+        generations[slot]++;
+        slotToDense[slot] = u32(liveSlots.size());
+        liveSlots.push_back(slot);
+        return slot;
     }
 
-    void free(u32 id)
+    void release(u32 slot)
     {
-        assert(id < entries.size());
-        releaseReusableEntry(nextFreeEntry, entries, offset, id);
+        assert(isAlive(slot) && "double release?");
+        generations[slot]++;
+        const u32 d = slotToDense[slot];
+        const u32 movedSlot = liveSlots.back();
+        liveSlots[d] = movedSlot;
+        slotToDense[movedSlot] = d;
+        liveSlots.pop_back();
+        slotToDense[slot] = firstFree;
+        firstFree = slot;
     }
 
-    T& operator[](u32 id)
+    template <typename... ExternalColumns>
+    void compact(ExternalColumns&... externalColumns)
     {
-        return entries[id];
-    }
-    const T& operator[](u32 id)const
-    {
-        return entries[id];
+        u32 n = u32(generations.size());
+        for (; n && !(generations[n - 1] & 1); n--)
+            compactedGeneration = glm::max(compactedGeneration, generations[n - 1]);
+        auto shrink = [n](auto& col) { col.erase(col.begin() + n, col.end()); col.shrink_to_fit(); };
+        shrink(generations);
+        shrink(slotToDense);
+        std::apply([&](auto&... cols) { (shrink(cols), ...); }, columns);
+        (shrink(externalColumns), ...);
+
+        // rebuild the free list, so the lower slots are reused first
+        firstFree = u32(-1);
+        for (u32 slot = n; slot-- > 0; ) {
+            if (!(generations[slot] & 1)) {
+                slotToDense[slot] = firstFree;
+                firstFree = slot;
+            }
+        }
     }
+
+    u32 size()const { return u32(liveSlots.size()); }
+    bool empty()const { return liveSlots.empty(); }
+    u32 numSlots()const { return u32(generations.size()); } // including the free ones
+    CSpan<u32> getLiveSlots()const { return liveSlots; } // in arbitrary order
+
+    bool isAlive(u32 slot)const { return slot < generations.size() && (generations[slot] & 1); }
+    u32 getGeneration(u32 slot)const { return generations[slot]; }
+    bool isValid(u32 slot, u32 generation)const { return slot < generations.size() && generations[slot] == generation; }
+
+    template <size_t I>
+    auto& col() { return std::get<I>(columns); }
+    template <size_t I>
+    const auto& col()const { return std::get<I>(columns); }
+    template <typename T>
+    std::vector<T>& col() { return std::get<std::vector<T>>(columns); }
+    template <typename T>
+    const std::vector<T>& col()const { return std::get<std::vector<T>>(columns); }
+
+    // for the maps of a single column
+    auto& operator[](u32 slot) requires (sizeof...(Ts) == 1) { return std::get<0>(columns)[slot]; }
+    const auto& operator[](u32 slot)const requires (sizeof...(Ts) == 1) { return std::get<0>(columns)[slot]; }
 };
 
 // computes the next power of two, unless it's already a power of two
@@ -33,25 +33,32 @@ void main()
     #if HAS_VERTCOLOR_0
         albedo *= v_color_0;
     #endif
-    #if HAS_TEXCOORD_0 && HAS_ALBEDO_TEX
-        albedo *= texture(u_albedoTex, v_texCoord_0);
+    #if HAS_TEXCOORD_0
+        if(HAS_ALBEDO_TEX)
+            albedo *= texture(u_albedoTex, v_texCoord_0);
     #endif
 
     #if HAS_NORMAL
         vec3 normal = v_normal;
-        #if HAS_TEXCOORD_0 && HAS_NORMAL_TEX && HAS_TANGENT
-            mat3 TBN = mat3(v_normal, v_tangent, cross(v_tangent, v_normal));
-            vec3 normalFromTex = texture(u_normalTex, v_texCoord_0).rgb;
-            vec3 normal = TBN * normalFromTex;
+        #if HAS_TEXCOORD_0 && HAS_TANGENT
+            if(HAS_NORMAL_TEX) {
+                mat3 TBN = mat3(v_tangent, cross(v_normal, v_tangent), v_normal);
+                // Z is reconstructed, so normal maps can be stored in two channels (BC5)
+                vec2 normalXY = texture(u_normalTex, v_texCoord_0).rg * 2.0 - 1.0;
+                vec3 normalFromTex = vec3(normalXY, sqrt(max(0.0, 1.0 - dot(normalXY, normalXY))));
+                normal = normalize(TBN * normalFromTex);
+            }
         #endif
     #endif
 
     float metallic = u_metallicFactor;
     float roughness = u_roughnessFactor;
-    #if HAS_TEXCOORD_0 && HAS_METALLIC_RUGHNESS_TEX
-        vec2 metallic_roughness_fromTex = texture(u_metallicRoughnessTex, v_texCoord_0).rg;
-        metallic *= metallic_roughness_fromTex[0];
-        roughness *= metallic_roughness_fromTex[1];
+    #if HAS_TEXCOORD_0
+        if(HAS_METALLIC_ROUGHNESS_TEX) {
+            vec2 metallic_roughness_fromTex = texture(u_metallicRoughnessTex, v_texCoord_0).rg;
+            metallic *= metallic_roughness_fromTex[0];
+            roughness *= metallic_roughness_fromTex[1];
+        }
     #endif
 
     vec3 color = albedo.rgb * u_ambientLight;
@@ -1,4 +1,7 @@
 #extension GL_EXT_scalar_block_layout : require
+#if BINDLESS
+    #extension GL_EXT_nonuniform_qualifier : require // unsized arrays of textures
+#endif
 
 #define DESCSET_GLOBAL 0
 #define DESCSET_MATERIAL 1
@@ -18,20 +21,47 @@ layout(std430, set = DESCSET_GLOBAL, binding = 0) uniform DirLights {
     DirLight u_dirLights[MAX_DIR_LIGHTS];
 };
 
+#if BINDLESS
+    // all the materials share the descriptor set (see PbrMaterialManager::bindless). The push constant selects the material
+    struct MaterialUniforms {
+        vec4 color;
+        float metallicFactor;
+        float roughnessFactor;
+        uint albedoTex;
+        uint normalTex;
+        uint metallicRoughnessTex;
+    };
+    layout(std430, set = DESCSET_MATERIAL, binding = 0) readonly buffer Materials {
+        MaterialUniforms u_materials[];
+    };
+    layout(set = DESCSET_MATERIAL, binding = 1) uniform sampler2D u_textures[];
+    layout(push_constant) uniform PushConstants {
+        uint u_materialIndex;
+    };
+
+    #define u_color u_materials[u_materialIndex].color
+    #define u_metallicFactor u_materials[u_materialIndex].metallicFactor
+    #define u_roughnessFactor u_materials[u_materialIndex].roughnessFactor
+    #define u_albedoTex u_textures[u_materials[u_materialIndex].albedoTex]
+    #define u_normalTex u_textures[u_materials[u_materialIndex].normalTex]
+    #define u_metallicRoughnessTex u_textures[u_materials[u_materialIndex].metallicRoughnessTex]
+#else
 layout(set = DESCSET_MATERIAL, binding = 0) uniform MaterialUniforms {
     vec4 u_color;
     float u_metallicFactor;
     float u_roughnessFactor;
 };
-
-#if HAS_ALBEDO_TEX
-    layout(set = DESCSET_MATERIAL, binding = 1) uniform sampler2D u_albedoTex;
-#endif
-#if HAS_NORMAL_TEX
-    layout(set = DESCSET_MATERIAL, binding = 2) uniform sampler2D u_normalTex;
 #endif
-#if HAS_METALLIC_RUGHNESS_TEX
-    layout(set = DESCSET_MATERIAL, binding = 3) uniform sampler2D u_metallicRoughnessTex;
+
+// the texture presence is specialized at pipeline creation (see PbrMaterialManager::getCreatePipeline)
+layout(constant_id = 0) const bool HAS_ALBEDO_TEX = false;
+layout(constant_id = 1) const bool HAS_NORMAL_TEX = false;
+layout(constant_id = 2) const bool HAS_METALLIC_ROUGHNESS_TEX = false;
+
+#if !BINDLESS
+layout(set = DESCSET_MATERIAL, binding = 1) uniform sampler2D u_albedoTex;
+layout(set = DESCSET_MATERIAL, binding = 2) uniform sampler2D u_normalTex;
+layout(set = DESCSET_MATERIAL, binding = 3) uniform sampler2D u_metallicRoughnessTex;
 #endif
 
 #if 0
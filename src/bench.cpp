@@ -0,0 +1,573 @@
+// Renderer and ECS benchmarks. Every scenario is run several times, and the timings are reported as percentiles.
+// A summary is printed, and the results are written in JSON (by default to bench_results.json) so they can be compared between runs.
+// The renderer runs in headless mode. Configure with TK_VK_NULL_BACKEND=ON to measure the CPU side without a GPU
+// Usage: tuki_bench [--filter <substring>] [--iterations <k>] [--out <file.json>] [--trace <file.json>] [--perf]
+//   --trace: records the whole run with the in-process profiler, and writes it as a Chrome trace
+//   --perf: adds the hardware counters (cycles, instructions, cache and branch misses) of the tk perf scopes to the results (Linux only)
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <format>
+#include <glm/glm.hpp>
+#include <glm/gtx/transform.hpp>
+#include <physfs.h>
+#include <stb_image_write.h>
+#include <tk.hpp>
+#include <tg.hpp>
+#include <shader_compiler.hpp>
+#include <profiler.hpp>
+#include <perf_counters.hpp>
+#ifdef TVK_NULL_BACKEND
+#include <tvk_null.hpp>
+#endif
+
+namespace tvk = tk::vk;
+namespace tg = tk::gfx;
+using tk::CSpan;
+using tk::CStr;
+using tk::u8;
+using tk::u32;
+using tk::u64;
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+struct Options {
+	std::string filter; // only the scenarios whose name contains this
+	u32 iterations = 20;
+	std::string outPath = "bench_results.json";
+	std::string tracePath; // empty: don't record a trace
+	bool perf = false;
+};
+static Options options;
+
+static constexpr u32 k_screenW = 1280, k_screenH = 720;
+
+// --- RESULTS ---
+struct Result {
+	std::string scenario;
+	u32 n, m; // the problem size. The meaning depends on the scenario (m is 1 if not used)
+	std::vector<double> samplesMs;
+	double bytesPerSample = 0; // for the throughput, 0 if it doesn't apply
+	std::string extra; // additional JSON fields, already formatted (for example: ", \"drawCalls\": 100")
+	std::string perf; // the perf scopes (JSON members) hit while measuring. The scenarios that measure two things in the same loop share them
+};
+static std::vector<Result> results;
+
+// the counters of the perf scopes since the last call, as JSON members
+static std::string takePerfCounters()
+{
+	if (!tk::perf::isEnabled())
+		return {};
+	std::string json;
+	for (const auto& s : tk::perf::getTotalCounters()) {
+		if (s.calls == 0)
+			continue;
+		json += std::format("{}\"{}\": {{ \"calls\": {}", json.empty() ? "" : ", ", s.name, s.calls);
+		for (u32 i = 0; i < u32(tk::perf::Counter::COUNT); i++)
+			json += std::format(", \"{}\": {}", tk::perf::toString(tk::perf::Counter(i)), s.counters.values[i]);
+		json += std::format(", \"ipc\": {:.3f} }}", s.counters.ipc());
+	}
+	tk::perf::resetTotals();
+	return json;
+}
+
+static double percentile(CSpan<double> sorted, double p)
+{
+	assert(sorted.size());
+	const size_t i = size_t(p * double(sorted.size() - 1) + 0.5);
+	return sorted[std::min(i, sorted.size() - 1)];
+}
+
+static void addResult(Result&& r)
+{
+	std::sort(r.samplesMs.begin(), r.samplesMs.end());
+	double sum = 0;
+	for (double s : r.samplesMs)
+		sum += s;
+	const double mean = sum / double(r.samplesMs.size());
+	printf("%-28s n=%-7u m=%-5u mean=%9.3fms p50=%9.3fms p99=%9.3fms", r.scenario.c_str(), r.n, r.m, mean,
+		percentile(r.samplesMs, 0.5), percentile(r.samplesMs, 0.99));
+	if (r.bytesPerSample > 0)
+		printf(" (%.1f MB/s)", r.bytesPerSample / (1 << 20) / (mean * 1e-3));
+	printf("\n");
+	results.push_back(std::move(r));
+}
+
+static bool writeResults(CStr path)
+{
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		printf("could not open file for writing: %s\n", path);
+		return false;
+	}
+#ifdef TVK_NULL_BACKEND
+	const bool nullBackend = true;
+#else
+	const bool nullBackend = false;
+#endif
+	fprintf(file, "{\n\t\"nullBackend\": %s,\n\t\"results\": [\n", nullBackend ? "true" : "false");
+	for (size_t i = 0; i < results.size(); i++) {
+		const auto& r = results[i];
+		const CSpan<double> s = r.samplesMs;
+		double sum = 0;
+		for (double x : s)
+			sum += x;
+		const double mean = sum / double(s.size());
+		fprintf(file, "\t\t{ \"scenario\": \"%s\", \"n\": %u, \"m\": %u, \"samples\": %zu, "
+			"\"minMs\": %.6f, \"meanMs\": %.6f, \"p50Ms\": %.6f, \"p90Ms\": %.6f, \"p99Ms\": %.6f, \"maxMs\": %.6f",
+			r.scenario.c_str(), r.n, r.m, s.size(),
+			s.front(), mean, percentile(s, 0.5), percentile(s, 0.9), percentile(s, 0.99), s.back());
+		if (r.bytesPerSample > 0)
+			fprintf(file, ", \"mbPerSec\": %.3f", r.bytesPerSample / (1 << 20) / (mean * 1e-3));
+		if (r.perf.size())
+			fprintf(file, ", \"perf\": { %s }", r.perf.c_str());
+		fprintf(file, "%s }%s\n", r.extra.c_str(), i + 1 < results.size() ? "," : "");
+	}
+	fprintf(file, "\t]\n}\n");
+	fclose(file);
+	return true;
+}
+
+static bool scenarioEnabled(CStr name)
+{
+	return options.filter.empty() || strstr(name, options.filter.c_str());
+}
+
+// --- SHARED RESOURCES ---
+struct GridGeom {
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> texCoords;
+	std::vector<u32> indices;
+
+	tg::CreateGeomInfo createInfo()const {
+		return {
+			.positions = tk::asBytesSpan(CSpan<glm::vec3>(positions)),
+			.normals = tk::asBytesSpan(CSpan<glm::vec3>(normals)),
+			.texCoords = tk::asBytesSpan(CSpan<glm::vec2>(texCoords)),
+			.indices = tk::asBytesSpan(CSpan<u32>(indices)),
+			.numVerts = u32(positions.size()),
+			.numInds = u32(indices.size()),
+		};
+	}
+};
+
+// a flat grid of (n+1)x(n+1) vertices
+static GridGeom makeGridGeom(u32 n)
+{
+	GridGeom g;
+	for (u32 y = 0; y <= n; y++)
+	for (u32 x = 0; x <= n; x++) {
+		const glm::vec2 uv = glm::vec2(x, y) / float(n);
+		g.positions.push_back(glm::vec3(uv - 0.5f, 0));
+		g.normals.push_back(glm::vec3(0, 0, 1));
+		g.texCoords.push_back(uv);
+	}
+	for (u32 y = 0; y < n; y++)
+	for (u32 x = 0; x < n; x++) {
+		const u32 i = x + (n + 1) * y;
+		const u32 quad[] = { i, i + 1, i + n + 2, i, i + n + 2, i + n + 1 };
+		g.indices.insert(g.indices.end(), std::begin(quad), std::end(quad));
+	}
+	return g;
+}
+
+static tg::MeshRC g_mesh;
+
+// draws a frame, with the given viewports. Returns the CPU time of tg::draw (prepareDraw is excluded because it waits for the GPU)
+static double drawFrame(CSpan<tg::RenderWorldViewport> viewports)
+{
+	tg::prepareDraw();
+	const auto t0 = Clock::now();
+	tg::draw(viewports, {});
+	const double ms = msSince(t0);
+	TK_PROFILE_FRAME;
+	return ms;
+}
+
+// pumps frames, so the pending uploads and image loads can make progress
+static void drawEmptyFrames(u32 n)
+{
+	for (u32 i = 0; i < n; i++)
+		drawFrame({});
+}
+
+static tg::RenderWorldViewport makeViewport(tg::RenderWorldId RW, float distance)
+{
+	return {
+		.renderWorld = RW,
+		.viewMtx = glm::lookAt(glm::vec3(0, 0, distance), glm::vec3(0), glm::vec3(0, 1, 0)),
+		.projMtx = tk::PerspectiveCamera{}.projMtx_vk(float(k_screenW) / float(k_screenH)),
+		.viewport = {0, 0, float(k_screenW), float(k_screenH)},
+		.scissor = {0, 0, k_screenW, k_screenH},
+	};
+}
+
+// --- ECS SCENARIOS ---
+static void bench_entitiesCreateDestroy(tk::WorldId world, tk::EntityFactory_Renderable3d& factory, u32 n)
+{
+	Result create = { .scenario = "entities_create", .n = n, .m = 1 };
+	Result destroy = { .scenario = "entities_destroy", .n = n, .m = 1 };
+	std::vector<u32> entities(n);
+	tk::perf::resetTotals();
+	for (u32 iter = 0; iter < options.iterations; iter++) {
+		auto t0 = Clock::now();
+		{
+			TK_PERF_SCOPE("bench_entitiesCreate");
+			for (u32 i = 0; i < n; i++) {
+				const auto e = factory.create({
+					.position = glm::vec3(i % 100, i / 100, 0),
+					.separateMaterial = false,
+					.mesh = g_mesh,
+					.expectedMaxInstances = n,
+				});
+				entities[i] = e.ind;
+			}
+		}
+		create.samplesMs.push_back(msSince(t0));
+
+		t0 = Clock::now();
+		world->addEntitiesToDelete(entities);
+		world->update(0);
+		destroy.samplesMs.push_back(msSince(t0));
+	}
+	create.perf = destroy.perf = takePerfCounters();
+	addResult(std::move(create));
+	addResult(std::move(destroy));
+}
+
+static std::vector<tk::EntityId> createEntities(tk::EntityFactory_Renderable3d& factory, u32 n)
+{
+	std::vector<tk::EntityId> entities(n);
+	for (u32 i = 0; i < n; i++) {
+		entities[i] = factory.create({
+			.position = glm::vec3(i % 100, i / 100, 0),
+			.separateMaterial = false,
+			.mesh = g_mesh,
+			.expectedMaxInstances = n,
+		});
+	}
+	return entities;
+}
+
+static void destroyEntities(tk::WorldId world, CSpan<tk::EntityId> entities)
+{
+	std::vector<u32> inds(entities.size());
+	for (size_t i = 0; i < entities.size(); i++)
+		inds[i] = entities[i].ind;
+	world->addEntitiesToDelete(inds);
+	world->update(0);
+}
+
+// moves all the entities, and propagates their matrices to the render world
+static void bench_transformsUpdate(tk::WorldId world, tk::DefaultBasicWorldSystems& systems, u32 n)
+{
+	auto& factory = *systems.system_render->factory_renderable3d;
+	const auto entities = createEntities(factory, n);
+	Result r = { .scenario = "transforms_update", .n = n, .m = 1 };
+	tk::perf::resetTotals();
+	for (u32 iter = 0; iter < options.iterations; iter++) {
+		const auto t0 = Clock::now();
+		const glm::vec3 offset(0, 0, 0.01f * float(iter));
+		for (auto& p : factory.components_position3d)
+			p += offset;
+		world->update(1.f / 60);
+		systems.update(1.f / 60);
+		r.samplesMs.push_back(msSince(t0));
+	}
+	r.perf = takePerfCounters();
+	addResult(std::move(r));
+	destroyEntities(world, entities);
+}
+
+// reparents every entity under a random one, then resolves the world matrices of all of them
+static void bench_hierarchyReparent(tk::WorldId world, tk::EntityFactory_Renderable3d& factory, u32 n)
+{
+	const auto entities = createEntities(factory, n);
+	std::mt19937 rng(1234);
+	Result reparent = { .scenario = "hierarchy_reparent", .n = n, .m = 1 };
+	Result matrices = { .scenario = "hierarchy_matrices", .n = n, .m = 1 };
+	tk::perf::resetTotals();
+	for (u32 iter = 0; iter < options.iterations; iter++) {
+		// the parent always has a lower index than the child, so we never create cycles
+		auto t0 = Clock::now();
+		{
+			TK_PERF_SCOPE("bench_hierarchyReparent");
+			for (u32 i = 1; i < n; i++) {
+				const u32 parent = std::uniform_int_distribution<u32>(0, i - 1)(rng);
+				if (iter % 2)
+					world->setEntityAsFirstChildOf(entities[i], entities[parent]);
+				else
+					world->setEntityAsLastChildOf(entities[i], entities[parent]);
+			}
+		}
+		reparent.samplesMs.push_back(msSince(t0));
+
+		t0 = Clock::now();
+		{
+			TK_PERF_SCOPE("bench_hierarchyMatrices");
+			world->update(0); // invalidates the cached matrices
+			for (const auto& e : entities)
+				world->getMatrix(e.ind);
+		}
+		matrices.samplesMs.push_back(msSince(t0));
+	}
+	reparent.perf = matrices.perf = takePerfCounters();
+	addResult(std::move(reparent));
+	addResult(std::move(matrices));
+	destroyEntities(world, entities);
+}
+
+// --- RENDERER SCENARIOS ---
+// n objects, with m instances each
+static void bench_drawRenderWorld(u32 n, u32 m)
+{
+	auto RW = tg::createRenderWorld();
+	std::vector<glm::mat4> instanceMatrices(m);
+	for (u32 i = 0; i < n; i++) {
+		for (u32 j = 0; j < m; j++)
+			instanceMatrices[j] = glm::translate(glm::vec3(float(i % 32) - 16, float(j % 32) - 16, -float(i / 32 + j / 32)));
+		RW.createObjectWithInstancing(g_mesh, instanceMatrices);
+	}
+
+	const tg::RenderWorldViewport viewports[] = { makeViewport(RW, 30) };
+	drawEmptyFrames(4); // upload the instance matrices, and compile the pipelines
+	for (u32 i = 0; i < 4; i++)
+		drawFrame(viewports);
+
+	Result r = { .scenario = "draw_renderWorld", .n = n, .m = m };
+#ifdef TVK_NULL_BACKEND
+	tvk::null::resetSubmitStats();
+#endif
+	tk::perf::resetTotals();
+	for (u32 iter = 0; iter < options.iterations; iter++)
+		r.samplesMs.push_back(drawFrame(viewports));
+	r.perf = takePerfCounters();
+	const auto& frameStats = tg::getFrameStats();
+	r.extra = std::format(", \"drawCalls\": {}, \"pipelineBinds\": {}, \"descriptorSetBinds\": {}, \"vertexBufferBinds\": {}, \"triangles\": {}",
+		frameStats.drawCalls, frameStats.pipelineBinds, frameStats.descriptorSetBinds, frameStats.vertexBufferBinds, frameStats.triangles);
+#ifdef TVK_NULL_BACKEND
+	const auto submitStats = tvk::null::getSubmitStats();
+	r.extra += std::format(", \"cmdsPerFrame\": {:.1f}", double(submitStats.cmdCounts.total()) / options.iterations);
+#endif
+	addResult(std::move(r));
+	tg::destroyRenderWorld(RW);
+}
+
+static void bench_geomSerialization(u32 gridN)
+{
+	const auto grid = makeGridGeom(gridN);
+	const auto info = grid.createInfo();
+	const size_t memSize = tg::geom_serializeToMem(info, {});
+	std::vector<u8> mem(memSize);
+
+	Result serialize = { .scenario = "geom_serializeToMem", .n = info.numVerts, .m = 1, .bytesPerSample = double(memSize) };
+	for (u32 iter = 0; iter < options.iterations; iter++) {
+		const auto t0 = Clock::now();
+		tg::geom_serializeToMem(info, mem);
+		serialize.samplesMs.push_back(msSince(t0));
+	}
+	addResult(std::move(serialize));
+
+	Result reset = { .scenario = "geom_resetFromMemFile", .n = info.numVerts, .m = 1, .bytesPerSample = double(memSize) };
+	auto geom = tg::geom_create();
+	for (u32 iter = 0; iter < options.iterations; iter++) {
+		const auto t0 = Clock::now();
+		const bool ok = tg::geom_resetFromMemFile(geom, mem);
+		reset.samplesMs.push_back(msSince(t0));
+		assert(ok);
+		drawEmptyFrames(1); // let the upload go, so the staging memory doesn't pile up
+	}
+	addResult(std::move(reset));
+}
+
+static void writeToVector(void* context, void* data, int size)
+{
+	auto& v = *(std::vector<u8>*)context;
+	v.insert(v.end(), (const u8*)data, (const u8*)data + size);
+}
+
+// loads m PNG files of size n x n with getOrLoadImage, until they are all decoded and uploaded
+static void bench_imageLoad(u32 n, u32 m)
+{
+	std::vector<u8> pixels(4 * n * n);
+	for (u32 y = 0; y < n; y++)
+	for (u32 x = 0; x < n; x++) {
+		u8* p = &pixels[4 * (x + n * y)];
+		p[0] = u8(x);
+		p[1] = u8(y);
+		p[2] = u8(x ^ y);
+		p[3] = 255;
+	}
+	std::vector<u8> png;
+	stbi_write_png_to_func(writeToVector, &png, int(n), int(n), 4, pixels.data(), int(4 * n));
+
+	Result r = { .scenario = "image_load", .n = n, .m = m, .bytesPerSample = double(m) * pixels.size() };
+	std::vector<std::string> paths(m);
+	std::vector<tg::ImageRC> images(m);
+	for (u32 iter = 0; iter < options.iterations; iter++) {
+		// getOrLoadImage caches by path, so every iteration needs new files
+		for (u32 i = 0; i < m; i++) {
+			paths[i] = std::format("bench_img_{}_{}.png", iter, i);
+			auto file = PHYSFS_openWrite(paths[i].c_str());
+			if (!file) {
+				printf("could not open file for writing (%s): %s\n", paths[i].c_str(), PHYSFS_getLastError());
+				return;
+			}
+			PHYSFS_writeBytes(file, png.data(), png.size());
+			PHYSFS_close(file);
+		}
+
+		const auto t0 = Clock::now();
+		for (u32 i = 0; i < m; i++)
+			images[i] = tg::getOrLoadImage(paths[i], false);
+		for (bool done = false; !done; ) {
+			drawEmptyFrames(1);
+			done = true;
+			for (const auto& img : images)
+				done = done && img.id.isLoaded() && img.id.isReady();
+		}
+		r.samplesMs.push_back(msSince(t0));
+
+		for (u32 i = 0; i < m; i++) {
+			images[i] = {};
+			PHYSFS_delete(paths[i].c_str());
+		}
+	}
+	addResult(std::move(r));
+}
+
+// compiles all the permutations of the PBR shaders (the same defines that tg uses). There is one sample per permutation
+static void bench_shaderPermutations()
+{
+	auto& compiler = tg::getShaderCompiler();
+	Result r = { .scenario = "shader_permutations", .n = 0, .m = 1 };
+	for (u32 normals = 0; normals < 3; normals++) // none, normals, normals and tangents
+	for (u32 texCoords = 0; texCoords < 2; texCoords++)
+	for (u32 colors = 0; colors < 2; colors++)
+	for (u32 bindless = 0; bindless < 2; bindless++) {
+		const tk::PreprocDefine defines[] = {
+			{"MAX_DIR_LIGHTS", "4"},
+			{"HAS_NORMAL", normals ? "1" : "0"},
+			{"HAS_TANGENT", normals == 2 ? "1" : "0"},
+			{"HAS_TEXCOORD_0", texCoords ? "1" : "0"},
+			{"HAS_VERTCOLOR_0", colors ? "1" : "0"},
+			{"BINDLESS", bindless ? "1" : "0"},
+		};
+		const auto t0 = Clock::now();
+		const auto vertResult = compiler.glslToSpv("shaders/pbr.vert.glsl", defines);
+		const auto fragResult = compiler.glslToSpv("shaders/pbr.frag.glsl", defines);
+		r.samplesMs.push_back(msSince(t0));
+		if (!vertResult.ok() || !fragResult.ok()) {
+			printf("Error compiling the PBR shaders:\n%s\n%s\n", vertResult.getErrorMsgs().c_str(), fragResult.getErrorMsgs().c_str());
+			return;
+		}
+		r.n++;
+	}
+	addResult(std::move(r));
+}
+
+static bool parseArgs(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++) {
+		const bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--filter") && hasValue)
+			options.filter = argv[++i];
+		else if (!strcmp(argv[i], "--iterations") && hasValue)
+			options.iterations = std::max(1, atoi(argv[++i]));
+		else if (!strcmp(argv[i], "--out") && hasValue)
+			options.outPath = argv[++i];
+		else if (!strcmp(argv[i], "--trace") && hasValue)
+			options.tracePath = argv[++i];
+		else if (!strcmp(argv[i], "--perf"))
+			options.perf = true;
+		else {
+			printf("usage: %s [--filter <substring>] [--iterations <k>] [--out <file.json>] [--trace <file.json>] [--perf]\n", argv[0]);
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (!parseArgs(argc, argv))
+		return 1;
+	tk::profiler::setEnabled(options.tracePath.size());
+	if (options.perf && !tk::perf::setEnabled(true))
+		return 1;
+
+	const tvk::AppInfo info = { .apiVersion = {1, 3, 0}, .appName = "tuki bench" };
+	VkInstance instance = tvk::createInstance(info, {}, {});
+
+	tk::init(argv[0]);
+
+	tg::initRenderUniverse({
+		.instance = instance,
+		.surface = VK_NULL_HANDLE,
+		.screenW = k_screenW, .screenH = k_screenH,
+		.headless = true,
+		.gpuTimings = false,
+	});
+
+	auto world = tk::createWorld();
+	auto systems = world->createDefaultBasicSystems();
+	defer(systems.destroy());
+	defer(tk::destroyWorld(world));
+	auto& factory = *systems.system_render->factory_renderable3d;
+
+	auto& pbrMgr = *tg::PbrMaterialManager::s_getOrCreate();
+	{
+		const auto grid = makeGridGeom(4);
+		auto geom = tg::geom_createFromInfo(grid.createInfo());
+		g_mesh = tg::makeMesh({ .geom = geom, .material = pbrMgr.createMaterial({}) });
+	}
+	defer(g_mesh = {});
+	drawEmptyFrames(2);
+
+	for (u32 n : { 1000u, 10000u, 100000u }) {
+		if (scenarioEnabled("entities_create") || scenarioEnabled("entities_destroy"))
+			bench_entitiesCreateDestroy(world, factory, n);
+		if (scenarioEnabled("transforms_update"))
+			bench_transformsUpdate(world, systems, n);
+		if (scenarioEnabled("hierarchy_reparent") || scenarioEnabled("hierarchy_matrices"))
+			bench_hierarchyReparent(world, factory, n);
+	}
+
+	if (scenarioEnabled("draw_renderWorld")) {
+		const u32 sizes[][2] = { {100, 1}, {1000, 1}, {10000, 1}, {100, 100}, {1000, 100} };
+		for (const auto& nm : sizes)
+			bench_drawRenderWorld(nm[0], nm[1]);
+	}
+
+	if (scenarioEnabled("geom_serializeToMem") || scenarioEnabled("geom_resetFromMemFile")) {
+		for (u32 gridN : { 16u, 256u, 1024u })
+			bench_geomSerialization(gridN);
+	}
+
+	if (scenarioEnabled("image_load")) {
+		bench_imageLoad(256, 16);
+		bench_imageLoad(1024, 4);
+	}
+
+	if (scenarioEnabled("shader_permutations"))
+		bench_shaderPermutations();
+
+	if (!writeResults(options.outPath.c_str()))
+		return 1;
+	printf("results written to %s\n", options.outPath.c_str());
+	if (options.tracePath.size() && tk::profiler::dumpChromeTrace(options.tracePath.c_str()))
+		printf("trace written to %s\n", options.tracePath.c_str());
+	return 0;
+}
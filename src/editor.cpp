@@ -11,7 +11,7 @@
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_vulkan.h>
 #include <physfs.h>
-#include <Tracy.hpp>
+#include <profiler.hpp>
 
 namespace tvk = tk::vk;
 using tk::CSpan;
@@ -21,7 +21,7 @@ using tk::u32;
 
 static const bool imguiEnable = true;
 
-static const CStr k_imageFileExtensions[] = { ".png", ".jpg" };
+static const CStr k_imageFileExtensions[] = { ".png", ".jpg", ".ktx2", ".dds" };
 
 static u32 cubeInds[6*6] = {
 	0, 1, 3, 0, 3, 2,
@@ -269,7 +269,7 @@ static void deleteSelectedEntities(tk::WorldId mainWorld)
 
 static void imgui_hierarchy(tk::WorldId mainWorld)
 {
-	ZoneScoped;
+	TK_PROFILE_SCOPE;
 	ImGui::Begin("scene");
 	tk::EntityId e = mainWorld->getRootEntity().firstChild();
 	int i = 0;
@@ -399,13 +399,14 @@ struct FilePreviews {
 
 			const tg::ImageInfo imgInfo = img.id.getInfo();
 			
-			if (aspectRatio == 0) { // initial window size
+			if (aspectRatio == 0 && img.id.isLoaded()) { // initial window size (we need to wait for the image to be loaded to know its size)
 				const auto initialWindowSize = calcInitialWindowSize(imgInfo);
-				ImGui::SetNextWindowSize(initialWindowSize, ImGuiCond_Appearing);
+				ImGui::SetNextWindowSize(initialWindowSize);
 				aspectRatio = initialWindowSize.x / initialWindowSize.y;
 			}
 			
-			ImGui::SetNextWindowSizeConstraints(glm::vec2(32, 32), glm::vec2(10 << 10, 10 << 10), windowResizeConstraintCallback, this);
+			if (aspectRatio != 0)
+				ImGui::SetNextWindowSizeConstraints(glm::vec2(32, 32), glm::vec2(10 << 10, 10 << 10), windowResizeConstraintCallback, this);
 
 			bool open = true;
 			ImGui::Begin(path.c_str(), &open, windowFlags);
@@ -575,7 +576,7 @@ struct FilePreviews {
 
 	void update(float dt)
 	{
-		ZoneScoped;
+		TK_PROFILE_SCOPE;
 		auto updatePreviews = [dt](auto& previews) {
 			for (auto& p : previews)
 				p.update(dt);
@@ -586,7 +587,7 @@ struct FilePreviews {
 
 	void draw()
 	{
-		ZoneScoped;
+		TK_PROFILE_SCOPE;
 		auto drawPreviews = [](auto& previews) {
 			for (size_t i = 0; i < previews.size(); ) {
 				const bool toClose = previews[i].draw();
@@ -748,7 +749,7 @@ struct ProjectExplorer
 
 	void draw()
 	{
-		ZoneScoped;
+		TK_PROFILE_SCOPE;
 		ImGui::Begin("project");
 
 		tmpPath[0] = '\0';
@@ -927,6 +928,8 @@ int main(int argc, char** argv)
 
 		if (imguiEnable) {
 			imgui_hierarchy(mainWorld);
+			tg::imgui_frameStatsOverlay();
+			tg::imgui_memoryStats();
 			ImGui::ShowDemoWindow();
 			projectExplorer.draw();
 			filePreviews.draw();
@@ -945,7 +948,7 @@ int main(int argc, char** argv)
 		filePreviews.getRenderTargetsViewports(renderTargetsViewports);
 
 		tg::draw(mainViewports, renderTargetsViewports);
-		FrameMark;
+		TK_PROFILE_FRAME;
 	}
 
 	return 0;
@@ -0,0 +1,519 @@
+// Offline texture converter: encodes images into block-compressed KTX2 files, with the mip chain precomputed.
+// The format is chosen from the file name, depending on the kind of data it stores:
+//   - normal maps: BC5 (only X and Y are stored, Z is reconstructed in the shader)
+//   - metallic-roughness maps: BC5 (our shaders read metallic from R and roughness from G)
+//   - single-channel maps (roughness, metallic, occlusion, height, masks): BC4
+//   - everything else is considered color (albedo): sRGB BC7
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <float.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <filesystem>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <stb_image.h>
+#include <tg.hpp>
+#include <texture_files.hpp>
+
+namespace fs = std::filesystem;
+namespace tvk = tk::vk;
+namespace tg = tk::gfx;
+using tk::CSpan;
+using tk::CStr;
+using tk::u8;
+using tk::u16;
+using tk::u32;
+using tk::u64;
+
+static const CStr k_inputExtensions[] = { ".png", ".jpg", ".jpeg", ".tga", ".bmp" };
+
+enum class Kind { color, normal, metallicRoughness, singleChannel };
+
+struct Image {
+	u32 w = 0, h = 0;
+	std::vector<glm::vec4> pixels; // [0, 1]. Color is in linear space
+	glm::vec4& at(u32 x, u32 y) { return pixels[x + w * y]; }
+	const glm::vec4& at(u32 x, u32 y)const { return pixels[x + w * y]; }
+};
+
+struct Options {
+	std::vector<fs::path> inputs;
+	fs::path outputFolder; // empty: next to the input files
+	tvk::Format forcedFormat = tvk::Format::undefined;
+	bool generateMips = true;
+	bool force = false; // convert even if the output is more recent than the input
+};
+
+// --- COLOR SPACE ---
+static float srgbToLinear(float x) { return x <= 0.04045f ? x / 12.92f : glm::pow((x + 0.055f) / 1.055f, 2.4f); }
+static float linearToSrgb(float x) { return x <= 0.0031308f ? x * 12.92f : 1.055f * glm::pow(x, 1.f / 2.4f) - 0.055f; }
+
+static u8 toU8(float x) { return u8(glm::clamp(x, 0.f, 1.f) * 255.f + 0.5f); }
+
+// --- KIND DEDUCTION ---
+static Kind deduceKind(const fs::path& path)
+{
+	std::string name = path.stem().string();
+	std::transform(name.begin(), name.end(), name.begin(), [](char c) { return char(tolower(c)); });
+	auto has = [&name](CStr s) { return name.find(s) != std::string::npos; };
+	if (has("normal") || has("_nrm") || name.ends_with("_n"))
+		return Kind::normal;
+	if (has("metallicroughness") || has("metalroughness") || has("metallic_roughness") || has("_mr"))
+		return Kind::metallicRoughness;
+	if (has("roughness") || has("metallic") || has("occlusion") || name.ends_with("_ao") || has("height") || has("mask") || has("gloss"))
+		return Kind::singleChannel;
+	return Kind::color;
+}
+
+static tvk::Format formatForKind(Kind kind)
+{
+	switch (kind) {
+	case Kind::normal: return tvk::Format::COMPR_BC5_UNORM;
+	case Kind::metallicRoughness: return tvk::Format::COMPR_BC5_UNORM;
+	case Kind::singleChannel: return tvk::Format::COMPR_BC4_UNORM;
+	default: return tvk::Format::COMPR_BC7_SRGB;
+	}
+}
+
+static bool isSrgb(tvk::Format format)
+{
+	return format == tvk::Format::COMPR_BC1_RGB_SRGB || format == tvk::Format::COMPR_BC1_RGBA_SRGB ||
+		format == tvk::Format::COMPR_BC3_SRGB || format == tvk::Format::COMPR_BC7_SRGB;
+}
+
+// --- MIP CHAIN ---
+static Image downsample(const Image& src, Kind kind)
+{
+	Image dst;
+	dst.w = glm::max(1u, src.w / 2);
+	dst.h = glm::max(1u, src.h / 2);
+	dst.pixels.resize(dst.w * dst.h);
+	for (u32 y = 0; y < dst.h; y++)
+	for (u32 x = 0; x < dst.w; x++) {
+		const u32 x0 = glm::min(2 * x, src.w - 1), x1 = glm::min(2 * x + 1, src.w - 1);
+		const u32 y0 = glm::min(2 * y, src.h - 1), y1 = glm::min(2 * y + 1, src.h - 1);
+		glm::vec4 p = 0.25f * (src.at(x0, y0) + src.at(x1, y0) + src.at(x0, y1) + src.at(x1, y1));
+		if (kind == Kind::normal) {
+			glm::vec3 n = glm::vec3(p) * 2.f - 1.f;
+			const float len = glm::length(n);
+			n = len > 0.f ? n / len : glm::vec3(0, 0, 1);
+			p = glm::vec4(n * 0.5f + 0.5f, p.a);
+		}
+		dst.at(x, y) = p;
+	}
+	return dst;
+}
+
+// --- BLOCK ENCODERS ---
+// all the encoders take a 4x4 block of texels in the [0, 255] range, in row order
+
+// principal axis of the colors, with a few iterations of the power method
+template <int N>
+static glm::vec<N, float> calcPrincipalAxis(const glm::vec<N, float> (&colors)[16], glm::vec<N, float> mean)
+{
+	float cov[N][N] = {};
+	for (const auto& c : colors) {
+		const auto d = c - mean;
+		for (int i = 0; i < N; i++)
+		for (int j = 0; j < N; j++)
+			cov[i][j] += d[i] * d[j];
+	}
+	glm::vec<N, float> axis(1.f);
+	for (int iter = 0; iter < 8; iter++) {
+		glm::vec<N, float> next(0.f);
+		for (int i = 0; i < N; i++)
+		for (int j = 0; j < N; j++)
+			next[i] += cov[i][j] * axis[j];
+		const float len = glm::length(next);
+		if (len < 1e-6f)
+			break;
+		axis = next / len;
+	}
+	return axis;
+}
+
+// range fit: the endpoints are the extremes of the projections of the colors onto the principal axis
+template <int N>
+static void calcEndpoints(const glm::vec<N, float> (&colors)[16], glm::vec<N, float>& e0, glm::vec<N, float>& e1)
+{
+	glm::vec<N, float> mean(0.f);
+	for (const auto& c : colors)
+		mean += c;
+	mean /= 16.f;
+	const auto axis = calcPrincipalAxis<N>(colors, mean);
+	float minT = 0, maxT = 0;
+	for (const auto& c : colors) {
+		const float t = glm::dot(c - mean, axis);
+		minT = glm::min(minT, t);
+		maxT = glm::max(maxT, t);
+	}
+	e0 = glm::clamp(mean + axis * maxT, 0.f, 255.f);
+	e1 = glm::clamp(mean + axis * minT, 0.f, 255.f);
+}
+
+struct BitWriter {
+	u64 bits[2] = {};
+	u32 pos = 0;
+	void write(u32 value, u32 numBits) {
+		for (u32 i = 0; i < numBits; i++, pos++)
+			bits[pos / 64] |= u64((value >> i) & 1) << (pos % 64);
+	}
+};
+
+static u16 packRgb565(glm::vec3 c)
+{
+	return u16((u32(c.r * 31.f / 255.f + 0.5f) << 11) | (u32(c.g * 63.f / 255.f + 0.5f) << 5) | u32(c.b * 31.f / 255.f + 0.5f));
+}
+
+static glm::vec3 unpackRgb565(u16 c)
+{
+	const u32 r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	return glm::vec3((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+}
+
+static void encodeBc1(u8* out, const glm::vec4 (&block)[16])
+{
+	glm::vec3 colors[16];
+	for (int i = 0; i < 16; i++)
+		colors[i] = glm::vec3(block[i]);
+	glm::vec3 e0, e1;
+	calcEndpoints<3>(colors, e0, e1);
+	u16 c0 = packRgb565(e0), c1 = packRgb565(e1);
+	if (c0 < c1)
+		std::swap(c0, c1); // c0 > c1 selects the 4 colors mode
+
+	u32 indices = 0;
+	if (c0 != c1) {
+		const glm::vec3 p0 = unpackRgb565(c0), p1 = unpackRgb565(c1);
+		const glm::vec3 palette[4] = { p0, p1, (2.f * p0 + p1) / 3.f, (p0 + 2.f * p1) / 3.f };
+		for (int i = 0; i < 16; i++) {
+			u32 best = 0;
+			float bestDist = FLT_MAX;
+			for (u32 j = 0; j < 4; j++) {
+				const glm::vec3 d = colors[i] - palette[j];
+				const float dist = glm::dot(d, d);
+				if (dist < bestDist) {
+					bestDist = dist;
+					best = j;
+				}
+			}
+			indices |= best << (2 * i);
+		}
+	}
+	memcpy(out + 0, &c0, 2);
+	memcpy(out + 2, &c1, 2);
+	memcpy(out + 4, &indices, 4);
+}
+
+// one channel, in the 8 values mode. Also used for the alpha of BC3, and for each channel of BC5
+static void encodeBc4(u8* out, const float (&values)[16])
+{
+	float minV = 255, maxV = 0;
+	for (float v : values) {
+		minV = glm::min(minV, v);
+		maxV = glm::max(maxV, v);
+	}
+	const u8 r0 = u8(maxV + 0.5f), r1 = u8(minV + 0.5f);
+	float palette[8] = { float(r0), float(r1) };
+	for (int i = 2; i < 8; i++)
+		palette[i] = float((8 - i) * r0 + (i - 1) * r1) / 7.f;
+
+	u64 bits = u64(r0) | (u64(r1) << 8);
+	if (r0 != r1) {
+		for (int i = 0; i < 16; i++) {
+			u32 best = 0;
+			for (u32 j = 1; j < 8; j++)
+				if (glm::abs(values[i] - palette[j]) < glm::abs(values[i] - palette[best]))
+					best = j;
+			bits |= u64(best) << (16 + 3 * i);
+		}
+	}
+	memcpy(out, &bits, 8);
+}
+
+static void encodeBc4Channel(u8* out, const glm::vec4 (&block)[16], int channel)
+{
+	float values[16];
+	for (int i = 0; i < 16; i++)
+		values[i] = block[i][channel];
+	encodeBc4(out, values);
+}
+
+static void encodeBc3(u8* out, const glm::vec4 (&block)[16])
+{
+	encodeBc4Channel(out, block, 3);
+	encodeBc1(out + 8, block);
+}
+
+static void encodeBc5(u8* out, const glm::vec4 (&block)[16])
+{
+	encodeBc4Channel(out, block, 0);
+	encodeBc4Channel(out + 8, block, 1);
+}
+
+// only mode 6 (one subset, RGBA 7.7.7.7 endpoints with a unique p-bit, 4-bit indices). It's a good fit for smooth color data, and simple to encode
+static void encodeBc7(u8* out, const glm::vec4 (&block)[16])
+{
+	static const u32 k_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	glm::vec4 e[2];
+	calcEndpoints<4>(block, e[0], e[1]);
+
+	// quantize the endpoints to 7 bits + p-bit, choosing the p-bit that minimizes the error
+	glm::uvec4 q[2];
+	u32 p[2];
+	glm::vec4 ep[2]; // the actual 8-bit endpoints
+	for (int i = 0; i < 2; i++) {
+		float bestErr = FLT_MAX;
+		for (u32 pbit = 0; pbit < 2; pbit++) {
+			const glm::uvec4 qi = glm::uvec4(glm::clamp((e[i] - float(pbit)) / 2.f + 0.5f, 0.f, 127.f));
+			const glm::vec4 v = glm::vec4((qi << 1u) | pbit);
+			const glm::vec4 d = v - e[i];
+			const float err = glm::dot(d, d);
+			if (err < bestErr) {
+				bestErr = err;
+				q[i] = qi;
+				p[i] = pbit;
+				ep[i] = v;
+			}
+		}
+	}
+
+	u32 indices[16];
+	for (int i = 0; i < 16; i++) {
+		float bestDist = FLT_MAX;
+		for (u32 j = 0; j < 16; j++) {
+			const glm::vec4 c = glm::floor(((64.f - k_weights[j]) * ep[0] + float(k_weights[j]) * ep[1] + 32.f) / 64.f);
+			const glm::vec4 d = block[i] - c;
+			const float dist = glm::dot(d, d);
+			if (dist < bestDist) {
+				bestDist = dist;
+				indices[i] = j;
+			}
+		}
+	}
+	// the MSB of the first index is implicitly 0: swap the endpoints if needed
+	if (indices[0] & 8) {
+		std::swap(q[0], q[1]);
+		std::swap(p[0], p[1]);
+		for (u32& index : indices)
+			index = 15 - index;
+	}
+
+	BitWriter w;
+	w.write(1 << 6, 7); // mode 6
+	for (int c = 0; c < 4; c++) {
+		w.write(q[0][c], 7);
+		w.write(q[1][c], 7);
+	}
+	w.write(p[0], 1);
+	w.write(p[1], 1);
+	w.write(indices[0], 3);
+	for (int i = 1; i < 16; i++)
+		w.write(indices[i], 4);
+	memcpy(out, w.bits, 16);
+}
+
+static void encodeLevel(std::vector<u8>& out, const Image& img, tvk::Format format)
+{
+	using F = tvk::Format;
+	const bool srgb = isSrgb(format);
+	const u32 blockBytes = tvk::getFormatBlockInfo(format).bytes;
+	const u32 numBlocksX = (img.w + 3) / 4, numBlocksY = (img.h + 3) / 4;
+	const size_t start = out.size();
+	out.resize(start + size_t(numBlocksX) * numBlocksY * blockBytes);
+	u8* dst = out.data() + start;
+	for (u32 by = 0; by < numBlocksY; by++)
+	for (u32 bx = 0; bx < numBlocksX; bx++) {
+		glm::vec4 block[16];
+		for (u32 y = 0; y < 4; y++)
+		for (u32 x = 0; x < 4; x++) {
+			// the blocks at the borders are padded by repeating the last texels
+			glm::vec4 c = img.at(glm::min(4 * bx + x, img.w - 1), glm::min(4 * by + y, img.h - 1));
+			if (srgb)
+				c = glm::vec4(linearToSrgb(c.r), linearToSrgb(c.g), linearToSrgb(c.b), c.a);
+			block[x + 4 * y] = glm::vec4(toU8(c.r), toU8(c.g), toU8(c.b), toU8(c.a));
+		}
+		switch (format) {
+		case F::COMPR_BC1_RGB_UNORM: case F::COMPR_BC1_RGB_SRGB: encodeBc1(dst, block); break;
+		case F::COMPR_BC3_UNORM: case F::COMPR_BC3_SRGB: encodeBc3(dst, block); break;
+		case F::COMPR_BC4_UNORM: encodeBc4Channel(dst, block, 0); break;
+		case F::COMPR_BC5_UNORM: encodeBc5(dst, block); break;
+		case F::COMPR_BC7_UNORM: case F::COMPR_BC7_SRGB: encodeBc7(dst, block); break;
+		default: assert(false);
+		}
+		dst += blockBytes;
+	}
+}
+
+// --- FILES ---
+static bool loadImage(Image& img, const fs::path& path, bool srgb)
+{
+	int w, h, nc;
+	u8* data = stbi_load(path.string().c_str(), &w, &h, &nc, 4);
+	if (!data) {
+		printf("Error loading %s: %s\n", path.string().c_str(), stbi_failure_reason());
+		return false;
+	}
+	img.w = u32(w);
+	img.h = u32(h);
+	img.pixels.resize(img.w * img.h);
+	for (u32 i = 0; i < img.w * img.h; i++) {
+		glm::vec4 c = glm::vec4(data[4 * i], data[4 * i + 1], data[4 * i + 2], data[4 * i + 3]) / 255.f;
+		if (srgb)
+			c = glm::vec4(srgbToLinear(c.r), srgbToLinear(c.g), srgbToLinear(c.b), c.a);
+		img.pixels[i] = c;
+	}
+	stbi_image_free(data);
+	return true;
+}
+
+static bool convertFile(const fs::path& inPath, const fs::path& outPath, const Options& options)
+{
+	const Kind kind = deduceKind(inPath);
+	const tvk::Format format = options.forcedFormat != tvk::Format::undefined ? options.forcedFormat : formatForKind(kind);
+
+	Image img;
+	if (!loadImage(img, inPath, isSrgb(format)))
+		return false;
+	if (img.w > 0xFFFF || img.h > 0xFFFF) {
+		printf("Error: %s is too big\n", inPath.string().c_str());
+		return false;
+	}
+
+	tg::TextureFile tex = {
+		.format = format,
+		.w = img.w, .h = img.h,
+		.numMips = options.generateMips ? tg::calcNumMipsFromDimensions(img.w, img.h) : u8(1),
+	};
+	tex.data.reserve(tg::calcImageSize(format, img.w, img.h, tex.numMips));
+	for (u8 level = 0; level < tex.numMips; level++) {
+		if (level)
+			img = downsample(img, kind);
+		encodeLevel(tex.data, img, format);
+	}
+
+	const std::vector<u8> fileData = tg::writeKtx2(tex);
+	fs::create_directories(outPath.parent_path());
+	FILE* file = fopen(outPath.string().c_str(), "wb");
+	if (!file) {
+		printf("Error: couldn't open %s for writing\n", outPath.string().c_str());
+		return false;
+	}
+	fwrite(fileData.data(), 1, fileData.size(), file);
+	fclose(file);
+	return true;
+}
+
+static bool isInputFile(const fs::path& path)
+{
+	std::string ext = path.extension().string();
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return char(tolower(c)); });
+	for (CStr inExt : k_inputExtensions)
+		if (ext == inExt)
+			return true;
+	return false;
+}
+
+static tvk::Format parseFormat(std::string_view s)
+{
+	using F = tvk::Format;
+	if (s == "bc1") return F::COMPR_BC1_RGB_UNORM;
+	if (s == "bc1_srgb") return F::COMPR_BC1_RGB_SRGB;
+	if (s == "bc3") return F::COMPR_BC3_UNORM;
+	if (s == "bc3_srgb") return F::COMPR_BC3_SRGB;
+	if (s == "bc4") return F::COMPR_BC4_UNORM;
+	if (s == "bc5") return F::COMPR_BC5_UNORM;
+	if (s == "bc7") return F::COMPR_BC7_UNORM;
+	if (s == "bc7_srgb") return F::COMPR_BC7_SRGB;
+	return F::undefined;
+}
+
+static void printUsage()
+{
+	printf(
+		"usage: tuki_texconv [options] <files or folders>...\n"
+		"Converts images to block-compressed KTX2 files, with the mip chain precomputed. Folders are processed recursively\n"
+		"  -o <folder>   output folder (by default, the KTX2 files are placed next to the images)\n"
+		"  -f <format>   bc1, bc1_srgb, bc3, bc3_srgb, bc4, bc5, bc7, bc7_srgb (by default, it's deduced from the file name)\n"
+		"  --no-mips     don't generate the mip chain\n"
+		"  --force       convert even if the KTX2 file is up to date\n");
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++) {
+		const std::string_view arg = argv[i];
+		if (arg == "-o" && i + 1 < argc)
+			options.outputFolder = argv[++i];
+		else if (arg == "-f" && i + 1 < argc) {
+			options.forcedFormat = parseFormat(argv[++i]);
+			if (options.forcedFormat == tvk::Format::undefined) {
+				printf("unknown format: %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (arg == "--no-mips")
+			options.generateMips = false;
+		else if (arg == "--force")
+			options.force = true;
+		else if (arg.starts_with("-")) {
+			printUsage();
+			return arg == "-h" || arg == "--help" ? 0 : 1;
+		}
+		else
+			options.inputs.push_back(argv[i]);
+	}
+	if (options.inputs.empty()) {
+		printUsage();
+		return 1;
+	}
+
+	// gather the jobs
+	struct Job { fs::path in, out; };
+	std::vector<Job> jobs;
+	auto addJob = [&](const fs::path& in, const fs::path& root) {
+		fs::path out = options.outputFolder.empty() ? in : options.outputFolder / fs::relative(in, root);
+		out.replace_extension(".ktx2");
+		std::error_code ec;
+		if (!options.force && fs::exists(out) && fs::last_write_time(out, ec) >= fs::last_write_time(in, ec))
+			return; // up to date
+		jobs.push_back({ in, out });
+	};
+	for (const auto& input : options.inputs) {
+		if (fs::is_directory(input)) {
+			for (const auto& entry : fs::recursive_directory_iterator(input))
+				if (entry.is_regular_file() && isInputFile(entry.path()))
+					addJob(entry.path(), input);
+		}
+		else if (fs::is_regular_file(input))
+			addJob(input, input.parent_path());
+		else
+			printf("Error: %s doesn't exist\n", input.string().c_str());
+	}
+
+	// the files are independent, so we convert them in parallel
+	std::atomic<size_t> nextJob = 0;
+	std::atomic<u32> numErrors = 0;
+	auto worker = [&]() {
+		for (size_t i = nextJob++; i < jobs.size(); i = nextJob++) {
+			if (convertFile(jobs[i].in, jobs[i].out, options))
+				printf("%s -> %s\n", jobs[i].in.string().c_str(), jobs[i].out.string().c_str());
+			else
+				numErrors++;
+		}
+	};
+	std::vector<std::thread> threads(glm::max(1u, std::thread::hardware_concurrency()));
+	for (auto& thread : threads)
+		thread = std::thread(worker);
+	for (auto& thread : threads)
+		thread.join();
+
+	printf("converted %zu files (%u errors)\n", jobs.size() - numErrors, u32(numErrors));
+	return numErrors ? 1 : 0;
+}